@@ -38,6 +38,7 @@ let options = {
     warn_on_undeclared: false,
     frozen_global: false,
     record_types: false,
+    shadow_stack: false,
     output_filename: null,
     show_help: false,
     leave_temp_files: false,
@@ -166,6 +167,10 @@ let args = {
         flag:    "record_types",
         help:    "generates an executable which records types in a format later used for optimizations."
     },
+    "--shadow-stack": {
+        flag:    "shadow_stack",
+        help:    "generated code registers its stack slots with the gc precisely, and only the runtime's own frames are scanned conservatively."
+    },
     "--frozen-global": {
         flag:    "frozen_global",
         help:    "compiler acts as if the global object is frozen after initialization, allowing for faster access."
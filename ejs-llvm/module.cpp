@@ -100,6 +100,9 @@ namespace ejsllvm {
         if (!strcmp (id.c_str(), "@llvm.gcroot")) {
             intrinsic_id = llvm::Intrinsic::gcroot;
         }
+        else if (!strcmp (id.c_str(), "@llvm.frameaddress")) {
+            intrinsic_id = llvm::Intrinsic::frameaddress;
+        }
         else {
             abort();
         }
@@ -8,6 +8,13 @@ import * as consts from './consts';
 
 let ir = llvm.IRBuilder;
 
+// the sret abi hides an ejsval return type in the llvm signature, so remember it on the function.
+// --shadow-stack roots the results of calls to these.
+function returnsEjsValue (ret_type, func) {
+    func.returns_ejsval = ret_type === types.EjsValue;
+    return func;
+}
+
 // our base ABI class assumes that there are no restrictions on
 // EjsValue types, and that they can be passed by value and returned by
 // value with no modification to signatures or callsites.
@@ -52,7 +59,7 @@ export class ABI {
     createCall (fromFunction, callee, argv, callname) { return ir.createCall(callee, argv, callname); }
     createInvoke (fromFunction, callee, argv, normal_block, exc_block, callname) { return ir.createInvoke(callee, argv, normal_block, exc_block, callname); }
     createRet (fromFunction, value) { return ir.createRet(value); }
-    createExternalFunction (inModule, name, ret_type, param_types) { return inModule.getOrInsertExternalFunction(name, ret_type, param_types); }
-    createFunction (inModule, name, ret_type, param_types) { return inModule.getOrInsertFunction(name, ret_type, param_types); }
+    createExternalFunction (inModule, name, ret_type, param_types) { return returnsEjsValue(ret_type, inModule.getOrInsertExternalFunction(name, ret_type, param_types)); }
+    createFunction (inModule, name, ret_type, param_types) { return returnsEjsValue(ret_type, inModule.getOrInsertFunction(name, ret_type, param_types)); }
     createFunctionType (ret_type, param_types) { return llvm.FunctionType.get(ret_type, param_types); }
 }
@@ -29,6 +29,33 @@ let ir = llvm.IRBuilder;
 
 let hasOwn = Object.prototype.hasOwnProperty;
 
+// binary operators with an open-coded path when both operands are numbers, see emitNumericBinop.
+// "double" ops produce a double, "compare" ops an i1, and "int32" ops work on ToInt32 of both sides.
+function shiftCount (r) { return ir.createAnd(r, consts.int32(31), "shift_count"); }
+let numericBinops = {
+    "+":   ["double",  (l, r) => ir.createFAdd(l, r, "fadd")],
+    "-":   ["double",  (l, r) => ir.createFSub(l, r, "fsub")],
+    "*":   ["double",  (l, r) => ir.createFMul(l, r, "fmul")],
+    "/":   ["double",  (l, r) => ir.createFDiv(l, r, "fdiv")],
+    "%":   ["double",  (l, r) => ir.createFRem(l, r, "frem")],
+    "<":   ["compare", (l, r) => ir.createFCmpOLt(l, r, "fcmp_lt")],
+    "<=":  ["compare", (l, r) => ir.createFCmpOLe(l, r, "fcmp_le")],
+    ">":   ["compare", (l, r) => ir.createFCmpOGt(l, r, "fcmp_gt")],
+    ">=":  ["compare", (l, r) => ir.createFCmpOGe(l, r, "fcmp_ge")],
+    "==":  ["compare", (l, r) => ir.createFCmpOEq(l, r, "fcmp_eq")],
+    "===": ["compare", (l, r) => ir.createFCmpOEq(l, r, "fcmp_eq")],
+    "!=":  ["compare", (l, r) => ir.createFCmpUNe(l, r, "fcmp_ne")],
+    "!==": ["compare", (l, r) => ir.createFCmpUNe(l, r, "fcmp_ne")],
+    "&":   ["int32",   (l, r) => ir.createSIToFP(ir.createAnd(l, r, "and"), types.Double, "and_num")],
+    "|":   ["int32",   (l, r) => ir.createSIToFP(ir.createOr(l, r, "or"), types.Double, "or_num")],
+    "^":   ["int32",   (l, r) => ir.createSIToFP(ir.createXor(l, r, "xor"), types.Double, "xor_num")],
+    "<<":  ["int32",   (l, r) => ir.createSIToFP(ir.createShl(l, shiftCount(r), "shl"), types.Double, "shl_num")],
+    ">>":  ["int32",   (l, r) => ir.createSIToFP(ir.createAShr(l, shiftCount(r), "ashr"), types.Double, "ashr_num")],
+    ">>>": ["int32",   (l, r) => ir.createUIToFP(ir.createLShr(l, shiftCount(r), "lshr"), types.Double, "lshr_num")]
+};
+
+function isNumberLiteral (n) { return n.type === b.Literal && typeof n.value === "number"; }
+
 class LLVMIRVisitor extends TreeVisitor {
     constructor (module, filename, options, abi, allModules, this_module_info) {
         this.module = module;
@@ -115,11 +142,15 @@ class LLVMIRVisitor extends TreeVisitor {
             builtinUndefined  : true,
             isNullOrUndefined : false, // causes a crash when self-hosting
             isUndefined       : true,
-            isNull            : true
+            isNull            : true,
+
+            elementAccess     : true, // obj[n] on dense arrays, see emitElementAccess
+            numericBinops     : true  // number op number, see emitNumericBinop
         };
         
         this.llvm_intrinsics = {
-            gcroot: () => module.getOrInsertIntrinsic("@llvm.gcroot")
+            gcroot: () => module.getOrInsertIntrinsic("@llvm.gcroot"),
+            frameaddress: () => module.getOrInsertIntrinsic("@llvm.frameaddress")
         };
 
         this.ejs_runtime = runtime.createInterface(module, this.abi);
@@ -209,6 +240,7 @@ class LLVMIRVisitor extends TreeVisitor {
         ir.createBr(this.toplevel_body_bb);
 
         ir.setInsertPoint(initialized_bb);
+        this.popShadowFrame(this.currentFunction);
         return ir.createRet(this.loadUndefinedEjsValue());
     }
 
@@ -377,11 +409,84 @@ class LLVMIRVisitor extends TreeVisitor {
         // if type is types.EjsValue
         //        // EjsValues are rooted
         //        this.createCall this.llvm_intrinsics.gcroot(), [(ir.createPointerCast alloca, types.Int8Pointer.pointerTo(), "rooted_alloca"), consts.Null types.Int8Pointer], ""
+        if (type === types.EjsValue)
+            this.addShadowRoot(func, alloca, true);
 
         ir.setInsertPoint(saved_insert_point);
         return alloca;
     }
 
+    // with --shadow-stack, every EjsValue alloca is handed to the collector as a precise root
+    // through the function's shadow frame.  slots we don't store to in the entry block are
+    // cleared to undefined there so the collector never sees whatever was on the stack before.
+    addShadowRoot (func, alloca, clear) {
+        if (!func.shadowFrame) return;
+        if (clear)
+            this.storeUndefined(alloca);
+        alloca._ejs_shadow_root = true;
+        func.shadowRoots.push(alloca);
+    }
+
+    // the collector doesn't scan a function's native frame when it has a shadow frame, so an ejsval
+    // that's only in an ssa value (a call's result, or a load of something that can be overwritten
+    // before it's used) would be lost to a collection in a later call.  keep a copy in a rooted slot.
+    //
+    // the slots come from a per-function pool.  a temporary never outlives the statement that
+    // made it, so each statement hands back the slots it took once it's been visited (see visit.)
+    rootTemporary (value, name) {
+        let func = this.currentFunction;
+        if (!func.shadowFrame) return value;
+        if (func.tempRootsUsed === func.tempRoots.length)
+            func.tempRoots.push(this.createAlloca(func, types.EjsValue, `temp_root_${func.tempRoots.length}`));
+        ir.createStore(value, func.tempRoots[func.tempRootsUsed]);
+        func.tempRootsUsed += 1;
+        return value;
+    }
+
+    // the scratch area the argument, template and spread lowering stores ejsvals into.  those
+    // values are only there until the call that consumes them, but that call can collect, so
+    // each element is a shadow root too.
+    createScratchArea (func, length) {
+        let saved_insert_point = ir.getInsertBlock();
+        ir.setInsertPointStartBB(func.entry_bb);
+        let scratch_area = ir.createAlloca(llvm.ArrayType.get(types.EjsValue, length), "args_scratch_area");
+        scratch_area.setAlignment(8);
+        if (func.shadowFrame) {
+            for (let i = 0; i < length; i ++)
+                this.addShadowRoot(func, ir.createInBoundsGetElementPointer(scratch_area, [consts.int32(0), consts.int32(i)], `args_scratch_root_${i}`), true);
+        }
+        ir.setInsertPoint(saved_insert_point);
+        func.scratch_area = scratch_area;
+        func.scratch_length = length;
+        return scratch_area;
+    }
+
+    // fill in the shadow frame and link it in.  called at the end of the entry block, once we
+    // know every alloca the function will use.
+    pushShadowFrame (func) {
+        if (!func.shadowFrame) return;
+        let num_roots = func.shadowRoots.length;
+        let roots = ir.createAlloca(llvm.ArrayType.get(types.EjsValue.pointerTo(), num_roots), "shadow_roots");
+        func.shadowRoots.forEach((root, i) => {
+            let root_slot = ir.createInBoundsGetElementPointer(roots, [consts.int32(0), consts.int32(i)], `shadow_root_${i}`);
+            ir.createStore(root, root_slot);
+        });
+        let num_roots_slot = ir.createInBoundsGetElementPointer(func.shadowFrame, [consts.int32(0), consts.int32(1)], "shadow_num_roots");
+        ir.createStore(consts.int32(num_roots), num_roots_slot);
+        let roots_slot = ir.createInBoundsGetElementPointer(func.shadowFrame, [consts.int32(0), consts.int32(2)], "shadow_roots_slot");
+        ir.createStore(ir.createInBoundsGetElementPointer(roots, [consts.int32(0), consts.int32(0)], "shadow_roots_ptr"), roots_slot);
+        let name_slot = ir.createInBoundsGetElementPointer(func.shadowFrame, [consts.int32(0), consts.int32(3)], "shadow_name");
+        ir.createStore(consts.string(ir, func.shadowName), name_slot);
+        let frame_address_slot = ir.createInBoundsGetElementPointer(func.shadowFrame, [consts.int32(0), consts.int32(4)], "shadow_frame_address");
+        ir.createStore(ir.createCall(this.llvm_intrinsics.frameaddress(), [consts.int32(0)], "frame_address"), frame_address_slot);
+        ir.createCall(this.ejs_runtime.push_shadow_frame, [func.shadowFrame], "");
+    }
+
+    popShadowFrame (func) {
+        if (!func.shadowFrame) return;
+        ir.createCall(this.ejs_runtime.pop_shadow_frame, [func.shadowFrame], "");
+    }
+
     createAllocas (func, ids, scope) {
         let allocas = [];
         let new_allocas = [];
@@ -396,6 +501,7 @@ class LLVMIRVisitor extends TreeVisitor {
             if (!scope.has(name)) {
                 allocas[j] = ir.createAlloca(types.EjsValue, `local_${name}`);
                 allocas[j].setAlignment(8);
+                this.addShadowRoot(func, allocas[j], true);
                 scope.set(name, allocas[j]);
                 new_allocas[j] = true;
             }
@@ -416,7 +522,32 @@ class LLVMIRVisitor extends TreeVisitor {
     createPropertyStore (obj,prop,rhs,computed) {
         if (computed) {
             // we store obj[prop], prop can be any value
-            return this.createCall(this.ejs_runtime.object_setprop, [obj, this.visit(prop), rhs], "propstore_computed");
+            let storeprop = this.visit(prop);
+
+            if (!this.canOpencodeElementAccess(prop))
+                return this.createCall(this.ejs_runtime.object_setprop, [obj, storeprop, rhs], "propstore_computed");
+
+            let fast_store = (objptr, slot, slow_bb, merge_bb) => {
+                ir.createStore(rhs, slot);
+
+                // the inline half of _ejs_gc_write_barrier
+                let barrier_bb = new llvm.BasicBlock("elemstore_barrier", ir.getInsertBlock().parent);
+                let barrier_load = ir.createLoad(this.ejs_runtime.gc_barrier_enabled, "barrier_enabled_load");
+                ir.createCondBr(ir.createICmpEq(barrier_load, consts.int32(0), "barrier_cmp"), merge_bb, barrier_bb);
+
+                this.doInsideBBlock(barrier_bb, () => {
+                    let owner = ir.createBitCast(objptr, types.Int8Pointer, "elemstore_owner");
+                    this.createCall(this.ejs_runtime.gc_write_barrier_slow, [owner, rhs], "", false);
+                    ir.createBr(merge_bb);
+                });
+            };
+
+            let slow_store = () => {
+                this.createCall(this.ejs_runtime.object_setprop, [obj, storeprop, rhs], "propstore_computed");
+            };
+
+            this.emitElementAccess(obj, storeprop, "elemstore", fast_store, slow_store);
+            return rhs;
         }
         else {
             var pname;
@@ -431,9 +562,14 @@ class LLVMIRVisitor extends TreeVisitor {
 
             debug.log(() => `createPropertyStore ${obj}[${pname}]`);
 
-            return this.createCall(this.ejs_runtime.object_setprop, [obj, c, rhs], `propstore_${pname}`);
+            return this.createCall(this.ejs_runtime.object_setprop_ic, [obj, c, rhs, this.createPropertyIC(`propstore_${pname}`)], `propstore_${pname}`);
         }
     }
+
+    // a zeroed inline cache for one obj.name load or store, see EJSPropertyIC in ejs-object.h
+    createPropertyIC (name) {
+        return new llvm.GlobalVariable(this.module, types.EjsPropertyIC, `ic_${name}_${this.idgen()}`, llvm.Constant.getAggregateZero(types.EjsPropertyIC), false);
+    }
     
     createPropertyLoad (obj,prop,computed,canThrow = true) {
         if (computed) {
@@ -443,7 +579,26 @@ class LLVMIRVisitor extends TreeVisitor {
             if (this.options.record_types)
                 this.createCall(this.ejs_runtime.record_getprop, [consts.int32(this.genRecordId()), obj, loadprop], "");
             
-            return this.createCall(this.ejs_runtime.object_getprop, [obj, loadprop], "getprop_computed", canThrow);
+            if (!this.canOpencodeElementAccess(prop))
+                return this.createCall(this.ejs_runtime.object_getprop, [obj, loadprop], "getprop_computed", canThrow);
+
+            let result = this.createAlloca(this.currentFunction, types.EjsValue, "elemload_result");
+
+            let fast_load = (objptr, slot, slow_bb, merge_bb) => {
+                let elem = this.createLoad(slot, "elemload_elem");
+                // holes are stored as magic values, leave those to the runtime
+                let mask = this.createEjsvalAnd(elem, consts.int64_lowhi(0xffff8000, 0x00000000), "mask.i");
+                let is_magic = ir.createICmpEq(mask, consts.int64_lowhi(0xfffa0000, 0x00000000), "elemload_is_magic");
+                ir.createStore(elem, result);
+                ir.createCondBr(is_magic, slow_bb, merge_bb);
+            };
+
+            let slow_load = () => {
+                ir.createStore(this.createCall(this.ejs_runtime.object_getprop, [obj, loadprop], "getprop_computed", canThrow), result);
+            };
+
+            this.emitElementAccess(obj, loadprop, "elemload", fast_load, slow_load);
+            return this.createLoad(result, "elemload_result_load");
         }
         else {
             // we load obj.prop, prop is an id
@@ -452,13 +607,91 @@ class LLVMIRVisitor extends TreeVisitor {
             if (this.options.record_types)
                 this.createCall(this.ejs_runtime.record_getprop, [consts.int32(this.genRecordId()), obj, pname], "");
 
-            return this.createCall(this.ejs_runtime.object_getprop, [obj, pname], `getprop_${prop.name}`, canThrow);
+            return this.createCall(this.ejs_runtime.object_getprop_ic, [obj, pname, this.createPropertyIC(`getprop_${prop.name}`)], `getprop_${prop.name}`, canThrow);
         }
     }
+
+    // string literal keys are never element indices, so obj["foo"] keeps the plain runtime call
+    canOpencodeElementAccess (prop) {
+        if (!this.opencode_intrinsics.elementAccess || this.options.target_pointer_size !== 64)
+            return false;
+        return !(prop.type === b.Literal && typeof prop.value === "string");
+    }
+
+    // open-coded obj[prop] for dense arrays.  when prop is a number
+    // and obj is an EJSArray, we check that prop is an integer in
+    // [0, array_length) and hand the element's slot to fast_f, which
+    // branches to either merge_bb or slow_bb.  everything else goes
+    // to slow_f, which calls into the runtime.
+    //
+    // this method assumes it's called in an opencoded context
+    emitElementAccess (obj, prop, name, fast_f, slow_f) {
+        let insertFunc = ir.getInsertBlock().parent;
+
+        let is_object_bb = new llvm.BasicBlock(`${name}_is_object`, insertFunc);
+        let is_array_bb  = new llvm.BasicBlock(`${name}_is_array`, insertFunc);
+        let in_range_bb  = new llvm.BasicBlock(`${name}_in_range`, insertFunc);
+        let fast_bb      = new llvm.BasicBlock(`${name}_fast`, insertFunc);
+        let slow_bb      = new llvm.BasicBlock(`${name}_slow`, insertFunc);
+        let merge_bb     = new llvm.BasicBlock(`${name}_merge`, insertFunc);
+
+        ir.createCondBr(this.isNumber(prop), is_object_bb, slow_bb);
+
+        let objptr, arr, num;
+
+        this.doInsideBBlock(is_object_bb, () => {
+            ir.createCondBr(this.isObject(obj), is_array_bb, slow_bb);
+        });
+
+        this.doInsideBBlock(is_array_bb, () => {
+            objptr = this.emitEjsvalToObjectPtr(obj);
+            ir.createCondBr(this.isObjectArray(objptr), in_range_bb, slow_bb);
+        });
+
+        // the range check is done on the double so that fptosi never sees NaN or something out of range
+        this.doInsideBBlock(in_range_bb, () => {
+            arr = ir.createBitCast(objptr, types.EjsArray.pointerTo(), `${name}_arr`);
+            num = ir.createBitCast(this.getEjsvalBits(prop), types.Double, `${name}_num`);
+            let length_slot = ir.createInBoundsGetElementPointer(arr, [consts.int64(0), consts.int32(2)], `${name}_length_slot`);
+            let length = ir.createSIToFP(ir.createLoad(length_slot, `${name}_length`), types.Double, `${name}_length_num`);
+            let in_range = ir.createAnd(ir.createFCmpOGe(num, llvm.ConstantFP.getDouble(0), `${name}_ge_zero`), ir.createFCmpOLt(num, length, `${name}_lt_length`), `${name}_in_range`);
+            ir.createCondBr(in_range, fast_bb, slow_bb);
+        });
+
+        this.doInsideBBlock(fast_bb, () => {
+            let idx = ir.createFPToSI(num, types.Int32, `${name}_idx`);
+            let is_integer = ir.createFCmpOEq(ir.createSIToFP(idx, types.Double, `${name}_idx_num`), num, `${name}_is_integer`);
+            let element_bb = new llvm.BasicBlock(`${name}_element`, insertFunc);
+            ir.createCondBr(is_integer, element_bb, slow_bb);
+
+            ir.setInsertPoint(element_bb);
+            let elements_slot = ir.createInBoundsGetElementPointer(arr, [consts.int64(0), consts.int32(5)], `${name}_elements_slot`);
+            let elements = ir.createLoad(elements_slot, `${name}_elements`);
+            let slot = ir.createInBoundsGetElementPointer(elements, [idx], `${name}_slot`);
+            fast_f(objptr, slot, slow_bb, merge_bb);
+        });
+
+        this.doInsideBBlock(slow_bb, () => {
+            slow_f();
+            ir.createBr(merge_bb);
+        });
+
+        ir.setInsertPoint(merge_bb);
+    }
     
 
     visitOrNull      (n) { return this.visit(n) || this.loadNullEjsValue(); }
     visitOrUndefined (n) { return this.visit(n) || this.loadUndefinedEjsValue(); }
+
+    visit (n, ...args) {
+        let func = this.currentFunction;
+        if (!func || !func.shadowFrame || !n || !/(Statement|Declaration)$/.test(n.type))
+            return super.visit(n, ...args);
+        let temp_roots_used = func.tempRootsUsed;
+        let rv = super.visit(n, ...args);
+        func.tempRootsUsed = temp_roots_used;
+        return rv;
+    }
     
     visitProgram (n) {
         // by the time we make it here the program has been
@@ -905,7 +1138,11 @@ class LLVMIRVisitor extends TreeVisitor {
             return this.createPropertyStore(this.visit(lhs.object), lhs.property, rhvalue, lhs.computed);
         }
         else if (is_intrinsic(lhs, "%slot")) {
-            return ir.createStore(rhvalue, this.handleSlotRef(lhs));
+            // a heap store like %setSlot's, so it needs the same write barrier
+            let env = this.visitOrNull(lhs.arguments[0]);
+            let result = ir.createStore(rhvalue, this.handleSlotRef(lhs, undefined, env));
+            this.createCall(this.ejs_runtime.closureenv_write_barrier, [env, rhvalue], "", false);
+            return result;
         }
         else if (is_intrinsic(lhs, "%getLocal")) {
             return ir.createStore(rhvalue, this.findIdentifierInScope(lhs.arguments[0].name));
@@ -976,12 +1213,23 @@ class LLVMIRVisitor extends TreeVisitor {
 
         ir_func.literalAllocas = Object.create(null);
 
+        if (this.options.shadow_stack) {
+            ir_func.shadowFrame = ir.createAlloca(types.EjsShadowFrame, "shadow_frame");
+            ir_func.shadowRoots = [];
+            ir_func.tempRoots = [];
+            ir_func.tempRootsUsed = 0;
+            ir_func.shadowName = `${n.ir_name} ${this.filename}:${n.loc ? n.loc.start.line : 0}`;
+        }
+
         let allocas = [];
 
         // create allocas for the builtin args
         for (let param of n.params) {
             let alloca = ir.createAlloca(param.llvm_type, `local_${param.name}`);
             alloca.setAlignment(8);
+            // these are stored to below, before the frame is pushed
+            if (param.llvm_type === types.EjsValue)
+                this.addShadowRoot(ir_func, alloca, false);
             new_scope.set(param.name, alloca);
             allocas.push(alloca);
         }
@@ -1028,11 +1276,13 @@ class LLVMIRVisitor extends TreeVisitor {
 
             // branch to the resolve_modules_bb from our entry_bb, but only in the toplevel function
             ir.setInsertPoint(entry_bb);
+            this.pushShadowFrame(ir_func);
             ir.createBr(this.resolve_modules_bb);
         }
         else {
             // branch to the body_bb from our entry_bb
             ir.setInsertPoint(entry_bb);
+            this.pushShadowFrame(ir_func);
             ir.createBr(body_bb);
         }
 
@@ -1045,6 +1295,7 @@ class LLVMIRVisitor extends TreeVisitor {
 
     createRet (x) {
         //this.createCall this.ejs_runtime.log, [consts.string(ir, `leaving ${this.currentFunction.name}`)], ""
+        this.popShadowFrame(this.currentFunction);
         return this.abi.createRet(this.currentFunction, x);
     }
     
@@ -1102,9 +1353,80 @@ class LLVMIRVisitor extends TreeVisitor {
         if (this.options.record_types)
             this.createCall(this.ejs_runtime.record_binop, [consts.int32(this.genRecordId()), consts.string(ir, n.operator), left_visited, right_visited], "");
 
+        if (this.opencode_intrinsics.numericBinops && this.options.target_pointer_size === 64 && hasOwn.call(numericBinops, n.operator))
+            return this.emitNumericBinop(n, callee, left_visited, right_visited);
+
         // call the actual runtime binaryop method
         return this.createCall(callee, [left_visited, right_visited], `result_${n.operator}`, !callee.doesNotThrow);
     }
+
+    // open-coded number op number.  unless they're numeric
+    // literals both operands are checked for a number tag, and the
+    // bitwise ops also need both doubles to truncate to an int32.
+    // anything else calls the runtime binop.
+    //
+    // this method assumes it's called in an opencoded context
+    emitNumericBinop (n, callee, left, right) {
+        let op = n.operator;
+        let [kind, emit] = numericBinops[op];
+
+        let insertFunc = ir.getInsertBlock().parent;
+        let fast_bb  = new llvm.BasicBlock("binop_fast", insertFunc);
+        let slow_bb  = new llvm.BasicBlock("binop_slow", insertFunc);
+        let merge_bb = new llvm.BasicBlock("binop_merge", insertFunc);
+
+        let result = this.createAlloca(this.currentFunction, types.EjsValue, `result_${op}`);
+
+        let checks = [];
+        if (!isNumberLiteral(n.left)) checks.push(this.isNumber(left));
+        if (!isNumberLiteral(n.right)) checks.push(this.isNumber(right));
+        if (checks.length === 0)
+            ir.createBr(fast_bb);
+        else if (checks.length === 1)
+            ir.createCondBr(checks[0], fast_bb, slow_bb);
+        else
+            ir.createCondBr(ir.createAnd(checks[0], checks[1], "both_numbers"), fast_bb, slow_bb);
+
+        this.doInsideBBlock(fast_bb, () => {
+            let lnum = ir.createBitCast(this.getEjsvalBits(left), types.Double, "binop_left");
+            let rnum = ir.createBitCast(this.getEjsvalBits(right), types.Double, "binop_right");
+            let rv;
+
+            if (kind === "compare") {
+                rv = this.createEjsBoolSelect(emit(lnum, rnum));
+            }
+            else if (kind === "double") {
+                rv = this.emitEjsvalFromDouble(emit(lnum, rnum));
+            }
+            else { // kind === "int32"
+                // the range check is done on the doubles so that fptosi never sees NaN or something out of range
+                let int32_bb = new llvm.BasicBlock("binop_int32", insertFunc);
+                ir.createCondBr(ir.createAnd(this.isInt32Range(lnum), this.isInt32Range(rnum), "both_int32"), int32_bb, slow_bb);
+                ir.setInsertPoint(int32_bb);
+                let lint = ir.createFPToSI(lnum, types.Int32, "binop_left_int32");
+                let rint = ir.createFPToSI(rnum, types.Int32, "binop_right_int32");
+                rv = this.emitEjsvalFromDouble(emit(lint, rint));
+            }
+
+            ir.createStore(rv, result);
+            ir.createBr(merge_bb);
+        });
+
+        this.doInsideBBlock(slow_bb, () => {
+            ir.createStore(this.createCall(callee, [left, right], `result_${op}`, !callee.doesNotThrow), result);
+            ir.createBr(merge_bb);
+        });
+
+        ir.setInsertPoint(merge_bb);
+        let rv = this.createLoad(result, `result_${op}_load`);
+        rv._ejs_returns_ejsval_bool = callee.returns_ejsval_bool;
+        return rv;
+    }
+
+    // true if trunc(num) is an int32, which makes ToInt32(num) a plain fptosi
+    isInt32Range (num) {
+        return ir.createAnd(ir.createFCmpOGt(num, llvm.ConstantFP.getDouble(-2147483649), "int32_gt_min"), ir.createFCmpOLt(num, llvm.ConstantFP.getDouble(2147483648), "int32_lt_max"), "int32_range");
+    }
     
     visitLogicalExpression (n) {
         debug.log ( () => `operator = '${n.operator}'` );
@@ -1317,6 +1639,8 @@ class LLVMIRVisitor extends TreeVisitor {
         if (source) {
             debug.log ( () => `found identifier in scope, at ${source}` );
             rv = this.createLoad(source, `load_${val}`);
+            if (source._ejs_shadow_root)
+                rv = this.rootTemporary(rv, `load_${val}`);
             return rv;
         }
 
@@ -1557,7 +1881,9 @@ class LLVMIRVisitor extends TreeVisitor {
             // after we've made our call we need to change the insertion point to our continuation
             ir.setInsertPoint(normal_block);
         }
-        
+
+        if (callee.returns_ejsval)
+            calltmp = this.rootTemporary(calltmp, callname);
         return calltmp;
     }
     
@@ -1621,6 +1947,10 @@ class LLVMIRVisitor extends TreeVisitor {
                 caught_result.addClause(ir.createPointerCast(this.ejs_runtime.exception_typeinfo, types.Int8Pointer, ""));
                 caught_result.setCleanup(true);
 
+                // the frames the exception unwound through never popped themselves
+                if (this.currentFunction.shadowFrame)
+                    ir.createCall(this.ejs_runtime.restore_shadow_frame, [this.currentFunction.shadowFrame], "");
+
                 let exception = ir.createExtractValue(caught_result, 0, "exception");
                 
                 if (catch_block)
@@ -1721,34 +2051,40 @@ class LLVMIRVisitor extends TreeVisitor {
     }
 
     handleTemplateDefaultHandlerCall (exp, opencode) {
-        // we should probably only inline the construction of the string if substitutions.length < $some-number
         let cooked_strings = exp.arguments[0].elements;
         let substitutions = exp.arguments[1].elements;
-        
-        let cooked_i = 0;
-        let sub_i = 0;
-        let strval = null;
 
-        let concat_string = (s) => {
-            if (!strval)
-                strval = s;
-            else
-                strval = this.createCall(this.ejs_runtime.string_concat, [strval, s], "strconcat");
-        };
-        
-        while (cooked_i < cooked_strings.length) {
-            let c = cooked_strings[cooked_i];
-            cooked_i += 1;
-            if (c.length !== 0)
-                concat_string(this.getAtom(c.value));
-            if (sub_i < substitutions.length) {
-                let sub = this.visit(substitutions[sub_i]);
-                concat_string(this.createCall(this.ejs_runtime.ToString, [sub], "subToString"));
-                sub_i += 1;
+        // each substitution is converted to a string as soon as it's evaluated, but the
+        // pieces are put together in a single runtime call instead of a chain of
+        // string_concat's, each making a rope node.
+        let pieces = [];
+        cooked_strings.forEach((c, i) => {
+            if (c.value.length !== 0)
+                pieces.push(this.getAtom(c.value));
+            if (i < substitutions.length) {
+                let sub = this.visit(substitutions[i]);
+                pieces.push(this.createCall(this.ejs_runtime.ToString, [sub], "subToString"));
             }
+        });
+
+        if (pieces.length === 0)
+            return this.getAtom("");
+        if (pieces.length === 1)
+            return pieces[0];
+
+        // the substitutions can use the scratch area themselves, so nothing is stored
+        // there until they've all been visited
+        if (!this.currentFunction.scratch_area || this.currentFunction.scratch_length < pieces.length) {
+            this.createScratchArea(this.currentFunction, pieces.length);
         }
 
-        return strval;
+        pieces.forEach((p, i) => {
+            let gep = ir.createGetElementPointer(this.currentFunction.scratch_area, [consts.int32(0), consts.int64(i)], `template_gep_${i}`);
+            ir.createStore(p, gep, `template[${i}]-store`);
+        });
+
+        let argsCast = ir.createGetElementPointer(this.currentFunction.scratch_area, [consts.int32(0), consts.int64(0)], "template_pieces_load");
+        return this.createCall(this.ejs_runtime.string_concatn, [consts.int32(pieces.length), argsCast], "template_str");
     }
 
     handleTemplateCallsite (exp, opencode) {
@@ -1814,6 +2150,7 @@ class LLVMIRVisitor extends TreeVisitor {
         });
         
         ir.setInsertPoint(merge_bb);
+        this.popShadowFrame(this.currentFunction);
         return ir.createRet(ir.createLoad(callsite_alloca, "load_local_callsite"));
     }
 
@@ -1847,7 +2184,7 @@ class LLVMIRVisitor extends TreeVisitor {
 
     handleModuleGetSlot (exp, opencode) {
         let slot_ref = this.handleModuleSlotRef(exp, opencode);
-        return ir.createLoad(slot_ref, "module_slot_load");
+        return this.rootTemporary(ir.createLoad(slot_ref, "module_slot_load"), "module_slot_load");
     }
 
     handleModuleSetSlot (exp, opencode) {
@@ -1884,7 +2221,7 @@ class LLVMIRVisitor extends TreeVisitor {
         let arg_i = exp.arguments[0].value;
         let arg_ptr = ir.createGetElementPointer(load_args, [consts.int32(arg_i)], `arg${arg_i}_ptr`);
                                 
-        return this.createLoad(arg_ptr, `arg${arg_i}`);
+        return this.rootTemporary(this.createLoad(arg_ptr, `arg${arg_i}`), `arg${arg_i}`);
     }
 
     handleGetArgumentsObject (exp, opencode) {
@@ -1953,6 +2290,16 @@ class LLVMIRVisitor extends TreeVisitor {
         }
     }
 
+    // the number ejsval for a double.  NaNs produced by arithmetic are canonical, so they stay below the tagged range
+    emitEjsvalFromDouble (num) {
+        let double_alloca = this.currentFunction.double_alloca;
+        if (!double_alloca)
+            double_alloca = this.currentFunction.double_alloca = this.createAlloca(this.currentFunction, types.Double, "double_alloca");
+        ir.createStore(num, double_alloca);
+        let ejsval_ptr = ir.createBitCast(double_alloca, types.EjsValue.pointerTo(), "double_ejsval_ptr");
+        return ir.createLoad(ejsval_ptr, "double_ejsval_load");
+    }
+
     emitEjsvalToObjectPtr (val) {
         return this.emitEjsvalTo(val, types.EjsObject.pointerTo(), "to_objectptr");
     }
@@ -2108,11 +2455,7 @@ class LLVMIRVisitor extends TreeVisitor {
     }
     
     handleCreateArgScratchArea (exp, opencode) {
-        let argsArrayType = llvm.ArrayType.get(types.EjsValue, exp.arguments[0].value);
-        this.currentFunction.scratch_length = exp.arguments[0].value;
-        this.currentFunction.scratch_area = this.createAlloca(this.currentFunction, argsArrayType, "args_scratch_area");
-        this.currentFunction.scratch_area.setAlignment(8);
-        return this.currentFunction.scratch_area;
+        return this.createScratchArea(this.currentFunction, exp.arguments[0].value);
     }
 
     handleMakeClosureEnv (exp, opencode) {
@@ -2126,7 +2469,7 @@ class LLVMIRVisitor extends TreeVisitor {
         //  %ret = load %EjsValueType* %ref, align 8
         //
         let slot_ref = this.handleSlotRef(exp, opencode);
-        return ir.createLoad(slot_ref, "slot_ref_load");
+        return this.rootTemporary(ir.createLoad(slot_ref, "slot_ref_load"), "slot_ref_load");
     }
 
     handleSetSlot (exp, opencode) {
@@ -2137,15 +2480,21 @@ class LLVMIRVisitor extends TreeVisitor {
         else
             new_slot_val = exp.arguments[2];
 
-        let slotref = this.handleSlotRef(exp, opencode);
+        let env = this.visitOrNull(exp.arguments[0]);
+        let slotref = this.handleSlotRef(exp, opencode, env);
         
         this.storeToDest(slotref, new_slot_val);
         
-        return ir.createLoad(slotref, "load_slot");
+        let rv = ir.createLoad(slotref, "load_slot");
+
+        // literals are never young gc objects, so they don't need the generational gc's write barrier
+        if (new_slot_val.type !== b.Literal)
+            this.createCall(this.ejs_runtime.closureenv_write_barrier, [env, rv], "", false);
+
+        return rv;
     }
 
-    handleSlotRef (exp, opencode) {
-        let env = this.visitOrNull(exp.arguments[0]);
+    handleSlotRef (exp, opencode, env = this.visitOrNull(exp.arguments[0])) {
         let slotnum = exp.arguments[1].value;
 
         if (opencode && this.options.target_pointer_size === 64) {
@@ -2201,6 +2550,10 @@ class LLVMIRVisitor extends TreeVisitor {
         return ir.createICmpEq(this.emitLoadSpecops(obj), this.ejs_runtime.symbol_specops, "symbol_specops_cmp");
     }
 
+    isObjectArray (obj) {
+        return ir.createICmpEq(this.emitLoadSpecops(obj), this.ejs_runtime.array_specops, "array_specops_cmp");
+    }
+
     isString (val) {
         if (this.options.target_pointer_size === 64) {
             let mask = this.createEjsvalAnd(val, consts.int64_lowhi(0xffff8000, 0x00000000), "mask.i");
@@ -2436,9 +2789,7 @@ class LLVMIRVisitor extends TreeVisitor {
     handleArrayFromSpread (exp) {
         let arg_count = exp.arguments.length;
         if (this.currentFunction.scratch_area && this.currentFunction.scratch_length < arg_count) {
-            let spreadArrayType = llvm.ArrayType.get(types.EjsValue, arg_count);
-            this.currentFunction.scratch_area = this.createAlloca(this.currentFunction, spreadArrayType, "args_scratch_area");
-            this.currentFunction.scratch_area.setAlignment(8);
+            this.createScratchArea(this.currentFunction, arg_count);
         }
 
         // reuse the scratch area
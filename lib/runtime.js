@@ -27,6 +27,7 @@ const runtime_interface = {
     make_closure_env:      function() { return this.abi.createExternalFunction(this.module, "_ejs_closureenv_new", types.EjsValue, [types.Int32]); },
     get_env_slot_val:      function() { return this.abi.createExternalFunction(this.module, "_ejs_closureenv_get_slot", types.EjsValue, [types.EjsValue, types.Int32]); },
     get_env_slot_ref:      function() { return this.abi.createExternalFunction(this.module, "_ejs_closureenv_get_slot_ref", types.EjsValue.pointerTo(), [types.EjsValue, types.Int32]); },
+    closureenv_write_barrier: function() { return does_not_throw(this.abi.createExternalFunction(this.module, "_ejs_closureenv_write_barrier", types.Void, [types.EjsValue, types.EjsValue])); },
     
     object_create:         function() { return this.abi.createExternalFunction(this.module, "_ejs_object_create",             types.EjsValue, [types.EjsValue]); },
     arguments_new:         function() { return does_not_throw(this.abi.createExternalFunction(this.module, "_ejs_arguments_new",             types.EjsValue, [types.Int32, types.EjsValue.pointerTo()])); },
@@ -39,6 +40,8 @@ const runtime_interface = {
     truthy:                function() { return does_not_throw(does_not_access_memory(this.abi.createExternalFunction(this.module, "_ejs_truthy",                    types.Bool, [types.EjsValue]))); },
     object_setprop:        function() { return this.abi.createExternalFunction(this.module, "_ejs_object_setprop",            types.EjsValue, [types.EjsValue, types.EjsValue, types.EjsValue]); },
     object_getprop:        function() { return only_reads_memory(this.abi.createExternalFunction(this.module, "_ejs_object_getprop",           types.EjsValue, [types.EjsValue, types.EjsValue])); },
+    object_setprop_ic:     function() { return this.abi.createExternalFunction(this.module, "_ejs_object_setprop_ic",         types.EjsValue, [types.EjsValue, types.EjsValue, types.EjsValue, types.EjsPropertyIC.pointerTo()]); },
+    object_getprop_ic:     function() { return this.abi.createExternalFunction(this.module, "_ejs_object_getprop_ic",         types.EjsValue, [types.EjsValue, types.EjsValue, types.EjsPropertyIC.pointerTo()]); },
     global_setprop:        function() { return this.abi.createExternalFunction(this.module, "_ejs_global_setprop",            types.EjsValue, [types.EjsValue, types.EjsValue]); },
     global_getprop:        function() { return only_reads_memory(this.abi.createExternalFunction(this.module, "_ejs_global_getprop",           types.EjsValue, [types.EjsValue])); },
 
@@ -58,9 +61,14 @@ const runtime_interface = {
 
     ToString:              function() { return this.abi.createExternalFunction(this.module, "ToString",                       types.EjsValue, [types.EjsValue]); },
     string_concat:         function() { return this.abi.createExternalFunction(this.module, "_ejs_string_concat",             types.EjsValue, [types.EjsValue, types.EjsValue]); },
+    string_concatn:        function() { return does_not_throw(this.abi.createExternalFunction(this.module, "_ejs_string_concatn",            types.EjsValue, [types.Int32, types.EjsValue.pointerTo()])); },
     init_string_literal:   function() { return this.abi.createExternalFunction(this.module, "_ejs_string_init_literal",       types.Void, [types.String, types.EjsValue.pointerTo(), types.EjsPrimString.pointerTo(), types.JSChar.pointerTo(), types.Int32]); },
 
     gc_add_root:           function() { return this.abi.createExternalFunction(this.module, "_ejs_gc_add_root",               types.Void, [types.EjsValue.pointerTo()]); },
+    push_shadow_frame:     function() { return does_not_throw(this.abi.createExternalFunction(this.module, "_ejs_gc_push_shadow_frame",    types.Void, [types.EjsShadowFrame.pointerTo()])); },
+    pop_shadow_frame:      function() { return does_not_throw(this.abi.createExternalFunction(this.module, "_ejs_gc_pop_shadow_frame",     types.Void, [types.EjsShadowFrame.pointerTo()])); },
+    restore_shadow_frame:  function() { return does_not_throw(this.abi.createExternalFunction(this.module, "_ejs_gc_restore_shadow_frame", types.Void, [types.EjsShadowFrame.pointerTo()])); },
+    gc_write_barrier_slow: function() { return does_not_throw(this.abi.createExternalFunction(this.module, "_ejs_gc_write_barrier_slow",   types.Void, [types.Int8Pointer, types.EjsValue])); },
     typeof_is_object:      function() { return returns_ejsval_bool(only_reads_memory(this.abi.createExternalFunction(this.module, "_ejs_op_typeof_is_object",       types.EjsValue, [types.EjsValue]))); },
     typeof_is_function:    function() { return returns_ejsval_bool(only_reads_memory(this.abi.createExternalFunction(this.module, "_ejs_op_typeof_is_function",     types.EjsValue, [types.EjsValue]))); },
     typeof_is_string:      function() { return returns_ejsval_bool(only_reads_memory(this.abi.createExternalFunction(this.module, "_ejs_op_typeof_is_string",       types.EjsValue, [types.EjsValue]))); },
@@ -81,6 +89,8 @@ const runtime_interface = {
     exception_typeinfo:    function() { return this.module.getOrInsertGlobal           ("EJS_EHTYPE_ejsvalue",            types.EjsExceptionTypeInfo); },
     function_specops:      function() { return this.module.getOrInsertGlobal           ("_ejs_Function_specops",          types.EjsSpecops); },
     symbol_specops:        function() { return this.module.getOrInsertGlobal           ("_ejs_Symbol_specops",            types.EjsSpecops); },
+    array_specops:         function() { return this.module.getOrInsertGlobal           ("_ejs_Array_specops",             types.EjsSpecops); },
+    gc_barrier_enabled:    function() { return this.module.getOrInsertGlobal           ("_ejs_gc_barrier_enabled",        types.Int32); },
 
     "unop-":           function() { return this.abi.createExternalFunction(this.module, "_ejs_op_neg",         types.EjsValue, [types.EjsValue]); },
     "unop+":           function() { return this.abi.createExternalFunction(this.module, "_ejs_op_plus",        types.EjsValue, [types.EjsValue]); },
@@ -91,6 +91,7 @@ export class SRetABI extends ABI {
             rv = inModule.getOrInsertFunction(name, ret_type, param_types);
 
         if (sret) rv.setStructRet();
+        rv.returns_ejsval = sret;
         return rv;
     }
 
@@ -38,6 +38,8 @@ export let EjsObject = llvm.StructType.create("struct.EJSObject", [
     String,                 // GCObjectHeader gc_header;
     EjsSpecops.pointerTo(), // EJSSpecOps*    ops;
     EjsValue,               // ejsval         proto; // the __proto__ property
+    Int8Pointer,            // EJSShape*      shape;
+    EjsValue.pointerTo(),   // ejsval*        slots;
     EjsPropertyMap.pointerTo(),  // EJSPropertyMap map;
 ]);
 
@@ -49,6 +51,18 @@ export let EjsFunction = llvm.StructType.create("struct.EJSFunction", [
     Int32,                 // EJSBool  bound;
 ]);
 
+let EjsPropertyDesc = llvm.StructType.create("struct.EJSPropertyDesc", [Int32, EjsValue, EjsValue]);
+
+// EJSArray from ejs-array.h, laid out for the dense case so generated code can index elements directly
+export let EjsArray = llvm.StructType.create("struct.EJSArray", [
+    EjsObject,             // EJSObject        obj;
+    EjsPropertyDesc,       // EJSPropertyDesc  array_length_desc;
+    Int32,                 // int              array_length;
+    Int32,                 // int              dense.array_alloc;
+    Int8Pointer,           // EJSPropertyDesc* dense.element_descs;
+    EjsValue.pointerTo()   // ejsval*          dense.elements;
+]);
+
 function CreateModuleTy (suffix, num_exports) {
     return llvm.StructType.create(`struct.EJSModule${suffix}`, [
         EjsObject,             // EJSObject obj;
@@ -64,6 +78,20 @@ export function getModuleSpecificType (module_name, num_exports) {
     return CreateModuleTy(`_${module_name}`, num_exports);
 }
 
+// struct _EJSShadowFrame from ejs-gc.h, used by --shadow-stack
+export let EjsShadowFrame = llvm.StructType.create("struct._EJSShadowFrame", [Int8Pointer, Int32, EjsValue.pointerTo().pointerTo(), Int8Pointer, Int8Pointer, Int8Pointer]);
+
+// EJSPropertyIC from ejs-object.h, one per cached obj.name load or store
+let EjsPropertyICEntry = llvm.StructType.create("EJSPropertyICEntry", [
+    EjsSpecops.pointerTo(), // EJSSpecOps* ops;
+    Int8Pointer,            // EJSShape*   shape;
+    Int8Pointer,            // EJSShape*   target_shape;
+    EjsValue,               // ejsval      proto;
+    Int32,                  // uint32_t    kind;
+    Int32                   // uint32_t    slot;
+]);
+export let EjsPropertyIC = llvm.StructType.create("EJSPropertyIC", [Int32, Int32, Int32, Int32, llvm.ArrayType.get(EjsPropertyICEntry, 4)]);
+
 // exception types
 
 // the c++ typeinfo for our exceptions
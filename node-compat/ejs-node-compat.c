@@ -451,24 +451,27 @@ _ejs_stream_write (ejsval env, ejsval _this, uint32_t argc, ejsval* args)
     ejsval internal_fd = _ejs_object_getprop (_this, _ejs_internal_fd_sym);
     int fd = ToInteger(internal_fd);
 
-    int remaining = EJSVAL_TO_STRLEN(to_write);
-    int offset = 0;
-    char *buf = ucs2_to_utf8(EJSVAL_TO_FLAT_STRING(to_write));
+    EJSUtf8Buffer buf;
+    _ejs_string_utf8_buffer_init (&buf, to_write);
+
+    // the utf8 is usually longer than the string, so count what's left in bytes
+    size_t remaining = buf.length;
+    size_t offset = 0;
     
-    do {
-        int num_written = write (fd, buf + offset, remaining);
+    while (remaining > 0) {
+        ssize_t num_written = write (fd, buf.str + offset, remaining);
         if (num_written == -1) {
             if (errno == EINTR)
                 continue;
             perror ("write");
-            free (buf);
+            _ejs_string_utf8_buffer_free (&buf);
             return _ejs_false;
         }
         remaining -= num_written;
         offset += num_written;
-    } while (remaining > 0);
+    }
 
-    free (buf);
+    _ejs_string_utf8_buffer_free (&buf);
     return _ejs_true;
 }
 
@@ -36,6 +36,10 @@ namespace jsllvm {
     NODE_SET_METHOD(s_func, "createCall", IRBuilder::CreateCall);
     NODE_SET_METHOD(s_func, "createInvoke", IRBuilder::CreateInvoke);
     NODE_SET_METHOD(s_func, "createFAdd", IRBuilder::CreateFAdd);
+    NODE_SET_METHOD(s_func, "createFSub", IRBuilder::CreateFSub);
+    NODE_SET_METHOD(s_func, "createFMul", IRBuilder::CreateFMul);
+    NODE_SET_METHOD(s_func, "createFDiv", IRBuilder::CreateFDiv);
+    NODE_SET_METHOD(s_func, "createFRem", IRBuilder::CreateFRem);
     NODE_SET_METHOD(s_func, "createAlloca", IRBuilder::CreateAlloca);
     NODE_SET_METHOD(s_func, "createLoad", IRBuilder::CreateLoad);
     NODE_SET_METHOD(s_func, "createStore", IRBuilder::CreateStore);
@@ -49,6 +53,12 @@ namespace jsllvm {
     NODE_SET_METHOD(s_func, "createICmpUGt", IRBuilder::CreateICmpUGt);
     NODE_SET_METHOD(s_func, "createICmpUGE", IRBuilder::CreateICmpUGE);
     NODE_SET_METHOD(s_func, "createICmpULt", IRBuilder::CreateICmpULt);
+    NODE_SET_METHOD(s_func, "createFCmpOEq", IRBuilder::CreateFCmpOEq);
+    NODE_SET_METHOD(s_func, "createFCmpOGe", IRBuilder::CreateFCmpOGe);
+    NODE_SET_METHOD(s_func, "createFCmpOLt", IRBuilder::CreateFCmpOLt);
+    NODE_SET_METHOD(s_func, "createFCmpOLe", IRBuilder::CreateFCmpOLe);
+    NODE_SET_METHOD(s_func, "createFCmpOGt", IRBuilder::CreateFCmpOGt);
+    NODE_SET_METHOD(s_func, "createFCmpUNe", IRBuilder::CreateFCmpUNe);
     NODE_SET_METHOD(s_func, "createCondBr", IRBuilder::CreateCondBr);
     NODE_SET_METHOD(s_func, "createBr", IRBuilder::CreateBr);
     NODE_SET_METHOD(s_func, "createPhi", IRBuilder::CreatePhi);
@@ -58,7 +68,14 @@ namespace jsllvm {
     NODE_SET_METHOD(s_func, "createUnreachable", IRBuilder::CreateUnreachable);
     NODE_SET_METHOD(s_func, "createAnd", IRBuilder::CreateAnd);
     NODE_SET_METHOD(s_func, "createOr", IRBuilder::CreateOr);
+    NODE_SET_METHOD(s_func, "createXor", IRBuilder::CreateXor);
+    NODE_SET_METHOD(s_func, "createShl", IRBuilder::CreateShl);
+    NODE_SET_METHOD(s_func, "createAShr", IRBuilder::CreateAShr);
+    NODE_SET_METHOD(s_func, "createLShr", IRBuilder::CreateLShr);
     NODE_SET_METHOD(s_func, "createZExt", IRBuilder::CreateZExt);
+    NODE_SET_METHOD(s_func, "createFPToSI", IRBuilder::CreateFPToSI);
+    NODE_SET_METHOD(s_func, "createSIToFP", IRBuilder::CreateSIToFP);
+    NODE_SET_METHOD(s_func, "createUIToFP", IRBuilder::CreateUIToFP);
     NODE_SET_METHOD(s_func, "createIntToPtr", IRBuilder::CreateIntToPtr);
     NODE_SET_METHOD(s_func, "createPtrToInt", IRBuilder::CreatePtrToInt);
     NODE_SET_METHOD(s_func, "createBitCast", IRBuilder::CreateBitCast);
@@ -181,6 +198,54 @@ namespace jsllvm {
     return scope.Close(result);
   }
 
+  v8::Handle<v8::Value> IRBuilder::CreateXor(const v8::Arguments& args)
+  {
+    HandleScope scope;
+
+    REQ_LLVM_VAL_ARG(0, lhs);
+    REQ_LLVM_VAL_ARG(1, rhs);
+    FALLBACK_EMPTY_UTF8_ARG(2, name);
+
+    Handle<v8::Value> result = Instruction::New(static_cast<llvm::Instruction*>(builder.CreateXor(lhs, rhs, *name)));
+    return scope.Close(result);
+  }
+
+  v8::Handle<v8::Value> IRBuilder::CreateShl(const v8::Arguments& args)
+  {
+    HandleScope scope;
+
+    REQ_LLVM_VAL_ARG(0, lhs);
+    REQ_LLVM_VAL_ARG(1, rhs);
+    FALLBACK_EMPTY_UTF8_ARG(2, name);
+
+    Handle<v8::Value> result = Instruction::New(static_cast<llvm::Instruction*>(builder.CreateShl(lhs, rhs, *name)));
+    return scope.Close(result);
+  }
+
+  v8::Handle<v8::Value> IRBuilder::CreateAShr(const v8::Arguments& args)
+  {
+    HandleScope scope;
+
+    REQ_LLVM_VAL_ARG(0, lhs);
+    REQ_LLVM_VAL_ARG(1, rhs);
+    FALLBACK_EMPTY_UTF8_ARG(2, name);
+
+    Handle<v8::Value> result = Instruction::New(static_cast<llvm::Instruction*>(builder.CreateAShr(lhs, rhs, *name)));
+    return scope.Close(result);
+  }
+
+  v8::Handle<v8::Value> IRBuilder::CreateLShr(const v8::Arguments& args)
+  {
+    HandleScope scope;
+
+    REQ_LLVM_VAL_ARG(0, lhs);
+    REQ_LLVM_VAL_ARG(1, rhs);
+    FALLBACK_EMPTY_UTF8_ARG(2, name);
+
+    Handle<v8::Value> result = Instruction::New(static_cast<llvm::Instruction*>(builder.CreateLShr(lhs, rhs, *name)));
+    return scope.Close(result);
+  }
+
   v8::Handle<v8::Value> IRBuilder::CreateZExt(const v8::Arguments& args)
   {
     HandleScope scope;
@@ -193,6 +258,42 @@ namespace jsllvm {
     return scope.Close(result);
   }
 
+  v8::Handle<v8::Value> IRBuilder::CreateFPToSI(const v8::Arguments& args)
+  {
+    HandleScope scope;
+
+    REQ_LLVM_VAL_ARG(0, V);
+    REQ_LLVM_TYPE_ARG(1, dest_ty);
+    FALLBACK_EMPTY_UTF8_ARG(2, name);
+
+    Handle<v8::Value> result = Instruction::New(static_cast<llvm::Instruction*>(builder.CreateFPToSI(V, dest_ty, *name)));
+    return scope.Close(result);
+  }
+
+  v8::Handle<v8::Value> IRBuilder::CreateSIToFP(const v8::Arguments& args)
+  {
+    HandleScope scope;
+
+    REQ_LLVM_VAL_ARG(0, V);
+    REQ_LLVM_TYPE_ARG(1, dest_ty);
+    FALLBACK_EMPTY_UTF8_ARG(2, name);
+
+    Handle<v8::Value> result = Instruction::New(static_cast<llvm::Instruction*>(builder.CreateSIToFP(V, dest_ty, *name)));
+    return scope.Close(result);
+  }
+
+  v8::Handle<v8::Value> IRBuilder::CreateUIToFP(const v8::Arguments& args)
+  {
+    HandleScope scope;
+
+    REQ_LLVM_VAL_ARG(0, V);
+    REQ_LLVM_TYPE_ARG(1, dest_ty);
+    FALLBACK_EMPTY_UTF8_ARG(2, name);
+
+    Handle<v8::Value> result = Instruction::New(static_cast<llvm::Instruction*>(builder.CreateUIToFP(V, dest_ty, *name)));
+    return scope.Close(result);
+  }
+
   v8::Handle<v8::Value> IRBuilder::CreateIntToPtr(const v8::Arguments& args)
   {
     HandleScope scope;
@@ -281,6 +382,54 @@ namespace jsllvm {
     return scope.Close(result);
   }
 
+  v8::Handle<v8::Value> IRBuilder::CreateFSub(const v8::Arguments& args)
+  {
+    HandleScope scope;
+
+    REQ_LLVM_VAL_ARG(0, left);
+    REQ_LLVM_VAL_ARG(1, right);
+    FALLBACK_EMPTY_UTF8_ARG(2, name);
+
+    Handle<v8::Value> result = Instruction::New(static_cast<llvm::Instruction*>(IRBuilder::builder.CreateFSub(left, right, *name)));
+    return scope.Close(result);
+  }
+
+  v8::Handle<v8::Value> IRBuilder::CreateFMul(const v8::Arguments& args)
+  {
+    HandleScope scope;
+
+    REQ_LLVM_VAL_ARG(0, left);
+    REQ_LLVM_VAL_ARG(1, right);
+    FALLBACK_EMPTY_UTF8_ARG(2, name);
+
+    Handle<v8::Value> result = Instruction::New(static_cast<llvm::Instruction*>(IRBuilder::builder.CreateFMul(left, right, *name)));
+    return scope.Close(result);
+  }
+
+  v8::Handle<v8::Value> IRBuilder::CreateFDiv(const v8::Arguments& args)
+  {
+    HandleScope scope;
+
+    REQ_LLVM_VAL_ARG(0, left);
+    REQ_LLVM_VAL_ARG(1, right);
+    FALLBACK_EMPTY_UTF8_ARG(2, name);
+
+    Handle<v8::Value> result = Instruction::New(static_cast<llvm::Instruction*>(IRBuilder::builder.CreateFDiv(left, right, *name)));
+    return scope.Close(result);
+  }
+
+  v8::Handle<v8::Value> IRBuilder::CreateFRem(const v8::Arguments& args)
+  {
+    HandleScope scope;
+
+    REQ_LLVM_VAL_ARG(0, left);
+    REQ_LLVM_VAL_ARG(1, right);
+    FALLBACK_EMPTY_UTF8_ARG(2, name);
+
+    Handle<v8::Value> result = Instruction::New(static_cast<llvm::Instruction*>(IRBuilder::builder.CreateFRem(left, right, *name)));
+    return scope.Close(result);
+  }
+
   v8::Handle<v8::Value> IRBuilder::CreateAlloca(const v8::Arguments& args)
   {
     HandleScope scope;
@@ -448,6 +597,78 @@ namespace jsllvm {
     return scope.Close(result);
   }
 
+  v8::Handle<v8::Value> IRBuilder::CreateFCmpOEq(const v8::Arguments& args)
+  {
+    HandleScope scope;
+
+    REQ_LLVM_VAL_ARG(0, left);
+    REQ_LLVM_VAL_ARG(1, right);
+    FALLBACK_EMPTY_UTF8_ARG(2, name);
+
+    Handle<v8::Value> result = Instruction::New(static_cast<llvm::Instruction*>(IRBuilder::builder.CreateFCmpOEQ(left, right, *name)));
+    return scope.Close(result);
+  }
+
+  v8::Handle<v8::Value> IRBuilder::CreateFCmpOGe(const v8::Arguments& args)
+  {
+    HandleScope scope;
+
+    REQ_LLVM_VAL_ARG(0, left);
+    REQ_LLVM_VAL_ARG(1, right);
+    FALLBACK_EMPTY_UTF8_ARG(2, name);
+
+    Handle<v8::Value> result = Instruction::New(static_cast<llvm::Instruction*>(IRBuilder::builder.CreateFCmpOGE(left, right, *name)));
+    return scope.Close(result);
+  }
+
+  v8::Handle<v8::Value> IRBuilder::CreateFCmpOLt(const v8::Arguments& args)
+  {
+    HandleScope scope;
+
+    REQ_LLVM_VAL_ARG(0, left);
+    REQ_LLVM_VAL_ARG(1, right);
+    FALLBACK_EMPTY_UTF8_ARG(2, name);
+
+    Handle<v8::Value> result = Instruction::New(static_cast<llvm::Instruction*>(IRBuilder::builder.CreateFCmpOLT(left, right, *name)));
+    return scope.Close(result);
+  }
+
+  v8::Handle<v8::Value> IRBuilder::CreateFCmpOLe(const v8::Arguments& args)
+  {
+    HandleScope scope;
+
+    REQ_LLVM_VAL_ARG(0, left);
+    REQ_LLVM_VAL_ARG(1, right);
+    FALLBACK_EMPTY_UTF8_ARG(2, name);
+
+    Handle<v8::Value> result = Instruction::New(static_cast<llvm::Instruction*>(IRBuilder::builder.CreateFCmpOLE(left, right, *name)));
+    return scope.Close(result);
+  }
+
+  v8::Handle<v8::Value> IRBuilder::CreateFCmpOGt(const v8::Arguments& args)
+  {
+    HandleScope scope;
+
+    REQ_LLVM_VAL_ARG(0, left);
+    REQ_LLVM_VAL_ARG(1, right);
+    FALLBACK_EMPTY_UTF8_ARG(2, name);
+
+    Handle<v8::Value> result = Instruction::New(static_cast<llvm::Instruction*>(IRBuilder::builder.CreateFCmpOGT(left, right, *name)));
+    return scope.Close(result);
+  }
+
+  v8::Handle<v8::Value> IRBuilder::CreateFCmpUNe(const v8::Arguments& args)
+  {
+    HandleScope scope;
+
+    REQ_LLVM_VAL_ARG(0, left);
+    REQ_LLVM_VAL_ARG(1, right);
+    FALLBACK_EMPTY_UTF8_ARG(2, name);
+
+    Handle<v8::Value> result = Instruction::New(static_cast<llvm::Instruction*>(IRBuilder::builder.CreateFCmpUNE(left, right, *name)));
+    return scope.Close(result);
+  }
+
   v8::Handle<v8::Value> IRBuilder::CreateBr(const v8::Arguments& args)
   {
     HandleScope scope;
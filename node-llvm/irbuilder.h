@@ -25,6 +25,10 @@ namespace jsllvm {
     static v8::Handle<v8::Value> CreateCall(const v8::Arguments& args);
     static v8::Handle<v8::Value> CreateInvoke(const v8::Arguments& args);
     static v8::Handle<v8::Value> CreateFAdd(const v8::Arguments& args);
+    static v8::Handle<v8::Value> CreateFSub(const v8::Arguments& args);
+    static v8::Handle<v8::Value> CreateFMul(const v8::Arguments& args);
+    static v8::Handle<v8::Value> CreateFDiv(const v8::Arguments& args);
+    static v8::Handle<v8::Value> CreateFRem(const v8::Arguments& args);
     static v8::Handle<v8::Value> CreateAlloca(const v8::Arguments& args);
     static v8::Handle<v8::Value> CreateLoad(const v8::Arguments& args);
     static v8::Handle<v8::Value> CreateStore(const v8::Arguments& args);
@@ -38,6 +42,12 @@ namespace jsllvm {
     static v8::Handle<v8::Value> CreateICmpUGE(const v8::Arguments& args);
     static v8::Handle<v8::Value> CreateICmpUGt(const v8::Arguments& args);
     static v8::Handle<v8::Value> CreateICmpULt(const v8::Arguments& args);
+    static v8::Handle<v8::Value> CreateFCmpOEq(const v8::Arguments& args);
+    static v8::Handle<v8::Value> CreateFCmpOGe(const v8::Arguments& args);
+    static v8::Handle<v8::Value> CreateFCmpOLt(const v8::Arguments& args);
+    static v8::Handle<v8::Value> CreateFCmpOLe(const v8::Arguments& args);
+    static v8::Handle<v8::Value> CreateFCmpOGt(const v8::Arguments& args);
+    static v8::Handle<v8::Value> CreateFCmpUNe(const v8::Arguments& args);
     static v8::Handle<v8::Value> CreateBr(const v8::Arguments& args);
     static v8::Handle<v8::Value> CreateCondBr(const v8::Arguments& args);
     static v8::Handle<v8::Value> CreatePhi(const v8::Arguments& args);
@@ -45,7 +55,14 @@ namespace jsllvm {
     static v8::Handle<v8::Value> CreateUnreachable(const v8::Arguments& args);
     static v8::Handle<v8::Value> CreateAnd(const v8::Arguments& args);
     static v8::Handle<v8::Value> CreateOr(const v8::Arguments& args);
+    static v8::Handle<v8::Value> CreateXor(const v8::Arguments& args);
+    static v8::Handle<v8::Value> CreateShl(const v8::Arguments& args);
+    static v8::Handle<v8::Value> CreateAShr(const v8::Arguments& args);
+    static v8::Handle<v8::Value> CreateLShr(const v8::Arguments& args);
     static v8::Handle<v8::Value> CreateZExt(const v8::Arguments& args);
+    static v8::Handle<v8::Value> CreateFPToSI(const v8::Arguments& args);
+    static v8::Handle<v8::Value> CreateSIToFP(const v8::Arguments& args);
+    static v8::Handle<v8::Value> CreateUIToFP(const v8::Arguments& args);
     static v8::Handle<v8::Value> CreateIntToPtr(const v8::Arguments& args);
     static v8::Handle<v8::Value> CreatePtrToInt(const v8::Arguments& args);
     static v8::Handle<v8::Value> CreateBitCast(const v8::Arguments& args);
@@ -93,6 +93,9 @@ namespace jsllvm {
     if (!strcmp (idstr, "@llvm.gcroot")) {
       intrinsic_id = llvm::Intrinsic::gcroot;
     }
+    else if (!strcmp (idstr, "@llvm.frameaddress")) {
+      intrinsic_id = llvm::Intrinsic::frameaddress;
+    }
     else {
       abort();
     }
@@ -71,7 +71,7 @@ _ejs_arguments_specop_get (ejsval obj, ejsval propertyName, ejsval receiver)
     }
 
     // we also handle the length getter here
-    if (EJSVAL_IS_STRING(propertyName) && !ucs2_strcmp (_ejs_ucs2_length, EJSVAL_TO_FLAT_STRING(propertyName))) {
+    if (EJSVAL_IS_STRING(propertyName) && _ejs_primstring_equal (EJSVAL_TO_STRING(propertyName), EJSVAL_TO_STRING(_ejs_atom_length))) {
         return NUMBER_TO_EJSVAL(arguments->argc);
     }
 
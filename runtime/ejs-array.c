@@ -13,6 +13,7 @@
 #include "ejs-string.h"
 #include "ejs-error.h"
 #include "ejs-symbol.h"
+#include "ejs-exception.h"
 
 // num > SPARSE_ARRAY_CUTOFF in "Array($num)" or "new Array($num)" triggers a sparse array
 #define SPARSE_ARRAY_CUTOFF 50000
@@ -37,6 +38,8 @@ ejsval
 _ejs_array_new (int numElements, EJSBool fill)
 {
     EJSArray* rv = _ejs_gc_new (EJSArray);
+    // keep the array visible to the stack scan while we allocate its elements
+    ejsval arr = OBJECT_TO_EJSVAL(rv);
 
     if (numElements > SPARSE_ARRAY_CUTOFF) {
         _ejs_init_object ((EJSObject*)rv, _ejs_Array_prototype, &_ejs_sparsearray_specops);
@@ -49,7 +52,8 @@ _ejs_array_new (int numElements, EJSBool fill)
         _ejs_init_object ((EJSObject*)rv, _ejs_Array_prototype, &_ejs_Array_specops);
 
         rv->dense.array_alloc = numElements + 5;
-        rv->dense.elements = (ejsval*)malloc(rv->dense.array_alloc * sizeof (ejsval));
+        rv->dense.elements = (ejsval*)_ejs_gc_new_store(rv->dense.array_alloc * sizeof (ejsval));
+        _ejs_gc_remember(rv);
         if (fill) {
             for (int i = 0; i < numElements; i ++)
                 rv->dense.elements[i] = MAGIC_TO_EJSVAL_IMPL(EJS_ARRAY_HOLE);
@@ -60,7 +64,7 @@ _ejs_array_new (int numElements, EJSBool fill)
     _ejs_property_desc_set_writable (&rv->array_length_desc, EJS_TRUE);
     _ejs_property_desc_set_value (&rv->array_length_desc, NUMBER_TO_EJSVAL(numElements));
 
-    return OBJECT_TO_EJSVAL(rv);
+    return arr;
 }
 
 ejsval
@@ -75,12 +79,14 @@ static void
 maybe_realloc_dense (EJSArray *arr, int high_index)
 {
     if (high_index >= arr->dense.array_alloc) {
-        int new_alloc = high_index + 32;
-        ejsval* new_elements = (ejsval*)malloc(new_alloc * sizeof(ejsval));
+        // grow geometrically, so pushing elements one at a time (as split does) copies each one a
+        // constant number of times on average
+        int new_alloc = MAX(high_index + 32, arr->dense.array_alloc * 2);
+        ejsval* new_elements = (ejsval*)_ejs_gc_new_store(new_alloc * sizeof(ejsval));
         memmove (new_elements, arr->dense.elements, arr->array_length * sizeof(ejsval));
-        free (arr->dense.elements);
         arr->dense.elements = new_elements;
         arr->dense.array_alloc = new_alloc;
+        _ejs_gc_remember(arr);
     }
 }
 
@@ -120,6 +126,7 @@ _ejs_array_push_dense(ejsval array, int argc, ejsval *args)
     EJSArray *arr = (EJSArray*)EJSVAL_TO_OBJECT(array);
     maybe_realloc_dense (arr, arr->array_length + argc);
     memmove (&EJSDENSEARRAY_ELEMENTS(arr)[EJSARRAY_LEN(arr)], args, argc * sizeof(ejsval));
+    _ejs_gc_remember(arr);
     EJSARRAY_LEN(arr) += argc;
     return EJSARRAY_LEN(arr);
 }
@@ -167,16 +174,18 @@ _ejs_Array_impl (ejsval env, ejsval _this, uint32_t argc, ejsval*args)
             }
             else {
                 arr->dense.array_alloc = alloc;
-                arr->dense.elements = (ejsval*)calloc(arr->dense.array_alloc, sizeof (ejsval));
+                arr->dense.elements = (ejsval*)_ejs_gc_new_store(arr->dense.array_alloc * sizeof (ejsval));
+                _ejs_gc_remember(arr);
             }
             arr->array_length = alloc;
         }
         else {
             arr->array_length = argc;
             arr->dense.array_alloc = argc + 5;
-            arr->dense.elements = (ejsval*)malloc(arr->dense.array_alloc * sizeof (ejsval));
+            arr->dense.elements = (ejsval*)_ejs_gc_new_store(arr->dense.array_alloc * sizeof (ejsval));
 
             memmove (arr->dense.elements, args, argc * sizeof(ejsval));
+            _ejs_gc_remember(arr);
         }
 
 
@@ -269,6 +278,7 @@ _ejs_Array_prototype_unshift (ejsval env, ejsval _this, uint32_t argc, ejsval* a
         int len = EJS_ARRAY_LEN(_this);
         memmove (EJS_DENSE_ARRAY_ELEMENTS(_this) + argc, EJS_DENSE_ARRAY_ELEMENTS(_this), sizeof(ejsval) * len);
         memmove (EJS_DENSE_ARRAY_ELEMENTS(_this), args, sizeof(ejsval) * argc);
+        _ejs_gc_remember(arr);
         EJS_ARRAY_LEN(_this) += argc;
         return NUMBER_TO_EJSVAL(len + argc);
     }
@@ -712,69 +722,57 @@ _ejs_Array_prototype_slice (ejsval env, ejsval _this, uint32_t argc, ejsval* arg
     return A;
 }
 
+// ToString, as a function join can call through _ejs_invoke_closure_catch
+static ejsval _ejs_Array_join_tostring EJSVAL_ALIGNMENT;
+
+static ejsval
+_ejs_Array_join_tostring_impl (ejsval env, ejsval _this, uint32_t argc, ejsval* args)
+{
+    return ToString(args[0]);
+}
+
 // ECMA262: 15.4.4.5
 static ejsval
 _ejs_Array_prototype_join (ejsval env, ejsval _this, uint32_t argc, ejsval*args)
 {
-    // XXX this method should be optimized to create a rope
-    // instead of a flat string.
-
     if (EJS_ARRAY_LEN(_this) == 0)
         return _ejs_atom_empty;
 
     if (!EJSVAL_IS_DENSE_ARRAY(_this))
         abort();
 
-    const jschar* separator;
-    int separator_len;
-
-    if (argc > 0) {
-        ejsval sepToString = ToString(args[0]);
-        separator_len = EJSVAL_TO_STRLEN(sepToString);
-        separator = EJSVAL_TO_FLAT_STRING(sepToString);
-    }
-    else {
-        static jschar comma[] = { (jschar)',' };
-        separator = comma;
-        separator_len = 1;
-    }
-  
-    jschar* result;
-    int result_len = 0;
-
-    int num_strings = EJS_ARRAY_LEN(_this);
-
-    ejsval* strings = (ejsval*)malloc (sizeof (ejsval) * num_strings);
-    int i;
-
-    for (i = 0; i < num_strings; i ++) {
-        strings[i] = ToString(EJS_DENSE_ARRAY_ELEMENTS(_this)[i]);
-        result_len += EJSVAL_TO_STRLEN(strings[i]);
-    }
-
-    result_len += separator_len * (EJS_ARRAY_LEN(_this)-1) + 1/* \0 terminator */;
-
-    result = (jschar*)malloc (sizeof(jschar) * result_len);
-    jschar *p = result;
-
-    for (i = 0; i < num_strings; i ++) {
-        jschar *str_str = EJSVAL_TO_FLAT_STRING(strings[i]);
-        int slen = EJSVAL_TO_STRLEN(strings[i]);
-        memmove (p, str_str, slen * sizeof(jschar));
-        p += slen;
-        if (i < num_strings-1) {
-            memmove (p, separator, separator_len * sizeof(jschar));
-            p += separator_len;
+    ejsval separator;
+    if (argc > 0 && !EJSVAL_IS_UNDEFINED(args[0]))
+        separator = ToString(args[0]);
+    else
+        separator = _ejs_string_new_latin1_len ((const uint8_t*)",", 1);
+
+    // each element's string is copied into the builder as soon as it's made, so nothing has to
+    // keep them alive (or keep a rope of them) until the end
+    EJSStringBuilder builder;
+    _ejs_string_builder_init (&builder);
+
+    for (int i = 0; i < EJS_ARRAY_LEN(_this); i ++) {
+        if (i > 0)
+            _ejs_string_builder_append (&builder, separator);
+        ejsval el = EJS_DENSE_ARRAY_ELEMENTS(_this)[i];
+        if (EJSVAL_IS_NULL_OR_UNDEFINED(el))
+            continue;
+
+        // only objects (through their toString or valueOf, or by being symbols) can throw.  the
+        // builder's buffer is malloc'd once it outgrows the stack, so free it before passing the
+        // exception on.
+        ejsval str;
+        if (!EJSVAL_IS_OBJECT(el))
+            str = ToString(el);
+        else if (!_ejs_invoke_closure_catch (&str, _ejs_Array_join_tostring, _ejs_undefined, 1, &el)) {
+            _ejs_string_builder_discard (&builder);
+            _ejs_exception_throw (str);
         }
+        _ejs_string_builder_append (&builder, str);
     }
-    *p = 0;
-
-    ejsval rv = _ejs_string_new_ucs2(result);
 
-    free (result);
-    free (strings);
-
-    return rv;
+    return _ejs_string_builder_finish (&builder);
 }
 
 ejsval
@@ -2248,6 +2246,9 @@ _ejs_array_init(ejsval global)
 
     _ejs_object_setprop (global,           _ejs_atom_Array,      _ejs_Array);
 
+    _ejs_gc_add_root (&_ejs_Array_join_tostring);
+    _ejs_Array_join_tostring = _ejs_function_new_native (_ejs_null, _ejs_atom_toString, (EJSClosureFunc)_ejs_Array_join_tostring_impl);
+
     _ejs_gc_add_root (&_ejs_Array_prototype);
     _ejs_Array_prototype = _ejs_array_new(0, EJS_FALSE);
     EJSVAL_TO_OBJECT(_ejs_Array_prototype)->proto = _ejs_Object_prototype;
@@ -2322,23 +2323,45 @@ _ejs_array_init(ejsval global)
 #undef PROTO_ITER_METHOD
 }
 
+// cheap test for whether propertyName names an element.  numbers are
+// checked directly, and only strings that start with a digit are
+// worth handing to ToNumber -- "length", method names and symbols
+// never are.
+EJSBool
+_ejs_array_index (ejsval propertyName, int* idx)
+{
+    double n;
+
+    if (EJSVAL_IS_NUMBER(propertyName)) {
+        n = EJSVAL_TO_NUMBER(propertyName);
+    }
+    else if (EJSVAL_IS_STRING(propertyName)) {
+        if (EJSVAL_TO_STRLEN(propertyName) == 0)
+            return EJS_FALSE;
+        jschar c = _ejs_string_ucs2_at (EJSVAL_TO_STRING(propertyName), 0);
+        if (c < '0' || c > '9')
+            return EJS_FALSE;
+        ejsval idx_val = ToNumber(propertyName);
+        if (!EJSVAL_IS_NUMBER(idx_val))
+            return EJS_FALSE;
+        n = EJSVAL_TO_NUMBER(idx_val);
+    }
+    else {
+        return EJS_FALSE;
+    }
+
+    if (!(n >= 0 && n < 2147483648.0) || (int)n != n)
+        return EJS_FALSE;
+    *idx = (int)n;
+    return EJS_TRUE;
+}
+
 static ejsval
 _ejs_array_specop_get (ejsval obj, ejsval propertyName, ejsval receiver)
 {
-    // check if propertyName is an integer, or a string that we can convert to an int
-    EJSBool is_index = EJS_FALSE;
-    ejsval idx_val = ToNumber(propertyName);
     int idx;
-    if (EJSVAL_IS_NUMBER(idx_val)) {
-        double n = EJSVAL_TO_NUMBER(idx_val);
-        if (floor(n) == n) {
-            idx = (int)n;
-            is_index = EJS_TRUE;
-        }
-    }
-
-    if (is_index) {
-        if (idx < 0 || idx >= EJS_ARRAY_LEN(obj)) {
+    if (_ejs_array_index(propertyName, &idx)) {
+        if (idx >= EJS_ARRAY_LEN(obj)) {
             //printf ("getprop(%d) on an array, returning undefined\n", idx);
             return _ejs_undefined;
         }
@@ -2349,7 +2372,7 @@ _ejs_array_specop_get (ejsval obj, ejsval propertyName, ejsval receiver)
     }
 
     // we also handle the length getter here
-    if (EJSVAL_IS_STRING(propertyName) && !ucs2_strcmp (_ejs_ucs2_length, EJSVAL_TO_FLAT_STRING(propertyName))) {
+    if (EJSVAL_IS_STRING(propertyName) && _ejs_primstring_equal (EJSVAL_TO_STRING(propertyName), EJSVAL_TO_STRING(_ejs_atom_length))) {
         return NUMBER_TO_EJSVAL (EJS_ARRAY_LEN(obj));
     }
 
@@ -2358,24 +2381,12 @@ _ejs_array_specop_get (ejsval obj, ejsval propertyName, ejsval receiver)
 }
 
 static EJSPropertyDesc*
-_ejs_array_specop_get_own_property (ejsval obj, ejsval propertyName, ejsval *exc)
+_ejs_array_specop_get_own_property (ejsval obj, ejsval propertyName, ejsval *exc, EJSPropertyDesc* desc)
 {
-    // check if propertyName is an integer, or a string that we can convert to an int
-    EJSBool is_index = EJS_FALSE;
-    ejsval idx_val = ToNumber(propertyName);
     int idx;
-    if (EJSVAL_IS_NUMBER(idx_val)) {
-        double n = EJSVAL_TO_NUMBER(idx_val);
-        if (floor(n) == n) {
-            idx = (int)n;
-            is_index = EJS_TRUE;
-        }
-    }
-
-    if (is_index) {
-        if (idx >= 0 || idx < EJS_ARRAY_LEN(obj)) {
-            // XXX we leak this.  need to change get_own_property to use an out param instead of a return value
-            EJSPropertyDesc* desc = (EJSPropertyDesc*)calloc(sizeof(EJSPropertyDesc), 1);
+    if (_ejs_array_index(propertyName, &idx)) {
+        if (idx < EJS_ARRAY_LEN(obj)) {
+            memset (desc, 0, sizeof(EJSPropertyDesc));
             _ejs_property_desc_set_writable (desc, EJS_TRUE);
             _ejs_property_desc_set_value (desc, EJS_DENSE_ARRAY_ELEMENTS(obj)[idx]);
             return desc;
@@ -2383,31 +2394,21 @@ _ejs_array_specop_get_own_property (ejsval obj, ejsval propertyName, ejsval *exc
     }
 
 
-    if (EJSVAL_IS_STRING(propertyName) && !ucs2_strcmp (_ejs_ucs2_length, EJSVAL_TO_FLAT_STRING(propertyName))) {
+    if (EJSVAL_IS_STRING(propertyName) && _ejs_primstring_equal (EJSVAL_TO_STRING(propertyName), EJSVAL_TO_STRING(_ejs_atom_length))) {
         EJSArray* arr = (EJSArray*)EJSVAL_TO_OBJECT(obj);
         _ejs_property_desc_set_value (&arr->array_length_desc, NUMBER_TO_EJSVAL(EJSARRAY_LEN(arr)));
-        return &arr->array_length_desc;
+        *desc = arr->array_length_desc;
+        return desc;
     }
 
-    return _ejs_Object_specops.GetOwnProperty (obj, propertyName, exc);
+    return _ejs_Object_specops.GetOwnProperty (obj, propertyName, exc, desc);
 }
 
 static EJSBool
 _ejs_array_specop_set (ejsval obj, ejsval propertyName, ejsval val, ejsval receiver)
 {
-    // check if propertyName is a uint32, or a string that we can convert to an uint32
-    EJSBool is_index = EJS_FALSE;
-    ejsval idx_val = ToNumber(propertyName);
     int idx;
-    if (EJSVAL_IS_NUMBER(idx_val)) {
-        double n = EJSVAL_TO_NUMBER(idx_val);
-        if (floor(n) == n) {
-            idx = (int)n;
-            is_index = EJS_TRUE;
-        }
-    }
-
-    if (is_index) {
+    if (_ejs_array_index(propertyName, &idx)) {
         if (EJSVAL_IS_DENSE_ARRAY(obj)) {
             // we're a dense array, realloc to include up to idx+1
 
@@ -2425,6 +2426,7 @@ _ejs_array_specop_set (ejsval obj, ejsval propertyName, ejsval val, ejsval recei
             }
 
             EJS_DENSE_ARRAY_ELEMENTS(obj)[idx] = val;
+            _ejs_gc_write_barrier(EJSVAL_TO_OBJECT(obj), val);
         }
         else {
             // we're already sparse, just give up as none of this is implemented yet.
@@ -2441,20 +2443,12 @@ _ejs_array_specop_set (ejsval obj, ejsval propertyName, ejsval val, ejsval recei
 static EJSBool
 _ejs_array_specop_has_property (ejsval obj, ejsval propertyName)
 {
-    // check if propertyName is an integer, or a string that we can convert to an int
-    ejsval idx_val = ToNumber(propertyName);
     int idx;
-    if (EJSVAL_IS_NUMBER(idx_val)) {
-        double n = EJSVAL_TO_NUMBER(idx_val);
-        if (floor(n) == n) {
-            idx = (int)n;
-            if (idx >= 0 && idx < EJS_ARRAY_LEN(obj)) {
-                ejsval element = EJS_DENSE_ARRAY_ELEMENTS(obj)[idx];
-                if (EJSVAL_IS_ARRAY_HOLE_MAGIC(element))
-                    return EJS_FALSE;
-                return EJS_TRUE;
-            }
-        }
+    if (_ejs_array_index(propertyName, &idx) && idx < EJS_ARRAY_LEN(obj)) {
+        ejsval element = EJS_DENSE_ARRAY_ELEMENTS(obj)[idx];
+        if (EJSVAL_IS_ARRAY_HOLE_MAGIC(element))
+            return EJS_FALSE;
+        return EJS_TRUE;
     }
 
     // if we fail there, we fall back to the object impl below
@@ -2486,20 +2480,8 @@ _ejs_array_specop_delete (ejsval obj, ejsval propertyName, EJSBool flag)
 static EJSBool
 _ejs_array_specop_define_own_property (ejsval obj, ejsval propertyName, EJSPropertyDesc* propertyDescriptor, EJSBool flag)
 {
-    // check if propertyName is a uint32, or a string that we can convert to an uint32
-    EJSBool is_index = EJS_FALSE;
-    ejsval idx_val = ToNumber(propertyName);
     int idx;
-    if (EJSVAL_IS_NUMBER(idx_val)) {
-        double n = EJSVAL_TO_NUMBER(idx_val);
-        if (floor(n) == n) {
-            idx = (int)n;
-            if (idx >= 0)
-                is_index = EJS_TRUE;
-        }
-    }
-
-    if (is_index) {
+    if (_ejs_array_index(propertyName, &idx)) {
         if (EJSVAL_IS_DENSE_ARRAY(obj)) {
             // we're a dense array, realloc to include up to idx+1
 
@@ -2521,6 +2503,7 @@ _ejs_array_specop_define_own_property (ejsval obj, ejsval propertyName, EJSPrope
             }
 
             EJS_DENSE_ARRAY_ELEMENTS(obj)[idx] = propertyDescriptor->value;
+            _ejs_gc_write_barrier(EJSVAL_TO_OBJECT(obj), propertyDescriptor->value);
         }
         else {
             // we're already sparse, just give up as none of this is implemented yet.
@@ -2531,7 +2514,7 @@ _ejs_array_specop_define_own_property (ejsval obj, ejsval propertyName, EJSPrope
     }
 
     if (EJSVAL_IS_STRING(propertyName)) {
-        if (!ucs2_strcmp (_ejs_ucs2_length, EJSVAL_TO_FLAT_STRING(propertyName))) {
+        if (_ejs_primstring_equal (EJSVAL_TO_STRING(propertyName), EJSVAL_TO_STRING(_ejs_atom_length))) {
             // XXX more from 15.4.5.1 here
             int newLen = ToUint32(_ejs_property_desc_get_value(propertyDescriptor));
             int oldLen = EJS_ARRAY_LEN(obj);
@@ -2576,9 +2559,6 @@ _ejs_array_specop_finalize (EJSObject* obj)
         }
         free (arr->sparse.arraylets);
     }
-    else {
-        free (EJSDENSEARRAY_ELEMENTS(obj));
-    }
     _ejs_Object_specops.Finalize (obj);
 }
 
@@ -2595,6 +2575,7 @@ _ejs_array_specop_scan (EJSObject* obj, EJSValueFunc scan_func)
         }
     }
     else {
+        _ejs_gc_mark_store (EJSDENSEARRAY_ELEMENTS(obj));
         for (int i = 0; i < EJSARRAY_LEN(obj); i ++)
             scan_func (EJSDENSEARRAY_ELEMENTS(obj)[i]);
     }
@@ -78,6 +78,10 @@ extern EJSSpecOps _ejs_ArrayIterator_specops;
 ejsval _ejs_array_create (ejsval length, ejsval proto);
 ejsval _ejs_array_new (int numElements, EJSBool fill);
 
+// true if propertyName is a number or numeric string naming an
+// element in [0, INT32_MAX], with the index stored in *idx.
+EJSBool _ejs_array_index (ejsval propertyName, int* idx);
+
 typedef enum {
     EJS_ARRAYITER_KIND_KEY,
     EJS_ARRAYITER_KIND_VALUE,
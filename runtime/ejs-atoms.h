@@ -323,8 +323,17 @@ EJS_ATOM(timeEnd)
 
 // gc functions
 EJS_ATOM(collect)
+EJS_ATOM(configure)
 EJS_ATOM(dumpAllocationStats)
 EJS_ATOM(dumpLiveStrings)
+EJS_ATOM(stats)
+EJS_ATOM(writeHeapSnapshot)
+EJS_ATOM(startAllocationSampling)
+EJS_ATOM(stopAllocationSampling)
+EJS_ATOM(heapGrowthFactor)
+EJS_ATOM(minHeapGrowth)
+EJS_ATOM(maxHeapGrowth)
+EJS_ATOM(eventFd)
 
 // process functions/properties
 EJS_ATOM(exit)
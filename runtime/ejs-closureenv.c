@@ -47,3 +47,16 @@ _ejs_closureenv_get_slot_ref (ejsval env, uint32_t slot)
     EJS_ASSERT(slot < env_->length);
     return &env_->slots[slot];
 }
+
+void
+_ejs_closureenv_set_slot (ejsval env, uint32_t slot, ejsval val)
+{
+    *_ejs_closureenv_get_slot_ref (env, slot) = val;
+    _ejs_gc_write_barrier (EJSVAL_TO_CLOSUREENV_IMPL(env), val);
+}
+
+void
+_ejs_closureenv_write_barrier (ejsval env, ejsval val)
+{
+    _ejs_gc_write_barrier (EJSVAL_TO_CLOSUREENV_IMPL(env), val);
+}
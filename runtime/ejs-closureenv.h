@@ -16,5 +16,9 @@ ejsval  _ejs_closureenv_new (uint32_t length);
 ejsval  _ejs_closure_init (EJSClosureEnv* env, uint32_t length);
 ejsval  _ejs_closureenv_get_slot (ejsval env, uint32_t slot);
 ejsval* _ejs_closureenv_get_slot_ref (ejsval env, uint32_t slot);
+void    _ejs_closureenv_set_slot (ejsval env, uint32_t slot, ejsval val);
+
+// called by generated code after it stores @val directly into one of @env's slots
+void    _ejs_closureenv_write_barrier (ejsval env, ejsval val);
 
 #endif /* _ejs_closureenv_h */
@@ -51,8 +51,6 @@ output (FILE *outfile, uint32_t argc, ejsval *args)
             }
         }
         else if (EJSVAL_IS_ARRAY(args[i])) {
-            char* strval_utf8;
-
             if (EJS_ARRAY_LEN(args[i]) == 0) {
                 OUTPUT0 ("[]");
             }
@@ -63,18 +61,20 @@ output (FILE *outfile, uint32_t argc, ejsval *args)
 
                 ejsval contents = _ejs_array_join (args[i], comma_space);
 
-                strval_utf8 = ucs2_to_utf8(EJSVAL_TO_FLAT_STRING(_ejs_string_concatv (lbracket, contents, rbracket, _ejs_null)));
+                EJSUtf8Buffer strval_utf8;
+                _ejs_string_utf8_buffer_init (&strval_utf8, _ejs_string_concatv (lbracket, contents, rbracket, _ejs_null));
 
-                OUTPUT ("%s", strval_utf8);
-                free (strval_utf8);
+                OUTPUT ("%s", strval_utf8.str);
+                _ejs_string_utf8_buffer_free (&strval_utf8);
             }
         }
         else if (EJSVAL_IS_ERROR(args[i])) {
             ejsval strval = ToString(args[i]);
 
-            char* strval_utf8 = ucs2_to_utf8(EJSVAL_TO_FLAT_STRING(strval));
-            OUTPUT ("[%s]", strval_utf8);
-            free (strval_utf8);
+            EJSUtf8Buffer strval_utf8;
+            _ejs_string_utf8_buffer_init (&strval_utf8, strval);
+            OUTPUT ("[%s]", strval_utf8.str);
+            _ejs_string_utf8_buffer_free (&strval_utf8);
         }
         else if (EJSVAL_IS_FUNCTION(args[i])) {
             ejsval func_name = _ejs_object_getprop (args[i], _ejs_atom_name);
@@ -83,17 +83,19 @@ output (FILE *outfile, uint32_t argc, ejsval *args)
                 OUTPUT0("[Function]");
             }
             else {
-                char* strval_utf8 = ucs2_to_utf8(EJSVAL_TO_FLAT_STRING(func_name));
-                OUTPUT ("[Function: %s]", strval_utf8);
-                free (strval_utf8);
+                EJSUtf8Buffer strval_utf8;
+                _ejs_string_utf8_buffer_init (&strval_utf8, func_name);
+                OUTPUT ("[Function: %s]", strval_utf8.str);
+                _ejs_string_utf8_buffer_free (&strval_utf8);
             }
         }
         else {
             ejsval strval = ToString(args[i]);
 
-            char* strval_utf8 = ucs2_to_utf8(EJSVAL_TO_FLAT_STRING(strval));
-            OUTPUT ("%s", strval_utf8);
-            free (strval_utf8);
+            EJSUtf8Buffer strval_utf8;
+            _ejs_string_utf8_buffer_init (&strval_utf8, strval);
+            OUTPUT ("%s", strval_utf8.str);
+            _ejs_string_utf8_buffer_free (&strval_utf8);
         }
 #if !IOS
         if (i < argc - 1)
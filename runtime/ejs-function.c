@@ -362,9 +362,7 @@ _ejs_Function_prototype_create(ejsval env, ejsval _this, uint32_t argc, ejsval*
         EJS_NOT_IMPLEMENTED(); // cross-realm doesn't exist in ejs yet
     }
 
-    EJSObject* obj = (EJSObject*)_ejs_gc_new (EJSObject);
-    _ejs_init_object (obj, proto, &_ejs_Object_specops);
-    return OBJECT_TO_EJSVAL(obj);
+    return _ejs_object_new (proto, &_ejs_Object_specops);
 }
 
 static void
@@ -9,8 +9,12 @@
 #include <stddef.h>
 #include <sys/types.h>
 #include <sys/time.h>
+#include <time.h>
+#include <math.h>
 #include <sys/mman.h>
 #include <setjmp.h>
+#include <pthread.h>
+#include <sched.h>
 
 #include "ejs-gc.h"
 #include "ejs-function.h"
@@ -20,12 +24,15 @@
 #include "ejs-ops.h"
 #include "ejsval.h"
 #include "ejs-module.h"
+#include "ejs-array.h"
+#include "ejs-shape.h"
 
 #define clear_on_finalize 0
 
 #define spew 0
 #define sanity 0
 #define gc_timings 0
+#define parallel_marking !IOS // we need __thread support
 
 #if spew
 static int _ejs_spew_level = (spew);
@@ -68,7 +75,10 @@ void _ejs_gc_dump_heap_stats();
 #define PTR_TO_ARENA_PAGE_BASE(ptr) ((void*)ALIGN(PTR_TO_ARENA(ptr) + sizeof(Arena), PAGE_SIZE))
 #define PTR_TO_ARENA_PAGE_INDEX(ptr) ((((uintptr_t)(ptr) & ~PTR_TO_ARENA_MASK) - ((uintptr_t)PTR_TO_ARENA_PAGE_BASE(ptr) & ~PTR_TO_ARENA_MASK)) / PAGE_SIZE)
 
-#define PTR_TO_CELL(ptr,info) (((char*)(ptr) - (char*)(info)->page_start) / (info)->cell_size)
+// cell sizes aren't powers of 2, so rather than dividing by the cell size we multiply by cell_magic
+// (2^32 / cell_size, rounded up), which is exact for any offset within a page.
+#define PTR_TO_CELL(ptr,info) ((uint32_t)((((uintptr_t)(ptr) - (uintptr_t)(info)->page_start) * (uint64_t)(info)->cell_magic) >> 32))
+#define CELL_MAGIC(size) ((uint32_t)((1ULL << 32) / (size)) + 1)
 
 #define OBJ_TO_PAGE(o) ((o) & ~PAGE_SIZE)
 
@@ -80,13 +90,100 @@ void _ejs_gc_dump_heap_stats();
 #if IOS || OSX
 #include <mach/vm_statistics.h>
 #define MAP_FD VM_MAKE_TAG (VM_MEMORY_APPLICATION_SPECIFIC_16)
+#define DECOMMIT_ADVICE MADV_FREE
 #else
 #define MAP_FD -1
+#define DECOMMIT_ADVICE MADV_DONTNEED
 #endif
 
 EJSBool gc_disabled;
 int collect_every_alloc = 0;
 
+// generational collection.  when enabled (EJS_GC_GENERATIONAL=1), freshly allocated cells make up the
+// young generation and are collected by frequent minor collections that only mark from the roots,
+// the stack, and the remembered set.  The collector is non-moving (we scan the C stack conservatively,
+// so we can't relocate anything), so survivors are promoted in place by setting CELL_OLD in their
+// bitmap cell.
+static EJSBool generational;
+
+// EJS_TRUE if the write barrier has work to do, either because we're generational or because an
+// incremental mark is in progress.
+EJSBool _ejs_gc_barrier_enabled;
+
+// the number of bytes we allocate between minor collections
+#define DEFAULT_NURSERY_SIZE (4*1024*1024)
+static size_t nursery_size = DEFAULT_NURSERY_SIZE;
+static size_t nursery_allocated = 0;
+
+// the number of bytes promoted to the old generation since the last full collection
+static size_t promoted_since_full_gc = 0;
+
+// heap growth policy.  the next full collection happens once we've allocated (or, if we're
+// generational, promoted) heap_growth_factor - 1 times what the last full collection found live,
+// clamped to [min_heap_growth, max_heap_growth].  set with EJS_GC_HEAP_GROWTH_FACTOR,
+// EJS_GC_MIN_HEAP_GROWTH and EJS_GC_MAX_HEAP_GROWTH, or GC.configure().
+#define DEFAULT_HEAP_GROWTH_FACTOR 2.0
+#define DEFAULT_MIN_HEAP_GROWTH (8*1024*1024)
+#define DEFAULT_MAX_HEAP_GROWTH (512*1024*1024)
+static double heap_growth_factor = DEFAULT_HEAP_GROWTH_FACTOR;
+static size_t min_heap_growth = DEFAULT_MIN_HEAP_GROWTH;
+static size_t max_heap_growth = DEFAULT_MAX_HEAP_GROWTH;
+
+// the bytes marked by the current (or last) full collection, and the allocation that will trigger the next one
+static size_t marked_bytes = 0;
+static size_t next_gc_allocation = DEFAULT_MIN_HEAP_GROWTH;
+
+// bytes of stores marked by the Scan op currently running on this thread.  mark_object folds
+// them into the owner's size.
+#if parallel_marking
+static __thread size_t marked_store_bytes;
+#else
+static size_t marked_store_bytes;
+#endif
+
+// EJS_TRUE while a minor collection is marking.  old cells are considered live and aren't traced.
+static EJSBool minor_collection = EJS_FALSE;
+
+// incremental marking.  when enabled (EJS_GC_INCREMENTAL=1), a full collection starts by graying the
+// roots, modules and stack, and then marking proceeds a step at a time, interleaved with allocation
+// (and run from the runloop when it's idle.)  Stores into the heap while marking is in progress go
+// through the write barrier, which grays the stored value (or regrays the owner if we don't know
+// what was stored), so a black object never hides a white one from the marker.  New cells are
+// allocated white, and are found by the final pause, which rescans the roots, modules and the stack
+// before draining what's left of the work list and sweeping.
+//
+// the final pause doesn't rescan the heap, so this is only sound if every store into a cell that
+// might already be black is barriered: the object, array, map, set, promise, proxy, regexp, string
+// and typed array code in the runtime, and closure env slot stores in both the runtime and
+// generated code.  stores that fill in a cell before anything else can reach it don't need the
+// barrier, as nothing can have scanned it yet.  module exports are rescanned by the final pause.
+static EJSBool incremental_marking;
+static EJSBool marking_in_progress;
+
+// we take a marking step every INCREMENTAL_MARK_STEP_BYTES allocated, marking at most
+// INCREMENTAL_MARK_STEP_BUDGET objects
+#define INCREMENTAL_MARK_STEP_BYTES (128*1024)
+#define INCREMENTAL_MARK_STEP_BUDGET 4096
+static size_t mark_step_allocated = 0;
+
+// the bytes taken up by allocated cells (live or not yet swept)
+static size_t heap_bytes_in_use = 0;
+
+// starts at 1 so zeroed caches are out of date
+uint32_t _ejs_gc_epoch = 1;
+
+// gc events are written as json lines to this fd, if it's set (see end_pause)
+static int event_fd = -1;
+static uint64_t gc_start_usec;
+static uint64_t gc_now_usec();
+
+// allocation sampling, off unless EJS_GC_ALLOC_SAMPLE_INTERVAL or GC.startAllocationSampling turn
+// it on.  we take a sample every alloc_sample_interval bytes.
+#define DEFAULT_ALLOC_SAMPLE_INTERVAL (32*1024)
+static size_t alloc_sample_interval = 0;
+static size_t alloc_sample_countdown = 0;
+static void sample_allocation(GCObjectPtr cell, size_t size);
+
 #define LOCK_PAGE(info)
 #define UNLOCK_PAGE(info)
 #define LOCK_GC()
@@ -160,18 +257,160 @@ _ejs_gc_worklist_pop()
     return rv;
 }
 
+#if parallel_marking
+// parallel marking (EJS_GC_MARK_THREADS=n).  the mutator seeds work_list from the roots, modules and
+// stack as usual, then that work is dealt out to per-thread Chase-Lev work stealing deques and drained by
+// n threads (the mutator thread included).  cells are grayed with a CAS, so only the thread that
+// grays a cell pushes it.
+#define MAX_MARK_THREADS 64
+#define MARK_DEQUE_INITIAL_SIZE 1024
+
+// don't bother starting threads to mark heaps smaller than this
+#define PARALLEL_MARK_MIN_HEAP_SIZE (32*1024*1024)
+
+typedef struct _MarkDequeArray {
+    struct _MarkDequeArray *retired; // arrays we've outgrown.  stealers might still be reading them.
+    int64_t size;
+    GCObjectPtr elements[1];
+} MarkDequeArray;
+
+typedef struct {
+    int64_t top;
+    int64_t bottom;
+    MarkDequeArray *array;
+    char pad[64 - 2 * sizeof(int64_t) - sizeof(MarkDequeArray*)]; // keep each deque on its own cache line
+} MarkDeque;
+
+#define MARK_DEQUE_EMPTY ((GCObjectPtr)NULL)
+#define MARK_DEQUE_ABORT ((GCObjectPtr)1)
+
+static int num_mark_threads = 1;
+static int num_active_markers;
+static MarkDeque mark_deques[MAX_MARK_THREADS];
+static __thread MarkDeque *current_mark_deque;
+
+static MarkDequeArray*
+mark_deque_array_new (int64_t size)
+{
+    MarkDequeArray *a = (MarkDequeArray*)malloc (sizeof(MarkDequeArray) + (size - 1) * sizeof(GCObjectPtr));
+    a->retired = NULL;
+    a->size = size;
+    return a;
+}
+
+static void
+mark_deque_init (MarkDeque *dq)
+{
+    if (!dq->array)
+        dq->array = mark_deque_array_new (MARK_DEQUE_INITIAL_SIZE);
+    dq->top = dq->bottom = 0;
+}
+
+static void
+mark_deque_free_retired (MarkDeque *dq)
+{
+    MarkDequeArray *a = dq->array->retired;
+    while (a) {
+        MarkDequeArray *next = a->retired;
+        free (a);
+        a = next;
+    }
+    dq->array->retired = NULL;
+}
+
+// only called by the deque's owner
+static void
+mark_deque_push (MarkDeque *dq, GCObjectPtr obj)
+{
+    int64_t b = __atomic_load_n (&dq->bottom, __ATOMIC_RELAXED);
+    int64_t t = __atomic_load_n (&dq->top, __ATOMIC_ACQUIRE);
+    MarkDequeArray *a = __atomic_load_n (&dq->array, __ATOMIC_RELAXED);
+
+    if (b - t > a->size - 1) {
+        MarkDequeArray *grown = mark_deque_array_new (a->size * 2);
+        for (int64_t i = t; i < b; i ++)
+            grown->elements[i & (grown->size - 1)] = a->elements[i & (a->size - 1)];
+        grown->retired = a;
+        __atomic_store_n (&dq->array, grown, __ATOMIC_RELEASE);
+        a = grown;
+    }
+
+    a->elements[b & (a->size - 1)] = obj;
+    __atomic_thread_fence (__ATOMIC_RELEASE);
+    __atomic_store_n (&dq->bottom, b + 1, __ATOMIC_RELAXED);
+}
+
+// only called by the deque's owner
+static GCObjectPtr
+mark_deque_take (MarkDeque *dq)
+{
+    int64_t b = __atomic_load_n (&dq->bottom, __ATOMIC_RELAXED) - 1;
+    MarkDequeArray *a = __atomic_load_n (&dq->array, __ATOMIC_RELAXED);
+    __atomic_store_n (&dq->bottom, b, __ATOMIC_RELAXED);
+    __atomic_thread_fence (__ATOMIC_SEQ_CST);
+    int64_t t = __atomic_load_n (&dq->top, __ATOMIC_RELAXED);
+
+    GCObjectPtr rv = MARK_DEQUE_EMPTY;
+    if (t <= b) {
+        rv = a->elements[b & (a->size - 1)];
+        if (t == b) {
+            // this is the last element, so we race the stealers for it
+            if (!__atomic_compare_exchange_n (&dq->top, &t, t + 1, EJS_FALSE, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+                rv = MARK_DEQUE_EMPTY;
+            __atomic_store_n (&dq->bottom, b + 1, __ATOMIC_RELAXED);
+        }
+    }
+    else {
+        __atomic_store_n (&dq->bottom, b + 1, __ATOMIC_RELAXED);
+    }
+    return rv;
+}
+
+// called by any thread.  returns MARK_DEQUE_ABORT if we lost a race with another thread
+static GCObjectPtr
+mark_deque_steal (MarkDeque *dq)
+{
+    int64_t t = __atomic_load_n (&dq->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence (__ATOMIC_SEQ_CST);
+    int64_t b = __atomic_load_n (&dq->bottom, __ATOMIC_ACQUIRE);
+
+    if (t >= b)
+        return MARK_DEQUE_EMPTY;
+
+    MarkDequeArray *a = __atomic_load_n (&dq->array, __ATOMIC_ACQUIRE);
+    GCObjectPtr rv = a->elements[t & (a->size - 1)];
+    if (!__atomic_compare_exchange_n (&dq->top, &t, t + 1, EJS_FALSE, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+        return MARK_DEQUE_ABORT;
+    return rv;
+}
+
+static EJSBool
+mark_deque_is_empty (MarkDeque *dq)
+{
+    return __atomic_load_n (&dq->top, __ATOMIC_ACQUIRE) >= __atomic_load_n (&dq->bottom, __ATOMIC_ACQUIRE);
+}
+
+// push onto the current marking thread's deque, or the global work list if we aren't marking in parallel
+static void
+mark_push (GCObjectPtr obj)
+{
+    if (current_mark_deque)
+        mark_deque_push (current_mark_deque, obj);
+    else
+        _ejs_gc_worklist_push (obj);
+}
+#else
+#define mark_push _ejs_gc_worklist_push
+#endif
+
 #define WORKLIST_PUSH_AND_GRAY(x) EJS_MACRO_START        \
-    if (is_white((GCObjectPtr)x)) {                      \
-        _ejs_gc_worklist_push((GCObjectPtr)(x));         \
-        set_gray ((GCObjectPtr)(x));                     \
-    }                                                    \
+    if (try_set_gray((GCObjectPtr)x))                    \
+        mark_push((GCObjectPtr)(x));                     \
     EJS_MACRO_END
 
 #define WORKLIST_PUSH_AND_GRAY_CELL(x, cell) EJS_MACRO_START    \
-    if (IS_WHITE(cell)) {                                       \
-        _ejs_gc_worklist_push((GCObjectPtr)(x));                \
-        SET_GRAY (cell);                                        \
-    }                                                           \
+    if (try_set_gray_cell(&(cell)))                             \
+        mark_push((GCObjectPtr)(x));                            \
     EJS_MACRO_END
 
 typedef struct _RootSetEntry {
@@ -181,6 +420,9 @@ typedef struct _RootSetEntry {
 
 static RootSetEntry *root_set;
 
+// innermost live frame of compiled code built with --shadow-stack
+static EJSShadowFrame *shadow_stack;
+
 static void*
 alloc_from_os(size_t size, size_t align)
 {
@@ -241,6 +483,56 @@ typedef struct _Arena {
 static Arena *heap_arenas[MAX_ARENAS];
 static int num_arenas;
 
+// how much memory we hang on to once sweeping is done.  empty pages past the first
+// retained_free_pages are decommitted (EJS_GC_RETAIN_FREE_PAGES), and arenas that are
+// entirely empty are unmapped as long as we keep retained_arenas of them (EJS_GC_RETAIN_ARENAS).
+#define DEFAULT_RETAINED_FREE_PAGES 256
+#define DEFAULT_RETAINED_ARENAS 10
+static int retained_free_pages = DEFAULT_RETAINED_FREE_PAGES;
+static int retained_arenas = DEFAULT_RETAINED_ARENAS;
+static int num_committed_free_pages;
+
+// pointer -> arena lookup.  arenas are ARENA_SIZE aligned, so the address bits above ARENA_SIZE
+// index a two level table of arenas.  the second level tables are allocated as arenas are.
+#if EJS_BITS_PER_WORD == 64
+#define ARENA_TABLE_ADDRESS_BITS 48
+#else
+#define ARENA_TABLE_ADDRESS_BITS 32
+#endif
+#define ARENA_TABLE_ENTRIES ((1ULL << ARENA_TABLE_ADDRESS_BITS) / ARENA_SIZE)
+#define ARENA_TABLE_L2_BITS 10
+#define ARENA_TABLE_L2_SIZE (1 << ARENA_TABLE_L2_BITS)
+#define ARENA_TABLE_L1_SIZE (ARENA_TABLE_ENTRIES / ARENA_TABLE_L2_SIZE + 1)
+
+static Arena **arena_table[ARENA_TABLE_L1_SIZE];
+
+static void
+arena_table_insert(Arena *arena)
+{
+    uintptr_t idx = (uintptr_t)arena / ARENA_SIZE;
+    Arena ***l2 = &arena_table[idx >> ARENA_TABLE_L2_BITS];
+    if (!*l2)
+        *l2 = (Arena**)calloc (ARENA_TABLE_L2_SIZE, sizeof(Arena*));
+    (*l2)[idx & (ARENA_TABLE_L2_SIZE - 1)] = arena;
+}
+
+static void
+arena_table_remove(Arena *arena)
+{
+    uintptr_t idx = (uintptr_t)arena / ARENA_SIZE;
+    arena_table[idx >> ARENA_TABLE_L2_BITS][idx & (ARENA_TABLE_L2_SIZE - 1)] = NULL;
+}
+
+static inline Arena*
+find_arena(GCObjectPtr ptr)
+{
+    uintptr_t idx = (uintptr_t)ptr / ARENA_SIZE;
+    if (EJS_UNLIKELY(idx >= ARENA_TABLE_ENTRIES))
+        return NULL; // the stack is full of things that aren't pointers
+    Arena **l2 = arena_table[idx >> ARENA_TABLE_L2_BITS];
+    return l2 ? l2[idx & (ARENA_TABLE_L2_SIZE - 1)] : NULL;
+}
+
 typedef char BitmapCell;
 
 #define CELL_COLOR_MASK       0x03
@@ -248,6 +540,8 @@ typedef char BitmapCell;
 #define CELL_WHITE_MASK_START 0x00
 #define CELL_BLACK_MASK_START 0x01
 #define CELL_FREE             0x04 // cell is in the free list for this page
+#define CELL_OLD              0x08 // cell has survived a collection
+#define CELL_REMEMBERED       0x10 // old cell is in the remembered set
 
 static unsigned int black_mask = CELL_BLACK_MASK_START;
 static unsigned int white_mask = CELL_WHITE_MASK_START;
@@ -291,17 +585,46 @@ static unsigned int white_mask = CELL_WHITE_MASK_START;
 #define IS_GRAY(cell) (((cell) & CELL_COLOR_MASK) == CELL_GRAY_MASK)
 #define IS_WHITE(cell) (((cell) & CELL_COLOR_MASK) == white_mask)
 #define IS_BLACK(cell) (((cell) & CELL_COLOR_MASK) == black_mask)
+#define IS_OLD(cell) (((cell) & CELL_OLD) == CELL_OLD)
+
+// a cell needs to be traced if it's white, unless we're in a minor collection and it's old
+#define IS_MARKABLE(cell) (IS_WHITE(cell) && !(minor_collection && IS_OLD(cell)))
+
+// atomically gray @cell if it's markable.  returns EJS_TRUE if we grayed it, in which case the caller
+// is responsible for pushing it on the work list.
+static inline EJSBool
+try_set_gray_cell (BitmapCell *cell)
+{
+    BitmapCell bc;
+    do {
+        bc = *cell;
+        if (!IS_MARKABLE(bc))
+            return EJS_FALSE;
+    } while (!__sync_bool_compare_and_swap (cell, bc, (bc & ~CELL_COLOR_MASK) | CELL_GRAY_MASK));
+    return EJS_TRUE;
+}
+
+#define SET_OLD(cell) EJS_MACRO_START                                   \
+    BitmapCell _bc;                                                     \
+    do {                                                                \
+        _bc = (cell);                                                   \
+    } while (!__sync_bool_compare_and_swap (&cell, _bc, (_bc & ~CELL_REMEMBERED) | CELL_OLD)); \
+    EJS_MACRO_END
 
 struct _PageInfo {
     EJS_LIST_HEADER(struct _PageInfo);
     void*       bump_ptr;
+    void*       free_list; // cells freed by the sweeper, linked through their first word
     void*       page_start;
     void*       page_end;
     BitmapCell* page_bitmap;
     LargeObjectInfo *los_info;
     int32_t     cell_size;
+    uint32_t    cell_magic;
     int16_t     num_cells;
     int16_t     num_free_cells;
+    EJSBool     has_young_cells; // the page is in young_pages
+    EJSBool     decommitted; // the page is on its arena's free list, and we've given its memory back to the OS
 };
 
 struct _LargeObjectInfo {
@@ -313,11 +636,143 @@ struct _LargeObjectInfo {
 #define OBJECT_SIZE_LOW_LIMIT_BITS 4   // smallest object we'll allocate (1<<4 = 16)
 #define OBJECT_SIZE_HIGH_LIMIT_BITS 11 // max object size for the non-LOS allocator = 2048
 
-#define HEAP_PAGELISTS_COUNT (OBJECT_SIZE_HIGH_LIMIT_BITS - OBJECT_SIZE_LOW_LIMIT_BITS) + 1 // +1 because we're inclusive on 11
+// the cell sizes we allocate from pages.  16 byte spacing up to 128, then four classes per doubling
+// up to 512.  above that the classes are picked to fit a whole number of cells in a 4k page.  every
+// class is a multiple of 16, so cells stay 16 byte aligned.
+static const int size_classes[] = {
+    16, 32, 48, 64, 80, 96, 112, 128,
+    160, 192, 224, 256,
+    320, 384, 448, 512,
+    576, 672, 816, 1024, 1360, 2048
+};
+
+#define HEAP_PAGELISTS_COUNT (sizeof(size_classes) / sizeof(size_classes[0]))
+
+// size -> index into size_classes, in 16 byte steps
+#define SIZE_CLASS_LOOKUP_COUNT (((1 << OBJECT_SIZE_HIGH_LIMIT_BITS) >> OBJECT_SIZE_LOW_LIMIT_BITS) + 1)
+static uint8_t size_class_lookup[SIZE_CLASS_LOOKUP_COUNT];
+#define SIZE_TO_BUCKET(size) (size_class_lookup[((size) + (1 << OBJECT_SIZE_LOW_LIMIT_BITS) - 1) >> OBJECT_SIZE_LOW_LIMIT_BITS])
+
+static void
+init_size_classes()
+{
+    int bucket = 0;
+    for (int i = 0; i < SIZE_CLASS_LOOKUP_COUNT; i ++) {
+        while (size_classes[bucket] < (i << OBJECT_SIZE_LOW_LIMIT_BITS))
+            bucket ++;
+        size_class_lookup[i] = bucket;
+    }
+}
 
 static EJSList heap_pages[HEAP_PAGELISTS_COUNT];
 static LargeObjectInfo *los_list;
 
+// large objects, hashed by their start address (the only address that can refer to them.)  open
+// addressing with linear probing, so removal shifts the following entries back rather than leaving
+// tombstones.
+static LargeObjectInfo **los_table;
+static size_t los_table_size; // always a power of 2
+static size_t los_table_count;
+
+#define LOS_TABLE_INITIAL_SIZE 256
+#define LOS_TABLE_HASH(ptr) ((((uintptr_t)(ptr) >> 4) * (uintptr_t)0x9E3779B97F4A7C15ULL) >> 16)
+
+static void los_table_insert(LargeObjectInfo *lobj);
+
+static void
+los_table_grow()
+{
+    LargeObjectInfo **old_table = los_table;
+    size_t old_size = los_table_size;
+
+    los_table_size = old_size ? old_size * 2 : LOS_TABLE_INITIAL_SIZE;
+    los_table = (LargeObjectInfo**)calloc (los_table_size, sizeof(LargeObjectInfo*));
+    los_table_count = 0;
+
+    for (size_t i = 0; i < old_size; i ++) {
+        if (old_table[i])
+            los_table_insert (old_table[i]);
+    }
+    free (old_table);
+}
+
+static void
+los_table_insert(LargeObjectInfo *lobj)
+{
+    if ((los_table_count + 1) * 2 > los_table_size)
+        los_table_grow();
+
+    size_t mask = los_table_size - 1;
+    size_t i = LOS_TABLE_HASH(lobj->page_info.page_start) & mask;
+    while (los_table[i])
+        i = (i + 1) & mask;
+    los_table[i] = lobj;
+    los_table_count ++;
+}
+
+static void
+los_table_remove(LargeObjectInfo *lobj)
+{
+    size_t mask = los_table_size - 1;
+    size_t i = LOS_TABLE_HASH(lobj->page_info.page_start) & mask;
+    while (los_table[i] != lobj) {
+        EJS_ASSERT(los_table[i]);
+        i = (i + 1) & mask;
+    }
+    los_table[i] = NULL;
+    los_table_count --;
+
+    // move back any entries in the same run that can now be found closer to their home slot
+    size_t j = i;
+    for (;;) {
+        j = (j + 1) & mask;
+        if (!los_table[j])
+            break;
+        size_t home = LOS_TABLE_HASH(los_table[j]->page_info.page_start) & mask;
+        // if home is cyclically in (i, j], the entry has to stay where it is
+        EJSBool stays = i <= j ? (i < home && home <= j) : (i < home || home <= j);
+        if (!stays) {
+            los_table[i] = los_table[j];
+            los_table[j] = NULL;
+            i = j;
+        }
+    }
+}
+
+static LargeObjectInfo*
+los_table_lookup(GCObjectPtr ptr)
+{
+    if (!los_table_count)
+        return NULL;
+    size_t mask = los_table_size - 1;
+    size_t i = LOS_TABLE_HASH(ptr) & mask;
+    LargeObjectInfo *lobj;
+    while ((lobj = los_table[i])) {
+        if (lobj->page_info.page_start == ptr)
+            return lobj;
+        i = (i + 1) & mask;
+    }
+    return NULL;
+}
+
+// pages waiting to be swept after a full collection, per size class.  sweep_garbage_mask is the
+// color that unmarked cells had when that collection finished marking.
+static EJSList sweep_pages[HEAP_PAGELISTS_COUNT];
+static int num_unswept_pages;
+static unsigned int sweep_garbage_mask;
+static EJSBool eager_sweep = EJS_FALSE;
+
+// pages that contain young cells.  a minor collection only sweeps these pages.  young large objects
+// are always at the head of los_list (we prepend new ones, and every collection promotes the survivors.)
+static PageInfo **young_pages;
+static int num_young_pages;
+static int young_pages_alloc;
+
+// old cells that might contain pointers to young cells.  they're traced during a minor collection.
+static GCObjectPtr *remembered_set;
+static int remembered_set_size;
+static int remembered_set_alloc;
+
 void* ptr_to_arena(void* ptr) { return PTR_TO_ARENA(ptr); }
 void* ptr_to_arena_page_base(void* ptr) { return PTR_TO_ARENA_PAGE_BASE(ptr); }
 uintptr_t ptr_to_arena_page_index(void* ptr) { return PTR_TO_ARENA_PAGE_INDEX(ptr); }
@@ -363,9 +818,10 @@ arena_new()
     }
     if (insert_point == -1) insert_point = num_arenas;
     if (num_arenas-insert_point > 0)
-        memmove (&heap_arenas[insert_point + 1], &heap_arenas[insert_point], (num_arenas-insert_point-1)*sizeof(Arena*));
+        memmove (&heap_arenas[insert_point + 1], &heap_arenas[insert_point], (num_arenas-insert_point)*sizeof(Arena*));
     heap_arenas[insert_point] = new_arena;
     num_arenas++;
+    arena_table_insert(new_arena);
     UNLOCK_ARENAS();
 
     return new_arena;
@@ -384,6 +840,7 @@ alloc_page_info_from_arena(Arena *arena, void *page_data, size_t cell_size)
     PageInfo* info = (PageInfo*)calloc(1, sizeof(PageInfo) + (sizeof(BitmapCell) * PAGE_SIZE / (1<<OBJECT_SIZE_LOW_LIMIT_BITS)));
     EJS_LIST_INIT(info);
     info->cell_size = cell_size;
+    info->cell_magic = CELL_MAGIC(cell_size);
     info->num_cells = CELLS_OF_SIZE(cell_size);
     info->num_free_cells = info->num_cells;
     EJS_ASSERT(info->num_cells > 0);
@@ -392,6 +849,7 @@ alloc_page_info_from_arena(Arena *arena, void *page_data, size_t cell_size)
     // allocate a bitmap large enough to store any sized object so we can reuse the bitmap
     info->page_bitmap = (BitmapCell*)(((char*)info) + sizeof(PageInfo));
     info->bump_ptr = info->page_start;
+    info->free_list = NULL;
     memset (info->page_bitmap, CELL_FREE, info->num_cells * sizeof(BitmapCell));
     return info;
 }
@@ -403,10 +861,16 @@ alloc_page_from_arena(Arena *arena, size_t cell_size)
     if (arena->free_pages) {
         PageInfo* info = arena->free_pages;
         EJS_LIST_DETACH(info, arena->free_pages);
+        if (info->decommitted)
+            info->decommitted = EJS_FALSE;
+        else
+            num_committed_free_pages --;
         info->cell_size = cell_size;
+        info->cell_magic = CELL_MAGIC(cell_size);
         info->num_cells = CELLS_OF_SIZE(cell_size);
         info->num_free_cells = info->num_cells;
         info->bump_ptr = info->page_start;
+        info->free_list = NULL;
         memset (info->page_bitmap, CELL_FREE, info->num_cells * sizeof(BitmapCell));
         SPEW(3, _ejs_log ("alloc_page_from_arena from free pages for cell size %zd = %p\n", info->cell_size, info));
         return info;
@@ -425,51 +889,6 @@ alloc_page_from_arena(Arena *arena, size_t cell_size)
     }
 }
 
-static int
-compare_ptrs(const void* v1, const void* v2)
-{
-    Arena **a1 = (Arena**)v1;
-    Arena **a2 = (Arena**)v2;
-    ptrdiff_t diff = (intptr_t)*a1 - (intptr_t)*a2;
-    if (diff < 0) return -1;
-    if (diff == 0) return 0;
-    return 1;
-}
-
-static Arena*
-find_arena(GCObjectPtr ptr)
-{
-    Arena* arena_ptr = PTR_TO_ARENA(ptr);
-
-    LOCK_ARENAS();
-    // inlined bsearch
-    void* rv = NULL;
-    Arena**base = heap_arenas;
-    for (int lim = num_arenas; lim != 0; lim >>= 1) {
-        Arena** p = base + (lim >> 1);
-        ptrdiff_t diff = (intptr_t)arena_ptr - (intptr_t)*p;
-        if (diff == 0) {
-            rv = *p;
-            break;
-        }
-        if (diff > 0) {  /* key > p: move right */
-            base = p + 1;
-            lim--;
-        }               /* else move left */
-    }
-    UNLOCK_ARENAS();
-    if (!rv) return NULL;
-    return *(Arena**)rv;
-}
-
-static Arena*
-find_arena_in_array(GCObjectPtr ptr, Arena** array, int length)
-{
-    void* arena_ptr = PTR_TO_ARENA(ptr);
-    Arena **bsearch_rv = (Arena**)bsearch (&arena_ptr, array, length, sizeof(Arena*), compare_ptrs);
-    return bsearch_rv ? *bsearch_rv : NULL;
-}
-
 static PageInfo*
 find_page_and_cell_from_arena(GCObjectPtr ptr, uint32_t *cell_idx, Arena *arena)
 {
@@ -478,76 +897,187 @@ find_page_and_cell_from_arena(GCObjectPtr ptr, uint32_t *cell_idx, Arena *arena)
 
         int page_index = PTR_TO_ARENA_PAGE_INDEX(ptr);
 
-        if (page_index < 0 || page_index > arena->num_pages) {
+        if (page_index < 0 || page_index >= arena->num_pages) {
             return NULL;
         }
 
         PageInfo *page = arena->page_infos[page_index];
 
-        if (!IS_ALIGNED_TO(ptr, page->cell_size)) {
+        uint32_t cell = PTR_TO_CELL(ptr, page);
+        if (page->page_start + cell * page->cell_size != ptr || cell >= page->num_cells) {
             return NULL; // can't possibly point to allocated cells.
         }
 
-        if (cell_idx) {
-            *cell_idx = PTR_TO_CELL(ptr, page);
-            EJS_ASSERT(*cell_idx >= 0 && *cell_idx < CELLS_IN_PAGE(page));
-        }
+        if (cell_idx)
+            *cell_idx = cell;
 
         return page;
     }
 
     // check if it's in the LOS
     LOCK_GC();
-    for (LargeObjectInfo *lobj = los_list; lobj; lobj = lobj->next) {
-        if (lobj->page_info.page_start == ptr) {
-            UNLOCK_GC();
-            if (cell_idx)
-                *cell_idx = 0;
-            return &lobj->page_info;
-        }
-    }
+    LargeObjectInfo *lobj = los_table_lookup(ptr);
     UNLOCK_GC();
-    return NULL;
+    if (!lobj)
+        return NULL;
+    if (cell_idx)
+        *cell_idx = 0;
+    return &lobj->page_info;
 }
 
 static PageInfo*
 find_page_and_cell(GCObjectPtr ptr, uint32_t *cell_idx)
 {
-    Arena* arena = find_arena_in_array(ptr, heap_arenas, num_arenas);
-    return find_page_and_cell_from_arena(ptr, cell_idx, arena);
+    return find_page_and_cell_from_arena(ptr, cell_idx, find_arena(ptr));
 }
 
-static void
-set_gray (GCObjectPtr ptr)
+
+// returns the size of the cell
+static size_t
+set_black (GCObjectPtr ptr)
 {
     uint32_t cell_idx;
     PageInfo *page = find_page_and_cell(ptr, &cell_idx);
     if (!page)
-        return;
+        return 0;
 
-    SET_GRAY(page->page_bitmap[cell_idx]);
+    SET_BLACK(page->page_bitmap[cell_idx]);
+    // everything that survives a full collection is promoted
+    if (!minor_collection)
+        SET_OLD(page->page_bitmap[cell_idx]);
+    return page->cell_size;
 }
 
-static void
-set_black (GCObjectPtr ptr)
+static EJSBool
+try_set_gray (GCObjectPtr ptr)
 {
     uint32_t cell_idx;
     PageInfo *page = find_page_and_cell(ptr, &cell_idx);
     if (!page)
-        return;
+        return EJS_FALSE;
 
-    SET_BLACK(page->page_bitmap[cell_idx]);
+    return try_set_gray_cell(&page->page_bitmap[cell_idx]);
 }
 
-static EJSBool
-is_white (GCObjectPtr ptr)
+EJSBool
+_ejs_gc_is_collectable (GCObjectPtr ptr)
 {
     uint32_t cell_idx;
     PageInfo *page = find_page_and_cell(ptr, &cell_idx);
-    if (!page)
-        return EJS_FALSE;
+    return page != NULL && IS_MARKABLE(page->page_bitmap[cell_idx]);
+}
+
+void
+_ejs_gc_shade (GCObjectPtr ptr)
+{
+    if (marking_in_progress && try_set_gray (ptr))
+        _ejs_gc_worklist_push (ptr);
+}
+
+static void
+add_young_page(PageInfo *info)
+{
+    if (num_young_pages == young_pages_alloc) {
+        young_pages_alloc = young_pages_alloc ? young_pages_alloc * 2 : 256;
+        young_pages = (PageInfo**)realloc (young_pages, young_pages_alloc * sizeof(PageInfo*));
+    }
+    young_pages[num_young_pages++] = info;
+    info->has_young_cells = EJS_TRUE;
+}
+
+static void
+clear_young_pages()
+{
+    for (int i = 0; i < num_young_pages; i ++)
+        young_pages[i]->has_young_cells = EJS_FALSE;
+    num_young_pages = 0;
+}
+
+static void
+remember_cell(GCObjectPtr ptr, PageInfo *page, uint32_t cell_idx)
+{
+    if (remembered_set_size == remembered_set_alloc) {
+        remembered_set_alloc = remembered_set_alloc ? remembered_set_alloc * 2 : 256;
+        remembered_set = (GCObjectPtr*)realloc (remembered_set, remembered_set_alloc * sizeof(GCObjectPtr));
+    }
+    remembered_set[remembered_set_size++] = ptr;
+    page->page_bitmap[cell_idx] |= CELL_REMEMBERED;
+}
+
+// empty the remembered set.  entries were traced (and so turned black) by the minor collection, so
+// we also reset them to white here.
+static void
+clear_remembered_set()
+{
+    for (int i = 0; i < remembered_set_size; i ++) {
+        uint32_t cell_idx;
+        PageInfo *page = find_page_and_cell(remembered_set[i], &cell_idx);
+        if (!page)
+            continue;
+        page->page_bitmap[cell_idx] &= ~CELL_REMEMBERED;
+        if (IS_OLD(page->page_bitmap[cell_idx]))
+            SET_WHITE(page->page_bitmap[cell_idx]);
+    }
+    remembered_set_size = 0;
+}
+
+void
+_ejs_gc_write_barrier_slow(GCObjectPtr owner, ejsval val)
+{
+    if (!EJSVAL_IS_TRACEABLE_IMPL(val))
+        return;
+
+    GCObjectPtr valptr = (GCObjectPtr)EJSVAL_TO_GCTHING_IMPL(val);
+    if (valptr == NULL)
+        return;
+
+    if (marking_in_progress) {
+        // the marker might have already scanned owner, so make sure val gets marked.  there's no
+        // need to remember owner, since the collection will promote everything that survives.
+        if (try_set_gray(valptr))
+            _ejs_gc_worklist_push(valptr);
+        return;
+    }
+
+    uint32_t owner_idx;
+    PageInfo *owner_page = find_page_and_cell(owner, &owner_idx);
+    if (!owner_page)
+        return;
+
+    // only old cells that aren't already remembered are interesting
+    if ((owner_page->page_bitmap[owner_idx] & (CELL_OLD | CELL_REMEMBERED)) != CELL_OLD)
+        return;
+
+    uint32_t val_idx;
+    PageInfo *val_page = find_page_and_cell(valptr, &val_idx);
+    if (!val_page || IS_OLD(val_page->page_bitmap[val_idx]))
+        return;
+
+    remember_cell(owner, owner_page, owner_idx);
+}
+
+void
+_ejs_gc_remember_slow(GCObjectPtr owner)
+{
+    uint32_t owner_idx;
+    PageInfo *owner_page = find_page_and_cell(owner, &owner_idx);
+    if (!owner_page)
+        return;
+
+    if (marking_in_progress) {
+        // we don't know what was stored, so if the marker has already scanned owner, it needs to
+        // be scanned again.
+        BitmapCell *cell = &owner_page->page_bitmap[owner_idx];
+        BitmapCell bc = *cell;
+        if (IS_BLACK(bc) && __sync_bool_compare_and_swap (cell, bc, (bc & ~CELL_COLOR_MASK) | CELL_GRAY_MASK))
+            _ejs_gc_worklist_push(owner);
+        return;
+    }
+
+    if ((owner_page->page_bitmap[owner_idx] & (CELL_OLD | CELL_REMEMBERED)) != CELL_OLD)
+        return;
 
-    return IS_WHITE(page->page_bitmap[cell_idx]);
+    remember_cell(owner, owner_page, owner_idx);
 }
 
 static PageInfo*
@@ -591,7 +1121,7 @@ finalize_object(GCObjectPtr p)
         EJSPrimString* primstr = (EJSPrimString*)p;
         if (EJS_PRIMSTR_GET_TYPE(primstr) == EJS_STRING_FLAT) {
             SPEW(2, {
-                    char* utf8 = ucs2_to_utf8(primstr->data.flat);
+                    char* utf8 = _ejs_string_to_utf8(primstr);
                     SPEW(2, _ejs_log ("finalizing flat primitive string %p(%s)\n", p, utf8));
                     free (utf8);
                 });
@@ -622,10 +1152,15 @@ _ejs_finalize_obj(GCObjectPtr ptr, Arena* arena, PageInfo* info, uint32_t cell_i
             info->cell_size);
 
     SET_FREE(info->page_bitmap[cell_idx]);
+    heap_bytes_in_use -= info->cell_size;
     SPEW(3, _ejs_log ("finalized object %p in page %p, num_free_cells == %zd\n", ptr, info, info->num_free_cells + 1));
     // if this page is empty, move it to this arena's free list
     LOCK_PAGE(info);
     info->num_free_cells ++;
+    if (!info->los_info) {
+        *(void**)ptr = info->free_list;
+        info->free_list = ptr;
+    }
     UNLOCK_PAGE(info);
 
     if (info->num_free_cells == info->num_cells) {
@@ -640,9 +1175,10 @@ _ejs_finalize_obj(GCObjectPtr ptr, Arena* arena, PageInfo* info, uint32_t cell_i
                 SPEW(2, _ejs_log ("page %p is empty, putting it on the free list\n", info));
                 LOCK_PAGE(info);
                 // the page is empty, add it to the arena's free page list.
-                int bucket = ffs(info->cell_size) - OBJECT_SIZE_LOW_LIMIT_BITS;
+                int bucket = SIZE_TO_BUCKET(info->cell_size);
                 _ejs_list_detach_node (&heap_pages[bucket], (EJSListNode*)info);
                 EJS_LIST_PREPEND (info, arena->free_pages);
+                num_committed_free_pages ++;
                 UNLOCK_PAGE(info);
             }
         }
@@ -657,6 +1193,47 @@ _ejs_gc_init()
     char* n_allocs = getenv("EJS_GC_EVERY_N_ALLOC");
     if (n_allocs)
         collect_every_alloc = atoi(n_allocs);
+    char* gen = getenv("EJS_GC_GENERATIONAL");
+    if (gen)
+        generational = _ejs_gc_barrier_enabled = atoi(gen) != 0;
+    char* retain_pages = getenv("EJS_GC_RETAIN_FREE_PAGES");
+    if (retain_pages)
+        retained_free_pages = MAX(0, atoi(retain_pages));
+    char* retain_arenas = getenv("EJS_GC_RETAIN_ARENAS");
+    if (retain_arenas)
+        retained_arenas = MAX(0, atoi(retain_arenas));
+    char* growth_factor = getenv("EJS_GC_HEAP_GROWTH_FACTOR");
+    if (growth_factor && atof(growth_factor) > 1)
+        heap_growth_factor = atof(growth_factor);
+    char* min_growth = getenv("EJS_GC_MIN_HEAP_GROWTH");
+    if (min_growth && atol(min_growth) > 0)
+        min_heap_growth = atol(min_growth);
+    char* max_growth = getenv("EJS_GC_MAX_HEAP_GROWTH");
+    if (max_growth && atol(max_growth) > 0)
+        max_heap_growth = atol(max_growth);
+    max_heap_growth = MAX(min_heap_growth, max_heap_growth);
+    next_gc_allocation = min_heap_growth;
+    char* incremental = getenv("EJS_GC_INCREMENTAL");
+    if (incremental)
+        incremental_marking = atoi(incremental) != 0;
+    eager_sweep = getenv("EJS_GC_EAGER_SWEEP") != NULL;
+    char* nursery = getenv("EJS_GC_NURSERY_SIZE");
+    if (nursery && atoi(nursery) > 0)
+        nursery_size = atoi(nursery);
+    char* events = getenv("EJS_GC_EVENT_FD");
+    if (events)
+        event_fd = atoi(events);
+    gc_start_usec = gc_now_usec();
+    char* sample_interval = getenv("EJS_GC_ALLOC_SAMPLE_INTERVAL");
+    if (sample_interval && atol(sample_interval) > 0)
+        _ejs_gc_set_allocation_sampling(atol(sample_interval));
+#if parallel_marking
+    char* mark_threads = getenv("EJS_GC_MARK_THREADS");
+    if (mark_threads)
+        num_mark_threads = MAX(1, MIN(MAX_MARK_THREADS, atoi(mark_threads)));
+#endif
+
+    init_size_classes();
 
     // allocate an initial arenas
     for (int i = 0; i < 10; i ++)
@@ -727,6 +1304,9 @@ _scan_from_ejsclosureenv(EJSClosureEnv *env)
 
 static GCObjectPtr *stack_bottom;
 
+// the heap references found on the stack (and in registers) by the current collection
+static int num_stack_roots = 0;
+
 void
 _ejs_gc_mark_thread_stack_bottom(GCObjectPtr* btm)
 {
@@ -737,11 +1317,11 @@ static void
 mark_pointers_in_range(GCObjectPtr* low, GCObjectPtr* high)
 {
     GCObjectPtr* p;
-    for (p = low; p < high-1; p++) {
+    for (p = low; p < high; p++) {
         GCObjectPtr gcptr;
 
-#if OSX
-        // really a 64 bit check here, since for 64 bit systems, ejsvals can be stuck in registers, so we need to check if it's a valid
+#if EJS_BITS_PER_WORD == 64
+        // for 64 bit systems, ejsvals can be stuck in registers, so we need to check if it's a valid
         // ejsval gcthing as well.
         ejsval ep = *(ejsval*)p;
         if (EJSVAL_IS_GCTHING_IMPL(ep))
@@ -759,8 +1339,9 @@ mark_pointers_in_range(GCObjectPtr* low, GCObjectPtr* high)
 
         // XXX more checks before we start treating the pointer like a GCObjectPtr?
         BitmapCell cell = page->page_bitmap[cell_idx];
-        if (IS_FREE(cell))   continue; // skip free cells
-        if (!IS_WHITE(cell)) continue; // skip pointers to gray/black cells
+        if (IS_FREE(cell))      continue; // skip free cells
+        num_stack_roots++;
+        if (!IS_MARKABLE(cell)) continue; // skip pointers to gray/black (or old, in a minor gc) cells
 
         WORKLIST_PUSH_AND_GRAY_CELL(gcptr, page->page_bitmap[cell_idx]);
     }
@@ -775,7 +1356,7 @@ mark_ejsvals_in_range(void* low, void* high)
         p++;
     }
 #endif
-    for (; p < high - sizeof(ejsval); p += sizeof(ejsval)) {
+    for (; p + sizeof(ejsval) <= high; p += sizeof(ejsval)) {
         ejsval candidate_val = *((ejsval*)p);
         if (EJSVAL_IS_GCTHING_IMPL(candidate_val)) {
             GCObjectPtr gcptr = (GCObjectPtr)EJSVAL_TO_GCTHING_IMPL(candidate_val);
@@ -788,7 +1369,8 @@ mark_ejsvals_in_range(void* low, void* high)
                 // XXX more checks before we start treating the pointer like a GCObjectPtr?
                 BitmapCell cell = page->page_bitmap[cell_idx];
                 if (IS_FREE(cell)) continue; // skip free cells
-                if (!IS_WHITE(cell)) continue; // skip pointers to gray/black cells
+                num_stack_roots++;
+                if (!IS_MARKABLE(cell)) continue; // skip pointers to gray/black (or old, in a minor gc) cells
 
                 if (EJSVAL_IS_STRING(candidate_val)) {
                     SPEW(4, _ejs_log ("found ptr to %p(PrimString) on stack\n", EJSVAL_TO_STRING(candidate_val)));
@@ -811,98 +1393,318 @@ static int total_objs = 0;
 static int num_object_allocs = 0;
 static int num_closureenv_allocs = 0;
 static int num_primstr_allocs = 0;
+static int num_store_allocs = 0;
 
 
-static void
-sweep_heap()
+static EJSBool
+arena_is_empty(Arena *arena)
 {
-    int pages_visited = 0;
-    int pages_skipped = 0;
-
-    // sweep the entire heap, freeing white nodes
-    for (int a = 0, e = num_arenas; a < e; a ++) {
-        Arena* arena = heap_arenas[a];
-
-        for (int p = 0, pe = arena->num_pages; p < pe; p++) {
-            PageInfo *info = arena->page_infos[p];
+    int num_free_pages = 0;
+    for (PageInfo *info = arena->free_pages; info; info = info->next) {
+        if (info->has_young_cells)
+            return EJS_FALSE; // still in young_pages
+        num_free_pages ++;
+    }
+    return num_free_pages == arena->num_pages;
+}
 
-            if (info->num_free_cells == info->num_cells) {
-                pages_skipped++;
-            }
-            else {
-                pages_visited ++;
+static void
+arena_release(int arena_idx)
+{
+    Arena *arena = heap_arenas[arena_idx];
 
-                for (int c = 0, ce = info->num_cells; c < ce; c ++) {
-                    BitmapCell cell = info->page_bitmap[c];
+    SPEW(1, _ejs_log ("releasing empty arena %p\n", arena));
 
-                    if (IS_FREE(cell))
-                        continue;
+    PageInfo *info = arena->free_pages;
+    while (info) {
+        PageInfo *next = info->next;
+        if (!info->decommitted)
+            num_committed_free_pages --;
+        free (info);
+        info = next;
+    }
 
-                    total_objs++;
+    LOCK_ARENAS();
+    memmove (&heap_arenas[arena_idx], &heap_arenas[arena_idx + 1], (num_arenas - arena_idx - 1) * sizeof(Arena*));
+    num_arenas --;
+    arena_table_remove (arena);
+    UNLOCK_ARENAS();
 
-                    if (IS_WHITE(cell)) {
-                        white_objs++;
+    release_to_os (arena, ARENA_SIZE);
+}
 
-                        GCObjectPtr gcobj = (GCObjectPtr)(info->page_start + c * info->cell_size);
-                        _ejs_finalize_obj(gcobj, arena, info, c);
-                    }
-                }
-            }
+// called once sweeping is done.  give the memory for empty pages back to the OS, and unmap empty
+// arenas, keeping what the retention policy asks for.
+static void
+release_free_memory()
+{
+    for (int i = 0; i < num_arenas && num_committed_free_pages > retained_free_pages; i ++) {
+        for (PageInfo *info = heap_arenas[i]->free_pages; info && num_committed_free_pages > retained_free_pages; info = info->next) {
+            if (info->decommitted)
+                continue;
+            madvise (info->page_start, PAGE_SIZE, DECOMMIT_ADVICE);
+            info->decommitted = EJS_TRUE;
+            num_committed_free_pages --;
         }
     }
-    
-    // sweep the large object store
-    SPEW(2, _ejs_log ("sweeping los: "));
-    LargeObjectInfo *lobj = los_list;
-    while (lobj) {
-        large_objs ++;
-        PageInfo *info = &lobj->page_info;
-        BitmapCell cell = info->page_bitmap[0];
-        LargeObjectInfo *next = lobj->next;
-        if (IS_WHITE(cell)) {
-            //            SPEW(2, { _ejs_log ("l"); fflush(stderr); });
-            white_objs++;
 
-            EJS_LIST_DETACH(lobj, los_list);
-            _ejs_finalize_obj(info->page_start, NULL, info, 0);
-        }
-        else {
-            //            SPEW(2, { _ejs_log ("L"); fflush(stderr); });
-        }
-        lobj = next;
+    for (int i = num_arenas - 1; i >= 0 && num_arenas > retained_arenas; i --) {
+        if (arena_is_empty (heap_arenas[i]))
+            arena_release (i);
     }
-    SPEW(2, { _ejs_log ("\n"); });
 }
 
+// sweep a page that was queued by sweep_heap, freeing the cells that the last full collection
+// didn't mark.  the page is moved back onto its heap_pages list first, as _ejs_finalize_obj moves
+// it from there to the arena's free list if it ends up empty.
 static void
-mark_from_roots()
+sweep_page(PageInfo *info, int bucket)
 {
-    SPEW (2, _ejs_log ("marking from roots"));
+    Arena *arena = PTR_TO_ARENA(info->page_start);
 
-    // mark from our registered roots
-    for (RootSetEntry *entry = root_set; entry; entry = entry->next) {
-        num_roots++;
-        if (entry->root) {
-            ejsval rootval = *entry->root;
-            if (!EJSVAL_IS_GCTHING_IMPL(rootval))
-                continue;
-            GCObjectPtr root_ptr = (GCObjectPtr)EJSVAL_TO_GCTHING_IMPL(rootval);
-            if (root_ptr == NULL)
-                continue;
-            uint32_t cell_idx;
-            PageInfo* page = find_page_and_cell(root_ptr, &cell_idx);
-            if (!page)
+    _ejs_list_detach_node (&sweep_pages[bucket], (EJSListNode*)info);
+    _ejs_list_prepend_node (&heap_pages[bucket], (EJSListNode*)info);
+    num_unswept_pages --;
+
+    for (int c = 0, ce = info->num_cells; c < ce; c ++) {
+        BitmapCell cell = info->page_bitmap[c];
+
+        if (IS_FREE(cell))
+            continue;
+
+        if ((cell & CELL_COLOR_MASK) == sweep_garbage_mask) {
+            white_objs++;
+            GCObjectPtr gcobj = (GCObjectPtr)(info->page_start + c * info->cell_size);
+            _ejs_finalize_obj(gcobj, arena, info, c);
+        }
+    }
+}
+
+// sweep pages from @bucket's queue until we find one with a free cell, and return it (it'll be at
+// the head of heap_pages[bucket].)  returns NULL if the queue runs out, or if a page was entirely
+// garbage, in which case it is on its arena's free list and alloc_new_page will pick it up.
+static PageInfo*
+sweep_for_free_cell(int bucket)
+{
+    PageInfo *info = (PageInfo*)sweep_pages[bucket].head;
+    if (!info)
+        return NULL;
+
+    for (; info; info = (PageInfo*)sweep_pages[bucket].head) {
+        sweep_page (info, bucket);
+        if (info->num_free_cells == info->num_cells) {
+            info = NULL;
+            break;
+        }
+        if (info->num_free_cells > 0)
+            break;
+        // the page is still full.  move it to the end of the list so it's out of the allocator's way
+        _ejs_list_pop_head (&heap_pages[bucket]);
+        _ejs_list_append_node (&heap_pages[bucket], (EJSListNode*)info);
+    }
+
+    // the allocator finishes the sweep as often as _ejs_gc_sweep_some does, and after that the idle
+    // hook has nothing left to do, so if we swept the last page release memory here too (after
+    // we're done with the page, since its arena could be one that goes.)
+    if (num_unswept_pages == 0)
+        release_free_memory();
+    return info;
+}
+
+EJSBool
+_ejs_gc_sweep_some(int max_pages)
+{
+    if (num_unswept_pages == 0)
+        return EJS_FALSE;
+
+    for (int bucket = 0; bucket < HEAP_PAGELISTS_COUNT && max_pages > 0; bucket ++) {
+        PageInfo *info;
+        while (max_pages > 0 && (info = (PageInfo*)sweep_pages[bucket].head)) {
+            sweep_page (info, bucket);
+            max_pages --;
+        }
+    }
+
+    if (num_unswept_pages > 0)
+        return EJS_TRUE;
+
+    release_free_memory();
+    return EJS_FALSE;
+}
+
+static void
+finish_sweeping()
+{
+    if (num_unswept_pages > 0)
+        _ejs_gc_sweep_some (num_unswept_pages);
+}
+
+// all of the heap's pages are queued up here for sweep_page, and swept either on demand by
+// _ejs_gc_alloc (or _ejs_gc_sweep_some), or at the start of the next collection.  we don't sweep the
+// large object store lazily, since there's no per-page work to spread out there.
+static void
+sweep_heap(EJSBool shutting_down)
+{
+    EJS_ASSERT(num_unswept_pages == 0);
+
+    sweep_garbage_mask = white_mask;
+
+    for (int hp = 0; hp < HEAP_PAGELISTS_COUNT; hp++) {
+        num_unswept_pages += _ejs_list_length (&heap_pages[hp]);
+        sweep_pages[hp] = heap_pages[hp];
+        heap_pages[hp].head = heap_pages[hp].tail = NULL;
+    }
+
+    // sweep the large object store
+    SPEW(2, _ejs_log ("sweeping los: "));
+    LargeObjectInfo *lobj = los_list;
+    while (lobj) {
+        large_objs ++;
+        PageInfo *info = &lobj->page_info;
+        BitmapCell cell = info->page_bitmap[0];
+        LargeObjectInfo *next = lobj->next;
+        if (IS_WHITE(cell)) {
+            //            SPEW(2, { _ejs_log ("l"); fflush(stderr); });
+            white_objs++;
+
+            EJS_LIST_DETACH(lobj, los_list);
+            _ejs_finalize_obj(info->page_start, NULL, info, 0);
+        }
+        else {
+            //            SPEW(2, { _ejs_log ("L"); fflush(stderr); });
+        }
+        lobj = next;
+    }
+    SPEW(2, { _ejs_log ("\n"); });
+
+    // the marker promoted everything that survived, so there are no young cells left
+    clear_young_pages();
+    remembered_set_size = 0;
+    promoted_since_full_gc = 0;
+
+    if (shutting_down || eager_sweep)
+        finish_sweeping();
+}
+
+// sweep the young cells in the heap, freeing the white ones and promoting the rest.  old cells were
+// left white by the marker, so promoted cells are reset to white here as well.
+static void
+sweep_young()
+{
+    for (int p = 0; p < num_young_pages; p ++) {
+        PageInfo *info = young_pages[p];
+        Arena *arena = PTR_TO_ARENA(info->page_start);
+
+        for (int c = 0, ce = info->num_cells; c < ce; c ++) {
+            BitmapCell cell = info->page_bitmap[c];
+
+            if (IS_FREE(cell) || IS_OLD(cell))
                 continue;
 
-            BitmapCell cell = page->page_bitmap[cell_idx];
-            if (IS_FREE(cell))   continue; // skip free cells
-            if (!IS_WHITE(cell)) continue; // skip pointers to gray/black cells
-            WORKLIST_PUSH_AND_GRAY_CELL(root_ptr, page->page_bitmap[cell_idx]);
+            total_objs++;
+
+            if (IS_WHITE(cell)) {
+                white_objs++;
+
+                GCObjectPtr gcobj = (GCObjectPtr)(info->page_start + c * info->cell_size);
+                _ejs_finalize_obj(gcobj, arena, info, c);
+            }
+            else {
+                SET_OLD(info->page_bitmap[c]);
+                SET_WHITE(info->page_bitmap[c]);
+                promoted_since_full_gc += info->cell_size;
+            }
+        }
+    }
+    clear_young_pages();
+
+    // young large objects are at the head of los_list
+    LargeObjectInfo *lobj = los_list;
+    while (lobj && !IS_OLD(lobj->page_info.page_bitmap[0])) {
+        large_objs ++;
+        PageInfo *info = &lobj->page_info;
+        LargeObjectInfo *next = lobj->next;
+        if (IS_WHITE(info->page_bitmap[0])) {
+            white_objs++;
+
+            EJS_LIST_DETACH(lobj, los_list);
+            _ejs_finalize_obj(info->page_start, NULL, info, 0);
+        }
+        else {
+            SET_OLD(info->page_bitmap[0]);
+            SET_WHITE(info->page_bitmap[0]);
+            promoted_since_full_gc += lobj->alloc_size;
         }
+        lobj = next;
+    }
+
+    release_free_memory();
+}
+
+static void
+mark_root_value(ejsval rootval)
+{
+    if (!EJSVAL_IS_GCTHING_IMPL(rootval))
+        return;
+    GCObjectPtr root_ptr = (GCObjectPtr)EJSVAL_TO_GCTHING_IMPL(rootval);
+    if (root_ptr == NULL)
+        return;
+    uint32_t cell_idx;
+    PageInfo* page = find_page_and_cell(root_ptr, &cell_idx);
+    if (!page)
+        return;
+
+    BitmapCell cell = page->page_bitmap[cell_idx];
+    if (IS_FREE(cell))      return; // skip free cells
+    if (!IS_MARKABLE(cell)) return; // skip pointers to gray/black (or old, in a minor gc) cells
+    WORKLIST_PUSH_AND_GRAY_CELL(root_ptr, page->page_bitmap[cell_idx]);
+}
+
+static void
+mark_from_roots()
+{
+    SPEW (2, _ejs_log ("marking from roots"));
+
+    // mark from our registered roots
+    for (RootSetEntry *entry = root_set; entry; entry = entry->next) {
+        num_roots++;
+        if (entry->root)
+            mark_root_value(*entry->root);
     }
     SPEW (2, _ejs_log ("done marking from roots"));
 }
 
+static void
+mark_from_shadow_stack()
+{
+    SPEW (2, _ejs_log ("marking from shadow stack"));
+
+    for (EJSShadowFrame *frame = shadow_stack; frame; frame = frame->prev) {
+        num_stack_roots += frame->num_roots;
+        for (int i = 0; i < frame->num_roots; i ++)
+            mark_root_value(*frame->roots[i]);
+    }
+}
+
+static void
+mark_from_remembered_set()
+{
+    SPEW(2, _ejs_log ("marking from remembered set"));
+
+    for (int i = 0; i < remembered_set_size; i ++) {
+        GCObjectPtr ptr = remembered_set[i];
+        uint32_t cell_idx;
+        PageInfo* page = find_page_and_cell(ptr, &cell_idx);
+        if (!page)
+            continue;
+        if (IS_GRAY(page->page_bitmap[cell_idx]))
+            continue;
+        // remembered cells are old, so push them regardless of their color
+        _ejs_gc_worklist_push(ptr);
+        SET_GRAY(page->page_bitmap[cell_idx]);
+    }
+}
+
 static void
 mark_from_modules()
 {
@@ -912,83 +1714,357 @@ mark_from_modules()
         _scan_from_ejsobject((EJSObject*)_ejs_modules[i]);
 }
 
+// the registers are stored to an array rather than to one local apiece, since the compiler is free
+// to lay locals out in any order (and at -O2 does, leaving a range between two of them empty).
 #if TARGET_CPU_ARM
 #define MARK_REGISTERS EJS_MACRO_START \
-    GCObjectPtr __r0, __r1, __r2, __r3, __r4, __r5, __r6, __r7, __r8, __r9, __r10, __r11, __r12; \
+    GCObjectPtr __regs[13]; \
     __asm ("str r0, %0; str r1, %1; str r2, %2; str r3, %3; str r4, %4; str r5, %5; str r6, %6;" \
            "str r7, %7; str r8, %8; str r9, %9; str r10, %10; str r11, %11; str r12, %12;" \
-          : "=m"(__r0), "=m"(__r1), "=m"(__r2), "=m"(__r3), "=m"(__r4),  \
-            "=m"(__r5), "=m"(__r6), "=m"(__r7), "=m"(__r8),  "=m"(__r9), \
-            "=m"(__r10), "=m"(__r11), "=m"(__r12));                      \
+          : "=m"(__regs[0]), "=m"(__regs[1]), "=m"(__regs[2]), "=m"(__regs[3]), "=m"(__regs[4]),  \
+            "=m"(__regs[5]), "=m"(__regs[6]), "=m"(__regs[7]), "=m"(__regs[8]),  "=m"(__regs[9]), \
+            "=m"(__regs[10]), "=m"(__regs[11]), "=m"(__regs[12]));             \
                                                                          \
-    mark_pointers_in_range(&__r12, &__r0);                               \
+    mark_pointers_in_range(__regs, __regs + 13);                         \
     EJS_MACRO_END
 #elif TARGET_CPU_AMD64
 #define MARK_REGISTERS EJS_MACRO_START \
-    GCObjectPtr __rax, __rbx, __rcx, __rdx, __rsi, __rdi, __rbp, __rsp, __r8, __r9, __r10, __r11, __r12, __r13, __r14, __r15; \
+    GCObjectPtr __regs[16]; \
     __asm ("movq %%rax, %0; movq %%rbx, %1; movq %%rcx, %2; movq %%rdx, %3; movq %%rsi, %4;" \
            "movq %%rdi, %5; movq %%rbp, %6; movq %%rsp, %7; movq %%r8, %8;  movq %%r9, %9;" \
            "movq %%r10, %10; movq %%r11, %11; movq %%r12, %12; movq %%r13, %13; movq %%r14, %14; movq %%r15, %15;" \
-          : "=m"(__rax), "=m"(__rbx), "=m"(__rcx), "=m"(__rdx), "=m"(__rsi), \
-            "=m"(__rdi), "=m"(__rbp), "=m"(__rsp), "=m"(__r8),  "=m"(__r9), \
-            "=m"(__r10), "=m"(__r11), "=m"(__r12), "=m"(__r13), "=m"(__r14), "=m"(__r15)); \
+          : "=m"(__regs[0]), "=m"(__regs[1]), "=m"(__regs[2]), "=m"(__regs[3]), "=m"(__regs[4]), \
+            "=m"(__regs[5]), "=m"(__regs[6]), "=m"(__regs[7]), "=m"(__regs[8]),  "=m"(__regs[9]), \
+            "=m"(__regs[10]), "=m"(__regs[11]), "=m"(__regs[12]), "=m"(__regs[13]), "=m"(__regs[14]), "=m"(__regs[15])); \
                                                                         \
-    mark_pointers_in_range(&__r15, &__rax);                             \
+    mark_pointers_in_range(__regs, __regs + 16);                        \
     EJS_MACRO_END
-#elif TARGET_CPU_X86
-#define MARK_REGISTERS // just keep the build limping along
 #else
-#error "put code here to mark registers"
+// setjmp spills the callee-saved registers (the only ones that can hold a live caller's
+// pointers at this point) into the jmp_buf, so scan that instead of hand-writing asm.
+#define MARK_REGISTERS EJS_MACRO_START \
+    jmp_buf __regs;                                                     \
+    setjmp(__regs);                                                     \
+    mark_pointers_in_range((GCObjectPtr*)&__regs, (GCObjectPtr*)(&__regs + 1)); \
+    EJS_MACRO_END
+#endif
+
+// the bytes just below a compiled function's frame address where its prologue saves the
+// callee-saved registers it uses.  they hold its caller's values, so they're scanned along with the
+// C frames even though the rest of the compiled frame isn't.
+#if TARGET_CPU_AMD64
+#define CALLEE_SAVED_AREA_SIZE (5 * 8)           // rbx, r12-r15
+#elif TARGET_CPU_X86
+#define CALLEE_SAVED_AREA_SIZE (3 * 4)           // ebx, esi, edi
+#elif TARGET_CPU_ARM
+#define CALLEE_SAVED_AREA_SIZE (6 * 4 + 8 * 8)   // r4-r6, r8, r10, r11, d8-d15
+#elif TARGET_CPU_ARM64
+#define CALLEE_SAVED_AREA_SIZE (10 * 8 + 8 * 8)  // x19-x28, d8-d15
 #endif
 
 static void
 mark_thread_stack()
 {
+    mark_from_shadow_stack();
+
     MARK_REGISTERS;
 
     GCObjectPtr stack_top = NULL;
+    void* low = ((void*)&stack_top) + sizeof(GCObjectPtr);
+
+#ifdef CALLEE_SAVED_AREA_SIZE
+    // everything a compiled frame keeps alive is in its shadow roots, so only the C frames between
+    // them are scanned conservatively.  frames are linked innermost (lowest) first.
+    for (EJSShadowFrame *frame = shadow_stack; frame; frame = frame->prev) {
+        void* frame_high = frame->frame_address - CALLEE_SAVED_AREA_SIZE;
+        if (frame->frame_address == NULL || frame->stack_low < low || frame_high <= frame->stack_low)
+            continue; // not a frame we can find the bounds of, leave it to the scan
+        mark_ejsvals_in_range(low, frame->stack_low);
+        low = frame_high;
+    }
+#endif
 
-    mark_ejsvals_in_range(((void*)&stack_top) + sizeof(GCObjectPtr), stack_bottom);
+    mark_ejsvals_in_range(low, stack_bottom);
 }
 
-static void
-process_worklist()
+// returns the number of bytes marked
+static size_t
+mark_object(GCObjectPtr p)
+{
+    size_t size = set_black (p);
+    GCObjectHeader* headerp = (GCObjectHeader*)p;
+    if ((*headerp & EJS_SCAN_TYPE_OBJECT) != 0)
+        _scan_from_ejsobject((EJSObject*)p);
+    else if ((*headerp & EJS_SCAN_TYPE_PRIMSTR) != 0)
+        _scan_from_ejsprimstr((EJSPrimString*)p);
+    else if ((*headerp & EJS_SCAN_TYPE_CLOSUREENV) != 0)
+        _scan_from_ejsclosureenv((EJSClosureEnv*)p);
+    size += marked_store_bytes;
+    marked_store_bytes = 0;
+    return size;
+}
+
+#if parallel_marking
+static size_t calc_heap_size();
+
+static GCObjectPtr
+mark_steal (int self)
+{
+    for (int i = 1; i < num_mark_threads; i ++) {
+        MarkDeque *victim = &mark_deques[(self + i) % num_mark_threads];
+        GCObjectPtr p;
+        while ((p = mark_deque_steal (victim)) == MARK_DEQUE_ABORT)
+            ;
+        if (p)
+            return p;
+    }
+    return MARK_DEQUE_EMPTY;
+}
+
+static EJSBool
+mark_work_available ()
+{
+    for (int i = 0; i < num_mark_threads; i ++)
+        if (!mark_deque_is_empty (&mark_deques[i]))
+            return EJS_TRUE;
+    return EJS_FALSE;
+}
+
+static void*
+mark_worker (void *data)
+{
+    int self = (int)(intptr_t)data;
+    current_mark_deque = &mark_deques[self];
+    size_t bytes = 0;
+
+    for (;;) {
+        GCObjectPtr p;
+        while ((p = mark_deque_take (current_mark_deque)) || (p = mark_steal (self)))
+            bytes += mark_object (p);
+
+        // we're out of work.  marking is done once every thread agrees there's nothing left to steal.
+        __atomic_sub_fetch (&num_active_markers, 1, __ATOMIC_SEQ_CST);
+        for (;;) {
+            if (__atomic_load_n (&num_active_markers, __ATOMIC_SEQ_CST) == 0) {
+                current_mark_deque = NULL;
+                __atomic_add_fetch (&marked_bytes, bytes, __ATOMIC_SEQ_CST);
+                return NULL;
+            }
+            if (mark_work_available()) {
+                __atomic_add_fetch (&num_active_markers, 1, __ATOMIC_SEQ_CST);
+                break;
+            }
+            sched_yield();
+        }
+    }
+}
+
+static EJSBool
+process_worklist_parallel()
 {
+    if (num_mark_threads < 2 || calc_heap_size() < PARALLEL_MARK_MIN_HEAP_SIZE)
+        return EJS_FALSE;
+
+    // deal the roots out to the per-thread deques
+    for (int i = 0; i < num_mark_threads; i ++)
+        mark_deque_init (&mark_deques[i]);
+
     GCObjectPtr p;
+    int n = 0;
     while ((p = _ejs_gc_worklist_pop())) {
-        set_black (p);
-        GCObjectHeader* headerp = (GCObjectHeader*)p;
-        if ((*headerp & EJS_SCAN_TYPE_OBJECT) != 0)
-            _scan_from_ejsobject((EJSObject*)p);
-        else if ((*headerp & EJS_SCAN_TYPE_PRIMSTR) != 0)
-            _scan_from_ejsprimstr((EJSPrimString*)p);
-        else if ((*headerp & EJS_SCAN_TYPE_CLOSUREENV) != 0)
-            _scan_from_ejsclosureenv((EJSClosureEnv*)p);
+        current_mark_deque = &mark_deques[n];
+        mark_deque_push (current_mark_deque, p);
+        n = (n + 1) % num_mark_threads;
+    }
+    current_mark_deque = NULL;
+
+    num_active_markers = num_mark_threads;
+
+    pthread_t threads[MAX_MARK_THREADS];
+    EJSBool started[MAX_MARK_THREADS];
+    for (int i = 1; i < num_mark_threads; i ++) {
+        started[i] = pthread_create (&threads[i], NULL, mark_worker, (void*)(intptr_t)i) == 0;
+        // the other threads will steal this one's work
+        if (!started[i])
+            __atomic_sub_fetch (&num_active_markers, 1, __ATOMIC_SEQ_CST);
+    }
+
+    mark_worker ((void*)(intptr_t)0);
+
+    for (int i = 1; i < num_mark_threads; i ++) {
+        if (started[i])
+            pthread_join (threads[i], NULL);
+    }
+
+    for (int i = 0; i < num_mark_threads; i ++) {
+        EJS_ASSERT(mark_deque_is_empty (&mark_deques[i]));
+        mark_deque_free_retired (&mark_deques[i]);
     }
 
+    return EJS_TRUE;
+}
+#endif
+
+static void
+process_worklist()
+{
+#if parallel_marking
+    if (process_worklist_parallel())
+        return;
+#endif
+
+    GCObjectPtr p;
+    while ((p = _ejs_gc_worklist_pop()))
+        marked_bytes += mark_object (p);
+
     EJS_ASSERT(work_list.list == NULL);
 }
 
+static void
+update_gc_trigger()
+{
+    double growth = marked_bytes * (heap_growth_factor - 1);
+    next_gc_allocation = MIN(max_heap_growth, MAX(min_heap_growth, (size_t)growth));
+    SPEW(1, _ejs_log ("%zd bytes live, next collection after %zd bytes\n", marked_bytes, next_gc_allocation));
+}
+
+// gc telemetry.  every pause is counted and timed into pause_histogram, and collections also leave
+// a record of what they did in last_collection.  GC.stats() reports all of it, and each pause is
+// written as a line of json to event_fd if that's been set (with EJS_GC_EVENT_FD or
+// GC.configure({ eventFd }).)  sweeping the pages a collection leaves behind happens lazily,
+// outside of any pause, so a full collection's heapAfter is what it found live.
+typedef enum {
+    GC_PAUSE_FULL,
+    GC_PAUSE_MINOR,
+    GC_PAUSE_MARK_STEP,
+    GC_PAUSE_KIND_COUNT
+} GCPauseKind;
+
+static const char* pause_kind_names[GC_PAUSE_KIND_COUNT] = { "full", "minor", "markStep" };
+
+typedef struct {
+    GCPauseKind kind;
+    uint64_t start_usec;
+    uint64_t mark_usec;
+    uint64_t sweep_usec;
+    uint64_t pause_usec;
+    size_t heap_before;
+    size_t heap_after;
+    int roots;
+    int stack_roots;
+} GCPause;
+
+// upper bounds (in microseconds) of the histogram's buckets.  the last bucket has no upper bound.
+static const uint64_t pause_histogram_bounds[] = {
+    50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000
+};
+#define PAUSE_HISTOGRAM_BUCKETS (sizeof(pause_histogram_bounds) / sizeof(pause_histogram_bounds[0]) + 1)
+
+static uint64_t pause_histogram[PAUSE_HISTOGRAM_BUCKETS];
+static uint64_t pause_counts[GC_PAUSE_KIND_COUNT];
+static uint64_t total_pause_usec;
+static uint64_t max_pause_usec;
+static uint64_t total_bytes_reclaimed;
+static EJSBool have_last_collection;
+static GCPause last_collection;
+
+static uint64_t
+gc_now_usec()
+{
+#if defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+    struct timeval tv;
+    gettimeofday (&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+#endif
+}
+
+static void
+begin_pause(GCPause* pause, GCPauseKind kind)
+{
+    memset (pause, 0, sizeof(*pause));
+    pause->kind = kind;
+    pause->start_usec = gc_now_usec();
+    num_stack_roots = 0;
+}
+
+static void
+write_pause_event(GCPause* pause)
+{
+    char buf[512];
+    int len = snprintf (buf, sizeof(buf),
+                        "{\"type\":\"%s\",\"startMs\":%.3f,\"pauseMs\":%.3f,\"markMs\":%.3f,\"sweepMs\":%.3f,"
+                        "\"heapBefore\":%zu,\"heapAfter\":%zu,\"reclaimed\":%zu,\"roots\":%d,\"stackRoots\":%d}\n",
+                        pause_kind_names[pause->kind],
+                        (pause->start_usec - gc_start_usec) / 1000.0, pause->pause_usec / 1000.0,
+                        pause->mark_usec / 1000.0, pause->sweep_usec / 1000.0,
+                        pause->heap_before, pause->heap_after, pause->heap_before - pause->heap_after,
+                        pause->roots, pause->stack_roots);
+    // one write per event, so lines from a pipe stay whole.  if the reader has gone away, stop trying.
+    if (len > 0 && write (event_fd, buf, MIN(len, (int)sizeof(buf) - 1)) < 0)
+        event_fd = -1;
+}
+
+static void
+end_pause(GCPause* pause)
+{
+    pause->pause_usec = gc_now_usec() - pause->start_usec;
+
+    pause_counts[pause->kind] ++;
+    total_pause_usec += pause->pause_usec;
+    max_pause_usec = MAX(max_pause_usec, pause->pause_usec);
+
+    size_t bucket = 0;
+    while (bucket < PAUSE_HISTOGRAM_BUCKETS - 1 && pause->pause_usec >= pause_histogram_bounds[bucket])
+        bucket ++;
+    pause_histogram[bucket] ++;
+
+    if (pause->kind != GC_PAUSE_MARK_STEP) {
+        total_bytes_reclaimed += pause->heap_before - pause->heap_after;
+        last_collection = *pause;
+        have_last_collection = EJS_TRUE;
+    }
+
+    if (event_fd >= 0)
+        write_pause_event(pause);
+}
+
 static void
 _ejs_gc_collect_inner(EJSBool shutting_down)
 {
 #if gc_timings > 1
     struct timeval tvbefore, tvafter;
 #endif
+    GCPause pause;
+    begin_pause(&pause, GC_PAUSE_FULL);
 
     // very simple stop the world collector
     SPEW(1, _ejs_log ("collection started\n"));
 
+    // the previous collection's garbage has to be gone before we start marking
+    finish_sweeping();
+
     num_roots = 0;
     white_objs = 0;
     large_objs = 0;
     total_objs = 0;
 
+    uint64_t mark_start = gc_now_usec();
+    pause.sweep_usec = mark_start - pause.start_usec;
+    pause.heap_before = heap_bytes_in_use;
+
 #if gc_timings > 1
     gettimeofday (&tvbefore, NULL);
 #endif
 
     if (!shutting_down) {
+        // an incremental mark has already counted what it's marked
+        if (!marking_in_progress)
+            marked_bytes = 0;
+
         mark_from_roots();
 
         total_objs = num_roots;
@@ -998,8 +2074,25 @@ _ejs_gc_collect_inner(EJSBool shutting_down)
         mark_thread_stack();
 
         process_worklist();
+
+        update_gc_trigger();
+
+        _ejs_string_purge_atoms();
+        _ejs_shape_purge_transitions();
     }
 
+    // anything unmarked is about to be swept
+    _ejs_gc_epoch ++;
+
+    // if we were marking incrementally, we just finished
+    marking_in_progress = EJS_FALSE;
+    _ejs_gc_barrier_enabled = generational;
+
+    uint64_t sweep_start = gc_now_usec();
+    pause.mark_usec = sweep_start - mark_start;
+    pause.roots = num_roots;
+    pause.stack_roots = num_stack_roots;
+
 #if gc_timings > 1
     gettimeofday (&tvafter, NULL);
 #endif
@@ -1017,7 +2110,10 @@ _ejs_gc_collect_inner(EJSBool shutting_down)
     gettimeofday (&tvbefore, NULL);
 #endif
 
-    sweep_heap();
+    sweep_heap(shutting_down);
+
+    pause.sweep_usec += gc_now_usec() - sweep_start;
+    pause.heap_after = MIN(marked_bytes, pause.heap_before);
 
 #if gc_timings > 1
     {
@@ -1067,7 +2163,7 @@ _ejs_gc_collect_inner(EJSBool shutting_down)
                          len ++;
                  });
 
-                 _ejs_log ("  size: %d     pages: %d\n", 1<<(hp + 3), len);
+                 _ejs_log ("  size: %d     pages: %d\n", size_classes[hp], len);
              });
     }
 #if sanity
@@ -1082,15 +2178,72 @@ _ejs_gc_collect_inner(EJSBool shutting_down)
         }
     }
 #endif
+    if (!shutting_down)
+        end_pause(&pause);
     SPEW(1, _ejs_log ("collection finished\n"));
 }
 
+static void
+_ejs_gc_collect_young()
+{
+    SPEW(1, _ejs_log ("minor collection started\n"));
+
+    GCPause pause;
+    begin_pause(&pause, GC_PAUSE_MINOR);
+
+    finish_sweeping();
+
+    num_roots = 0;
+    white_objs = 0;
+    large_objs = 0;
+    total_objs = 0;
+
+    uint64_t mark_start = gc_now_usec();
+    pause.sweep_usec = mark_start - pause.start_usec;
+    pause.heap_before = heap_bytes_in_use;
+
+    minor_collection = EJS_TRUE;
+
+    mark_from_roots();
+
+    mark_from_remembered_set();
+
+    mark_from_modules();
+
+    mark_thread_stack();
+
+    process_worklist();
+
+    _ejs_string_purge_atoms();
+    _ejs_shape_purge_transitions();
+
+    minor_collection = EJS_FALSE;
+
+    _ejs_gc_epoch ++;
+
+    uint64_t sweep_start = gc_now_usec();
+    pause.mark_usec = sweep_start - mark_start;
+    pause.roots = num_roots;
+    pause.stack_roots = num_stack_roots;
+
+    clear_remembered_set();
+
+    sweep_young();
+
+    pause.sweep_usec += gc_now_usec() - sweep_start;
+    pause.heap_after = heap_bytes_in_use;
+    end_pause(&pause);
+
+    SPEW(1, _ejs_log ("minor collection finished, %d of %d young objects were garbage\n", white_objs, total_objs));
+}
+
 static size_t
 calc_heap_size()
 {
     size_t size = 0;
     for (int hp = 0; hp < HEAP_PAGELISTS_COUNT; hp++) {
         size += _ejs_list_length(&heap_pages[hp]) * PAGE_SIZE;
+        size += _ejs_list_length(&sweep_pages[hp]) * PAGE_SIZE;
     }
     return size;
 }
@@ -1124,34 +2277,90 @@ _ejs_gc_collect()
 
 int total_allocs = 0;
 
-void
-_ejs_gc_shutdown()
+// gray the roots, modules and stack, and leave the rest of the marking to _ejs_gc_mark_some
+static void
+start_incremental_marking()
 {
-    _ejs_gc_collect_inner(EJS_TRUE);
+    SPEW(1, _ejs_log ("incremental marking started\n"));
+
+    GCPause pause;
+    begin_pause(&pause, GC_PAUSE_MARK_STEP);
+
+    finish_sweeping();
+
+    num_roots = 0;
+    marked_bytes = 0;
+
+    marking_in_progress = EJS_TRUE;
+    _ejs_gc_barrier_enabled = EJS_TRUE;
+    mark_step_allocated = 0;
+
+    mark_from_roots();
+
+    mark_from_modules();
+
+    mark_thread_stack();
+
+    pause.roots = num_roots;
+    pause.stack_roots = num_stack_roots;
+    pause.heap_before = pause.heap_after = heap_bytes_in_use;
+    pause.mark_usec = gc_now_usec() - pause.start_usec;
+    end_pause(&pause);
+}
+
+EJSBool
+_ejs_gc_mark_some(int max_objects)
+{
+    if (!marking_in_progress || max_objects == 0)
+        return marking_in_progress;
+
+    GCPause pause;
+    begin_pause(&pause, GC_PAUSE_MARK_STEP);
+
+    GCObjectPtr p;
+    while (max_objects > 0 && (p = _ejs_gc_worklist_pop())) {
+        marked_bytes += mark_object (p);
+        max_objects --;
+    }
+
+    pause.heap_before = pause.heap_after = heap_bytes_in_use;
+    pause.mark_usec = gc_now_usec() - pause.start_usec;
+    end_pause(&pause);
+
+    if (work_list.list != NULL)
+        return EJS_TRUE;
+
+    // the heap has no gray objects left.  _ejs_gc_collect rescans the roots and the stack, marks
+    // whatever they reach that we haven't already, and sweeps.
+    _ejs_gc_collect();
+    return EJS_FALSE;
+}
+
+// called from the allocator when it's time for a full collection
+static void
+start_full_collection()
+{
+    if (incremental_marking)
+        start_incremental_marking();
+    else
+        _ejs_gc_collect();
+}
+
+void
+_ejs_gc_shutdown()
+{
+    // finish up a collection in progress so the final collection starts with everything white
+    if (marking_in_progress)
+        _ejs_gc_collect_inner(EJS_FALSE);
+
+    _ejs_gc_collect_inner(EJS_TRUE);
     SPEW(1, _ejs_log ("total allocs = %d\n", total_allocs));
 
     _ejs_log ("gc allocation stats (_ejs_gc_shutdown):\n");
     _ejs_log ("  objects: %d\n", num_object_allocs);
     _ejs_log ("  closureenv: %d\n", num_closureenv_allocs);
     _ejs_log ("  primstr: %d\n", num_primstr_allocs);
-}
-
-/* Compute the smallest power of 2 that is >= x. */
-static inline size_t
-pow2_ceil(size_t x)
-{
-
-	x--;
-	x |= x >> 1;
-	x |= x >> 2;
-	x |= x >> 4;
-	x |= x >> 8;
-	x |= x >> 16;
-#if (SIZEOF_PTR == 8)
-	x |= x >> 32;
-#endif
-	x++;
-	return (x);
+    _ejs_log ("  store: %d\n", num_store_allocs);
 }
 
 static GCObjectPtr
@@ -1172,25 +2381,27 @@ alloc_from_page(PageInfo *info)
         info->bump_ptr += info->cell_size;
         // check if we can service the next alloc request from the bump_ptr.  if we can't, switch
         // to the freelist code below.
-        if (info->bump_ptr + info->cell_size >= info->page_end)
+        if (info->bump_ptr + info->cell_size > info->page_end)
             info->bump_ptr = NULL;
     }
     else {
-        for (cell = 0; cell < info->num_cells; cell ++) {
-            if (IS_FREE(info->page_bitmap[cell])) {
-                rv = info->page_start + (cell * info->cell_size);
-                break;
-            }
-        }
+        rv = info->free_list;
+        EJS_ASSERT (rv);
+        info->free_list = *(void**)rv;
+        cell = PTR_TO_CELL(rv, info);
     }
 
     EJS_ASSERT (rv);
+    EJS_ASSERT (IS_FREE(info->page_bitmap[cell]));
 
     SET_ALLOCATED(info->page_bitmap[cell]);
     SET_WHITE(info->page_bitmap[cell]);
 
     info->num_free_cells --;
 
+    if (!info->has_young_cells)
+        add_young_page(info);
+
     UNLOCK_PAGE(info);
 
     SPEW(2, _ejs_log ("allocated obj %p from page %p (cell size %zd), free cells remaining %zd\n", rv, info, info->cell_size, info->num_free_cells));
@@ -1201,13 +2412,176 @@ alloc_from_page(PageInfo *info)
     return rv;
 }
 
+// large objects up to MEDIUM_OBJECT_MAX_SIZE are carved out of shared chunks instead of each getting
+// their own mmap.  every block in a chunk starts with a boundary tag holding its size and the size
+// of the block before it, so a freed block can be coalesced with both neighbors.  free blocks are
+// kept on lists segregated by size, MEDIUM_BIN_SIZE bytes per bin.  a zero sized tag marks the
+// end of the chunk.
+#define MEDIUM_CHUNK_SIZE (1024 * 1024)
+#define MEDIUM_OBJECT_MAX_SIZE (64 * 1024)
+#define MEDIUM_GRANULE 64
+#define MEDIUM_MIN_BLOCK 256 // don't split off free blocks smaller than this
+#define MEDIUM_BIN_SHIFT 11
+#define MEDIUM_BIN_SIZE (1 << MEDIUM_BIN_SHIFT)
+#define MEDIUM_BIN_COUNT ((MEDIUM_OBJECT_MAX_SIZE >> MEDIUM_BIN_SHIFT) + 2) // the last bin holds blocks too big for any request
+#define MEDIUM_RETAINED_EMPTY_CHUNKS 1
+
+typedef struct _MediumBlock {
+    size_t size;      // including the tag.  MEDIUM_BLOCK_FREE is set while the block is free
+    size_t prev_size; // 0 for the first block in the chunk
+
+    // only valid while the block is free
+    struct _MediumBlock *next_free;
+    struct _MediumBlock *prev_free;
+} MediumBlock;
+
+#define MEDIUM_BLOCK_FREE 1
+#define MEDIUM_TAG_SIZE offsetof(MediumBlock, next_free)
+#define MEDIUM_CHUNK_SPAN (MEDIUM_CHUNK_SIZE - MEDIUM_TAG_SIZE) // everything but the end tag
+#define MEDIUM_BLOCK_SIZE(b) ((b)->size & ~(size_t)MEDIUM_BLOCK_FREE)
+#define MEDIUM_NEXT_BLOCK(b) ((MediumBlock*)((char*)(b) + MEDIUM_BLOCK_SIZE(b)))
+#define MEDIUM_PREV_BLOCK(b) ((MediumBlock*)((char*)(b) - (b)->prev_size))
+
+static MediumBlock *medium_bins[MEDIUM_BIN_COUNT];
+static int num_empty_medium_chunks;
+
+static int
+medium_bin(size_t size)
+{
+    size_t bin = size >> MEDIUM_BIN_SHIFT;
+    return bin < MEDIUM_BIN_COUNT ? bin : MEDIUM_BIN_COUNT - 1;
+}
+
+static void
+medium_bin_insert(MediumBlock *block)
+{
+    int bin = medium_bin(MEDIUM_BLOCK_SIZE(block));
+    block->size |= MEDIUM_BLOCK_FREE;
+    block->prev_free = NULL;
+    block->next_free = medium_bins[bin];
+    if (block->next_free)
+        block->next_free->prev_free = block;
+    medium_bins[bin] = block;
+}
+
+static void
+medium_bin_remove(MediumBlock *block)
+{
+    if (block->prev_free)
+        block->prev_free->next_free = block->next_free;
+    else
+        medium_bins[medium_bin(MEDIUM_BLOCK_SIZE(block))] = block->next_free;
+    if (block->next_free)
+        block->next_free->prev_free = block->prev_free;
+    block->size &= ~(size_t)MEDIUM_BLOCK_FREE;
+}
+
+static MediumBlock*
+medium_chunk_new()
+{
+    MediumBlock *block = alloc_from_os(MEDIUM_CHUNK_SIZE, 0);
+    if (block == NULL)
+        return NULL;
+
+    block->size = MEDIUM_CHUNK_SPAN;
+    block->prev_size = 0;
+
+    MediumBlock *end = MEDIUM_NEXT_BLOCK(block);
+    end->size = 0;
+    end->prev_size = MEDIUM_CHUNK_SPAN;
+    return block;
+}
+
+static void*
+medium_alloc(size_t size)
+{
+    size = ALIGN(size + MEDIUM_TAG_SIZE, MEDIUM_GRANULE);
+
+    // blocks in the request's own bin might be too small, but anything in a later bin will fit
+    int bin = medium_bin(size);
+    MediumBlock *block;
+    for (block = medium_bins[bin]; block && MEDIUM_BLOCK_SIZE(block) < size; block = block->next_free)
+        ;
+    while (!block && ++bin < MEDIUM_BIN_COUNT)
+        block = medium_bins[bin];
+
+    if (block) {
+        if (MEDIUM_BLOCK_SIZE(block) == MEDIUM_CHUNK_SPAN)
+            num_empty_medium_chunks --;
+        medium_bin_remove(block);
+    }
+    else {
+        block = medium_chunk_new();
+        if (block == NULL)
+            return NULL;
+    }
+
+    size_t remainder = MEDIUM_BLOCK_SIZE(block) - size;
+    if (remainder >= MEDIUM_MIN_BLOCK) {
+        block->size = size;
+
+        MediumBlock *rest = MEDIUM_NEXT_BLOCK(block);
+        rest->size = remainder;
+        rest->prev_size = size;
+        MEDIUM_NEXT_BLOCK(rest)->prev_size = remainder;
+        medium_bin_insert(rest);
+    }
+
+    return (char*)block + MEDIUM_TAG_SIZE;
+}
+
+static void
+medium_free(void* ptr)
+{
+    MediumBlock *block = (MediumBlock*)((char*)ptr - MEDIUM_TAG_SIZE);
+
+    MediumBlock *next = MEDIUM_NEXT_BLOCK(block);
+    if (next->size & MEDIUM_BLOCK_FREE) {
+        medium_bin_remove(next);
+        block->size += next->size;
+    }
+    if (block->prev_size) {
+        MediumBlock *prev = MEDIUM_PREV_BLOCK(block);
+        if (prev->size & MEDIUM_BLOCK_FREE) {
+            medium_bin_remove(prev);
+            prev->size += block->size;
+            block = prev;
+        }
+    }
+    MEDIUM_NEXT_BLOCK(block)->prev_size = MEDIUM_BLOCK_SIZE(block);
+
+    if (MEDIUM_BLOCK_SIZE(block) == MEDIUM_CHUNK_SPAN) {
+        // the whole chunk is free.  keep a few around so a program cycling through big buffers
+        // doesn't map and unmap a chunk on every collection.
+        if (num_empty_medium_chunks >= MEDIUM_RETAINED_EMPTY_CHUNKS) {
+            SPEW(2, _ejs_log ("releasing empty medium chunk %p\n", block));
+            release_to_os(block, MEDIUM_CHUNK_SIZE);
+            return;
+        }
+        num_empty_medium_chunks ++;
+    }
+
+    medium_bin_insert(block);
+}
+
 static GCObjectPtr
 alloc_from_los(size_t size, EJSScanType scan_type)
 {
     // allocate enough space for the object, our header, and our bitmap.  leave room enough to align the return value
-    LargeObjectInfo *rv = alloc_from_os(size + sizeof(LargeObjectInfo) + 16, 0);
-    if (rv == NULL)
-        return NULL;
+    size_t lobj_size = size + sizeof(LargeObjectInfo) + 16;
+    LargeObjectInfo *rv;
+    if (size <= MEDIUM_OBJECT_MAX_SIZE) {
+        rv = medium_alloc(lobj_size);
+        if (rv == NULL)
+            return NULL;
+        // fresh mmaps come back zeroed, recycled blocks don't
+        memset (rv, 0, lobj_size);
+    }
+    else {
+        rv = alloc_from_os(lobj_size, 0);
+        if (rv == NULL)
+            return NULL;
+    }
 
     rv->page_info.page_bitmap = (char*)((void*)rv + sizeof(LargeObjectInfo)); // our bitmap comes right after the header
     rv->page_info.page_start = (void*)ALIGN((void*)rv + sizeof(LargeObjectInfo) + 8, 8);
@@ -1224,6 +2598,7 @@ alloc_from_los(size_t size, EJSScanType scan_type)
     rv->alloc_size = size;
 
     EJS_LIST_PREPEND (rv, los_list);
+    los_table_insert (rv);
     //_ejs_log ("alloc_from_los returning %p\n, los_list = %p\n", rv->page_info.page_start, los_list);
     return rv->page_info.page_start;
 }
@@ -1231,7 +2606,11 @@ alloc_from_los(size_t size, EJSScanType scan_type)
 static void
 release_to_los (LargeObjectInfo *lobj)
 {
-    release_to_os (lobj, lobj->alloc_size);
+    los_table_remove (lobj);
+    if (lobj->alloc_size <= MEDIUM_OBJECT_MAX_SIZE)
+        medium_free (lobj);
+    else
+        release_to_os (lobj, lobj->alloc_size + sizeof(LargeObjectInfo) + 16);
 }
 
 size_t alloc_size = 0;
@@ -1250,26 +2629,49 @@ _ejs_gc_alloc(size_t size, EJSScanType scan_type)
 
     switch (scan_type) {
     case EJS_SCAN_TYPE_PRIMSTR: num_primstr_allocs ++; break;
+    case EJS_SCAN_TYPE_STORE: num_store_allocs ++; break;
     case EJS_SCAN_TYPE_OBJECT: num_object_allocs ++; break;
     case EJS_SCAN_TYPE_CLOSUREENV: num_closureenv_allocs ++; break;
     }
 
-    if (!gc_disabled && ((num_allocs == 400000 || (alloc_size - alloc_size_at_last_gc) >= 60*1024*1024) || (collect_every_alloc && collect_every_alloc == num_allocs))) {
-        //        if (num_allocs == 400000) _ejs_log ("collecting due to num_allocs == %d, alloc_size = %d, alloc_size size last gc = %d\n", num_allocs, alloc_size, alloc_size - alloc_size_at_last_gc);
-        //        if (alloc_size - alloc_size_at_last_gc >= 40*1024*1024) _ejs_log ("collecting due to allocs since last gc\n");
-        _ejs_gc_collect();
+    if (marking_in_progress) {
+        // no minor collections while we're marking incrementally, just keep the marker moving
+        mark_step_allocated += size;
+        if (mark_step_allocated >= INCREMENTAL_MARK_STEP_BYTES) {
+            mark_step_allocated = 0;
+            if (!_ejs_gc_mark_some(INCREMENTAL_MARK_STEP_BUDGET)) {
+                alloc_size_at_last_gc = alloc_size;
+                nursery_allocated = 0;
+                num_allocs = 0;
+            }
+        }
+    }
+    else if (generational && !gc_disabled && !collect_every_alloc) {
+        nursery_allocated += size;
+        if (nursery_allocated >= nursery_size) {
+            if (promoted_since_full_gc >= next_gc_allocation) {
+                start_full_collection();
+                alloc_size_at_last_gc = alloc_size;
+            }
+            else {
+                _ejs_gc_collect_young();
+            }
+            nursery_allocated = 0;
+            num_allocs = 0;
+        }
+    }
+    else if (!gc_disabled && ((alloc_size - alloc_size_at_last_gc) >= next_gc_allocation || (collect_every_alloc && collect_every_alloc == num_allocs))) {
+        start_full_collection();
         alloc_size_at_last_gc = alloc_size;
         num_allocs = 0;
     }
 
     int bucket;
-    int bucket_size = MAX(pow2_ceil(size), 1<<OBJECT_SIZE_LOW_LIMIT_BITS);
-
-    bucket = ffs(bucket_size);
+    int bucket_size;
 
     retry_allocation:
     {
-    if (bucket > OBJECT_SIZE_HIGH_LIMIT_BITS) {
+    if (size > (1 << OBJECT_SIZE_HIGH_LIMIT_BITS)) {
         SPEW(2, _ejs_log ("need to alloc %zd from los!!!\n", size));
         rv = alloc_from_los(size, scan_type);
         if (rv == NULL) {
@@ -1286,15 +2688,21 @@ _ejs_gc_alloc(size_t size, EJSScanType scan_type)
                 goto retry_allocation;
             }
         }
+        heap_bytes_in_use += size;
+        if (EJS_UNLIKELY(alloc_sample_interval != 0))
+            sample_allocation(rv, size);
         return rv;
     }
 
-    bucket -= OBJECT_SIZE_LOW_LIMIT_BITS;
+    bucket = SIZE_TO_BUCKET(size);
+    bucket_size = size_classes[bucket];
 
     LOCK_GC();
 
     PageInfo* info = (PageInfo*)heap_pages[bucket].head;
-    if (!info || !info->num_free_cells) {
+    if (!info || !info->num_free_cells)
+        info = sweep_for_free_cell(bucket);
+    if (!info) {
         info = alloc_new_page(bucket_size);
         if (info == NULL) {
             if (num_allocs == 0) {
@@ -1314,6 +2722,7 @@ _ejs_gc_alloc(size_t size, EJSScanType scan_type)
 
     rv = alloc_from_page(info);
     *((GCObjectHeader*)rv) = scan_type;
+    heap_bytes_in_use += bucket_size;
 
     if (info->num_free_cells == 0) {
         // if the page is full, bump it to the end of the list (if there's more than 1 page in the list)
@@ -1325,9 +2734,57 @@ _ejs_gc_alloc(size_t size, EJSScanType scan_type)
 
     UNLOCK_GC();
     }
+    if (EJS_UNLIKELY(alloc_sample_interval != 0))
+        sample_allocation(rv, size);
     return rv;
 }
 
+// stores start with a GCObjectHeader like every other cell, padded so the data that follows is
+// ejsval aligned.
+#define STORE_HEADER_SIZE 8
+
+void*
+_ejs_gc_new_store(size_t size)
+{
+    return (char*)_ejs_gc_alloc(size + STORE_HEADER_SIZE, EJS_SCAN_TYPE_STORE) + STORE_HEADER_SIZE;
+}
+
+typedef struct _HeapSnapshot HeapSnapshot;
+static HeapSnapshot *snapshot; // the snapshot being written, if any
+static void snapshot_store_edge(void* store);
+
+void
+_ejs_gc_mark_store(void* store)
+{
+    if (store == NULL)
+        return;
+
+    // the snapshot writer runs Scan ops to find edges, and wants the stores they mark as edges too
+    if (EJS_UNLIKELY(snapshot != NULL)) {
+        snapshot_store_edge(store);
+        return;
+    }
+
+    GCObjectPtr ptr = (char*)store - STORE_HEADER_SIZE;
+    uint32_t cell_idx;
+    PageInfo *page = find_page_and_cell(ptr, &cell_idx);
+    if (!page)
+        return;
+
+    // there's nothing inside a store for the marker to trace, so it goes straight to black
+    BitmapCell *cell = &page->page_bitmap[cell_idx];
+    BitmapCell bc;
+    do {
+        bc = *cell;
+        if (!IS_MARKABLE(bc))
+            return;
+    } while (!__sync_bool_compare_and_swap (cell, bc, (bc & ~CELL_COLOR_MASK) | black_mask));
+
+    if (!minor_collection)
+        SET_OLD(*cell);
+    marked_store_bytes += page->cell_size;
+}
+
 void
 _ejs_gc_add_root(ejsval* root)
 {
@@ -1351,6 +2808,33 @@ _ejs_gc_remove_root(ejsval* root)
     }
 }
 
+void
+_ejs_gc_push_shadow_frame(EJSShadowFrame* frame)
+{
+    // the caller's stack pointer, below which are only the frames it calls
+    frame->stack_low = __builtin_dwarf_cfa();
+    frame->prev = shadow_stack;
+    shadow_stack = frame;
+}
+
+void
+_ejs_gc_pop_shadow_frame(EJSShadowFrame* frame)
+{
+    shadow_stack = frame->prev;
+}
+
+EJSShadowFrame*
+_ejs_gc_get_shadow_frame()
+{
+    return shadow_stack;
+}
+
+void
+_ejs_gc_restore_shadow_frame(EJSShadowFrame* frame)
+{
+    shadow_stack = frame;
+}
+
 static int
 page_list_count (PageInfo* page)
 {
@@ -1374,7 +2858,7 @@ _ejs_gc_dump_heap_stats()
 #if gc_timings > 3
         EJSBool printed_something = EJS_FALSE;
 #endif
-        _ejs_log ("heap_pages[%d, size %d] : %d pages\n", i, 1 << (i + OBJECT_SIZE_LOW_LIMIT_BITS), _ejs_list_length (&heap_pages[i]));
+        _ejs_log ("heap_pages[%d, size %d] : %d pages\n", i, size_classes[i], _ejs_list_length (&heap_pages[i]));
 #if gc_timings > 3
         EJS_LIST_FOREACH (&heap_pages[i], PageInfo, page, {
             GCObjectPtr p = page->page_start;
@@ -1385,6 +2869,7 @@ _ejs_gc_dump_heap_stats()
                 if ((*headerp & EJS_SCAN_TYPE_OBJECT) != 0)          _ejs_log ("O");
                 else if ((*headerp & EJS_SCAN_TYPE_CLOSUREENV) != 0) _ejs_log ("C");
                 else if ((*headerp & EJS_SCAN_TYPE_PRIMSTR) != 0)    _ejs_log (((*headerp >> EJS_GC_USER_FLAGS_SHIFT) & 0x10) != 0 ? "s" : "S");
+                else if ((*headerp & EJS_SCAN_TYPE_STORE) != 0)      _ejs_log ("B");
                 printed_something = EJS_TRUE;
             }
         })
@@ -1402,11 +2887,715 @@ _ejs_gc_dump_heap_stats()
             if ((*headerp & EJS_SCAN_TYPE_OBJECT) != 0)          _ejs_log ("O");
             else if ((*headerp & EJS_SCAN_TYPE_CLOSUREENV) != 0) _ejs_log ("C");
             else if ((*headerp & EJS_SCAN_TYPE_PRIMSTR) != 0)    _ejs_log ("S");
+            else if ((*headerp & EJS_SCAN_TYPE_STORE) != 0)      _ejs_log ("B");
         }
         _ejs_log ("\n");
     }
 }
 
+// allocation sampling.  a sampled cell gets HEADER_SAMPLED_FLAG set in its header (which is
+// overwritten when the cell is reused) and an entry in sampled_cells recording its site, so a
+// snapshot can tell which live cells were sampled and where they were allocated.
+#define HEADER_SAMPLED_FLAG (1 << 15)
+
+typedef struct {
+    const char* name; // from the innermost shadow frame, NULL for allocations outside compiled code
+    uint64_t count;
+    uint64_t size;
+} AllocationSite;
+
+static AllocationSite *alloc_sites;
+static int num_alloc_sites;
+static int alloc_sites_alloc;
+
+typedef struct {
+    GCObjectPtr cell;
+    int site;
+} SampledCell;
+
+// open addressed, keyed on the cell's address
+static SampledCell *sampled_cells;
+static size_t sampled_cells_size;
+static size_t num_sampled_cells;
+
+#define SAMPLED_CELL_HASH(p) (((uintptr_t)(p) >> 3) * 2654435761u)
+
+static EJSBool
+sampled_cell_is_live(GCObjectPtr cell)
+{
+    uint32_t cell_idx;
+    PageInfo *page = find_page_and_cell(cell, &cell_idx);
+    return page && !IS_FREE(page->page_bitmap[cell_idx]) && (*(GCObjectHeader*)cell & HEADER_SAMPLED_FLAG) != 0;
+}
+
+static void
+sampled_cell_insert(GCObjectPtr cell, int site)
+{
+    size_t i = SAMPLED_CELL_HASH(cell) & (sampled_cells_size - 1);
+    while (sampled_cells[i].cell && sampled_cells[i].cell != cell)
+        i = (i + 1) & (sampled_cells_size - 1);
+    if (!sampled_cells[i].cell)
+        num_sampled_cells ++;
+    sampled_cells[i].cell = cell;
+    sampled_cells[i].site = site;
+}
+
+// returns the site of @cell if it was sampled, -1 if not
+static int
+sampled_cell_lookup(GCObjectPtr cell)
+{
+    if (num_sampled_cells == 0 || (*(GCObjectHeader*)cell & HEADER_SAMPLED_FLAG) == 0)
+        return -1;
+    size_t i = SAMPLED_CELL_HASH(cell) & (sampled_cells_size - 1);
+    while (sampled_cells[i].cell) {
+        if (sampled_cells[i].cell == cell)
+            return sampled_cells[i].site;
+        i = (i + 1) & (sampled_cells_size - 1);
+    }
+    return -1;
+}
+
+// drop the entries for cells that have died, growing the table if that doesn't free up enough room
+static void
+sampled_cells_rehash()
+{
+    SampledCell *old_cells = sampled_cells;
+    size_t old_size = sampled_cells_size;
+    size_t live = 0;
+    for (size_t i = 0; i < old_size; i ++) {
+        if (old_cells[i].cell && sampled_cell_is_live(old_cells[i].cell))
+            live ++;
+    }
+
+    sampled_cells_size = old_size ? old_size : 1024;
+    while (live * 4 >= sampled_cells_size)
+        sampled_cells_size *= 2;
+    sampled_cells = (SampledCell*)calloc(sampled_cells_size, sizeof(SampledCell));
+    num_sampled_cells = 0;
+
+    for (size_t i = 0; i < old_size; i ++) {
+        if (old_cells[i].cell && sampled_cell_is_live(old_cells[i].cell))
+            sampled_cell_insert(old_cells[i].cell, old_cells[i].site);
+    }
+    free (old_cells);
+}
+
+static int
+find_alloc_site(const char* name)
+{
+    for (int i = 0; i < num_alloc_sites; i ++) {
+        if (alloc_sites[i].name == name)
+            return i;
+    }
+    if (num_alloc_sites == alloc_sites_alloc) {
+        alloc_sites_alloc = alloc_sites_alloc ? alloc_sites_alloc * 2 : 64;
+        alloc_sites = (AllocationSite*)realloc(alloc_sites, alloc_sites_alloc * sizeof(AllocationSite));
+    }
+    alloc_sites[num_alloc_sites].name = name;
+    alloc_sites[num_alloc_sites].count = 0;
+    alloc_sites[num_alloc_sites].size = 0;
+    return num_alloc_sites ++;
+}
+
+static void
+sample_allocation(GCObjectPtr cell, size_t size)
+{
+    if (size < alloc_sample_countdown) {
+        alloc_sample_countdown -= size;
+        return;
+    }
+    alloc_sample_countdown = alloc_sample_interval;
+
+    int site = find_alloc_site(shadow_stack ? shadow_stack->name : NULL);
+    alloc_sites[site].count ++;
+    alloc_sites[site].size += size;
+
+    if (num_sampled_cells * 2 >= sampled_cells_size)
+        sampled_cells_rehash();
+    *(GCObjectHeader*)cell |= HEADER_SAMPLED_FLAG;
+    sampled_cell_insert(cell, site);
+}
+
+void
+_ejs_gc_set_allocation_sampling(size_t interval)
+{
+    alloc_sample_interval = interval;
+    alloc_sample_countdown = interval;
+}
+
+// heap snapshots, in the format v8 writes (see HeapSnapshotJSONSerializer in v8's
+// heap-snapshot-generator.cc.)  every live cell is a node, and its edges are whatever its Scan op
+// (or the collector, for strings and closure envs) reports, with the property map and dense elements
+// of objects walked first so those edges get names.  node 0 is the root, with the roots we know about
+// hanging off synthetic nodes below "(GC roots)".
+
+enum {
+    SNAPSHOT_NODE_HIDDEN = 0,
+    SNAPSHOT_NODE_ARRAY = 1,
+    SNAPSHOT_NODE_STRING = 2,
+    SNAPSHOT_NODE_OBJECT = 3,
+    SNAPSHOT_NODE_CLOSURE = 5,
+    SNAPSHOT_NODE_SYNTHETIC = 9,
+    SNAPSHOT_NODE_CONCATENATED_STRING = 10,
+    SNAPSHOT_NODE_SLICED_STRING = 11
+};
+
+enum {
+    SNAPSHOT_EDGE_CONTEXT = 0,
+    SNAPSHOT_EDGE_ELEMENT = 1,
+    SNAPSHOT_EDGE_PROPERTY = 2,
+    SNAPSHOT_EDGE_INTERNAL = 3,
+    SNAPSHOT_EDGE_SHORTCUT = 5
+};
+
+#define SNAPSHOT_NODE_FIELDS 6
+#define SNAPSHOT_EDGE_FIELDS 3
+
+// the synthetic nodes, followed by one node per live cell
+enum {
+    SNAPSHOT_ROOT_NODE,
+    SNAPSHOT_GC_ROOTS_NODE,
+    SNAPSHOT_HANDLES_NODE,
+    SNAPSHOT_MODULES_NODE,
+    SNAPSHOT_STACK_NODE,
+    SNAPSHOT_FIRST_CELL_NODE
+};
+
+// the longest string contents we'll use as a node name
+#define SNAPSHOT_MAX_STRING_NAME 1024
+
+typedef struct {
+    char* data;
+    size_t len;
+    size_t alloc;
+} SnapshotBuffer;
+
+struct _HeapSnapshot {
+    // cells[i] is node SNAPSHOT_FIRST_CELL_NODE + i
+    GCObjectPtr *cells;
+    uint32_t num_cells;
+
+    // open addressed map from a cell to its node index + 1
+    uint32_t *node_table;
+    size_t node_table_size;
+
+    uint32_t *edges;
+    size_t num_edges;
+    size_t edges_alloc;
+    uint32_t *edge_counts;
+
+    // edge_stamp[n] is 1 + the last node that got an edge to node n, so edges reported by Scan ops
+    // don't duplicate the named ones we already added
+    uint32_t *edge_stamp;
+    uint32_t current_node;
+    uint32_t scan_ordinal;
+
+    // the string table.  entries are already escaped for json
+    char **strings;
+    uint32_t num_strings;
+    uint32_t strings_alloc;
+    uint32_t *string_table;
+    size_t string_table_size;
+
+    SnapshotBuffer scratch;
+};
+
+static void
+snapshot_buffer_append(SnapshotBuffer* buf, const char* str, size_t len)
+{
+    if (buf->len + len + 1 > buf->alloc) {
+        buf->alloc = MAX(buf->alloc * 2, buf->len + len + 1);
+        buf->data = (char*)realloc(buf->data, buf->alloc);
+    }
+    memmove (buf->data + buf->len, str, len);
+    buf->len += len;
+    buf->data[buf->len] = 0;
+}
+
+static void
+snapshot_buffer_clear(SnapshotBuffer* buf)
+{
+    buf->len = 0;
+    snapshot_buffer_append(buf, "", 0);
+}
+
+static void
+snapshot_buffer_append_char(SnapshotBuffer* buf, jschar c)
+{
+    char escaped[8];
+    switch (c) {
+    case '"':  snapshot_buffer_append(buf, "\\\"", 2); break;
+    case '\\': snapshot_buffer_append(buf, "\\\\", 2); break;
+    case '\n': snapshot_buffer_append(buf, "\\n", 2); break;
+    case '\r': snapshot_buffer_append(buf, "\\r", 2); break;
+    case '\t': snapshot_buffer_append(buf, "\\t", 2); break;
+    default:
+        if (c < 0x20 || c >= 0x7f) {
+            snprintf (escaped, sizeof(escaped), "\\u%04x", c);
+            snapshot_buffer_append(buf, escaped, 6);
+        }
+        else {
+            escaped[0] = (char)c;
+            snapshot_buffer_append(buf, escaped, 1);
+        }
+        break;
+    }
+}
+
+// C strings (class names, and the function names from shadow frames) are utf8, which json allows as is
+static void
+snapshot_buffer_append_utf8(SnapshotBuffer* buf, const char* str)
+{
+    for (const char* p = str; *p; p ++) {
+        if ((unsigned char)*p >= 0x80)
+            snapshot_buffer_append(buf, p, 1);
+        else
+            snapshot_buffer_append_char(buf, (jschar)*p);
+    }
+}
+
+static void
+snapshot_buffer_append_primstr(SnapshotBuffer* buf, EJSPrimString* primstr)
+{
+    if (EJS_PRIMSTR_GET_TYPE(primstr) != EJS_STRING_FLAT) {
+        snapshot_buffer_append_utf8(buf, EJS_PRIMSTR_GET_TYPE(primstr) == EJS_STRING_ROPE ? "(concatenated string)" : "(sliced string)");
+        return;
+    }
+    uint32_t len = MIN(primstr->length, SNAPSHOT_MAX_STRING_NAME);
+    for (uint32_t i = 0; i < len; i ++)
+        snapshot_buffer_append_char(buf, EJS_PRIMSTR_FLAT_CHAR_AT(primstr, i));
+}
+
+static uint32_t
+snapshot_string_hash(const char* str)
+{
+    uint32_t hash = 2166136261u;
+    for (const char* p = str; *p; p ++)
+        hash = (hash ^ (unsigned char)*p) * 16777619u;
+    return hash;
+}
+
+// returns the index of the (already escaped) @str in the snapshot's string table, adding it if it's not there
+static uint32_t
+snapshot_intern(HeapSnapshot* snap, const char* str)
+{
+    if (snap->num_strings * 2 >= snap->string_table_size) {
+        free (snap->string_table);
+        snap->string_table_size = snap->string_table_size ? snap->string_table_size * 2 : 1024;
+        snap->string_table = (uint32_t*)calloc(snap->string_table_size, sizeof(uint32_t));
+        for (uint32_t i = 0; i < snap->num_strings; i ++) {
+            size_t j = snapshot_string_hash(snap->strings[i]) & (snap->string_table_size - 1);
+            while (snap->string_table[j])
+                j = (j + 1) & (snap->string_table_size - 1);
+            snap->string_table[j] = i + 1;
+        }
+    }
+
+    size_t j = snapshot_string_hash(str) & (snap->string_table_size - 1);
+    while (snap->string_table[j]) {
+        if (!strcmp(snap->strings[snap->string_table[j] - 1], str))
+            return snap->string_table[j] - 1;
+        j = (j + 1) & (snap->string_table_size - 1);
+    }
+
+    if (snap->num_strings == snap->strings_alloc) {
+        snap->strings_alloc = snap->strings_alloc ? snap->strings_alloc * 2 : 1024;
+        snap->strings = (char**)realloc(snap->strings, snap->strings_alloc * sizeof(char*));
+    }
+    snap->strings[snap->num_strings] = strdup(str);
+    snap->string_table[j] = snap->num_strings + 1;
+    return snap->num_strings ++;
+}
+
+static uint32_t
+snapshot_intern_utf8(HeapSnapshot* snap, const char* prefix, const char* str)
+{
+    snapshot_buffer_clear(&snap->scratch);
+    snapshot_buffer_append_utf8(&snap->scratch, prefix);
+    snapshot_buffer_append_utf8(&snap->scratch, str);
+    return snapshot_intern(snap, snap->scratch.data);
+}
+
+static uint32_t
+snapshot_intern_primstr(HeapSnapshot* snap, const char* prefix, EJSPrimString* primstr)
+{
+    snapshot_buffer_clear(&snap->scratch);
+    snapshot_buffer_append_utf8(&snap->scratch, prefix);
+    snapshot_buffer_append_primstr(&snap->scratch, primstr);
+    return snapshot_intern(snap, snap->scratch.data);
+}
+
+static uint32_t
+snapshot_intern_number(HeapSnapshot* snap, uint32_t n)
+{
+    char buf[16];
+    snprintf (buf, sizeof(buf), "%u", n);
+    return snapshot_intern(snap, buf);
+}
+
+#define SNAPSHOT_NODE_HASH(p) (((uintptr_t)(p) >> 3) * 2654435761u)
+
+// just counts the cells if we haven't allocated snap->cells yet
+static void
+snapshot_add_cell(HeapSnapshot* snap, GCObjectPtr cell)
+{
+    if (snap->cells)
+        snap->cells[snap->num_cells] = cell;
+    snap->num_cells ++;
+}
+
+// returns the node index for @ptr, or -1 if it isn't a live cell
+static int64_t
+snapshot_find_node(HeapSnapshot* snap, GCObjectPtr ptr)
+{
+    size_t i = SNAPSHOT_NODE_HASH(ptr) & (snap->node_table_size - 1);
+    while (snap->node_table[i]) {
+        uint32_t node = snap->node_table[i] - 1;
+        if (snap->cells[node - SNAPSHOT_FIRST_CELL_NODE] == ptr)
+            return node;
+        i = (i + 1) & (snap->node_table_size - 1);
+    }
+    return -1;
+}
+
+static void
+snapshot_add_edge(HeapSnapshot* snap, uint32_t type, uint32_t name_or_index, uint32_t to_node)
+{
+    if (snap->num_edges + SNAPSHOT_EDGE_FIELDS > snap->edges_alloc) {
+        snap->edges_alloc = snap->edges_alloc ? snap->edges_alloc * 2 : 3 * 16384;
+        snap->edges = (uint32_t*)realloc(snap->edges, snap->edges_alloc * sizeof(uint32_t));
+    }
+    snap->edges[snap->num_edges ++] = type;
+    snap->edges[snap->num_edges ++] = name_or_index;
+    snap->edges[snap->num_edges ++] = to_node * SNAPSHOT_NODE_FIELDS;
+    snap->edge_counts[snap->current_node] ++;
+    snap->edge_stamp[to_node] = snap->current_node + 1;
+}
+
+static void
+snapshot_add_edge_to_value(HeapSnapshot* snap, uint32_t type, uint32_t name_or_index, ejsval val)
+{
+    if (!EJSVAL_IS_TRACEABLE_IMPL(val))
+        return;
+    GCObjectPtr ptr = (GCObjectPtr)EJSVAL_TO_GCTHING_IMPL(val);
+    if (ptr == NULL)
+        return;
+    int64_t node = snapshot_find_node(snap, ptr);
+    if (node != -1)
+        snapshot_add_edge(snap, type, name_or_index, (uint32_t)node);
+}
+
+static void
+snapshot_store_edge(void* store)
+{
+    int64_t node = snapshot_find_node(snapshot, (char*)store - STORE_HEADER_SIZE);
+    if (node != -1 && snapshot->edge_stamp[node] != snapshot->current_node + 1)
+        snapshot_add_edge(snapshot, SNAPSHOT_EDGE_INTERNAL, snapshot_intern_utf8(snapshot, "", "(backing store)"), (uint32_t)node);
+}
+
+// the EJSValueFunc we hand to Scan ops
+static void
+snapshot_scan_value(ejsval val)
+{
+    if (!EJSVAL_IS_TRACEABLE_IMPL(val))
+        return;
+    GCObjectPtr ptr = (GCObjectPtr)EJSVAL_TO_GCTHING_IMPL(val);
+    if (ptr == NULL)
+        return;
+    int64_t node = snapshot_find_node(snapshot, ptr);
+    if (node == -1 || snapshot->edge_stamp[node] == snapshot->current_node + 1)
+        return;
+    snapshot_add_edge(snapshot, SNAPSHOT_EDGE_INTERNAL, snapshot_intern_number(snapshot, snapshot->scan_ordinal ++), (uint32_t)node);
+}
+
+static uint32_t
+snapshot_key_name(HeapSnapshot* snap, const char* prefix, ejsval key)
+{
+    if (EJSVAL_IS_STRING(key))
+        return snapshot_intern_primstr(snap, prefix, EJSVAL_TO_STRING(key));
+    if (EJSVAL_IS_NUMBER(key)) {
+        char buf[32];
+        snprintf (buf, sizeof(buf), "%g", EJSVAL_TO_NUMBER(key));
+        return snapshot_intern_utf8(snap, prefix, buf);
+    }
+    return snapshot_intern_utf8(snap, prefix, "<symbol>");
+}
+
+static void
+snapshot_object_edges(HeapSnapshot* snap, EJSObject* obj)
+{
+    EJSOwnPropertyIter iter;
+    _ejs_own_property_iter_init (&iter, obj);
+    while (_ejs_own_property_iter_next (&iter)) {
+        if (_ejs_property_desc_has_value (iter.desc))
+            snapshot_add_edge_to_value(snap, SNAPSHOT_EDGE_PROPERTY, snapshot_key_name(snap, "", iter.name), iter.desc->value);
+        if (_ejs_property_desc_has_getter (iter.desc))
+            snapshot_add_edge_to_value(snap, SNAPSHOT_EDGE_PROPERTY, snapshot_key_name(snap, "get ", iter.name), iter.desc->getter);
+        if (_ejs_property_desc_has_setter (iter.desc))
+            snapshot_add_edge_to_value(snap, SNAPSHOT_EDGE_PROPERTY, snapshot_key_name(snap, "set ", iter.name), iter.desc->setter);
+    }
+    snapshot_add_edge_to_value(snap, SNAPSHOT_EDGE_PROPERTY, snapshot_intern_utf8(snap, "", "__proto__"), obj->proto);
+
+    if (obj->ops == &_ejs_Array_specops) {
+        for (uint32_t i = 0; i < EJSARRAY_LEN(obj); i ++)
+            snapshot_add_edge_to_value(snap, SNAPSHOT_EDGE_ELEMENT, i, EJSDENSEARRAY_ELEMENTS(obj)[i]);
+    }
+
+    // and whatever else the object holds on to
+    snap->scan_ordinal = 0;
+    OP(obj,Scan)(obj, snapshot_scan_value);
+}
+
+static void
+snapshot_cell_edges(HeapSnapshot* snap, GCObjectPtr cell)
+{
+    GCObjectHeader header = *(GCObjectHeader*)cell;
+    if ((header & EJS_SCAN_TYPE_OBJECT) != 0) {
+        snapshot_object_edges(snap, (EJSObject*)cell);
+    }
+    else if ((header & EJS_SCAN_TYPE_PRIMSTR) != 0) {
+        EJSPrimString* primstr = (EJSPrimString*)cell;
+        switch (EJS_PRIMSTR_GET_TYPE(primstr)) {
+        case EJS_STRING_ROPE:
+            snapshot_add_edge_to_value(snap, SNAPSHOT_EDGE_INTERNAL, snapshot_intern_utf8(snap, "", "first"), STRING_TO_EJSVAL(primstr->data.rope.left));
+            snapshot_add_edge_to_value(snap, SNAPSHOT_EDGE_INTERNAL, snapshot_intern_utf8(snap, "", "second"), STRING_TO_EJSVAL(primstr->data.rope.right));
+            break;
+        case EJS_STRING_DEPENDENT:
+            snapshot_add_edge_to_value(snap, SNAPSHOT_EDGE_INTERNAL, snapshot_intern_utf8(snap, "", "parent"), STRING_TO_EJSVAL(primstr->data.dependent.dep));
+            break;
+        case EJS_STRING_FLAT:
+            break;
+        }
+    }
+    else if ((header & EJS_SCAN_TYPE_CLOSUREENV) != 0) {
+        EJSClosureEnv* env = (EJSClosureEnv*)cell;
+        for (uint32_t i = 0; i < env->length; i ++)
+            snapshot_add_edge_to_value(snap, SNAPSHOT_EDGE_CONTEXT, snapshot_intern_number(snap, i), env->slots[i]);
+    }
+}
+
+static void
+snapshot_root_edges(HeapSnapshot* snap)
+{
+    snap->current_node = SNAPSHOT_ROOT_NODE;
+    snapshot_add_edge(snap, SNAPSHOT_EDGE_ELEMENT, 1, SNAPSHOT_GC_ROOTS_NODE);
+    snapshot_add_edge_to_value(snap, SNAPSHOT_EDGE_SHORTCUT, snapshot_intern_utf8(snap, "", "global"), _ejs_global);
+
+    snap->current_node = SNAPSHOT_GC_ROOTS_NODE;
+    snapshot_add_edge(snap, SNAPSHOT_EDGE_ELEMENT, 1, SNAPSHOT_HANDLES_NODE);
+    snapshot_add_edge(snap, SNAPSHOT_EDGE_ELEMENT, 2, SNAPSHOT_MODULES_NODE);
+    snapshot_add_edge(snap, SNAPSHOT_EDGE_ELEMENT, 3, SNAPSHOT_STACK_NODE);
+
+    uint32_t index = 0;
+    snap->current_node = SNAPSHOT_HANDLES_NODE;
+    for (RootSetEntry *entry = root_set; entry; entry = entry->next) {
+        if (entry->root)
+            snapshot_add_edge_to_value(snap, SNAPSHOT_EDGE_ELEMENT, index++, *entry->root);
+    }
+
+    // module objects aren't allocated from the heap, so they're not nodes of their own
+    snap->current_node = SNAPSHOT_MODULES_NODE;
+    snap->scan_ordinal = 0;
+    for (int i = 0; i < _ejs_num_modules; i ++)
+        OP((EJSObject*)_ejs_modules[i],Scan)((EJSObject*)_ejs_modules[i], snapshot_scan_value);
+
+    index = 0;
+    snap->current_node = SNAPSHOT_STACK_NODE;
+    for (EJSShadowFrame *frame = shadow_stack; frame; frame = frame->prev) {
+        for (int i = 0; i < frame->num_roots; i ++)
+            snapshot_add_edge_to_value(snap, SNAPSHOT_EDGE_ELEMENT, index++, *frame->roots[i]);
+    }
+    GCObjectPtr stack_top = NULL;
+    for (void* p = ((void*)&stack_top) + sizeof(GCObjectPtr); p < (void*)stack_bottom - sizeof(ejsval); p += sizeof(ejsval))
+        snapshot_add_edge_to_value(snap, SNAPSHOT_EDGE_ELEMENT, index++, *(ejsval*)p);
+}
+
+static void
+snapshot_write_node(HeapSnapshot* snap, FILE* fp, uint32_t node, int type, uint32_t name, uint64_t id, size_t size, uint32_t trace_node)
+{
+    fprintf (fp, "%s%d,%u,%llu,%zu,%u,%u\n", node == 0 ? "" : ",", type, name, (unsigned long long)id, size, snap->edge_counts[node], trace_node);
+}
+
+static void
+snapshot_write_cell_node(HeapSnapshot* snap, FILE* fp, uint32_t node)
+{
+    GCObjectPtr cell = snap->cells[node - SNAPSHOT_FIRST_CELL_NODE];
+    GCObjectHeader header = *(GCObjectHeader*)cell;
+    uint32_t cell_idx;
+    PageInfo *page = find_page_and_cell(cell, &cell_idx);
+    int type = SNAPSHOT_NODE_HIDDEN;
+    uint32_t name;
+
+    if ((header & EJS_SCAN_TYPE_OBJECT) != 0) {
+        EJSObject* obj = (EJSObject*)cell;
+        type = SNAPSHOT_NODE_OBJECT;
+        name = snapshot_intern_utf8(snap, "", CLASSNAME(obj));
+        if (obj->ops == &_ejs_Function_specops) {
+            type = SNAPSHOT_NODE_CLOSURE;
+            EJSPropertyDesc desc_storage;
+            EJSPropertyDesc* desc = _ejs_object_lookup_property (obj, _ejs_atom_name, &desc_storage);
+            if (desc && _ejs_property_desc_has_value (desc) && EJSVAL_IS_STRING(desc->value))
+                name = snapshot_intern_primstr(snap, "", EJSVAL_TO_STRING(desc->value));
+        }
+    }
+    else if ((header & EJS_SCAN_TYPE_PRIMSTR) != 0) {
+        EJSPrimString* primstr = (EJSPrimString*)cell;
+        switch (EJS_PRIMSTR_GET_TYPE(primstr)) {
+        case EJS_STRING_ROPE:      type = SNAPSHOT_NODE_CONCATENATED_STRING; break;
+        case EJS_STRING_DEPENDENT: type = SNAPSHOT_NODE_SLICED_STRING; break;
+        case EJS_STRING_FLAT:      type = SNAPSHOT_NODE_STRING; break;
+        }
+        name = snapshot_intern_primstr(snap, "", primstr);
+    }
+    else if ((header & EJS_SCAN_TYPE_CLOSUREENV) != 0) {
+        name = snapshot_intern_utf8(snap, "", "(closure env)");
+    }
+    else {
+        type = SNAPSHOT_NODE_ARRAY;
+        name = snapshot_intern_utf8(snap, "", "(backing store)");
+    }
+
+    // trace node ids are 1 for the root and site + 2 for the allocation sites
+    int site = sampled_cell_lookup(cell);
+    snapshot_write_node(snap, fp, node, type, name, ((uintptr_t)cell >> 2) | 1, page->cell_size, site == -1 ? 0 : site + 2);
+}
+
+static void
+snapshot_write_strings(HeapSnapshot* snap, FILE* fp)
+{
+    for (uint32_t i = 0; i < snap->num_strings; i ++)
+        fprintf (fp, "%s\"%s\"\n", i == 0 ? "" : ",", snap->strings[i]);
+}
+
+static void
+snapshot_write_traces(HeapSnapshot* snap, FILE* fp)
+{
+    // function info 0 is the root, and site i gets function info i + 1
+    fprintf (fp, "\"trace_function_infos\":[0,%u,%u,0,0,0", snapshot_intern_utf8(snap, "", "(root)"), snapshot_intern_utf8(snap, "", ""));
+    for (int i = 0; i < num_alloc_sites; i ++) {
+        uint32_t name = snapshot_intern_utf8(snap, "", alloc_sites[i].name ? alloc_sites[i].name : "(runtime)");
+        fprintf (fp, ",\n%d,%u,%u,0,0,0", i + 1, name, snapshot_intern_utf8(snap, "", ""));
+    }
+    fprintf (fp, "],\n\"trace_tree\":[1,0,0,0,[");
+    for (int i = 0; i < num_alloc_sites; i ++)
+        fprintf (fp, "%s%d,%d,%llu,%llu,[]", i == 0 ? "" : ",", i + 2, i + 1, (unsigned long long)alloc_sites[i].count, (unsigned long long)alloc_sites[i].size);
+    fprintf (fp, "]],\n");
+}
+
+EJSBool
+_ejs_gc_write_heap_snapshot(const char* path)
+{
+    FILE* fp = fopen(path, "w");
+    if (!fp)
+        return EJS_FALSE;
+
+    // collect so only live cells end up in the snapshot, and keep anything we do from here on (like
+    // looking up function names) from starting another collection
+    _ejs_gc_collect();
+    finish_sweeping();
+    EJSBool was_disabled = gc_disabled;
+    gc_disabled = EJS_TRUE;
+
+    HeapSnapshot snap;
+    memset (&snap, 0, sizeof(snap));
+
+    // count the live cells, then go back and fill them in
+    for (int pass = 0; pass < 2; pass ++) {
+        for (int i = 0; i < HEAP_PAGELISTS_COUNT; i ++) {
+            EJS_LIST_FOREACH (&heap_pages[i], PageInfo, page, {
+                GCObjectPtr p = page->page_start;
+                for (int c = 0; c < CELLS_IN_PAGE (page); c ++, p += page->cell_size) {
+                    if (!IS_FREE(page->page_bitmap[c]))
+                        snapshot_add_cell(&snap, p);
+                }
+            });
+        }
+        for (LargeObjectInfo* lobj = los_list; lobj; lobj = lobj->next)
+            snapshot_add_cell(&snap, lobj->page_info.page_start);
+
+        if (pass == 0) {
+            snap.cells = (GCObjectPtr*)malloc(MAX(snap.num_cells, 1) * sizeof(GCObjectPtr));
+            snap.num_cells = 0;
+        }
+    }
+
+    uint32_t num_nodes = SNAPSHOT_FIRST_CELL_NODE + snap.num_cells;
+    snap.node_table_size = 1024;
+    while (snap.node_table_size < num_nodes * 2)
+        snap.node_table_size *= 2;
+    snap.node_table = (uint32_t*)calloc(snap.node_table_size, sizeof(uint32_t));
+    for (uint32_t i = 0; i < snap.num_cells; i ++) {
+        size_t j = SNAPSHOT_NODE_HASH(snap.cells[i]) & (snap.node_table_size - 1);
+        while (snap.node_table[j])
+            j = (j + 1) & (snap.node_table_size - 1);
+        snap.node_table[j] = SNAPSHOT_FIRST_CELL_NODE + i + 1;
+    }
+    snap.edge_counts = (uint32_t*)calloc(num_nodes, sizeof(uint32_t));
+    snap.edge_stamp = (uint32_t*)calloc(num_nodes, sizeof(uint32_t));
+
+    // the strings devtools expects at fixed positions come first
+    snapshot_intern(&snap, "");
+    snapshot_intern(&snap, "(GC roots)");
+
+    // the edges have to be written grouped by the node they come from, in node order
+    snapshot = &snap;
+    snapshot_root_edges(&snap);
+    for (uint32_t node = SNAPSHOT_FIRST_CELL_NODE; node < num_nodes; node ++) {
+        snap.current_node = node;
+        snapshot_cell_edges(&snap, snap.cells[node - SNAPSHOT_FIRST_CELL_NODE]);
+    }
+    snapshot = NULL;
+
+    fprintf (fp, "{\"snapshot\":{\"meta\":{"
+             "\"node_fields\":[\"type\",\"name\",\"id\",\"self_size\",\"edge_count\",\"trace_node_id\"],"
+             "\"node_types\":[[\"hidden\",\"array\",\"string\",\"object\",\"code\",\"closure\",\"regexp\",\"number\",\"native\",\"synthetic\",\"concatenated string\",\"sliced string\",\"symbol\",\"bigint\"],\"string\",\"number\",\"number\",\"number\",\"number\",\"number\"],"
+             "\"edge_fields\":[\"type\",\"name_or_index\",\"to_node\"],"
+             "\"edge_types\":[[\"context\",\"element\",\"property\",\"internal\",\"hidden\",\"shortcut\",\"weak\"],\"string_or_number\",\"node\"],"
+             "\"trace_function_info_fields\":[\"function_id\",\"name\",\"script_name\",\"script_id\",\"line\",\"column\"],"
+             "\"trace_node_fields\":[\"id\",\"function_info_index\",\"count\",\"size\",\"children\"],"
+             "\"sample_fields\":[\"timestamp_us\",\"last_assigned_id\"],"
+             "\"location_fields\":[\"object_index\",\"script_id\",\"line\",\"column\"]},"
+             "\"node_count\":%u,\"edge_count\":%zu,\"trace_function_count\":%d},\n",
+             num_nodes, snap.num_edges / SNAPSHOT_EDGE_FIELDS, num_alloc_sites + 1);
+
+    fprintf (fp, "\"nodes\":[");
+    snapshot_write_node(&snap, fp, SNAPSHOT_ROOT_NODE, SNAPSHOT_NODE_SYNTHETIC, snapshot_intern(&snap, ""), 1, 0, 0);
+    snapshot_write_node(&snap, fp, SNAPSHOT_GC_ROOTS_NODE, SNAPSHOT_NODE_SYNTHETIC, snapshot_intern(&snap, "(GC roots)"), 3, 0, 0);
+    snapshot_write_node(&snap, fp, SNAPSHOT_HANDLES_NODE, SNAPSHOT_NODE_SYNTHETIC, snapshot_intern(&snap, "(Global handles)"), 5, 0, 0);
+    snapshot_write_node(&snap, fp, SNAPSHOT_MODULES_NODE, SNAPSHOT_NODE_SYNTHETIC, snapshot_intern(&snap, "(Modules)"), 7, 0, 0);
+    snapshot_write_node(&snap, fp, SNAPSHOT_STACK_NODE, SNAPSHOT_NODE_SYNTHETIC, snapshot_intern(&snap, "(Stack roots)"), 9, 0, 0);
+    for (uint32_t node = SNAPSHOT_FIRST_CELL_NODE; node < num_nodes; node ++)
+        snapshot_write_cell_node(&snap, fp, node);
+
+    fprintf (fp, "],\n\"edges\":[");
+    for (size_t i = 0; i < snap.num_edges; i += SNAPSHOT_EDGE_FIELDS)
+        fprintf (fp, "%s%u,%u,%u\n", i == 0 ? "" : ",", snap.edges[i], snap.edges[i+1], snap.edges[i+2]);
+    fprintf (fp, "],\n");
+
+    snapshot_write_traces(&snap, fp);
+    fprintf (fp, "\"samples\":[],\n\"locations\":[],\n\"strings\":[");
+    snapshot_write_strings(&snap, fp);
+    fprintf (fp, "]}\n");
+
+    EJSBool rv = !ferror(fp);
+    if (fclose(fp) != 0)
+        rv = EJS_FALSE;
+
+    for (uint32_t i = 0; i < snap.num_strings; i ++)
+        free (snap.strings[i]);
+    free (snap.strings);
+    free (snap.string_table);
+    free (snap.scratch.data);
+    free (snap.edge_stamp);
+    free (snap.edge_counts);
+    free (snap.edges);
+    free (snap.node_table);
+    free (snap.cells);
+
+    gc_disabled = was_disabled;
+    return rv;
+}
+
 /////////
 ejsval _ejs_GC;
 
@@ -1436,10 +3625,12 @@ _ejs_GC_dumpAllocationStats (ejsval env, ejsval _this, uint32_t argc, ejsval *ar
     _ejs_log ("  objects: %d\n", num_object_allocs);
     _ejs_log ("  closureenv: %d\n", num_closureenv_allocs);
     _ejs_log ("  primstr: %d\n", num_primstr_allocs);
+    _ejs_log ("  store: %d\n", num_store_allocs);
 
     num_object_allocs = 0;
     num_closureenv_allocs = 0;
     num_primstr_allocs = 0;
+    num_store_allocs = 0;
 
     if (tag) free (tag);
 
@@ -1449,6 +3640,8 @@ _ejs_GC_dumpAllocationStats (ejsval env, ejsval _this, uint32_t argc, ejsval *ar
 static ejsval
 _ejs_GC_dumpLiveStrings (ejsval env, ejsval _this, uint32_t argc, ejsval *args)
 {
+    finish_sweeping();
+
     _ejs_log ("strings:\n");
     for (int i = 0; i < HEAP_PAGELISTS_COUNT; i ++) {
         EJS_LIST_FOREACH (&heap_pages[i], PageInfo, page, {
@@ -1496,6 +3689,146 @@ _ejs_GC_dumpLiveStrings (ejsval env, ejsval _this, uint32_t argc, ejsval *args)
     return _ejs_undefined;
 }
 
+// GC.writeHeapSnapshot([path]).  returns the path written, which defaults to
+// ejs-<pid>-<time>.heapsnapshot in the current directory.
+static ejsval
+_ejs_GC_writeHeapSnapshot (ejsval env, ejsval _this, uint32_t argc, ejsval *args)
+{
+    char default_path[64];
+    char* path;
+
+    if (argc > 0 && !EJSVAL_IS_UNDEFINED(args[0])) {
+        path = _ejs_string_to_utf8(EJSVAL_TO_STRING(ToString(args[0])));
+    }
+    else {
+        snprintf (default_path, sizeof(default_path), "ejs-%d-%ld.heapsnapshot", (int)getpid(), (long)time(NULL));
+        path = strdup(default_path);
+    }
+
+    EJSBool written = _ejs_gc_write_heap_snapshot(path);
+    ejsval rv = _ejs_string_new_utf8(path);
+    free (path);
+    if (!written)
+        _ejs_throw_nativeerror (EJS_ERROR, _ejs_string_concat (_ejs_string_new_utf8("couldn't write heap snapshot to "), rv));
+    return rv;
+}
+
+// GC.startAllocationSampling([interval]) samples an allocation every @interval bytes (32k by
+// default), resetting the counts from any earlier sampling.
+static ejsval
+_ejs_GC_startAllocationSampling (ejsval env, ejsval _this, uint32_t argc, ejsval *args)
+{
+    double interval = DEFAULT_ALLOC_SAMPLE_INTERVAL;
+    if (argc > 0 && !EJSVAL_IS_UNDEFINED(args[0]))
+        interval = ToDouble(args[0]);
+    if (!(interval >= 1))
+        _ejs_throw_nativeerror_utf8 (EJS_RANGE_ERROR, "sampling interval must be at least 1 byte");
+
+    num_alloc_sites = 0;
+    free (sampled_cells);
+    sampled_cells = NULL;
+    sampled_cells_size = num_sampled_cells = 0;
+    _ejs_gc_set_allocation_sampling((size_t)interval);
+    return _ejs_undefined;
+}
+
+static ejsval
+_ejs_GC_stopAllocationSampling (ejsval env, ejsval _this, uint32_t argc, ejsval *args)
+{
+    _ejs_gc_set_allocation_sampling(0);
+    return _ejs_undefined;
+}
+
+static ejsval
+pause_to_object (GCPause* pause)
+{
+    ejsval rv = _ejs_object_new (_ejs_Object_prototype, &_ejs_Object_specops);
+    _ejs_object_setprop_utf8 (rv, "type", _ejs_string_new_utf8(pause_kind_names[pause->kind]));
+    _ejs_object_setprop_utf8 (rv, "startMs", NUMBER_TO_EJSVAL((pause->start_usec - gc_start_usec) / 1000.0));
+    _ejs_object_setprop_utf8 (rv, "pauseMs", NUMBER_TO_EJSVAL(pause->pause_usec / 1000.0));
+    _ejs_object_setprop_utf8 (rv, "markMs", NUMBER_TO_EJSVAL(pause->mark_usec / 1000.0));
+    _ejs_object_setprop_utf8 (rv, "sweepMs", NUMBER_TO_EJSVAL(pause->sweep_usec / 1000.0));
+    _ejs_object_setprop_utf8 (rv, "heapBefore", NUMBER_TO_EJSVAL(pause->heap_before));
+    _ejs_object_setprop_utf8 (rv, "heapAfter", NUMBER_TO_EJSVAL(pause->heap_after));
+    _ejs_object_setprop_utf8 (rv, "reclaimed", NUMBER_TO_EJSVAL(pause->heap_before - pause->heap_after));
+    _ejs_object_setprop_utf8 (rv, "roots", NUMBER_TO_EJSVAL(pause->roots));
+    _ejs_object_setprop_utf8 (rv, "stackRoots", NUMBER_TO_EJSVAL(pause->stack_roots));
+    return rv;
+}
+
+// GC.stats() returns the pause counts and times (in milliseconds) since startup, a histogram of
+// pause times ([{ le, count }], the last bucket's le being Infinity), and what the most recent
+// full or minor collection did.
+static ejsval
+_ejs_GC_stats (ejsval env, ejsval _this, uint32_t argc, ejsval *args)
+{
+    ejsval rv = _ejs_object_new (_ejs_Object_prototype, &_ejs_Object_specops);
+    _ejs_object_setprop_utf8 (rv, "fullCollections", NUMBER_TO_EJSVAL(pause_counts[GC_PAUSE_FULL]));
+    _ejs_object_setprop_utf8 (rv, "minorCollections", NUMBER_TO_EJSVAL(pause_counts[GC_PAUSE_MINOR]));
+    _ejs_object_setprop_utf8 (rv, "markSteps", NUMBER_TO_EJSVAL(pause_counts[GC_PAUSE_MARK_STEP]));
+    _ejs_object_setprop_utf8 (rv, "totalPauseMs", NUMBER_TO_EJSVAL(total_pause_usec / 1000.0));
+    _ejs_object_setprop_utf8 (rv, "maxPauseMs", NUMBER_TO_EJSVAL(max_pause_usec / 1000.0));
+    _ejs_object_setprop_utf8 (rv, "bytesReclaimed", NUMBER_TO_EJSVAL(total_bytes_reclaimed));
+    _ejs_object_setprop_utf8 (rv, "heapSize", NUMBER_TO_EJSVAL(heap_bytes_in_use));
+
+    ejsval histogram = _ejs_array_new (0, EJS_FALSE);
+    _ejs_object_setprop_utf8 (rv, "pauseHistogram", histogram);
+    for (size_t i = 0; i < PAUSE_HISTOGRAM_BUCKETS; i ++) {
+        ejsval bucket = _ejs_object_new (_ejs_Object_prototype, &_ejs_Object_specops);
+        _ejs_object_setprop_utf8 (bucket, "le", NUMBER_TO_EJSVAL(i < PAUSE_HISTOGRAM_BUCKETS - 1 ? pause_histogram_bounds[i] / 1000.0 : INFINITY));
+        _ejs_object_setprop_utf8 (bucket, "count", NUMBER_TO_EJSVAL(pause_histogram[i]));
+        _ejs_array_push_dense (histogram, 1, &bucket);
+    }
+
+    _ejs_object_setprop_utf8 (rv, "lastCollection", have_last_collection ? pause_to_object (&last_collection) : _ejs_null);
+    return rv;
+}
+
+// GC.configure({ heapGrowthFactor, minHeapGrowth, maxHeapGrowth, eventFd }).  any of the properties
+// can be left out, and an eventFd of -1 stops writing gc events.  returns the resulting configuration.
+static ejsval
+_ejs_GC_configure (ejsval env, ejsval _this, uint32_t argc, ejsval *args)
+{
+    double factor = heap_growth_factor;
+    double min_growth = min_heap_growth;
+    double max_growth = max_heap_growth;
+    double fd = event_fd;
+
+    if (argc > 0 && EJSVAL_IS_OBJECT(args[0])) {
+        ejsval options = args[0];
+        ejsval v;
+
+        v = _ejs_object_getprop (options, _ejs_atom_heapGrowthFactor);
+        if (!EJSVAL_IS_UNDEFINED(v)) factor = ToDouble(v);
+        v = _ejs_object_getprop (options, _ejs_atom_minHeapGrowth);
+        if (!EJSVAL_IS_UNDEFINED(v)) min_growth = ToDouble(v);
+        v = _ejs_object_getprop (options, _ejs_atom_maxHeapGrowth);
+        if (!EJSVAL_IS_UNDEFINED(v)) max_growth = ToDouble(v);
+        v = _ejs_object_getprop (options, _ejs_atom_eventFd);
+        if (!EJSVAL_IS_UNDEFINED(v)) fd = ToDouble(v);
+
+        if (!(factor > 1))
+            _ejs_throw_nativeerror_utf8 (EJS_RANGE_ERROR, "heapGrowthFactor must be greater than 1");
+        if (!(min_growth > 0 && min_growth <= max_growth))
+            _ejs_throw_nativeerror_utf8 (EJS_RANGE_ERROR, "minHeapGrowth must be positive and no larger than maxHeapGrowth");
+        if (!(fd >= -1 && fd == (int)fd))
+            _ejs_throw_nativeerror_utf8 (EJS_RANGE_ERROR, "eventFd must be a file descriptor, or -1");
+
+        heap_growth_factor = factor;
+        min_heap_growth = (size_t)min_growth;
+        max_heap_growth = (size_t)max_growth;
+        event_fd = (int)fd;
+        update_gc_trigger();
+    }
+
+    ejsval rv = _ejs_object_new (_ejs_Object_prototype, &_ejs_Object_specops);
+    _ejs_object_setprop (rv, _ejs_atom_heapGrowthFactor, NUMBER_TO_EJSVAL(heap_growth_factor));
+    _ejs_object_setprop (rv, _ejs_atom_minHeapGrowth, NUMBER_TO_EJSVAL(min_heap_growth));
+    _ejs_object_setprop (rv, _ejs_atom_maxHeapGrowth, NUMBER_TO_EJSVAL(max_heap_growth));
+    _ejs_object_setprop (rv, _ejs_atom_eventFd, NUMBER_TO_EJSVAL(event_fd));
+    return rv;
+}
+
 void
 _ejs_GC_init(ejsval ejs_obj)
 {
@@ -1505,8 +3838,13 @@ _ejs_GC_init(ejsval ejs_obj)
 #define OBJ_METHOD(x) EJS_INSTALL_ATOM_FUNCTION(_ejs_GC, x, _ejs_GC_##x)
 
     OBJ_METHOD(collect);
+    OBJ_METHOD(configure);
     OBJ_METHOD(dumpAllocationStats);
     OBJ_METHOD(dumpLiveStrings);
+    OBJ_METHOD(stats);
+    OBJ_METHOD(writeHeapSnapshot);
+    OBJ_METHOD(startAllocationSampling);
+    OBJ_METHOD(stopAllocationSampling);
 
 #undef OBJ_METHOD
 }
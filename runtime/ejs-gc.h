@@ -14,7 +14,8 @@ EJS_BEGIN_DECLS
 typedef enum {
     EJS_SCAN_TYPE_PRIMSTR    = 1 << 0,
     EJS_SCAN_TYPE_OBJECT     = 1 << 1,
-    EJS_SCAN_TYPE_CLOSUREENV = 1 << 2
+    EJS_SCAN_TYPE_CLOSUREENV = 1 << 2,
+    EJS_SCAN_TYPE_STORE      = 1 << 3
 } EJSScanType;
 
 #define EJS_GC_INTERNAL_FLAGS_MASK 0x0000ffff
@@ -29,6 +30,15 @@ extern void _ejs_gc_allocate_oom_exceptions();
 extern void _ejs_gc_shutdown();
 extern void _ejs_gc_collect();
 
+// sweep up to @max_pages of the pages left unswept by the last collection.  returns EJS_TRUE if there
+// are still pages waiting to be swept.  the allocator sweeps on demand, so this is only needed to get
+// sweeping done while the program is otherwise idle.
+extern EJSBool _ejs_gc_sweep_some(int max_pages);
+
+// mark up to @max_objects objects if an incremental collection is in progress, finishing the
+// collection if that empties the work list.  returns EJS_TRUE if there's still marking to do.
+extern EJSBool _ejs_gc_mark_some(int max_objects);
+
 extern GCObjectPtr _ejs_gc_alloc(size_t size, EJSScanType scan_type);
 
 #define _ejs_gc_new(T) (T*)_ejs_gc_alloc(sizeof(T), EJS_SCAN_TYPE_OBJECT)
@@ -36,9 +46,77 @@ extern GCObjectPtr _ejs_gc_alloc(size_t size, EJSScanType scan_type);
 #define _ejs_gc_new_primstr(sz) (EJSPrimString*)_ejs_gc_alloc(sz, EJS_SCAN_TYPE_PRIMSTR)
 #define _ejs_gc_new_closureenv(sz) (EJSClosureEnv*)_ejs_gc_alloc(sz, EJS_SCAN_TYPE_CLOSUREENV)
 
+// raw memory owned by a single gc object, like dense array elements or property map storage.  the
+// collector never looks inside a store: the owner's Scan op marks it with _ejs_gc_mark_store (and
+// scans whatever ejsvals it holds), and it's reclaimed without any finalization once the owner
+// stops pointing at it.  stores come back zeroed.  the stack is only scanned for ejsvals, so don't
+// allocate again while a new store is referenced only by a C local, and call _ejs_gc_remember(owner)
+// after pointing the owner at it.
+extern void* _ejs_gc_new_store(size_t size);
+extern void _ejs_gc_mark_store(void* store);
+
+// bumped by every collection.  anything outside the heap holding on to gc objects it doesn't root
+// (like property caches) has to forget them when this changes.
+extern uint32_t _ejs_gc_epoch;
+
+// only meaningful between marking and sweeping, for clearing weak references: EJS_TRUE if @ptr is
+// in the gc heap, wasn't marked, and is about to be swept.
+extern EJSBool _ejs_gc_is_collectable(GCObjectPtr ptr);
+
+// call before handing out an object found through a weak reference.  an incremental mark in progress
+// might not have reached it yet, and nothing else will tell the marker it's live again.
+extern void _ejs_gc_shade(GCObjectPtr ptr);
+
 extern void _ejs_gc_add_root(ejsval* val);
 extern void _ejs_gc_remove_root(ejsval* root);
 
+// precise roots for compiled code.  when built with --shadow-stack, each generated function fills in
+// one of these on its native stack (pointing at the allocas holding its locals and every temporary
+// that could be live across a call), pushes it on entry and pops it before returning.  frames an
+// exception unwinds past never get popped, so anything that catches one has to put back the frame
+// that was current when its try began, using _ejs_gc_get_shadow_frame/_ejs_gc_restore_shadow_frame.
+// the conservative stack scan skips the native stack between a frame's stack_low and frame_address,
+// and only covers the C runtime frames (and registers) in between.
+typedef struct _EJSShadowFrame {
+    struct _EJSShadowFrame *prev;
+    int32_t num_roots;
+    ejsval **roots;
+    const char *name;    // the function's name and location, for allocation sampling
+    void *frame_address; // the function's frame pointer, filled in by the function
+    void *stack_low;     // its stack pointer, filled in by _ejs_gc_push_shadow_frame
+} EJSShadowFrame;
+
+extern void _ejs_gc_push_shadow_frame(EJSShadowFrame* frame);
+extern void _ejs_gc_pop_shadow_frame(EJSShadowFrame* frame);
+extern EJSShadowFrame* _ejs_gc_get_shadow_frame();
+extern void _ejs_gc_restore_shadow_frame(EJSShadowFrame* frame);
+
+// collect, then write everything still live to @path in the .heapsnapshot format chrome's devtools
+// load.  returns EJS_FALSE if @path couldn't be written.
+extern EJSBool _ejs_gc_write_heap_snapshot(const char* path);
+
+// sample roughly one allocation every @interval bytes (0 turns sampling off.)  samples are counted
+// against the innermost compiled function on the shadow stack, and appear in heap snapshots as
+// allocation traces, so only binaries built with --shadow-stack can say which function allocated.
+extern void _ejs_gc_set_allocation_sampling(size_t interval);
+
+// write barrier for the generational collector and incremental marker.  call _ejs_gc_write_barrier after storing an ejsval
+// into a gc-allocated object (or memory owned by one, like its property map or dense array elements),
+// and _ejs_gc_remember if you've stored an unknown number of values (e.g. with memmove.)
+extern EJSBool _ejs_gc_barrier_enabled;
+extern void _ejs_gc_write_barrier_slow(GCObjectPtr owner, ejsval val);
+extern void _ejs_gc_remember_slow(GCObjectPtr owner);
+
+#define _ejs_gc_write_barrier(owner, val) EJS_MACRO_START               \
+    if (EJS_UNLIKELY(_ejs_gc_barrier_enabled))                          \
+        _ejs_gc_write_barrier_slow((GCObjectPtr)(owner), (val));        \
+    EJS_MACRO_END
+
+#define _ejs_gc_remember(owner) EJS_MACRO_START                         \
+    if (EJS_UNLIKELY(_ejs_gc_barrier_enabled))                          \
+        _ejs_gc_remember_slow((GCObjectPtr)(owner));                    \
+    EJS_MACRO_END
+
 #define EJS_GC_MARK_THREAD_STACK_BOTTOM do {        \
         GCObjectPtr btm;                            \
         _ejs_gc_mark_thread_stack_bottom (&btm);    \
@@ -36,6 +36,7 @@
 #endif
 #include "ejs-map.h"
 #include "ejs-set.h"
+#include "ejs-shape.h"
 #if IOS
 #include "ejs-webgl.h"
 #endif
@@ -105,6 +106,7 @@ _ejs_init_classes()
     _ejs_Class_initialize (&_ejs_Promise_specops, &_ejs_Object_specops);
     _ejs_Class_initialize (&_ejs_Set_specops, &_ejs_Object_specops);
     _ejs_Class_initialize (&_ejs_SetIterator_specops, &_ejs_Object_specops);
+    _ejs_Class_initialize (&_ejs_Shape_specops, &_ejs_Object_specops);
     _ejs_Class_initialize (&_ejs_Number_specops, &_ejs_Object_specops);
     _ejs_Class_initialize (&_ejs_RegExp_specops, &_ejs_Object_specops);
     _ejs_Class_initialize (&_ejs_String_specops, &_ejs_Object_specops);
@@ -150,6 +152,7 @@ _ejs_init(int argc, char** argv)
     _ejs_init_static_strings();
 
     _ejs_gc_init();
+    _ejs_shape_init();
     _ejs_exception_init();
 
     // initialization or ECMA262 builtins
@@ -6,6 +6,7 @@
 define i32 @_ejs_invoke_closure_catch (%EjsValueType* nocapture %retval, %EjsValueType %closure, %EjsValueType %_this, i32 %argc, %EjsValueType* nocapture readnone %args) {
 entry:
   %rv_alloc = alloca i32
+  %shadow_frame = call i8* @_ejs_gc_get_shadow_frame()
 
   %ref = getelementptr inbounds %EjsValueType* %retval, i64 0, i32 0
 
@@ -23,6 +24,7 @@ exception:
   %caught_result = landingpad %0 personality i8* bitcast (i32 (i32, i32, i64, i8*, i8*)* @__ejs_personality_v0 to i8*)
           cleanup
           catch i8* bitcast (%EjsExceptionTypeInfoType** @EJS_EHTYPE_ejsvalue to i8*)
+  call void @_ejs_gc_restore_shadow_frame(i8* %shadow_frame)
   %exception4 = extractvalue %0 %caught_result, 0
   %begincatch = call i64 @_ejs_begin_catch(i8* %exception4)
 
@@ -44,3 +46,6 @@ declare i32 @__ejs_personality_v0(i32, i32, i64, i8*, i8*)
 
 declare i64 @_ejs_begin_catch(i8*)
 declare void @_ejs_end_catch()
+
+declare i8* @_ejs_gc_get_shadow_frame()
+declare void @_ejs_gc_restore_shadow_frame(i8*)
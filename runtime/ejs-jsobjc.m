@@ -579,16 +579,17 @@
 	self = [super init];
 
     EJSObject* _obj = [obj jsObject];
-    EJSPropertyMap *map = _obj->map;
-    _count = map->inuse;
+    _count = _ejs_object_num_properties (_obj);
     if (_count == 0) {
         _names = NULL;
     }
     else {
         _names = (CKString**)malloc(_count * sizeof(CKString*));
         uint32_t i = 0;
-        for (_EJSPropertyMapEntry* s = map->head_insert; s; s = s->next_insert) {
-            ejsval name = s->name;
+        EJSOwnPropertyIter iter;
+        _ejs_own_property_iter_init (&iter, _obj);
+        while (_ejs_own_property_iter_next (&iter)) {
+            ejsval name = iter.name;
             char* utf8 = ucs2_to_utf8(EJSVAL_TO_FLAT_STRING(name));
 
             _names[i++] = [[CKString alloc] initWithUTF8CString:utf8];
@@ -94,7 +94,7 @@ _ejs_JSON_parse (ejsval env, ejsval _this, uint32_t argc, ejsval *args)
 
     /* 2. Parse JText using the grammars in 15.12.1. Throw a SyntaxError exception if JText did not conform to the 
        JSON grammar for the goal symbol JSONText.  */
-    char *flattened_jtext =  ucs2_to_utf8(EJSVAL_TO_FLAT_STRING(jtext));
+    char *flattened_jtext =  _ejs_string_to_utf8(EJSVAL_TO_STRING(jtext));
 
     /* 3. Let unfiltered be the result of parsing and evaluating JText as if it was the source text of an ECMAScript 
        Program but using JSONString in place of StringLiteral. Note that since JText conforms to the JSON 
@@ -272,11 +272,13 @@ JO(StringifyState *state, ejsval value)
               Object.keys standard built-in function. */
         EJSObject* value_obj = EJSVAL_TO_OBJECT(value);
         K = _ejs_array_new (0, EJS_FALSE);
-        for (_EJSPropertyMapEntry *s = value_obj->map->head_insert; s; s = s->next_insert) {
-            if (!_ejs_property_desc_is_enumerable(s->desc))
+        EJSOwnPropertyIter iter;
+        _ejs_own_property_iter_init (&iter, value_obj);
+        while (_ejs_own_property_iter_next (&iter)) {
+            if (!_ejs_property_desc_is_enumerable(iter.desc))
                 continue;
 
-            ejsval propname = s->name;
+            ejsval propname = iter.name;
             _ejs_array_push_dense(K, 1, &propname);
         }
     }
@@ -368,7 +370,7 @@ Quote(StringifyState *state, ejsval value)
 {
     int len = EJSVAL_TO_STRLEN(value);
     jschar *product = malloc((len * 4 + 2) * sizeof(jschar));
-    EJSPrimString* prim_value = _ejs_primstring_flatten(EJSVAL_TO_STRING(value)); // this is pretty terrible.. we need a way to simply iterate over characters in a string
+    EJSPrimString* prim_value = _ejs_primstring_flatten_any(EJSVAL_TO_STRING(value)); // this is pretty terrible.. we need a way to simply iterate over characters in a string
 
     int pi = 0;
     /* 1. Let product be the double quote character. */
@@ -376,7 +378,7 @@ Quote(StringifyState *state, ejsval value)
 
     /* 2. For each character C in value */
     for (int vi = 0; vi < len; vi++) {
-        jschar C = prim_value->data.flat[vi];
+        jschar C = EJS_PRIMSTR_FLAT_CHAR_AT(prim_value, vi);
         /*    a. If C is the double quote character or the backslash character */
         if (C == '\"' || C == '\\') {
             /*       i. Let product be the concatenation of product and the backslash character. */
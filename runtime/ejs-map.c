@@ -323,6 +323,7 @@ _ejs_map_set (ejsval map, ejsval key, ejsval value)
         if (same (p->key, key)) {
             //       i. Set p.[[value]] to value.
             p->value = value;
+            _ejs_gc_write_barrier(_map, value);
             //       ii. Return M.
             return map;
         }
@@ -331,6 +332,8 @@ _ejs_map_set (ejsval map, ejsval key, ejsval value)
     p = calloc (1, sizeof (EJSKeyValueEntry));
     p->key = key;
     p->value = value;
+    _ejs_gc_write_barrier(_map, key);
+    _ejs_gc_write_barrier(_map, value);
 
     // 10. Append p as the last element of entries.
     if (!_map->head_insert)
@@ -1109,15 +1109,17 @@ register_members (Class cls, CKObject* obj, NSMutableDictionary* method_map)
 	CKObject* ctor = NULL;
     EJSObject* _obj = [obj jsObject];
 
-    for (_EJSPropertyMapEntry* s = _obj->map->head_insert; s; s = s->next_insert) {
-        if (_ejs_property_desc_has_getter(s->desc) || 
-            _ejs_property_desc_has_setter(s->desc)) {
-			if (_ejs_property_desc_has_getter(s->desc)) {
-
-                char *utf8 = ucs2_to_utf8(EJSVAL_TO_FLAT_STRING(s->name));
+    EJSOwnPropertyIter iter;
+    _ejs_own_property_iter_init (&iter, _obj);
+    while (_ejs_own_property_iter_next (&iter)) {
+        if (_ejs_property_desc_has_getter(iter.desc) || 
+            _ejs_property_desc_has_setter(iter.desc)) {
+			if (_ejs_property_desc_has_getter(iter.desc)) {
+
+                char *utf8 = ucs2_to_utf8(EJSVAL_TO_FLAT_STRING(iter.name));
                 CKString* name = [CKString stringWithUTF8CString:utf8];
 
-                CKObject *getter = [CKObject objectWithJSObject:EJSVAL_TO_OBJECT(s->desc->getter)];
+                CKObject *getter = [CKObject objectWithJSObject:EJSVAL_TO_OBJECT(iter.desc->getter)];
                 NSLog (@"there was a getter for %@", [name nsString]);
 				CKValue* ck_ivar = [getter valueForPropertyNS:@"_ck_ivar"];
 
@@ -1131,7 +1133,7 @@ register_members (Class cls, CKObject* obj, NSMutableDictionary* method_map)
 			}
 		}
 		else {
-            char *utf8 = ucs2_to_utf8(EJSVAL_TO_FLAT_STRING(s->name));
+            char *utf8 = ucs2_to_utf8(EJSVAL_TO_FLAT_STRING(iter.name));
             CKString* name = [CKString stringWithUTF8CString:utf8];
             free (utf8);
             NSString* name_nsstr = [name nsString];
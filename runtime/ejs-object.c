@@ -12,6 +12,7 @@
 #include "ejs-value.h"
 #include "ejs-ops.h"
 #include "ejs-object.h"
+#include "ejs-shape.h"
 #include "ejs-number.h"
 #include "ejs-arguments.h"
 #include "ejs-boolean.h"
@@ -175,7 +176,7 @@ DefinePropertyOrThrow (ejsval O, ejsval P, EJSPropertyDesc* desc, ejsval *exc)
     return success;
 }
 
-static uint32_t
+uint32_t
 PropertyKeyHash (ejsval argument)
 {
     EJS_ASSERT(EJSVAL_IS_STRING(argument) || EJSVAL_IS_SYMBOL(argument));
@@ -373,202 +374,428 @@ ToPropertyDescriptor(ejsval Obj, EJSPropertyDesc *desc)
     // 12. Return desc. 
 }
 
-EJSPropertyDesc*
-_ejs_propertydesc_new ()
-{
-    return (EJSPropertyDesc*)calloc (sizeof(EJSPropertyDesc), 1);
-}
+// shared by every object that hasn't had a property added yet, so creating an object doesn't have to
+// allocate anything else.  it's never written to: inserting into it gives the object its own map.
+EJSPropertyMap _ejs_empty_propertymap;
+
+#define PROPERTYMAP_MIN_CAPACITY 8
+// entries (live or removed) a map of @capacity can hold before it's rebuilt.  every one of them
+// has a place in the insertion order, so this is also the size of the order array.
+#define PROPERTYMAP_LIMIT(capacity) ((capacity) - (capacity) / 4)
+#define PROPERTYMAP_ORDER(map) ((uint32_t*)&(map)->entries[(map)->capacity])
+// an entry of the insertion order whose property was removed
+#define PROPERTYMAP_HOLE UINT32_MAX
+
+#define ENTRY_IS_FREE(e) ((e)->name.asBits == 0)
+#define ENTRY_IS_REMOVED(e) EJSVAL_IS_UNDEFINED((e)->name)
 
 void
-_ejs_propertydesc_free (EJSPropertyDesc* desc)
+_ejs_propertymap_foreach_value (EJSPropertyMap* map, EJSValueFunc foreach_func)
 {
-    free (desc);
+    uint32_t* order = PROPERTYMAP_ORDER(map);
+    for (uint32_t i = 0; i < map->num_order; i ++) {
+        if (order[i] == PROPERTYMAP_HOLE)
+            continue;
+        _EJSPropertyMapEntry* s = &map->entries[order[i]];
+        if (_ejs_property_desc_has_value (&s->desc))
+            foreach_func(s->desc.value);
+    }
 }
 
-static int primes[] = {
-    5, 17, 31, 67, 131, 257, 521, 1031, 2053, 4099
-};
-static int nprimes = sizeof(primes) / sizeof(primes[0]);
-
 void
-_ejs_propertymap_init (EJSPropertyMap *map)
+_ejs_propertymap_foreach_property (EJSPropertyMap* map, EJSPropertyDescFunc foreach_func, void* data)
 {
-    //_ejs_log ("%p: init\n", map);
-    map->head_insert = map->tail_insert = NULL;
-    map->buckets = NULL;
-    map->nbuckets = 0;
-    map->inuse = 0;
+    uint32_t* order = PROPERTYMAP_ORDER(map);
+    for (uint32_t i = 0; i < map->num_order; i ++) {
+        if (order[i] == PROPERTYMAP_HOLE)
+            continue;
+        _EJSPropertyMapEntry* s = &map->entries[order[i]];
+        foreach_func (s->name, &s->desc, data);
+    }
 }
 
 void
-_ejs_propertymap_free (EJSPropertyMap *map)
+_ejs_propertymap_scan (EJSPropertyMap* map, EJSValueFunc scan_func)
 {
-    //_ejs_log ("%p: free\n", map);
-    _EJSPropertyMapEntry* s = map->head_insert;
-    while (s) {
-        _EJSPropertyMapEntry* next = s->next_insert;
-        free (s->desc);
-        free (s);
-        s = next;
+    if (map == &_ejs_empty_propertymap)
+        return;
+
+    _ejs_gc_mark_store (map);
+    uint32_t* order = PROPERTYMAP_ORDER(map);
+    for (uint32_t i = 0; i < map->num_order; i ++) {
+        if (order[i] == PROPERTYMAP_HOLE)
+            continue;
+        _EJSPropertyMapEntry* s = &map->entries[order[i]];
+
+        scan_func (s->name);
+        if (_ejs_property_desc_has_value (&s->desc))
+            scan_func (s->desc.value);
+        if (_ejs_property_desc_has_getter (&s->desc))
+            scan_func (s->desc.getter);
+        if (_ejs_property_desc_has_setter (&s->desc))
+            scan_func (s->desc.setter);
     }
-    free (map->buckets);
-    free (map);
 }
 
-void
-_ejs_propertymap_foreach_value (EJSPropertyMap* map, EJSValueFunc foreach_func)
+// the entry for @name, or NULL
+static _EJSPropertyMapEntry*
+propertymap_find (EJSPropertyMap* map, ejsval name, uint32_t hash)
 {
-    for (_EJSPropertyMapEntry *s = map->head_insert; s; s = s->next_insert) {
-        if (_ejs_property_desc_has_value (s->desc))
-            foreach_func(s->desc->value);
+    uint32_t mask = map->capacity - 1;
+    for (uint32_t i = hash & mask; ; i = (i + 1) & mask) {
+        _EJSPropertyMapEntry* s = &map->entries[i];
+        if (EJSVAL_EQ(s->name, name))
+            return s;
+        if (ENTRY_IS_FREE(s))
+            return NULL;
     }
 }
 
-void
-_ejs_propertymap_foreach_property (EJSPropertyMap* map, EJSPropertyDescFunc foreach_func, void* data)
+// fills in the first free entry in @name's probe sequence, and puts it at the end of the insertion
+// order.  the map has to have room.
+static _EJSPropertyMapEntry*
+propertymap_add (EJSPropertyMap* map, ejsval name, uint32_t hash, EJSPropertyDesc* desc)
 {
-    for (_EJSPropertyMapEntry *s = map->head_insert; s; s = s->next_insert) {
-        foreach_func (s->name, s->desc, data);
+    uint32_t mask = map->capacity - 1;
+    uint32_t i = hash & mask;
+    while (!ENTRY_IS_FREE(&map->entries[i]))
+        i = (i + 1) & mask;
+
+    _EJSPropertyMapEntry* s = &map->entries[i];
+    s->hash = hash;
+    s->order = map->num_order;
+    s->name = name;
+    s->desc = *desc;
+    PROPERTYMAP_ORDER(map)[map->num_order++] = i;
+    map->inuse ++;
+    return s;
+}
+
+// moves @obj's properties into a new map of @capacity entries, dropping removed entries and the
+// holes they left in the insertion order
+static void
+propertymap_rebuild (EJSObject* obj, uint32_t capacity)
+{
+    size_t size = sizeof(EJSPropertyMap) + capacity * sizeof(_EJSPropertyMapEntry) + PROPERTYMAP_LIMIT(capacity) * sizeof(uint32_t);
+    EJSPropertyMap* map = (EJSPropertyMap*)_ejs_gc_new_store (size);
+    map->capacity = capacity;
+
+    // nothing below allocates, so the new map doesn't need to be reachable until we're done
+    EJSPropertyMap* old = obj->map;
+    uint32_t* old_order = PROPERTYMAP_ORDER(old);
+    for (uint32_t i = 0; i < old->num_order; i ++) {
+        if (old_order[i] == PROPERTYMAP_HOLE)
+            continue;
+        _EJSPropertyMapEntry* s = &old->entries[old_order[i]];
+        propertymap_add (map, s->name, s->hash, &s->desc);
     }
+
+    obj->map = map;
+    _ejs_gc_remember (obj);
 }
 
 void
 _ejs_propertymap_remove (EJSPropertyMap *map, ejsval name)
 {
-    //_ejs_log ("%p: remove (%s)\n", map, ucs2_to_utf8(EJSVAL_TO_FLAT_STRING(name)));
-    if (map->inuse == 0) {
-        //_ejs_log ("  map empty, returning early\n");
+    if (map->inuse == 0)
         return;
-    }
 
-    uint32_t hashcode = PropertyKeyHash(name);
-    int bucket = (int)(hashcode % map->nbuckets);
+    _EJSPropertyMapEntry* s = propertymap_find (map, name, PropertyKeyHash(name));
+    if (!s)
+        return;
 
-    _EJSPropertyMapEntry* prev = NULL;
-    _EJSPropertyMapEntry* s = map->buckets[bucket];
-    while (s) {
-        if (s->hash == hashcode && EJSVAL_TO_BOOLEAN(_ejs_op_strict_eq(s->name, name))) {
-            //_ejs_log ("  found entry in bucket (hashcode %d, bucket %d)\n", hashcode, bucket);
-            if (prev)
-                prev->next_bucket = s->next_bucket;
-            else
-                map->buckets[bucket] = s->next_bucket;
+    // the entry stays in name's probe sequence, so lookups of the names after it still find them.
+    // it's only reused once the map is rebuilt.
+    PROPERTYMAP_ORDER(map)[s->order] = PROPERTYMAP_HOLE;
+    s->name = _ejs_undefined;
+    memset (&s->desc, 0, sizeof(s->desc));
+    map->inuse --;
+}
 
-            if (map->head_insert == s) {
-                map->head_insert = s->next_insert;
-                if (map->tail_insert == s)
-                    map->tail_insert = NULL;
-            }
-            else {
-                // FIXME do we need a doubly linked list for the insert-list instead of this second traversal?
-                _EJSPropertyMapEntry *prev_insert;
-                for (prev_insert = map->head_insert; prev_insert; prev_insert = prev_insert->next_insert) {
-                    if (prev_insert->next_insert == s) {
-                        //_ejs_log ("  found entry in insert list\n");
-                        prev_insert->next_insert = s->next_insert;
-                        if (map->tail_insert == s)
-                            map->tail_insert = prev_insert;
-                        break;
-                    }
-                }
-            }
-                
+EJSPropertyDesc*
+_ejs_propertymap_lookup (EJSPropertyMap* map, ejsval name)
+{
+    if (map->inuse == 0)
+        return NULL;
 
-            free (s->desc);
-            free (s);
-            map->inuse --;
+    _EJSPropertyMapEntry* s = propertymap_find (map, name, PropertyKeyHash(name));
+    return s ? &s->desc : NULL;
+}
+
+void
+_ejs_propertymap_insert (EJSObject* obj, ejsval name, EJSPropertyDesc* desc)
+{
+    uint32_t hash = PropertyKeyHash(name);
+    EJSPropertyMap* map = obj->map;
+
+    if (map->inuse > 0) {
+        _EJSPropertyMapEntry* s = propertymap_find (map, name, hash);
+        if (s) {
+            s->desc = *desc;
             return;
         }
-        prev = s;
-        s = s->next_bucket;
     }
+
+    if (map->num_order == PROPERTYMAP_LIMIT(map->capacity)) {
+        // grow unless enough of the entries were removed that rebuilding at this size leaves room.
+        // the empty map has a capacity of 0, so it always ends up here.
+        uint32_t capacity = PROPERTYMAP_MIN_CAPACITY;
+        while (capacity / 2 < map->inuse + 1)
+            capacity <<= 1;
+        propertymap_rebuild (obj, capacity);
+        map = obj->map;
+    }
+
+    propertymap_add (map, name, hash, desc);
+    _ejs_gc_remember (obj);
 }
 
-EJSPropertyDesc*
-_ejs_propertymap_lookup (EJSPropertyMap* map, ejsval name)
+/* object property storage */
+
+// how many values @obj's slots have room for, if @num_slots of them are in use.  out of line slots
+// are allocated in powers of 2, so we don't need to remember how big they are.
+static uint32_t
+slots_capacity (EJSObject* obj, uint32_t num_slots)
 {
-    if (map->inuse == 0)
-        return NULL;
+    if (obj->slots == NULL)
+        return 0;
+    if (obj->slots == EJS_OBJECT_INLINE_SLOTS(obj))
+        return EJS_OBJECT_NUM_INLINE_SLOTS;
 
-    uint32_t hashcode = PropertyKeyHash(name);
-    int bucket = (int)(hashcode % map->nbuckets);
+    uint32_t capacity = 8;
+    while (capacity < num_slots)
+        capacity <<= 1;
+    return capacity;
+}
 
-    for (_EJSPropertyMapEntry* s = map->buckets[bucket]; s; s = s->next_bucket) {
-        if (s->hash != hashcode)
-            continue;
-        if (EJSVAL_TO_BOOLEAN(_ejs_op_strict_eq(s->name, name)))
-            return s->desc;
+static void
+ensure_slots (EJSObject* obj, uint32_t num_slots, uint32_t needed)
+{
+    if (needed <= slots_capacity (obj, num_slots))
+        return;
+
+    uint32_t capacity = 8;
+    while (capacity < needed)
+        capacity <<= 1;
+
+    ejsval* slots = (ejsval*)_ejs_gc_new_store (capacity * sizeof(ejsval));
+    if (num_slots > 0)
+        memmove (slots, obj->slots, num_slots * sizeof(ejsval));
+    obj->slots = slots;
+    _ejs_gc_remember (obj);
+}
+
+static EJSPropertyDesc*
+slot_property (EJSObject* obj, EJSShape* prop, EJSPropertyDesc* desc)
+{
+    desc->flags = prop->flags;
+    if (EJS_SHAPE_IS_ACCESSOR(prop)) {
+        desc->getter = obj->slots[prop->slot];
+        desc->setter = obj->slots[prop->slot + 1];
     }
-    return NULL;
+    else {
+        desc->value = obj->slots[prop->slot];
+        desc->setter = _ejs_undefined;
+    }
+    return desc;
 }
 
 static void
-_ejs_propertymap_rehash (EJSPropertyMap* map)
-{
-    // find the next prime up
-    int new_size = -1;
-    for (int i = 0; i < nprimes-1; i ++) {
-        if (map->nbuckets == primes[i]) {
-            new_size = primes[i+1];
-            break;
-        }
+set_slot_property (EJSObject* obj, EJSShape* prop, EJSPropertyDesc* desc)
+{
+    if (EJS_SHAPE_IS_ACCESSOR(prop)) {
+        obj->slots[prop->slot] = _ejs_property_desc_get_getter (desc);
+        obj->slots[prop->slot + 1] = _ejs_property_desc_get_setter (desc);
     }
-    if (new_size == -1)
-        abort();
+    else {
+        obj->slots[prop->slot] = _ejs_property_desc_get_value (desc);
+    }
+}
+
+// the atom for @name if it's a string, or undefined if nothing has a property by that name
+static inline ejsval
+property_key_atom (ejsval name)
+{
+    return EJSVAL_IS_STRING(name) ? _ejs_string_find_atom (name) : name;
+}
 
-    free (map->buckets);
-    map->nbuckets = new_size;
-    map->buckets = (_EJSPropertyMapEntry**)calloc (sizeof(_EJSPropertyMapEntry*), map->nbuckets);
+// moves @obj's properties out of its slots and into a map of its own.  the slots stay put until
+// we're done, so the collector can still find the values.
+static void
+convert_to_dictionary (EJSObject* obj)
+{
+    EJSOwnPropertyIter iter;
+    _ejs_own_property_iter_init (&iter, obj);
+    while (_ejs_own_property_iter_next (&iter))
+        _ejs_propertymap_insert (obj, iter.name, iter.desc);
+
+    obj->shape = NULL;
+    obj->slots = NULL;
+}
 
-    for (_EJSPropertyMapEntry *s = map->head_insert; s; s = s->next_insert) {
-        uint32_t hashcode = s->hash;
-        int bucket = (int)(hashcode % map->nbuckets);
+EJSPropertyDesc*
+_ejs_object_lookup_property (EJSObject* obj, ejsval name, EJSPropertyDesc* desc)
+{
+    name = property_key_atom (name);
+    if (EJSVAL_IS_UNDEFINED(name))
+        return NULL;
 
-        s->next_bucket = map->buckets[bucket];
-        map->buckets[bucket] = s;
+    if (obj->shape) {
+        EJSShape* prop = _ejs_shape_lookup (obj->shape, name);
+        return prop ? slot_property (obj, prop, desc) : NULL;
     }
+
+    EJSPropertyDesc* map_desc = _ejs_propertymap_lookup (obj->map, name);
+    if (!map_desc)
+        return NULL;
+    *desc = *map_desc;
+    return desc;
 }
 
 void
-_ejs_propertymap_insert (EJSPropertyMap* map, ejsval name, EJSPropertyDesc* desc)
+_ejs_object_insert_property (EJSObject* obj, ejsval name, EJSPropertyDesc* desc)
 {
-    //_ejs_log ("%p: insert (%s)\n", map, ucs2_to_utf8(EJSVAL_TO_FLAT_STRING(name)));
-    if (map->buckets == NULL) {
-        map->nbuckets = primes[0];
-        map->buckets = calloc (sizeof(_EJSPropertyMapEntry*), map->nbuckets);
+    if (EJSVAL_IS_STRING(name))
+        name = _ejs_string_intern (name);
+
+    // property caches assume stores into objects inheriting from a watched prototype won't hit a
+    // setter or read-only property
+    if (EJS_OBJECT_IS_WATCHED_PROTO(obj) && (IsAccessorDescriptor(desc) || !_ejs_property_desc_is_writable(desc)))
+        _ejs_property_ic_store_epoch ++;
+
+    if (obj->shape) {
+        EJSShape* prop = _ejs_shape_lookup (obj->shape, name);
+        if (prop && prop->flags == desc->flags) {
+            set_slot_property (obj, prop, desc);
+            return;
+        }
+
+        if (!prop) {
+            EJSShape* shape = _ejs_shape_add_property (obj->shape, name, desc->flags);
+            if (shape) {
+                // transitions are weak, so the new shape could be collected if growing the slots
+                // does.  volatile keeps a copy where the stack scan sees it.
+                volatile ejsval shape_val = OBJECT_TO_EJSVAL(shape);
+                ensure_slots (obj, obj->shape->num_slots, shape->num_slots);
+
+                shape = (EJSShape*)EJSVAL_TO_OBJECT(shape_val);
+                set_slot_property (obj, shape, desc);
+                obj->shape = shape;
+                _ejs_gc_write_barrier (obj, shape_val);
+                return;
+            }
+        }
+
+        // there are too many properties for a shape, or one is being reconfigured
+        convert_to_dictionary (obj);
     }
 
-    uint32_t hashcode = PropertyKeyHash(name);
-    int bucket = (int)(hashcode % map->nbuckets);
+    _ejs_propertymap_insert (obj, name, desc);
+}
 
-    for (_EJSPropertyMapEntry* s = map->buckets[bucket]; s; s = s->next_bucket) {
-        if (s->hash != hashcode)
-            continue;
-        if (EJSVAL_TO_BOOLEAN(_ejs_op_strict_eq(s->name, name))) {
-            _ejs_propertydesc_free (s->desc);
-            s->desc = desc;
+void
+_ejs_object_remove_property (EJSObject* obj, ejsval name)
+{
+    name = property_key_atom (name);
+    if (EJSVAL_IS_UNDEFINED(name))
+        return;
+
+    if (obj->shape) {
+        EJSShape* prop = _ejs_shape_lookup (obj->shape, name);
+        if (!prop)
+            return;
+
+        if (prop == obj->shape) {
+            // removing the last property added just takes us back to the shape we had before it
+            obj->shape = prop->parent;
+            _ejs_gc_write_barrier (obj, OBJECT_TO_EJSVAL(obj->shape));
             return;
         }
+
+        convert_to_dictionary (obj);
     }
-    _EJSPropertyMapEntry* new_s = malloc(sizeof(_EJSPropertyMapEntry));
-    new_s->hash = hashcode;
-    new_s->name = name;
-    new_s->desc = desc;
-    new_s->next_bucket = map->buckets[bucket];
-    new_s->next_insert = NULL;
-    map->buckets[bucket] = new_s;
-    map->inuse ++;
 
-    if (!map->head_insert)
-        map->head_insert = new_s;
+    _ejs_propertymap_remove (obj->map, name);
+}
+
+uint32_t
+_ejs_object_num_properties (EJSObject* obj)
+{
+    return obj->shape ? obj->shape->num_properties : (uint32_t)obj->map->inuse;
+}
+
+void
+_ejs_own_property_iter_init (EJSOwnPropertyIter* iter, EJSObject* obj)
+{
+    iter->name = _ejs_undefined;
+    iter->desc = NULL;
+    iter->obj = obj;
+    iter->index = 0;
+
+    if (obj->shape) {
+        iter->shape = OBJECT_TO_EJSVAL(obj->shape);
+        iter->map = NULL;
+
+        // shapes point at their parents, so walk back from the object's shape to get the properties
+        // in the order they were added
+        uint32_t i = obj->shape->num_properties;
+        for (EJSShape* s = obj->shape; s->parent; s = s->parent)
+            iter->chain[--i] = s;
+    }
+    else {
+        iter->shape = _ejs_null;
+        iter->map = obj->map;
+    }
+}
 
-    if (map->tail_insert)
-        map->tail_insert->next_insert = new_s;
-    map->tail_insert = new_s;
+EJSBool
+_ejs_own_property_iter_next (EJSOwnPropertyIter* iter)
+{
+    if (EJSVAL_IS_NULL(iter->shape)) {
+        EJSPropertyMap* map = iter->obj->map;
+        if (map != iter->map) {
+            // the map's been rebuilt since we started, which compacts the insertion order.  carry on
+            // after the last property we returned, or from about the same place if it's gone.
+            _EJSPropertyMapEntry* s = NULL;
+            if (iter->index > 0 && map->inuse > 0)
+                s = propertymap_find (map, iter->name, PropertyKeyHash(iter->name));
+            iter->index = s ? s->order + 1 : MIN(iter->index, map->num_order);
+            iter->map = map;
+        }
+
+        uint32_t* order = PROPERTYMAP_ORDER(map);
+        while (iter->index < map->num_order) {
+            uint32_t i = order[iter->index++];
+            if (i == PROPERTYMAP_HOLE)
+                continue;
+            iter->name = map->entries[i].name;
+            iter->storage = map->entries[i].desc;
+            iter->desc = &iter->storage;
+            return EJS_TRUE;
+        }
+
+        iter->desc = NULL;
+        return EJS_FALSE;
+    }
+
+    EJSShape* shape = (EJSShape*)EJSVAL_TO_OBJECT(iter->shape);
+    while (iter->index < shape->num_properties) {
+        EJSShape* prop = iter->chain[iter->index++];
+        iter->name = prop->name;
+
+        if (iter->obj->shape == shape) {
+            iter->desc = slot_property (iter->obj, prop, &iter->storage);
+            return EJS_TRUE;
+        }
 
-    if (map->inuse > map->nbuckets * 0.75) {
-        _ejs_propertymap_rehash (map);
+        // the object's properties have changed since we started, so look this one up again
+        iter->desc = _ejs_object_lookup_property (iter->obj, prop->name, &iter->storage);
+        if (iter->desc)
+            return EJS_TRUE;
     }
+
+    iter->desc = NULL;
+    return EJS_FALSE;
 }
 
 /* property iterators */
@@ -628,7 +855,7 @@ static EJSBool
 name_in_keys (ejsval name, ejsval *keys, int num)
 {
     for (int i = 0; i < num; i ++) {
-        if (!ucs2_strcmp(EJSVAL_TO_FLAT_STRING(name), EJSVAL_TO_FLAT_STRING(keys[i])))
+        if (_ejs_primstring_equal(EJSVAL_TO_STRING(name), EJSVAL_TO_STRING(keys[i])))
             return EJS_TRUE;
     }
     return EJS_FALSE;
@@ -643,14 +870,16 @@ collect_keys (ejsval objval, int *num, int *alloc, ejsval **keys)
     EJSObject *obj = EJSVAL_TO_OBJECT(objval);
     EJS_ASSERT(obj);
 
-    for (_EJSPropertyMapEntry *s = obj->map->head_insert; s; s = s->next_insert) {
-        if (_ejs_property_desc_is_enumerable (s->desc) && !name_in_keys (s->name, *keys, *num)) {
+    EJSOwnPropertyIter iter;
+    _ejs_own_property_iter_init (&iter, obj);
+    while (_ejs_own_property_iter_next (&iter)) {
+        if (_ejs_property_desc_is_enumerable (iter.desc) && !name_in_keys (iter.name, *keys, *num)) {
             if (*num == *alloc-1) {
                 // we need to reallocate
                 (*alloc) += 10;
                 *keys = (ejsval*)realloc (*keys, (*alloc) * sizeof(ejsval));
             }
-            (*keys)[(*num)++] = s->name;
+            (*keys)[(*num)++] = iter.name;
         }
     }
 
@@ -747,14 +976,16 @@ _ejs_property_iterator_free (ejsval iter)
 
 ///
 
+EJSObject* _ejs_object_specop_allocate ();
+
 void
 _ejs_init_object (EJSObject* obj, ejsval proto, EJSSpecOps *ops)
 {
     obj->proto = proto;
     obj->ops = ops ? ops : &_ejs_Object_specops;
-    obj->map = calloc (sizeof(EJSPropertyMap), 1);
-    _ejs_propertymap_init (obj->map);
-    //printf ("obj->map = %p\n", obj->map);
+    obj->shape = _ejs_empty_shape;
+    obj->slots = NULL;
+    obj->map = &_ejs_empty_propertymap;
     EJS_OBJECT_SET_EXTENSIBLE(obj);
 #if notyet
     ((GCObjectPtr)obj)->gc_data = 0x01; // HAS_FINALIZE
@@ -766,6 +997,8 @@ _ejs_object_new (ejsval proto, EJSSpecOps *ops)
 {
     EJSObject *obj = ops->Allocate();
     _ejs_init_object (obj, proto, ops);
+    if (ops->Allocate == _ejs_object_specop_allocate)
+        obj->slots = EJS_OBJECT_INLINE_SLOTS(obj);
     return OBJECT_TO_EJSVAL(obj);
 }
 
@@ -844,7 +1077,7 @@ _ejs_object_getprop (ejsval obj, ejsval key)
 
     if (EJSVAL_IS_PRIMITIVE(obj)) {
         if (EJSVAL_IS_STRING(obj)) {
-            if (!ucs2_strcmp(EJSVAL_TO_FLAT_STRING(ToString(key)), _ejs_ucs2_length))
+            if (_ejs_primstring_equal(EJSVAL_TO_STRING(ToString(key)), EJSVAL_TO_STRING(_ejs_atom_length)))
                 return NUMBER_TO_EJSVAL(EJSVAL_TO_STRING(obj)->length);
         }
         obj = ToObject(obj);
@@ -858,6 +1091,213 @@ _ejs_object_getprop (ejsval obj, ejsval key)
     return OP(EJSVAL_TO_OBJECT(obj),Get)(obj, key, obj);
 }
 
+/* inline caches */
+
+// starts at 1 so zeroed caches are out of date
+uint32_t _ejs_property_ic_store_epoch = 1;
+
+// objects whose [[Get]] behaves exactly like an ordinary object's
+static EJSBool
+ordinary_get (EJSObject* obj)
+{
+    EJSSpecOps* ops = obj->ops;
+    return (ops->Get == _ejs_Object_specops.Get &&
+            ops->GetOwnProperty == _ejs_Object_specops.GetOwnProperty &&
+            ops->GetPrototypeOf == _ejs_Object_specops.GetPrototypeOf);
+}
+
+// objects whose [[Set]] behaves exactly like an ordinary object's
+static EJSBool
+ordinary_set (EJSObject* obj)
+{
+    EJSSpecOps* ops = obj->ops;
+    return (ops->Set == _ejs_Object_specops.Set &&
+            ops->GetOwnProperty == _ejs_Object_specops.GetOwnProperty &&
+            ops->DefineOwnProperty == _ejs_Object_specops.DefineOwnProperty &&
+            ops->GetPrototypeOf == _ejs_Object_specops.GetPrototypeOf);
+}
+
+#define IS_WRITABLE_DATA(s) (!EJS_SHAPE_IS_ACCESSOR(s) && ((s)->flags & EJS_PROP_FLAGS_WRITABLE) != 0)
+
+// get @ic ready for a miss to fill in.  returns EJS_FALSE if it's full.
+static EJSBool
+ic_prepare_fill (EJSPropertyIC* ic, ejsval key)
+{
+    if (ic->gc_epoch != _ejs_gc_epoch || ic->store_epoch != _ejs_property_ic_store_epoch) {
+        ic->gc_epoch = _ejs_gc_epoch;
+        ic->store_epoch = _ejs_property_ic_store_epoch;
+        ic->num_entries = 0;
+    }
+
+    if (ic->num_entries == EJS_PROPERTY_IC_ENTRIES)
+        return EJS_FALSE;
+
+    // __proto__ is special-cased by [[Get]], and we only expect to be handed atoms
+    return EJSVAL_IS_STRING(key) && EJS_PRIMSTR_IS_ATOM(EJSVAL_TO_STRING(key)) && !EJSVAL_EQ(key, _ejs_atom___proto__);
+}
+
+static void
+ic_add_entry (EJSPropertyIC* ic, EJSObject* obj, EJSShape* shape, EJSPropertyICKind kind, EJSShape* target_shape, uint32_t slot)
+{
+    EJSPropertyICEntry* entry = &ic->entries[ic->num_entries++];
+    entry->ops = obj->ops;
+    entry->shape = shape;
+    entry->target_shape = target_shape;
+    entry->proto = obj->proto;
+    entry->kind = kind;
+    entry->slot = slot;
+}
+
+static void
+getprop_ic_fill (ejsval obj, ejsval key, EJSPropertyIC* ic)
+{
+    if (!EJSVAL_IS_OBJECT(obj) || !ic_prepare_fill (ic, key))
+        return;
+
+    EJSObject* o = EJSVAL_TO_OBJECT(obj);
+    if (!o->shape || !ordinary_get (o))
+        return;
+
+    EJSShape* prop = _ejs_shape_lookup (o->shape, key);
+    if (prop) {
+        if (!EJS_SHAPE_IS_ACCESSOR(prop))
+            ic_add_entry (ic, o, o->shape, EJS_PROPERTY_IC_OWN, NULL, prop->slot);
+        return;
+    }
+
+    if (!EJSVAL_IS_OBJECT(o->proto))
+        return;
+
+    EJSObject* proto = EJSVAL_TO_OBJECT(o->proto);
+    if (!proto->shape || !ordinary_get (proto))
+        return;
+
+    prop = _ejs_shape_lookup (proto->shape, key);
+    if (prop && !EJS_SHAPE_IS_ACCESSOR(prop))
+        ic_add_entry (ic, o, o->shape, EJS_PROPERTY_IC_PROTO, proto->shape, prop->slot);
+}
+
+ejsval
+_ejs_object_getprop_ic (ejsval obj, ejsval key, EJSPropertyIC* ic)
+{
+    if (EJSVAL_IS_OBJECT(obj) && ic->gc_epoch == _ejs_gc_epoch) {
+        EJSObject* o = EJSVAL_TO_OBJECT(obj);
+        for (uint32_t i = 0; i < ic->num_entries; i ++) {
+            EJSPropertyICEntry* entry = &ic->entries[i];
+            if (entry->shape != o->shape || entry->ops != o->ops)
+                continue;
+
+            if (entry->kind == EJS_PROPERTY_IC_OWN)
+                return o->slots[entry->slot];
+
+            if (entry->kind == EJS_PROPERTY_IC_PROTO && EJSVAL_EQ(entry->proto, o->proto)) {
+                EJSObject* proto = EJSVAL_TO_OBJECT(o->proto);
+                if (proto->shape == entry->target_shape)
+                    return proto->slots[entry->slot];
+            }
+        }
+    }
+
+    ejsval rv = _ejs_object_getprop (obj, key);
+    getprop_ic_fill (obj, key, ic);
+    return rv;
+}
+
+// a store to @o that doesn't find @key on it ends up adding @key, as long as nothing on the way up
+// the prototype chain has a setter or read-only property by that name.  if that's so, watch the
+// prototypes so we hear about it if it changes.
+static EJSBool
+watch_proto_chain (EJSObject* o, ejsval key)
+{
+    for (ejsval p = o->proto; !EJSVAL_IS_NULL(p); p = EJSVAL_TO_OBJECT(p)->proto) {
+        EJSObject* proto = EJSVAL_TO_OBJECT(p);
+        if (!ordinary_set (proto))
+            return EJS_FALSE;
+
+        EJSPropertyDesc desc;
+        EJSPropertyDesc* found = _ejs_object_lookup_property (proto, key, &desc);
+        if (found && (IsAccessorDescriptor(found) || !_ejs_property_desc_is_writable(found)))
+            return EJS_FALSE;
+    }
+
+    for (ejsval p = o->proto; !EJSVAL_IS_NULL(p); p = EJSVAL_TO_OBJECT(p)->proto)
+        EJS_OBJECT_SET_WATCHED_PROTO(EJSVAL_TO_OBJECT(p));
+    return EJS_TRUE;
+}
+
+ejsval
+_ejs_object_setprop_ic (ejsval obj, ejsval key, ejsval value, EJSPropertyIC* ic)
+{
+    if (!EJSVAL_IS_OBJECT(obj))
+        return _ejs_object_setprop (obj, key, value);
+
+    EJSObject* o = EJSVAL_TO_OBJECT(obj);
+
+    if (ic->gc_epoch == _ejs_gc_epoch && ic->store_epoch == _ejs_property_ic_store_epoch) {
+        for (uint32_t i = 0; i < ic->num_entries; i ++) {
+            EJSPropertyICEntry* entry = &ic->entries[i];
+            if (entry->shape != o->shape || entry->ops != o->ops)
+                continue;
+
+            if (entry->kind == EJS_PROPERTY_IC_OWN) {
+                o->slots[entry->slot] = value;
+                _ejs_gc_write_barrier (o, value);
+                return value;
+            }
+
+            if (entry->kind == EJS_PROPERTY_IC_ADD && EJSVAL_EQ(entry->proto, o->proto) && EJS_OBJECT_IS_EXTENSIBLE(o)) {
+                // nothing but the cache refers to the new shape, so keep it where the stack scan
+                // sees it in case growing the slots collects
+                EJSShape* shape = entry->target_shape;
+                volatile ejsval shape_val = OBJECT_TO_EJSVAL(shape);
+                uint32_t slot = entry->slot;
+                ensure_slots (o, o->shape->num_slots, shape->num_slots);
+
+                shape = (EJSShape*)EJSVAL_TO_OBJECT(shape_val);
+                o->slots[slot] = value;
+                o->shape = shape;
+                _ejs_gc_write_barrier (o, value);
+                _ejs_gc_write_barrier (o, shape_val);
+                return value;
+            }
+        }
+    }
+
+    EJSShape* old_shape = o->shape;
+    uint32_t gc_epoch = _ejs_gc_epoch;
+
+    _ejs_object_setprop (obj, key, value);
+
+    // if we collected, old_shape might not be around anymore
+    if (!old_shape || gc_epoch != _ejs_gc_epoch || !ordinary_set (o) || !ic_prepare_fill (ic, key))
+        return value;
+
+    EJSShape* shape = o->shape;
+    if (!shape)
+        return value;
+
+    if (shape == old_shape) {
+        EJSShape* prop = _ejs_shape_lookup (shape, key);
+        if (prop && IS_WRITABLE_DATA(prop))
+            ic_add_entry (ic, o, shape, EJS_PROPERTY_IC_OWN, NULL, prop->slot);
+        return value;
+    }
+
+    if (shape->parent != old_shape || !IS_WRITABLE_DATA(shape) || !EJSVAL_EQ(shape->name, key))
+        return value;
+
+    // only shapes in the tree can be cached, so objects that go through here end up with the same
+    // shape as ones built up any other way
+    EJSBool shared = EJS_FALSE;
+    for (uint32_t i = 0; i < old_shape->num_transitions; i ++)
+        shared = shared || old_shape->transitions[i] == shape;
+
+    if (shared && watch_proto_chain (o, key))
+        ic_add_entry (ic, o, old_shape, EJS_PROPERTY_IC_ADD, shape, shape->slot);
+
+    return value;
+}
+
 ejsval
 _ejs_global_setprop (ejsval key, ejsval value)
 {
@@ -1048,7 +1488,8 @@ _ejs_Object_getOwnPropertyDescriptor (ejsval env, ejsval _this, uint32_t argc, e
 
     // 5. Let desc be the result of calling the [[GetOwnProperty]] internal method of obj with argument key. 
     // 6. ReturnIfAbrupt(desc). 
-    EJSPropertyDesc* desc = OP(EJSVAL_TO_OBJECT(obj),GetOwnProperty)(obj, key, NULL);
+    EJSPropertyDesc desc_storage;
+    EJSPropertyDesc* desc = OP(EJSVAL_TO_OBJECT(obj),GetOwnProperty)(obj, key, NULL, &desc_storage);
 
     // 7. Return the result of calling FromPropertyDescriptor(desc). 
     return FromPropertyDescriptor(desc);
@@ -1074,12 +1515,14 @@ _ejs_Object_getOwnPropertyNames (ejsval env, ejsval _this, uint32_t argc, ejsval
     /* 3. Let n be 0. */
 
     /* 4. For each named own property P of O */
-    for (_EJSPropertyMapEntry* s = O_->map->head_insert; s; s = s->next_insert) {
-        if (!_ejs_property_desc_is_enumerable(s->desc))
+    EJSOwnPropertyIter iter;
+    _ejs_own_property_iter_init (&iter, O_);
+    while (_ejs_own_property_iter_next (&iter)) {
+        if (!_ejs_property_desc_is_enumerable(iter.desc))
             continue;
 
         /*    a. Let name be the String value that is the name of P. */
-        ejsval name = s->name;
+        ejsval name = iter.name;
 
         if (!EJSVAL_IS_SYMBOL(name)) {
             /*    b. Call the [[DefineOwnProperty]] internal method of array with arguments ToString(n), the
@@ -1117,12 +1560,14 @@ _ejs_Object_getOwnPropertySymbols (ejsval env, ejsval _this, uint32_t argc, ejsv
     /* 3. Let n be 0. */
 
     /* 4. For each named own property P of O */
-    for (_EJSPropertyMapEntry* s = O_->map->head_insert; s; s = s->next_insert) {
-        if (!_ejs_property_desc_is_enumerable(s->desc))
+    EJSOwnPropertyIter iter;
+    _ejs_own_property_iter_init (&iter, O_);
+    while (_ejs_own_property_iter_next (&iter)) {
+        if (!_ejs_property_desc_is_enumerable(iter.desc))
             continue;
 
         /*    a. Let name be the String value that is the name of P. */
-        ejsval name = s->name;
+        ejsval name = iter.name;
 
         if (EJSVAL_IS_SYMBOL(name)) {
             /*    b. Call the [[DefineOwnProperty]] internal method of array with arguments ToString(n), the
@@ -1185,13 +1630,15 @@ _ejs_Object_assign (ejsval env, ejsval _this, uint32_t argc, ejsval *args)
         ejsval pendingException = _ejs_undefined;
 
         //    k. Repeat while nextIndex < len, 
-        for (_EJSPropertyMapEntry* s = from_->map->head_insert; s; s = s->next_insert) {
+        EJSOwnPropertyIter iter;
+        _ejs_own_property_iter_init (&iter, from_);
+        while (_ejs_own_property_iter_next (&iter)) {
             //       i. Let nextKey be Get(keysArray, ToString(nextIndex)). 
             //       ii. ReturnIfAbrupt(nextKey). 
-            ejsval nextKey = s->name;
+            ejsval nextKey = iter.name;
 
             //       iii. Let desc be the result of calling the [[GetOwnProperty]] internal method of from with argument nextKey. 
-            EJSPropertyDesc* desc = s->desc;
+            EJSPropertyDesc* desc = iter.desc;
             //       iv. If desc is an abrupt completion, then 
             //           1. If pendingException is undefined, then set pendingException to desc. 
             
@@ -1336,8 +1783,10 @@ _ejs_Object_defineProperties (ejsval env, ejsval _this, uint32_t argc, ejsval *a
 
     /* 3. Let names be an internal list containing the names of each enumerable own property of props. */
     int names_len = 0;
-    for (_EJSPropertyMapEntry *s = props_obj->map->head_insert; s; s = s->next_insert) {
-        if (_ejs_property_desc_is_enumerable (s->desc))
+    EJSOwnPropertyIter iter;
+    _ejs_own_property_iter_init (&iter, props_obj);
+    while (_ejs_own_property_iter_next (&iter)) {
+        if (_ejs_property_desc_is_enumerable (iter.desc))
             names_len ++;
     }
 
@@ -1348,9 +1797,10 @@ _ejs_Object_defineProperties (ejsval env, ejsval _this, uint32_t argc, ejsval *a
 
     ejsval* names = malloc(names_len * sizeof(ejsval));
     int n = 0;
-    for (_EJSPropertyMapEntry *s = props_obj->map->head_insert; s; s = s->next_insert) {
-        if (_ejs_property_desc_is_enumerable(s->desc))
-            names[n++] = s->name;
+    _ejs_own_property_iter_init (&iter, props_obj);
+    while (_ejs_own_property_iter_next (&iter)) {
+        if (_ejs_property_desc_is_enumerable(iter.desc))
+            names[n++] = iter.name;
     }
 
     /* 4. Let descriptors be an empty internal List. */
@@ -1447,7 +1897,8 @@ SetIntegrityLevel (ejsval O, IntegrityLevel level)
             ejsval k = keys[i];
             //       i. Let status be the result of calling the [[GetOwnProperty]] internal method of O with k. 
             ejsval exc;
-            EJSPropertyDesc* currentDesc = OP(EJSVAL_TO_OBJECT(O),GetOwnProperty)(O, k, &exc);
+            EJSPropertyDesc currentDesc_storage;
+            EJSPropertyDesc* currentDesc = OP(EJSVAL_TO_OBJECT(O),GetOwnProperty)(O, k, &exc, &currentDesc_storage);
             //       ii. If status is an abrupt completion, then 
             if (!currentDesc && !EJSVAL_IS_UNDEFINED(exc)) {
                 //           1. If pendingException is undefined, then set pendingException to status. 
@@ -1818,7 +2269,8 @@ _ejs_Object_prototype_hasOwnProperty (ejsval env, ejsval _this, uint32_t argc, e
     if (EJS_UNLIKELY(argc > 0))
         needle = args[0];
 
-    return BOOLEAN_TO_EJSVAL(OP(EJSVAL_TO_OBJECT(_this),GetOwnProperty)(_this, needle, NULL) != NULL);
+    EJSPropertyDesc desc;
+    return BOOLEAN_TO_EJSVAL(OP(EJSVAL_TO_OBJECT(_this),GetOwnProperty)(_this, needle, NULL, &desc) != NULL);
 }
 
 // ECMA262: 15.2.4.6
@@ -1865,7 +2317,8 @@ _ejs_Object_prototype_propertyIsEnumerable (ejsval env, ejsval _this, uint32_t a
     EJSObject* O_ = EJSVAL_TO_OBJECT(O);
 
     /* 3. Let desc be the result of calling the [[GetOwnProperty]] internal method of O passing P as the argument. */
-    EJSPropertyDesc* desc = OP(O_, GetOwnProperty)(O, P, NULL);
+    EJSPropertyDesc desc_storage;
+    EJSPropertyDesc* desc = OP(O_, GetOwnProperty)(O, P, NULL, &desc_storage);
     /* 4. If desc is undefined, return false. */
     if (!desc)
         return _ejs_false;
@@ -2002,6 +2455,9 @@ _ejs_object_specop_set_prototype_of (ejsval O, ejsval V)
 
     // 9. Set the value of the [[Prototype]] internal slot of O to V.
     O_->proto = V;
+    _ejs_gc_write_barrier(O_, V);
+    if (EJS_OBJECT_IS_WATCHED_PROTO(O_))
+        _ejs_property_ic_store_epoch ++;
 
     // 10. Return true.
     return EJS_TRUE;
@@ -2014,12 +2470,13 @@ _ejs_object_specop_get (ejsval O, ejsval P, ejsval Receiver)
     // 1. Assert: IsPropertyKey(P) is true. 
     ejsval pname = ToPropertyKey(P); // XXX this shouldn't be necessary, but ejs passes numbers here
 
-    if (EJSVAL_IS_STRING(pname) && !ucs2_strcmp(_ejs_ucs2___proto__, EJSVAL_TO_FLAT_STRING(pname)))
+    if (EJSVAL_IS_STRING(pname) && _ejs_primstring_equal(EJSVAL_TO_STRING(pname), EJSVAL_TO_STRING(_ejs_atom___proto__)))
         return OP(EJSVAL_TO_OBJECT(O),GetPrototypeOf) (O);
 
     // 2. Let desc be the result of calling the [[GetOwnProperty]] internal method of O with argument P. 
     // 3. ReturnIfAbrupt(desc). 
-    EJSPropertyDesc* desc = OP(EJSVAL_TO_OBJECT(O),GetOwnProperty) (O, P, NULL);
+    EJSPropertyDesc desc_storage;
+    EJSPropertyDesc* desc = OP(EJSVAL_TO_OBJECT(O),GetOwnProperty) (O, P, NULL, &desc_storage);
 
     // 4. If desc is undefined, then 
     if (desc == NULL) {
@@ -2058,12 +2515,12 @@ _ejs_object_specop_get (ejsval O, ejsval P, ejsval Receiver)
 
 // ECMA262: 8.12.1
 static EJSPropertyDesc*
-_ejs_object_specop_get_own_property (ejsval obj, ejsval propertyName, ejsval* exc)
+_ejs_object_specop_get_own_property (ejsval obj, ejsval propertyName, ejsval* exc, EJSPropertyDesc* desc)
 {
     ejsval property_str = ToPropertyKey(propertyName);
     EJSObject* obj_ = EJSVAL_TO_OBJECT(obj);
 
-    return _ejs_propertymap_lookup (obj_->map, property_str);
+    return _ejs_object_lookup_property (obj_, property_str, desc);
 }
 
 // ECMA262: 9.1.9
@@ -2077,7 +2534,8 @@ _ejs_object_specop_set (ejsval O, ejsval P, ejsval V, ejsval Receiver)
     
     // 2. Let ownDesc be the result of calling the [[GetOwnProperty]] internal method of O with argument P. 
     // 3. ReturnIfAbrupt(ownDesc). 
-    EJSPropertyDesc* ownDesc = OP(EJSVAL_TO_OBJECT(O),GetOwnProperty)(O, P, NULL);
+    EJSPropertyDesc ownDesc_storage;
+    EJSPropertyDesc* ownDesc = OP(EJSVAL_TO_OBJECT(O),GetOwnProperty)(O, P, NULL, &ownDesc_storage);
 
     // 4. If ownDesc is undefined, then 
     if (!ownDesc) {
@@ -2108,7 +2566,8 @@ _ejs_object_specop_set (ejsval O, ejsval P, ejsval V, ejsval Receiver)
 
         //    c. Let existingDescriptor be the result of calling the [[GetOwnProperty]] internal method of Receiver with argument P. 
         //    d. ReturnIfAbrupt(existingDescriptor). 
-        EJSPropertyDesc* existingDescriptor = OP(EJSVAL_TO_OBJECT(Receiver),GetOwnProperty)(Receiver, P, NULL);
+        EJSPropertyDesc existingDescriptor_storage;
+        EJSPropertyDesc* existingDescriptor = OP(EJSVAL_TO_OBJECT(Receiver),GetOwnProperty)(Receiver, P, NULL, &existingDescriptor_storage);
 
         //    e. If existingDescriptor is not undefined, then 
         if (existingDescriptor) {
@@ -2149,7 +2608,8 @@ _ejs_object_specop_has_property (ejsval O, ejsval P)
 
     // 2. Let hasOwn be the result of calling the [[GetOwnProperty]] internal method of O with argument P. 
     // 3. ReturnIfAbrupt(hasOwn). 
-    EJSPropertyDesc* hasOwn = OP(EJSVAL_TO_OBJECT(O),GetOwnProperty)(O, P, NULL);
+    EJSPropertyDesc hasOwn_storage;
+    EJSPropertyDesc* hasOwn = OP(EJSVAL_TO_OBJECT(O),GetOwnProperty)(O, P, NULL, &hasOwn_storage);
 
     // 4. If hasOwn is not undefined, then return true. 
     if (hasOwn)
@@ -2173,14 +2633,15 @@ _ejs_object_specop_delete (ejsval O, ejsval P, EJSBool Throw)
 {
     EJSObject* obj = EJSVAL_TO_OBJECT(O);
     /* 1. Let desc be the result of calling the [[GetOwnProperty]] internal method of O with property name P. */
-    EJSPropertyDesc* desc = OP(obj,GetOwnProperty)(O, P, NULL);
+    EJSPropertyDesc desc_storage;
+    EJSPropertyDesc* desc = OP(obj,GetOwnProperty)(O, P, NULL, &desc_storage);
     /* 2. If desc is undefined, then return true. */
     if (!desc)
         return EJS_TRUE;
     /* 3. If desc.[[Configurable]] is true, then */
     if (_ejs_property_desc_is_configurable(desc)) {
         /*    a. Remove the own property with name P from O. */
-        _ejs_propertymap_remove (obj->map, P);
+        _ejs_object_remove_property (obj, P);
         /*    b. Return true. */
         return EJS_TRUE;
     }
@@ -2192,6 +2653,18 @@ _ejs_object_specop_delete (ejsval O, ejsval P, EJSBool Throw)
     return EJS_FALSE;
 }
 
+// the values in a property descriptor are owned by the object it describes a property of
+static void
+write_barrier_desc (EJSObject* obj, EJSPropertyDesc* desc)
+{
+    if (_ejs_property_desc_has_value (desc))
+        _ejs_gc_write_barrier(obj, _ejs_property_desc_get_value (desc));
+    if (_ejs_property_desc_has_getter (desc))
+        _ejs_gc_write_barrier(obj, _ejs_property_desc_get_getter (desc));
+    if (_ejs_property_desc_has_setter (desc))
+        _ejs_gc_write_barrier(obj, _ejs_property_desc_get_setter (desc));
+}
+
 // ECMA262: 8.12.9
 static EJSBool
 _ejs_object_specop_define_own_property (ejsval O, ejsval P, EJSPropertyDesc* Desc, EJSBool Throw)
@@ -2205,7 +2678,8 @@ _ejs_object_specop_define_own_property (ejsval O, ejsval P, EJSPropertyDesc* Des
 
     EJSObject* obj = EJSVAL_TO_OBJECT(O);
     /* 1. Let current be the result of calling the [[GetOwnProperty]] internal method of O with property name P. */
-    EJSPropertyDesc* current = OP(obj, GetOwnProperty)(O, P, NULL);
+    EJSPropertyDesc current_storage;
+    EJSPropertyDesc* current = OP(obj, GetOwnProperty)(O, P, NULL, &current_storage);
 
     /* 2. Let extensible be the value of the [[Extensible]] internal property of O. */
     EJSBool extensible = EJS_OBJECT_IS_EXTENSIBLE(obj);
@@ -2216,7 +2690,8 @@ _ejs_object_specop_define_own_property (ejsval O, ejsval P, EJSPropertyDesc* Des
 
     /* 4. If current is undefined and extensible is true, then */
     if (!current && extensible) {
-        EJSPropertyDesc *dest = _ejs_propertydesc_new();
+        EJSPropertyDesc dest_desc = { 0 };
+        EJSPropertyDesc *dest = &dest_desc;
 
         /*    a. If  IsGenericDescriptor(Desc) or IsDataDescriptor(Desc) is true, then */
         if (IsGenericDescriptor(Desc) || IsDataDescriptor(Desc)) {
@@ -2248,7 +2723,9 @@ _ejs_object_specop_define_own_property (ejsval O, ejsval P, EJSPropertyDesc* Des
             if (_ejs_property_desc_has_enumerable (Desc))
                 _ejs_property_desc_set_enumerable (dest, _ejs_property_desc_is_enumerable (Desc));
         }
-        _ejs_propertymap_insert (obj->map, P, dest);
+        _ejs_object_insert_property (obj, P, dest);
+        _ejs_gc_write_barrier(obj, P);
+        write_barrier_desc (obj, dest);
 
         /*    c. Return true. */
         return EJS_TRUE;
@@ -2350,7 +2827,9 @@ _ejs_object_specop_define_own_property (ejsval O, ejsval P, EJSPropertyDesc* Des
 
     /* 12. For each attribute field of Desc that is present, set the correspondingly named attribute of the property  */
     /*     named P of object O to the value of the field. */
-    EJSPropertyDesc* dest = _ejs_propertymap_lookup (obj->map, P);
+    /*     (current is our own copy of the property, already converted by step 9, so we update it and */
+    /*     store it back.) */
+    EJSPropertyDesc* dest = current;
 
     if (_ejs_property_desc_has_getter (Desc))
         _ejs_property_desc_set_getter (dest, _ejs_property_desc_get_getter (Desc));
@@ -2365,6 +2844,9 @@ _ejs_object_specop_define_own_property (ejsval O, ejsval P, EJSPropertyDesc* Des
     if (_ejs_property_desc_has_writable (Desc))
         _ejs_property_desc_set_writable (dest, _ejs_property_desc_is_writable (Desc));
 
+    _ejs_object_insert_property (obj, P, dest);
+    write_barrier_desc (obj, dest);
+
     /* 13. Return true. */
     return EJS_TRUE;
 }
@@ -2372,37 +2854,27 @@ _ejs_object_specop_define_own_property (ejsval O, ejsval P, EJSPropertyDesc* Des
 EJSObject*
 _ejs_object_specop_allocate ()
 {
-    return _ejs_gc_new(EJSObject);
+    return _ejs_gc_new_obj (EJSObject, sizeof(EJSObject) + EJS_OBJECT_NUM_INLINE_SLOTS * sizeof(ejsval));
 }
 
 void 
 _ejs_object_specop_finalize(EJSObject* obj)
 {
-    //printf ("_ejs_propertymap_free(obj->map = %p)\n", obj->map);
-    _ejs_propertymap_free (obj->map);
-    obj->map = NULL;
-}
-
-static void
-scan_property (ejsval name, EJSPropertyDesc *desc, EJSValueFunc scan_func)
-{
-    scan_func (name);
-
-    if (_ejs_property_desc_has_value (desc)) {
-        scan_func (desc->value);
-    }
-    if (_ejs_property_desc_has_getter (desc)) {
-        scan_func (desc->getter); 
-    }
-    if (_ejs_property_desc_has_setter (desc)) {
-        scan_func (desc->setter);
-    }
+    // the slots and property map live in gc stores, so there's nothing to free here.
 }
 
 static void
 _ejs_object_specop_scan (EJSObject* obj, EJSValueFunc scan_func)
 {
-    _ejs_propertymap_foreach_property (obj->map, (EJSPropertyDescFunc)scan_property, scan_func);
+    if (obj->shape) {
+        scan_func (OBJECT_TO_EJSVAL(obj->shape));
+        if (obj->slots != EJS_OBJECT_INLINE_SLOTS(obj))
+            _ejs_gc_mark_store (obj->slots);
+        for (uint32_t i = 0; i < obj->shape->num_slots; i ++)
+            scan_func (obj->slots[i]);
+    }
+    // an object moving to dictionary mode has both
+    _ejs_propertymap_scan (obj->map, scan_func);
     scan_func (obj->proto);
 }
 
@@ -2453,33 +2925,36 @@ _ejs_object_specop_own_property_keys (ejsval O)
 {
     EJSObject* O_ = EJSVAL_TO_OBJECT(O);
 
-    ejsval* numberkeys = malloc(sizeof(ejsval) *O_->map->inuse);
+    uint32_t num_properties = _ejs_object_num_properties (O_);
+    ejsval* numberkeys = malloc(sizeof(ejsval) *num_properties);
     int num_numberkeys = 0;
-    ejsval* stringkeys = malloc(sizeof(ejsval) *O_->map->inuse);
+    ejsval* stringkeys = malloc(sizeof(ejsval) *num_properties);
     int num_stringkeys = 0;
-    ejsval* symbolkeys = malloc(sizeof(ejsval) *O_->map->inuse);
+    ejsval* symbolkeys = malloc(sizeof(ejsval) *num_properties);
     int num_symbolkeys = 0;
     // 1. Let keys be a new empty List. 
-    for (_EJSPropertyMapEntry *s = O_->map->head_insert; s; s = s->next_insert) {
-        if (EJSVAL_IS_STRING(s->name)) {
-            ejsval idx_val = ToNumber(s->name);
+    EJSOwnPropertyIter iter;
+    _ejs_own_property_iter_init (&iter, O_);
+    while (_ejs_own_property_iter_next (&iter)) {
+        if (EJSVAL_IS_STRING(iter.name)) {
+            ejsval idx_val = ToNumber(iter.name);
             if (EJSVAL_IS_NUMBER(idx_val)) {
                 double n = EJSVAL_TO_NUMBER(idx_val);
                 if (floor(n) == n) {
                     // 2. For each own property key P of O that is an integer index, in ascending numeric index order 
                     //    a. Add P as the last element of keys. 
-                    numberkeys[num_numberkeys++] = s->name;
+                    numberkeys[num_numberkeys++] = iter.name;
                     continue;
                 }
             }
             // 3. For each own property key P of O that is a String but is not an integer index, in property creation order 
             //    a. Add P as the last element of keys. 
-            stringkeys[num_stringkeys++] = s->name;
+            stringkeys[num_stringkeys++] = iter.name;
         }
         else {
             // 4. For each own property key P of O that is a Symbol, in property creation order
             //    a. Add P as the last element of keys. 
-            symbolkeys[num_symbolkeys++] = s->name;
+            symbolkeys[num_symbolkeys++] = iter.name;
         }
     }
 
@@ -39,9 +39,6 @@ typedef struct {
     ejsval setter;
 } EJSPropertyDesc;
 
-EJSPropertyDesc* _ejs_propertydesc_new ();
-void _ejs_propertydesc_free (EJSPropertyDesc* desc);
-
 #define _ejs_property_desc_set_flag(p, v, propflag, flagset) EJS_MACRO_START \
     if ((v)) {                                                          \
         (p)->flags |= (propflag);                                       \
@@ -100,6 +97,7 @@ void _ejs_propertydesc_free (EJSPropertyDesc* desc);
 #define _ejs_property_desc_get_setter(p) _ejs_property_desc_get_value_flag_default(p, setter, EJS_PROP_FLAGS_SETTER_SET, _ejs_undefined)
 
 ejsval  ToPropertyKey          (ejsval argument);
+uint32_t PropertyKeyHash       (ejsval argument);
 void    ToPropertyDescriptor   (ejsval O, EJSPropertyDesc* desc);
 ejsval  FromPropertyDescriptor (EJSPropertyDesc* Desc);
 EJSBool IsDataDescriptor       (EJSPropertyDesc* Desc);
@@ -113,23 +111,23 @@ ejsval DeletePropertyOrThrow (ejsval O, ejsval P);
     
 typedef struct _EJSPropertyMapEntry _EJSPropertyMapEntry;
 struct _EJSPropertyMapEntry {
-    // the next entry in this bucket
-    _EJSPropertyMapEntry *next_bucket;
-
-    // the next entry in insertion order
-    _EJSPropertyMapEntry *next_insert;
-
     uint32_t hash;
-    ejsval name;
-    EJSPropertyDesc* desc;
+    uint32_t order; // where the entry is in the map's insertion order
+    ejsval name;    // all zero bits if the entry has never been used, undefined if its property was removed
+    EJSPropertyDesc desc;
 };
 
+// the dictionary an object keeps its properties in once it's given up its shape (see ejs-shape.h.)
+// an open addressed table of capacity (a power of 2) entries, followed by the insertion order: the
+// index of each entry in the order its property was added, with holes where properties were removed.
+// the whole map is a single gc store owned by the object, replaced by a bigger (or compacted) one
+// when it fills up.  objects start out pointing at _ejs_empty_propertymap and get a map of their own
+// on the first insert.
 struct _EJSPropertyMap {
-    _EJSPropertyMapEntry* head_insert;
-    _EJSPropertyMapEntry* tail_insert;
-    _EJSPropertyMapEntry** buckets;
-    int nbuckets;
-    int inuse;
+    uint32_t capacity;
+    uint32_t inuse;     // properties in the map
+    uint32_t num_order; // entries used in the insertion order, holes included
+    _EJSPropertyMapEntry entries[];
 };
 
 typedef struct _EJSPropertyMap EJSPropertyMap;
@@ -140,7 +138,9 @@ typedef void (*EJSPropertyDescFunc)(ejsval name, EJSPropertyDesc *desc, void* da
 typedef ejsval           (*SpecOpGetPrototypeOf) (ejsval obj);
 typedef EJSBool          (*SpecOpSetPrototypeOf) (ejsval obj, ejsval proto);
 typedef ejsval           (*SpecOpGet) (ejsval obj, ejsval propertyName, ejsval receiver);
-typedef EJSPropertyDesc* (*SpecOpGetOwnProperty) (ejsval obj, ejsval propertyName, ejsval* exc);
+// fills in @desc and returns it, or returns NULL if there's no such property.  changing @desc doesn't
+// change the property, use DefineOwnProperty for that.
+typedef EJSPropertyDesc* (*SpecOpGetOwnProperty) (ejsval obj, ejsval propertyName, ejsval* exc, EJSPropertyDesc* desc);
 typedef EJSBool          (*SpecOpSet) (ejsval obj, ejsval propertyName, ejsval val, ejsval receiver);
 typedef EJSBool          (*SpecOpHasProperty) (ejsval obj, ejsval propertyName);
 typedef EJSBool          (*SpecOpDelete) (ejsval obj, ejsval propertyName, EJSBool flag);
@@ -216,13 +216,28 @@ void _ejs_Class_initialize (EJSSpecOps *child, EJSSpecOps* parent);
 
 #define EJS_OBJECT_IS_EXTENSIBLE(o) ((((EJSObject*)(o))->gc_header & EJS_OBJECT_EXTENSIBLE_FLAG_SHIFTED) != 0)
 
+// set on prototypes that a cached property store depends on, see EJSPropertyIC
+#define EJS_OBJECT_WATCHED_PROTO_FLAG 0x02
+
+#define EJS_OBJECT_WATCHED_PROTO_FLAG_SHIFTED (EJS_OBJECT_WATCHED_PROTO_FLAG << EJS_GC_USER_FLAGS_SHIFT)
+
+#define EJS_OBJECT_SET_WATCHED_PROTO(o) (((EJSObject*)(o))->gc_header |= EJS_OBJECT_WATCHED_PROTO_FLAG_SHIFTED)
+#define EJS_OBJECT_IS_WATCHED_PROTO(o) ((((EJSObject*)(o))->gc_header & EJS_OBJECT_WATCHED_PROTO_FLAG_SHIFTED) != 0)
+
 struct _EJSObject {
     GCObjectHeader   gc_header;
     EJSSpecOps*      ops;
     ejsval           proto; // [[Prototype]]
+    EJSShape*        shape; // NULL once the object's properties are in map
+    ejsval*          slots; // the property values, laid out by shape
     EJSPropertyMap*  map;
 };
 
+// objects allocated by the Object class's Allocate op have room for their first few property values
+// right after the object, and only need slots of their own once they outgrow it.
+#define EJS_OBJECT_NUM_INLINE_SLOTS 4
+#define EJS_OBJECT_INLINE_SLOTS(o) ((ejsval*)((EJSObject*)(o) + 1))
+
 
 #define OP(o,op) EJS_ASSERT_VAL(o, "object is null in call to " #op " op", (((EJSObject*)o)->ops->op))
 
@@ -230,10 +245,49 @@ struct _EJSObject {
 
 EJS_BEGIN_DECLS
 
-void _ejs_propertymap_init (EJSPropertyMap* map);
+extern EJSPropertyMap _ejs_empty_propertymap;
+
+// the storage behind the Object class's ops, whether the object has a shape or a dictionary.
+// lookup fills in and returns @desc, or returns NULL.  insert copies @desc into @obj, replacing the
+// existing property named @name if there is one.  string names are interned on the way in (see
+// _ejs_string_intern), so shapes and maps compare names by pointer.
+EJSPropertyDesc* _ejs_object_lookup_property (EJSObject *obj, ejsval name, EJSPropertyDesc* desc);
+void _ejs_object_insert_property (EJSObject *obj, ejsval name, EJSPropertyDesc* desc);
+void _ejs_object_remove_property (EJSObject *obj, ejsval name);
+uint32_t _ejs_object_num_properties (EJSObject *obj);
+
+#define EJS_SHAPE_MAX_PROPERTIES 64 // objects go to dictionary mode past this many properties
+
+// walks an object's own properties in insertion order:
+//
+//   EJSOwnPropertyIter iter;
+//   _ejs_own_property_iter_init (&iter, obj);
+//   while (_ejs_own_property_iter_next (&iter)) { ... iter.name, iter.desc ... }
+//
+// properties added or removed while iterating might or might not be seen.  the iterator has to live on
+// the stack, where the collector can see what it's walking.
+typedef struct {
+    ejsval name;
+    EJSPropertyDesc* desc;
+
+    EJSObject* obj;
+    ejsval shape; // the shape being walked, which obj might have moved on from
+    uint32_t index;
+    EJSPropertyMap* map; // the map being walked, only compared against obj's
+    EJSShape* chain[EJS_SHAPE_MAX_PROPERTIES];
+    EJSPropertyDesc storage;
+} EJSOwnPropertyIter;
+
+void    _ejs_own_property_iter_init (EJSOwnPropertyIter* iter, EJSObject* obj);
+EJSBool _ejs_own_property_iter_next (EJSOwnPropertyIter* iter);
+
+// these expect @name to be an atom or a symbol
 EJSPropertyDesc* _ejs_propertymap_lookup (EJSPropertyMap *map, ejsval name);
-void _ejs_propertymap_insert (EJSPropertyMap *map, ejsval name, EJSPropertyDesc* desc);
+// copies @desc into @obj's map, replacing the existing property named @name if there is one
+void _ejs_propertymap_insert (EJSObject *obj, ejsval name, EJSPropertyDesc* desc);
 void _ejs_propertymap_remove (EJSPropertyMap *map, ejsval name);
+// marks the map's stores and passes every name and value/getter/setter in it to @scan_func
+void _ejs_propertymap_scan (EJSPropertyMap *map, EJSValueFunc scan_func);
 void _ejs_propertymap_foreach_value (EJSPropertyMap *map, EJSValueFunc foreach_func);
 void _ejs_propertymap_foreach_property (EJSPropertyMap *map, EJSPropertyDescFunc foreach_func, void* data);
 
@@ -243,6 +297,46 @@ EJSBool _ejs_object_define_accessor_property (ejsval obj, ejsval key, ejsval get
 ejsval _ejs_object_setprop (ejsval obj, ejsval key, ejsval value);
 ejsval _ejs_object_getprop (ejsval obj, ejsval key);
 
+// an inline cache for one obj.name load or store in compiled code.  the compiler emits a zeroed
+// EJSPropertyIC for each site and passes it (with the same name, every time) to
+// _ejs_object_getprop_ic/_ejs_object_setprop_ic, which remember the shapes of the ordinary objects
+// they've seen and where the property was for each.  a site that sees more than
+// EJS_PROPERTY_IC_ENTRIES shapes goes through the generic path until the cache is next reset.
+//
+// caches hold raw pointers, so they're reset after every collection (when _ejs_gc_epoch changes.)
+// stores that add a property also depend on nothing in the receiver's prototype chain having a
+// setter or read-only property with that name.  the prototypes are marked as watched, and giving one
+// of them such a property (or a new prototype) changes _ejs_property_ic_store_epoch.
+#define EJS_PROPERTY_IC_ENTRIES 4
+
+typedef enum {
+    EJS_PROPERTY_IC_OWN,   // a data property of the receiver
+    EJS_PROPERTY_IC_PROTO, // a data property of the receiver's prototype (loads only)
+    EJS_PROPERTY_IC_ADD    // a store that adds a data property to the receiver
+} EJSPropertyICKind;
+
+typedef struct {
+    EJSSpecOps* ops;
+    EJSShape*   shape;        // the receiver's shape
+    EJSShape*   target_shape; // PROTO: the prototype's shape.  ADD: the receiver's new shape
+    ejsval      proto;        // PROTO, ADD: the receiver's prototype
+    uint32_t    kind;
+    uint32_t    slot;         // in the receiver (OWN, ADD) or the prototype (PROTO)
+} EJSPropertyICEntry;
+
+typedef struct {
+    uint32_t gc_epoch;
+    uint32_t store_epoch;
+    uint32_t num_entries;
+    uint32_t unused;
+    EJSPropertyICEntry entries[EJS_PROPERTY_IC_ENTRIES];
+} EJSPropertyIC;
+
+extern uint32_t _ejs_property_ic_store_epoch;
+
+ejsval _ejs_object_getprop_ic (ejsval obj, ejsval key, EJSPropertyIC* ic);
+ejsval _ejs_object_setprop_ic (ejsval obj, ejsval key, ejsval value, EJSPropertyIC* ic);
+
 ejsval _ejs_global_setprop (ejsval key, ejsval value);
 ejsval _ejs_global_getprop (ejsval key);
 
@@ -207,21 +207,17 @@ ejsval ToNumber(ejsval exp)
     else if (EJSVAL_IS_BOOLEAN(exp))
         return EJSVAL_TO_BOOLEAN(exp) ? _ejs_one : _ejs_zero;
     else if (EJSVAL_IS_STRING(exp)) {
-        char num_utf8_buf[128];
-        memset(num_utf8_buf, 0, sizeof(num_utf8_buf));
-        char* num_utf8 = ucs2_to_utf8_buf(EJSVAL_TO_FLAT_STRING(exp), num_utf8_buf, sizeof(num_utf8_buf));
-        if (num_utf8 == NULL) {
-            num_utf8 = ucs2_to_utf8(EJSVAL_TO_FLAT_STRING(exp));
-        }
+        // anything strtod accepts is short, so this rarely leaves the stack
+        EJSUtf8Buffer num_utf8;
+        _ejs_string_utf8_buffer_init (&num_utf8, exp);
         char *endptr;
-        double d = strtod(num_utf8, &endptr);
-        if (*endptr != '\0') {
-            if (num_utf8 != num_utf8_buf) free (num_utf8);
+        double d = strtod(num_utf8.str, &endptr);
+        // the whole string has to be the number, including past any 0 in it
+        EJSBool consumed = endptr == num_utf8.str + num_utf8.length;
+        _ejs_string_utf8_buffer_free (&num_utf8);
+        if (!consumed)
             return _ejs_nan;
-        }
-        ejsval rv = NUMBER_TO_EJSVAL(d); // XXX NaN
-        if (num_utf8 != num_utf8_buf) free (num_utf8);
-        return rv;
+        return NUMBER_TO_EJSVAL(d); // XXX NaN
     }
     else if (EJSVAL_IS_UNDEFINED(exp))
         return _ejs_nan;
@@ -463,10 +459,7 @@ SameValue(ejsval x, ejsval y)
     if (EJSVAL_IS_STRING(x)) {
         // a. If x and y are exactly the same sequence of code units (same length and same code units in corresponding positions) return true;
         //    otherwise, return false.
-        if (EJSVAL_TO_STRLEN(x) != EJSVAL_TO_STRLEN(y)) return EJS_FALSE;
-
-        // XXX there is doubtless a more efficient way to compare two ropes, but we convert but to flat strings for now.
-        return ucs2_strcmp (EJSVAL_TO_FLAT_STRING(x), EJSVAL_TO_FLAT_STRING(y)) ? EJS_FALSE : EJS_TRUE;
+        return _ejs_primstring_equal (EJSVAL_TO_STRING(x), EJSVAL_TO_STRING(y));
     }
     // 8. If Type(x) is Boolean, then
     if (EJSVAL_IS_BOOLEAN(x)) {
@@ -520,10 +513,7 @@ SameValueZero(ejsval x, ejsval y)
     if (EJSVAL_IS_STRING(x)) {
         //    a. If x and y are exactly the same sequence of code units (same length and same code units in corresponding positions) return true;
         //       otherwise, return false.
-        if (EJSVAL_TO_STRLEN(x) != EJSVAL_TO_STRLEN(y)) return EJS_FALSE;
-
-        // XXX there is doubtless a more efficient way to compare two ropes, but we convert but to flat strings for now.
-        return ucs2_strcmp (EJSVAL_TO_FLAT_STRING(x), EJSVAL_TO_FLAT_STRING(y)) ? EJS_FALSE : EJS_TRUE;
+        return _ejs_primstring_equal (EJSVAL_TO_STRING(x), EJSVAL_TO_STRING(y));
     }
     // 8. If Type(x) is Boolean, then
     if (EJSVAL_IS_BOOLEAN(x)) {
@@ -883,7 +873,7 @@ _ejs_op_lt_ejsbool (ejsval lhs, ejsval rhs)
         ejsval lstr = ToString(lprim);
         ejsval rstr = ToString(rprim);
 
-        return ucs2_strcmp (EJSVAL_TO_FLAT_STRING(lstr), EJSVAL_TO_FLAT_STRING(rstr)) < 0;
+        return _ejs_primstring_compare (EJSVAL_TO_STRING(lstr), EJSVAL_TO_STRING(rstr)) < 0;
     }
 
     return ToDouble(lprim) < ToDouble(rprim);
@@ -901,7 +891,7 @@ _ejs_op_le (ejsval lhs, ejsval rhs)
         ejsval lstr = ToString(lprim);
         ejsval rstr = ToString(rprim);
 
-        return BOOLEAN_TO_EJSVAL (ucs2_strcmp (EJSVAL_TO_FLAT_STRING(lstr), EJSVAL_TO_FLAT_STRING(rstr)) <= 0);
+        return BOOLEAN_TO_EJSVAL (_ejs_primstring_compare (EJSVAL_TO_STRING(lstr), EJSVAL_TO_STRING(rstr)) <= 0);
     }
 
     return BOOLEAN_TO_EJSVAL(ToDouble(lprim) <= ToDouble(rprim));
@@ -919,7 +909,7 @@ _ejs_op_gt (ejsval lhs, ejsval rhs)
         ejsval lstr = ToString(lprim);
         ejsval rstr = ToString(rprim);
 
-        return BOOLEAN_TO_EJSVAL (ucs2_strcmp (EJSVAL_TO_FLAT_STRING(lstr), EJSVAL_TO_FLAT_STRING(rstr)) > 0);
+        return BOOLEAN_TO_EJSVAL (_ejs_primstring_compare (EJSVAL_TO_STRING(lstr), EJSVAL_TO_STRING(rstr)) > 0);
     }
 
     return BOOLEAN_TO_EJSVAL(ToDouble(lprim) > ToDouble(rprim));
@@ -937,7 +927,7 @@ _ejs_op_ge (ejsval lhs, ejsval rhs)
         ejsval lstr = ToString(lprim);
         ejsval rstr = ToString(rprim);
 
-        return BOOLEAN_TO_EJSVAL (ucs2_strcmp (EJSVAL_TO_FLAT_STRING(lstr), EJSVAL_TO_FLAT_STRING(rstr)) >= 0);
+        return BOOLEAN_TO_EJSVAL (_ejs_primstring_compare (EJSVAL_TO_STRING(lstr), EJSVAL_TO_STRING(rstr)) >= 0);
     }
 
     return BOOLEAN_TO_EJSVAL(ToDouble(lprim) >= ToDouble(rprim));
@@ -986,9 +976,7 @@ _ejs_op_strict_eq (ejsval x, ejsval y)
     if (EJSVAL_IS_STRING(x)) {
         //    a. If x and y are exactly the same sequence of characters (same length and same characters in corresponding positions), return true.
         //    b. Else, return false.
-        if (EJSVAL_TO_STRLEN(x) != EJSVAL_TO_STRLEN(y))
-            return _ejs_false;
-        return BOOLEAN_TO_EJSVAL (!ucs2_strcmp (EJSVAL_TO_FLAT_STRING(x), EJSVAL_TO_FLAT_STRING(y)));
+        return BOOLEAN_TO_EJSVAL (_ejs_primstring_equal (EJSVAL_TO_STRING(x), EJSVAL_TO_STRING(y)));
     }
     // 6. If Type(x) is Boolean, then
     if (EJSVAL_IS_BOOLEAN(x)) {
@@ -149,6 +149,7 @@ static ejsval RejectPromise (ejsval promise, ejsval reason)
 
     // 3. Set the value of promise's [[PromiseResult]] internal slot to reason. 
     _promise->result = reason;
+    _ejs_gc_write_barrier(_promise, reason);
 
     // 4. Set the value of promise's [[PromiseFulfillReactions]] internal slot to undefined. 
     // XXX we need to free our listnodes
@@ -180,6 +181,7 @@ static ejsval FulfillPromise (ejsval promise, ejsval resolutionValue)
     EJSPromiseReaction* reactions = _promise->fulfillReactions;
     // 3. Set the value of promise's [[PromiseResult]] internal slot to resolutionvalue. 
     _promise->result = resolutionValue;
+    _ejs_gc_write_barrier(_promise, resolutionValue);
 
     // 4. Set the value of promise's [[PromiseFulfullReactions]] internal slot to undefined. 
     // XXX we need to free our listnodes
@@ -596,6 +598,7 @@ _ejs_Promise_prototype_then (ejsval env, ejsval _this, uint32_t argc, ejsval *ar
         EJS_LIST_APPEND(EJSPromiseReaction, fulfillReaction, _promise->fulfillReactions);
         //        b. Append rejectReaction as the last element of the List that is the value of promise's [[PromiseRejectReactions]] internal slot. 
         EJS_LIST_APPEND(EJSPromiseReaction, rejectReaction, _promise->rejectReactions);
+        _ejs_gc_remember(_promise);
     }
     // 13. Else if the value of promise's [[PromiseState]] internal slot is "fulfilled", 
     else if (_promise->state == PROMISE_STATE_FULFILLED) {
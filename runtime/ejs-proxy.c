@@ -71,9 +71,11 @@ _ejs_Proxy_impl (ejsval env, ejsval _this, uint32_t argc, ejsval *args)
 
     // 6. Set the [[ProxyTarget]] internal slot of P to target. 
     P->target = target;
+    _ejs_gc_write_barrier(P, target);
     
     // 7. Set the [[ProxyHandler]] internal slot of P to handler. 
     P->handler = handler;
+    _ejs_gc_write_barrier(P, handler);
 
     // 8. Return P. 
     return _this;
@@ -273,7 +275,8 @@ _ejs_proxy_specop_get (ejsval obj, ejsval propertyName, ejsval receiver)
 
     // 10. Let targetDesc be the result of calling the [[GetOwnProperty]] internal method of target with argument P.
     // 11. ReturnIfAbrupt(targetDesc). 
-    EJSPropertyDesc* targetDesc = OP(_target,GetOwnProperty)(target, propertyName, NULL);
+    EJSPropertyDesc targetDesc_storage;
+    EJSPropertyDesc* targetDesc = OP(_target,GetOwnProperty)(target, propertyName, NULL, &targetDesc_storage);
 
     // 12. If targetDesc is not undefined, then 
     if (!targetDesc) {
@@ -295,7 +298,7 @@ _ejs_proxy_specop_get (ejsval obj, ejsval propertyName, ejsval receiver)
 }
 
 static EJSPropertyDesc*
-_ejs_proxy_specop_get_own_property (ejsval O, ejsval P, ejsval* exc)
+_ejs_proxy_specop_get_own_property (ejsval O, ejsval P, ejsval* exc, EJSPropertyDesc* desc)
 {
     // 1. Assert: IsPropertyKey(P) is true. 
     EJSProxy* proxy = EJSVAL_TO_PROXY(O);
@@ -319,7 +322,7 @@ _ejs_proxy_specop_get_own_property (ejsval O, ejsval P, ejsval* exc)
     // 7. If trap is undefined, then 
     if (EJSVAL_IS_UNDEFINED(trap)) {
         //    a. Return the result of calling the [[GetOwnProperty]] internal method of target with argument P.
-        return OP(_target,GetOwnProperty)(target, P, NULL);
+        return OP(_target,GetOwnProperty)(target, P, NULL, desc);
     }
 
     // 8. Let trapResultObj be the result of calling the [[Call]] internal method of trap with handler as the this value and a new List containing target and P. 
@@ -334,7 +337,8 @@ _ejs_proxy_specop_get_own_property (ejsval O, ejsval P, ejsval* exc)
 
     // 11. Let targetDesc be the result of calling the [[GetOwnProperty]] internal method of target with argument P. 
     // 12. ReturnIfAbrupt(targetDesc). 
-    EJSPropertyDesc* targetDesc = OP(_target,GetOwnProperty)(target, P, NULL);
+    EJSPropertyDesc targetDesc_storage;
+    EJSPropertyDesc* targetDesc = OP(_target,GetOwnProperty)(target, P, NULL, &targetDesc_storage);
 
     // 13. If trapResultObj is undefined, then 
     if (EJSVAL_IS_UNDEFINED(trapResultObj)) {
@@ -433,7 +437,8 @@ _ejs_proxy_specop_set (ejsval obj, ejsval propertyName, ejsval val, ejsval recei
 
     // 12. Let targetDesc be the result of calling the [[GetOwnProperty]] internal method of target with argument P. 
     // 13. ReturnIfAbrupt(targetDesc). 
-    EJSPropertyDesc* targetDesc = OP(_target,GetOwnProperty)(target, propertyName, NULL);
+    EJSPropertyDesc targetDesc_storage;
+    EJSPropertyDesc* targetDesc = OP(_target,GetOwnProperty)(target, propertyName, NULL, &targetDesc_storage);
 
     // 14. If targetDesc is not undefined, then 
     if (targetDesc) {
@@ -495,7 +500,8 @@ _ejs_proxy_specop_has_property (ejsval O, ejsval P)
     if (!booleanTrapResult) {
         //     a. Let targetDesc be the result of calling the [[GetOwnProperty]] internal method of target with argument P. 
         //     b. ReturnIfAbrupt(targetDesc). 
-        EJSPropertyDesc* targetDesc = OP(_target,GetOwnProperty)(target, P, NULL);
+        EJSPropertyDesc targetDesc_storage;
+        EJSPropertyDesc* targetDesc = OP(_target,GetOwnProperty)(target, P, NULL, &targetDesc_storage);
 
         //     c. If targetDesc is not undefined, then 
         if (!targetDesc) {
@@ -562,7 +568,8 @@ _ejs_proxy_specop_delete (ejsval O, ejsval P, EJSBool unusedflag)
 
     // 12. Let targetDesc be the result of calling the [[GetOwnProperty]] internal method of target with argument P. 
     // 13. ReturnIfAbrupt(targetDesc). 
-    EJSPropertyDesc* targetDesc = OP(_target,GetOwnProperty)(target, P, NULL);
+    EJSPropertyDesc targetDesc_storage;
+    EJSPropertyDesc* targetDesc = OP(_target,GetOwnProperty)(target, P, NULL, &targetDesc_storage);
 
     // 14. If targetDesc is undefined, then return true. 
     if (!targetDesc)
@@ -620,7 +627,8 @@ _ejs_proxy_specop_define_own_property (ejsval O, ejsval P, EJSPropertyDesc* Desc
 
     // 14. Let targetDesc be the result of calling the [[GetOwnProperty]] internal method of target with argument P. 
     // 15. ReturnIfAbrupt(targetDesc). 
-    EJSPropertyDesc* targetDesc = OP(_target,GetOwnProperty)(target, P, NULL);
+    EJSPropertyDesc targetDesc_storage;
+    EJSPropertyDesc* targetDesc = OP(_target,GetOwnProperty)(target, P, NULL, &targetDesc_storage);
 
     // 16. Let extensibleTarget be IsExtensible(target). 
     // 17. ReturnIfAbrupt(extensibleTarget). 
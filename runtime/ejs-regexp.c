@@ -132,6 +132,8 @@ _ejs_RegExp_impl (ejsval env, ejsval _this, uint32_t argc, ejsval *args)
 
     if (argc > 0) re->pattern = args[0];
     if (argc > 1) re->flags = args[1];
+    _ejs_gc_write_barrier(re, re->pattern);
+    _ejs_gc_write_barrier(re, re->flags);
 
     if (!EJSVAL_IS_STRING(re->pattern))
         EJS_NOT_IMPLEMENTED();
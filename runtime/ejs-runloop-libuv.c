@@ -1,6 +1,7 @@
 #if HAVE_LIBUV
 
 #include "ejs-runloop.h"
+#include "ejs-gc.h"
 
 #include "uv.h"
 
@@ -12,6 +13,31 @@ typedef struct {
   TaskDataDtor dtor;
 } task_timer;
 
+// when the collector is in the middle of an incremental mark, or leaves pages unswept, do a bit of
+// that work at a time while the loop is idle
+#define IDLE_MARK_BUDGET 8192
+#define IDLE_SWEEP_BUDGET 64
+
+static uv_idle_t gc_idle;
+static int gc_idle_active;
+
+static int
+gc_work_pending()
+{
+  return _ejs_gc_mark_some(0) || _ejs_gc_sweep_some(0);
+}
+
+static void
+gc_when_idle(uv_idle_t* idle, int unused)
+{
+  if (_ejs_gc_mark_some(IDLE_MARK_BUDGET))
+    return;
+  if (!_ejs_gc_sweep_some(IDLE_SWEEP_BUDGET)) {
+    uv_idle_stop(idle);
+    gc_idle_active = 0;
+  }
+}
+
 static void
 invoke_task(uv_timer_t* timer, int unused)
 {
@@ -20,6 +46,11 @@ invoke_task(uv_timer_t* timer, int unused)
   t->dtor(t->data);
   uv_timer_stop(timer);
   free(t);
+
+  if (!gc_idle_active && gc_work_pending()) {
+    uv_idle_start(&gc_idle, gc_when_idle);
+    gc_idle_active = 1;
+  }
 }
 
 void
@@ -38,6 +69,7 @@ _ejs_runloop_add_task(Task task, void* data, TaskDataDtor dtor)
 void
 _ejs_runloop_start()
 {
+  uv_idle_init(uv_default_loop(), &gc_idle);
   uv_run(uv_default_loop(), UV_RUN_DEFAULT);
 }
 
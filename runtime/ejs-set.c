@@ -241,6 +241,7 @@ _ejs_set_add(ejsval S, ejsval value)
     // 8. Append value as the last element of entries. 
     e = calloc (1, sizeof (EJSSetValueEntry));
     e->value = value;
+    _ejs_gc_write_barrier(_set, value);
 
     if (!_set->head_insert)
         _set->head_insert = e;
@@ -0,0 +1,283 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-
+ * vim: set ts=4 sw=4 et tw=99 ft=cpp:
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ejs-shape.h"
+#include "ejs-gc.h"
+#include "ejs-ops.h"
+#include "ejs-string.h"
+
+typedef struct _EJSShapeTable {
+    uint32_t size;  // a power of 2
+    uint32_t count; // the number of properties of the last shape added to the table
+    EJSShape* entries[];
+} EJSShapeTable;
+
+static ejsval _ejs_empty_shape_val EJSVAL_ALIGNMENT;
+EJSShape* _ejs_empty_shape;
+
+// the children nothing remembers, which start trees of their own.  like transitions, these don't
+// keep them alive.
+static EJSShape** detached_shapes;
+static uint32_t num_detached_shapes;
+static uint32_t detached_shapes_size;
+
+static EJSShape*
+table_lookup (EJSShapeTable* table, EJSShape* shape, ejsval name, uint32_t hash)
+{
+    uint32_t mask = table->size - 1;
+    for (uint32_t i = hash & mask; table->entries[i]; i = (i + 1) & mask) {
+        EJSShape* s = table->entries[i];
+        if (EJSVAL_EQ(name, s->name))
+            // the table might have been extended by one of shape's descendants
+            return s->num_properties <= shape->num_properties ? s : NULL;
+    }
+    return NULL;
+}
+
+static void
+table_insert (EJSShapeTable* table, EJSShape* s)
+{
+    uint32_t mask = table->size - 1;
+    uint32_t i = s->hash & mask;
+    while (table->entries[i])
+        i = (i + 1) & mask;
+    table->entries[i] = s;
+}
+
+// the table for a new shape.  we add to the parent's table if nothing else has, and it has room,
+// so a chain of shapes built up one property at a time shares one table.  otherwise we build a new
+// one from the shape's ancestors.
+static void
+attach_table (EJSShape* shape, EJSBool shared)
+{
+    EJSShapeTable* table = shape->parent->table;
+    if (shared && table && table->count == shape->parent->num_properties && (table->count + 1) * 2 <= table->size) {
+        table_insert (table, shape);
+        table->count ++;
+        shape->table = table;
+        _ejs_gc_remember (shape);
+        return;
+    }
+
+    uint32_t size = 16;
+    while (size < shape->num_properties * 4)
+        size <<= 1;
+
+    table = (EJSShapeTable*)_ejs_gc_new_store (sizeof(EJSShapeTable) + size * sizeof(EJSShape*));
+    table->size = size;
+    table->count = shape->num_properties;
+    for (EJSShape* s = shape; s->parent; s = s->parent)
+        table_insert (table, s);
+    shape->table = table;
+    _ejs_gc_remember (shape);
+}
+
+static void
+add_transition (EJSShape* shape, EJSShape* child)
+{
+    if (shape->num_transitions == shape->transitions_size) {
+        uint32_t new_size = shape->transitions_size ? shape->transitions_size * 2 : 2;
+        EJSShape** transitions = (EJSShape**)_ejs_gc_new_store (new_size * sizeof(EJSShape*));
+        if (shape->num_transitions)
+            memmove (transitions, shape->transitions, shape->num_transitions * sizeof(EJSShape*));
+        shape->transitions = transitions;
+        shape->transitions_size = new_size;
+        _ejs_gc_remember (shape);
+    }
+    // transitions are weak references, so there's no write barrier
+    shape->transitions[shape->num_transitions++] = child;
+}
+
+// appends @shape to a malloc'd array of shapes, growing it if it's full
+static EJSShape**
+shape_list_push (EJSShape** list, uint32_t* count, uint32_t* size, EJSShape* shape)
+{
+    if (*count == *size) {
+        *size = *size ? *size * 2 : 64;
+        list = (EJSShape**)realloc (list, *size * sizeof(EJSShape*));
+    }
+    list[(*count)++] = shape;
+    return list;
+}
+
+static EJSShape*
+shape_new ()
+{
+    EJSShape* shape = _ejs_gc_new(EJSShape);
+    _ejs_init_object ((EJSObject*)shape, _ejs_null, &_ejs_Shape_specops);
+    // shapes have no properties of their own, so they don't need one
+    shape->obj.shape = NULL;
+    return shape;
+}
+
+EJSShape*
+_ejs_shape_add_property (EJSShape* shape, ejsval name, uint32_t flags)
+{
+    uint32_t hash = PropertyKeyHash(name);
+
+    for (uint32_t i = 0; i < shape->num_transitions; i ++) {
+        EJSShape* child = shape->transitions[i];
+        if (child->flags == flags && EJSVAL_EQ(name, child->name)) {
+            _ejs_gc_shade (child);
+            return child;
+        }
+    }
+
+    if (shape->num_properties == EJS_SHAPE_MAX_PROPERTIES)
+        return NULL;
+
+    // nothing else refers to the child until we return it, so keep it where the stack scan will
+    // find it while we allocate its transitions and table
+    EJSShape* child = shape_new();
+    volatile ejsval child_val = OBJECT_TO_EJSVAL(child);
+
+    child->parent = shape;
+    child->name = name;
+    child->hash = hash;
+    child->flags = flags;
+    child->slot = shape->num_slots;
+    child->num_slots = shape->num_slots + EJS_SHAPE_PROPERTY_SLOTS(flags);
+    child->num_properties = shape->num_properties + 1;
+
+    // once a shape has lots of different children we stop remembering new ones, so objects with
+    // one-off sets of keys don't fill up the tree.  either way the child is collected along with the
+    // last object using it.
+    EJSBool shared = shape->num_transitions < EJS_SHAPE_MAX_TRANSITIONS;
+    if (shared)
+        add_transition (shape, child);
+    else
+        detached_shapes = shape_list_push (detached_shapes, &num_detached_shapes, &detached_shapes_size, child);
+
+    if (child->num_properties > EJS_SHAPE_LINEAR_LOOKUP_MAX)
+        attach_table (child, shared);
+
+    return (EJSShape*)EJSVAL_TO_OBJECT(child_val);
+}
+
+EJSShape*
+_ejs_shape_lookup (EJSShape* shape, ejsval name)
+{
+    if (shape->num_properties == 0)
+        return NULL;
+
+    if (shape->table)
+        return table_lookup (shape->table, shape, name, PropertyKeyHash(name));
+
+    for (EJSShape* s = shape; s->parent; s = s->parent) {
+        if (EJSVAL_EQ(name, s->name))
+            return s;
+    }
+    return NULL;
+}
+
+static EJSObject*
+_ejs_shape_specop_allocate ()
+{
+    return (EJSObject*)_ejs_gc_new(EJSShape);
+}
+
+static void
+_ejs_shape_specop_scan (EJSObject* obj, EJSValueFunc scan_func)
+{
+    EJSShape* shape = (EJSShape*)obj;
+
+    if (shape->parent)
+        scan_func (OBJECT_TO_EJSVAL(shape->parent));
+    scan_func (shape->name);
+
+    // the transitions are weak, and forgotten by _ejs_shape_purge_transitions when the collector
+    // finds nothing else using them
+    _ejs_gc_mark_store (shape->transitions);
+
+    // the shapes in the table past this one are descendants sharing it.  they're dropped from the
+    // table along with the transition to them.
+    _ejs_gc_mark_store (shape->table);
+
+    _ejs_Object_specops.Scan (obj, scan_func);
+}
+
+// @shape's child is about to be swept, and was sharing @shape's table.  the child and all the
+// shapes sharing the table after it are dead, and they were the last ones put in it, so clearing
+// their entries leaves the table as it was before they were added.
+static void
+table_truncate (EJSShapeTable* table, EJSShape* shape)
+{
+    for (uint32_t i = 0; i < table->size; i ++) {
+        EJSShape* s = table->entries[i];
+        if (s && s->num_properties > shape->num_properties)
+            table->entries[i] = NULL;
+    }
+    table->count = shape->num_properties;
+}
+
+void
+_ejs_shape_purge_transitions ()
+{
+    // a stack of the live shapes left to visit, since the trees are as deep as the most properties
+    // an object has
+    EJSShape** stack = NULL;
+    uint32_t depth = 0;
+    uint32_t stack_size = 0;
+    stack = shape_list_push (stack, &depth, &stack_size, _ejs_empty_shape);
+
+    uint32_t num_live = 0;
+    for (uint32_t i = 0; i < num_detached_shapes; i ++) {
+        EJSShape* shape = detached_shapes[i];
+        if (_ejs_gc_is_collectable (shape))
+            continue;
+        detached_shapes[num_live++] = shape;
+        stack = shape_list_push (stack, &depth, &stack_size, shape);
+    }
+    num_detached_shapes = num_live;
+
+    while (depth > 0) {
+        EJSShape* shape = stack[--depth];
+        uint32_t live = 0;
+        for (uint32_t i = 0; i < shape->num_transitions; i ++) {
+            EJSShape* child = shape->transitions[i];
+            if (_ejs_gc_is_collectable (child)) {
+                if (child->table && child->table == shape->table)
+                    table_truncate (shape->table, shape);
+                continue;
+            }
+            shape->transitions[live++] = child;
+            stack = shape_list_push (stack, &depth, &stack_size, child);
+        }
+        // clear the rest, so the store doesn't keep pointing at swept cells
+        for (uint32_t i = live; i < shape->num_transitions; i ++)
+            shape->transitions[i] = NULL;
+        shape->num_transitions = live;
+    }
+
+    free (stack);
+}
+
+EJS_DEFINE_CLASS(Shape,
+                 OP_INHERIT, // [[GetPrototypeOf]]
+                 OP_INHERIT, // [[SetPrototypeOf]]
+                 OP_INHERIT, // [[IsExtensible]]
+                 OP_INHERIT, // [[PreventExtensions]]
+                 OP_INHERIT, // [[GetOwnProperty]]
+                 OP_INHERIT, // [[DefineOwnProperty]]
+                 OP_INHERIT, // [[HasProperty]]
+                 OP_INHERIT, // [[Get]]
+                 OP_INHERIT, // [[Set]]
+                 OP_INHERIT, // [[Delete]]
+                 OP_INHERIT, // [[Enumerate]]
+                 OP_INHERIT, // [[OwnPropertyKeys]]
+                 _ejs_shape_specop_allocate,
+                 OP_INHERIT, // [[Finalize]]
+                 _ejs_shape_specop_scan)
+
+void
+_ejs_shape_init()
+{
+    _ejs_gc_add_root (&_ejs_empty_shape_val);
+    _ejs_empty_shape = shape_new();
+    _ejs_empty_shape->name = _ejs_undefined;
+    _ejs_empty_shape_val = OBJECT_TO_EJSVAL(_ejs_empty_shape);
+}
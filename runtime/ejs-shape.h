@@ -0,0 +1,69 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-
+ * vim: set ts=4 sw=4 et tw=99 ft=cpp:
+ */
+
+#ifndef _ejs_shape_h_
+#define _ejs_shape_h_
+
+#include "ejs-object.h"
+
+// a shape (hidden class) describes the names, attributes and slot layout of an object's own
+// properties, so objects built up the same way can share one and keep only their values.  shapes
+// are immutable.  each one adds a single property to its parent, and adding a property to an object
+// moves it to a child of its current shape, found (or created and remembered) in the parent's
+// transitions.  every shape tree starts at _ejs_empty_shape.  transitions are weak, so a shape lives
+// only as long as the objects (and descendant shapes) using it.
+//
+// objects with too many properties, or whose properties are deleted or reconfigured, drop their
+// shape and keep their properties in a dictionary (EJSPropertyMap) instead.
+
+#define EJS_SHAPE_MAX_TRANSITIONS 32    // past this, a shape's new children aren't shared
+#define EJS_SHAPE_LINEAR_LOOKUP_MAX 8   // shapes with more properties than this get a hash table
+
+struct _EJSShape {
+    /* object header */
+    EJSObject obj;
+
+    EJSShape* parent;       // NULL for _ejs_empty_shape
+    ejsval    name;         // the property this shape adds
+    uint32_t  hash;
+    uint32_t  flags;        // the property's EJS_PROP_FLAGS_*
+    uint32_t  slot;         // where its value (or getter, then setter) is kept
+    uint32_t  num_slots;    // slots used by an object with this shape
+    uint32_t  num_properties;
+
+    // the children of this shape, and how many we have room for.  a gc store.
+    EJSShape** transitions;
+    uint32_t   num_transitions;
+    uint32_t   transitions_size;
+
+    // name -> shape, for shapes with more than EJS_SHAPE_LINEAR_LOOKUP_MAX properties.  a table is
+    // shared along a chain of shapes, each ignoring the entries added after it.  a gc store.
+    struct _EJSShapeTable* table;
+};
+
+// accessor properties keep their getter and setter in consecutive slots
+#define EJS_SHAPE_IS_ACCESSOR(s) (((s)->flags & (EJS_PROP_FLAGS_GETTER_SET | EJS_PROP_FLAGS_SETTER_SET)) != 0)
+#define EJS_SHAPE_PROPERTY_SLOTS(flags) (((flags) & (EJS_PROP_FLAGS_GETTER_SET | EJS_PROP_FLAGS_SETTER_SET)) != 0 ? 2 : 1)
+
+EJS_BEGIN_DECLS
+
+extern EJSShape* _ejs_empty_shape;
+extern EJSSpecOps _ejs_Shape_specops;
+
+void _ejs_shape_init();
+
+// the shape an object with @shape moves to when it gets a property named @name with attributes
+// @flags, or NULL if that would be too many properties.
+EJSShape* _ejs_shape_add_property (EJSShape* shape, ejsval name, uint32_t flags);
+
+// the shape (@shape itself or one of its ancestors) that added @name, or NULL
+EJSShape* _ejs_shape_lookup (EJSShape* shape, ejsval name);
+
+// called by the collector between marking and sweeping, to drop the transitions to shapes it's
+// about to sweep
+void _ejs_shape_purge_transitions ();
+
+EJS_END_DECLS
+
+#endif /* _ejs_shape_h_ */
@@ -0,0 +1,669 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-
+ * vim: set ts=4 sw=4 et tw=99 ft=cpp:
+ */
+#include <string.h>
+
+#include "ejs.h"
+#include "ejs-string-kernels.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define HAVE_SSE2 1
+#endif
+
+// AVX2 versions are compiled with the target attribute, so the rest of the runtime doesn't need
+// to be built for cpus that have it.
+#if HAVE_SSE2 && defined(__x86_64__) && (defined(__clang__) || defined(__GNUC__))
+#include <immintrin.h>
+#define HAVE_AVX2 1
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+#endif
+
+#define HASH_K 16777619
+
+/// searching
+
+// searches compare the first and last characters of the needle against every candidate position
+// (a block of positions at a time in the vector versions), and only compare the rest where both
+// match.
+
+static int
+latin1_index_of_portable (const uint8_t* haystack, int haystack_len, const uint8_t* needle, int needle_len, int start)
+{
+    const uint8_t* last_candidate = haystack + haystack_len - needle_len;
+    const uint8_t* p = haystack + start;
+    while (p <= last_candidate && (p = (const uint8_t*)memchr (p, needle[0], last_candidate - p + 1))) {
+        if (p[needle_len - 1] == needle[needle_len - 1] && !memcmp (p, needle, needle_len))
+            return p - haystack;
+        p ++;
+    }
+    return -1;
+}
+
+static int
+ucs2_index_of_portable (const jschar* haystack, int haystack_len, const jschar* needle, int needle_len, int start)
+{
+    jschar first = needle[0];
+    jschar last = needle[needle_len - 1];
+    for (int i = start; i <= haystack_len - needle_len; i ++) {
+        if (haystack[i] == first && haystack[i + needle_len - 1] == last && !memcmp (haystack + i, needle, needle_len * sizeof(jschar)))
+            return i;
+    }
+    return -1;
+}
+
+static int
+latin1_last_index_of_portable (const uint8_t* haystack, int haystack_len, const uint8_t* needle, int needle_len, int start)
+{
+    uint8_t first = needle[0];
+    uint8_t last = needle[needle_len - 1];
+    for (int i = start; i >= 0; i --) {
+        if (haystack[i] == first && haystack[i + needle_len - 1] == last && !memcmp (haystack + i, needle, needle_len))
+            return i;
+    }
+    return -1;
+}
+
+static int
+ucs2_last_index_of_portable (const jschar* haystack, int haystack_len, const jschar* needle, int needle_len, int start)
+{
+    jschar first = needle[0];
+    jschar last = needle[needle_len - 1];
+    for (int i = start; i >= 0; i --) {
+        if (haystack[i] == first && haystack[i + needle_len - 1] == last && !memcmp (haystack + i, needle, needle_len * sizeof(jschar)))
+            return i;
+    }
+    return -1;
+}
+
+#if HAVE_SSE2
+// movemask gives a bit per byte, so a ucs2 match at position n sets bits 2n and 2n+1
+
+static int
+latin1_index_of_sse2 (const uint8_t* haystack, int haystack_len, const uint8_t* needle, int needle_len, int start)
+{
+    __m128i first = _mm_set1_epi8 ((char)needle[0]);
+    __m128i last = _mm_set1_epi8 ((char)needle[needle_len - 1]);
+    int i = start;
+
+    for (; i + 16 <= haystack_len - needle_len + 1; i += 16) {
+        __m128i block_first = _mm_loadu_si128 ((const __m128i*)(haystack + i));
+        __m128i block_last = _mm_loadu_si128 ((const __m128i*)(haystack + i + needle_len - 1));
+        unsigned mask = _mm_movemask_epi8 (_mm_and_si128 (_mm_cmpeq_epi8 (block_first, first), _mm_cmpeq_epi8 (block_last, last)));
+        while (mask) {
+            int bit = __builtin_ctz (mask);
+            if (!memcmp (haystack + i + bit, needle, needle_len))
+                return i + bit;
+            mask &= mask - 1;
+        }
+    }
+
+    return i <= haystack_len - needle_len ? latin1_index_of_portable (haystack, haystack_len, needle, needle_len, i) : -1;
+}
+
+static int
+ucs2_index_of_sse2 (const jschar* haystack, int haystack_len, const jschar* needle, int needle_len, int start)
+{
+    __m128i first = _mm_set1_epi16 ((short)needle[0]);
+    __m128i last = _mm_set1_epi16 ((short)needle[needle_len - 1]);
+    int i = start;
+
+    for (; i + 8 <= haystack_len - needle_len + 1; i += 8) {
+        __m128i block_first = _mm_loadu_si128 ((const __m128i*)(haystack + i));
+        __m128i block_last = _mm_loadu_si128 ((const __m128i*)(haystack + i + needle_len - 1));
+        unsigned mask = _mm_movemask_epi8 (_mm_and_si128 (_mm_cmpeq_epi16 (block_first, first), _mm_cmpeq_epi16 (block_last, last)));
+        while (mask) {
+            int bit = __builtin_ctz (mask);
+            if (!memcmp (haystack + i + bit / 2, needle, needle_len * sizeof(jschar)))
+                return i + bit / 2;
+            mask &= ~(3u << bit);
+        }
+    }
+
+    return i <= haystack_len - needle_len ? ucs2_index_of_portable (haystack, haystack_len, needle, needle_len, i) : -1;
+}
+
+// the backwards searches look at the block of candidates ending at @i, the highest match first
+
+static int
+latin1_last_index_of_sse2 (const uint8_t* haystack, int haystack_len, const uint8_t* needle, int needle_len, int start)
+{
+    __m128i first = _mm_set1_epi8 ((char)needle[0]);
+    __m128i last = _mm_set1_epi8 ((char)needle[needle_len - 1]);
+    int i = start;
+
+    for (; i >= 15; i -= 16) {
+        int base = i - 15;
+        __m128i block_first = _mm_loadu_si128 ((const __m128i*)(haystack + base));
+        __m128i block_last = _mm_loadu_si128 ((const __m128i*)(haystack + base + needle_len - 1));
+        unsigned mask = _mm_movemask_epi8 (_mm_and_si128 (_mm_cmpeq_epi8 (block_first, first), _mm_cmpeq_epi8 (block_last, last)));
+        while (mask) {
+            int bit = 31 - __builtin_clz (mask);
+            if (!memcmp (haystack + base + bit, needle, needle_len))
+                return base + bit;
+            mask &= ~(1u << bit);
+        }
+    }
+
+    return latin1_last_index_of_portable (haystack, haystack_len, needle, needle_len, i);
+}
+
+static int
+ucs2_last_index_of_sse2 (const jschar* haystack, int haystack_len, const jschar* needle, int needle_len, int start)
+{
+    __m128i first = _mm_set1_epi16 ((short)needle[0]);
+    __m128i last = _mm_set1_epi16 ((short)needle[needle_len - 1]);
+    int i = start;
+
+    for (; i >= 7; i -= 8) {
+        int base = i - 7;
+        __m128i block_first = _mm_loadu_si128 ((const __m128i*)(haystack + base));
+        __m128i block_last = _mm_loadu_si128 ((const __m128i*)(haystack + base + needle_len - 1));
+        unsigned mask = _mm_movemask_epi8 (_mm_and_si128 (_mm_cmpeq_epi16 (block_first, first), _mm_cmpeq_epi16 (block_last, last)));
+        while (mask) {
+            int bit = 31 - __builtin_clz (mask);
+            if (!memcmp (haystack + base + bit / 2, needle, needle_len * sizeof(jschar)))
+                return base + bit / 2;
+            mask &= ~(3u << (bit - 1));
+        }
+    }
+
+    return ucs2_last_index_of_portable (haystack, haystack_len, needle, needle_len, i);
+}
+#endif
+
+#if HAVE_AVX2
+AVX2_FUNCTION static int
+latin1_index_of_avx2 (const uint8_t* haystack, int haystack_len, const uint8_t* needle, int needle_len, int start)
+{
+    __m256i first = _mm256_set1_epi8 ((char)needle[0]);
+    __m256i last = _mm256_set1_epi8 ((char)needle[needle_len - 1]);
+    int i = start;
+
+    for (; i + 32 <= haystack_len - needle_len + 1; i += 32) {
+        __m256i block_first = _mm256_loadu_si256 ((const __m256i*)(haystack + i));
+        __m256i block_last = _mm256_loadu_si256 ((const __m256i*)(haystack + i + needle_len - 1));
+        unsigned mask = (unsigned)_mm256_movemask_epi8 (_mm256_and_si256 (_mm256_cmpeq_epi8 (block_first, first), _mm256_cmpeq_epi8 (block_last, last)));
+        while (mask) {
+            int bit = __builtin_ctz (mask);
+            if (!memcmp (haystack + i + bit, needle, needle_len))
+                return i + bit;
+            mask &= mask - 1;
+        }
+    }
+
+    return i <= haystack_len - needle_len ? latin1_index_of_sse2 (haystack, haystack_len, needle, needle_len, i) : -1;
+}
+
+AVX2_FUNCTION static int
+ucs2_index_of_avx2 (const jschar* haystack, int haystack_len, const jschar* needle, int needle_len, int start)
+{
+    __m256i first = _mm256_set1_epi16 ((short)needle[0]);
+    __m256i last = _mm256_set1_epi16 ((short)needle[needle_len - 1]);
+    int i = start;
+
+    for (; i + 16 <= haystack_len - needle_len + 1; i += 16) {
+        __m256i block_first = _mm256_loadu_si256 ((const __m256i*)(haystack + i));
+        __m256i block_last = _mm256_loadu_si256 ((const __m256i*)(haystack + i + needle_len - 1));
+        unsigned mask = (unsigned)_mm256_movemask_epi8 (_mm256_and_si256 (_mm256_cmpeq_epi16 (block_first, first), _mm256_cmpeq_epi16 (block_last, last)));
+        while (mask) {
+            int bit = __builtin_ctz (mask);
+            if (!memcmp (haystack + i + bit / 2, needle, needle_len * sizeof(jschar)))
+                return i + bit / 2;
+            mask &= ~(3u << bit);
+        }
+    }
+
+    return i <= haystack_len - needle_len ? ucs2_index_of_sse2 (haystack, haystack_len, needle, needle_len, i) : -1;
+}
+#endif
+
+/// comparing
+
+static int
+ucs2_mismatch_portable (const jschar* a, const jschar* b, int len)
+{
+    int i = 0;
+    while (i < len && a[i] == b[i])
+        i ++;
+    return i;
+}
+
+static int
+latin1_ucs2_mismatch_portable (const uint8_t* a, const jschar* b, int len)
+{
+    int i = 0;
+    while (i < len && a[i] == b[i])
+        i ++;
+    return i;
+}
+
+#if HAVE_SSE2
+static int
+ucs2_mismatch_sse2 (const jschar* a, const jschar* b, int len)
+{
+    int i = 0;
+    for (; i + 8 <= len; i += 8) {
+        __m128i va = _mm_loadu_si128 ((const __m128i*)(a + i));
+        __m128i vb = _mm_loadu_si128 ((const __m128i*)(b + i));
+        unsigned mask = _mm_movemask_epi8 (_mm_cmpeq_epi16 (va, vb)) ^ 0xffff;
+        if (mask)
+            return i + __builtin_ctz (mask) / 2;
+    }
+    return i + ucs2_mismatch_portable (a + i, b + i, len - i);
+}
+
+// the latin1 side is zero extended to 16 bits, 8 characters at a time
+static int
+latin1_ucs2_mismatch_sse2 (const uint8_t* a, const jschar* b, int len)
+{
+    __m128i zero = _mm_setzero_si128 ();
+    int i = 0;
+    for (; i + 8 <= len; i += 8) {
+        __m128i va = _mm_unpacklo_epi8 (_mm_loadl_epi64 ((const __m128i*)(a + i)), zero);
+        __m128i vb = _mm_loadu_si128 ((const __m128i*)(b + i));
+        unsigned mask = _mm_movemask_epi8 (_mm_cmpeq_epi16 (va, vb)) ^ 0xffff;
+        if (mask)
+            return i + __builtin_ctz (mask) / 2;
+    }
+    return i + latin1_ucs2_mismatch_portable (a + i, b + i, len - i);
+}
+#endif
+
+/// hashing
+
+static uint32_t
+hash_k_pow (uint32_t n)
+{
+    uint32_t rv = 1;
+    uint32_t k = HASH_K;
+    while (n) {
+        if (n & 1)
+            rv *= k;
+        k *= k;
+        n >>= 1;
+    }
+    return rv;
+}
+
+// four characters a step, so the multiplies for them don't wait on each other, only on the
+// previous step's hash
+#define HASH_K2 ((uint32_t)HASH_K * HASH_K)
+#define HASH_K3 (HASH_K2 * HASH_K)
+#define HASH_K4 (HASH_K2 * HASH_K2)
+
+#define HASH_PORTABLE_BODY                                              \
+    uint32_t h = (uint32_t)hash;                                        \
+    int i = 0;                                                          \
+    for (; i + 4 <= length; i += 4)                                     \
+        h = h * HASH_K4 + str[i] * HASH_K3 + str[i+1] * HASH_K2 + str[i+2] * (uint32_t)HASH_K + str[i+3]; \
+    for (; i < length; i ++)                                            \
+        h = h * HASH_K + str[i];                                        \
+    return h;
+
+static uint32_t
+latin1_hash_portable (const uint8_t* str, int hash, int length)
+{
+    HASH_PORTABLE_BODY
+}
+
+static uint32_t
+ucs2_hash_portable (const jschar* str, int hash, int length)
+{
+    HASH_PORTABLE_BODY
+}
+
+#if HAVE_AVX2
+// 16 characters a step, in two vectors of 8 lanes.  lane n of the first accumulates every 16th
+// character starting at n, and of the second starting at n + 8.  at the end each lane is scaled by
+// K to the power of how far its last character is from the end.
+AVX2_FUNCTION static uint32_t
+hash_avx2_lanes (uint32_t h, __m256i acc0, __m256i acc1, int steps)
+{
+    uint32_t lanes[16];
+    _mm256_storeu_si256 ((__m256i*)lanes, acc0);
+    _mm256_storeu_si256 ((__m256i*)(lanes + 8), acc1);
+
+    uint32_t rv = h * hash_k_pow (16 * steps);
+    uint32_t k = 1;
+    for (int n = 15; n >= 0; n --) {
+        rv += lanes[n] * k;
+        k *= HASH_K;
+    }
+    return rv;
+}
+
+AVX2_FUNCTION static uint32_t
+latin1_hash_avx2 (const uint8_t* str, int hash, int length)
+{
+    int steps = length / 16;
+    if (steps < 2)
+        return latin1_hash_portable (str, hash, length);
+
+    __m256i k16 = _mm256_set1_epi32 ((int)hash_k_pow (16));
+    __m256i acc0 = _mm256_setzero_si256 ();
+    __m256i acc1 = _mm256_setzero_si256 ();
+    for (int s = 0; s < steps; s ++) {
+        const uint8_t* p = str + s * 16;
+        acc0 = _mm256_add_epi32 (_mm256_mullo_epi32 (acc0, k16), _mm256_cvtepu8_epi32 (_mm_loadl_epi64 ((const __m128i*)p)));
+        acc1 = _mm256_add_epi32 (_mm256_mullo_epi32 (acc1, k16), _mm256_cvtepu8_epi32 (_mm_loadl_epi64 ((const __m128i*)(p + 8))));
+    }
+
+    uint32_t h = hash_avx2_lanes ((uint32_t)hash, acc0, acc1, steps);
+    return latin1_hash_portable (str + steps * 16, (int)h, length - steps * 16);
+}
+
+AVX2_FUNCTION static uint32_t
+ucs2_hash_avx2 (const jschar* str, int hash, int length)
+{
+    int steps = length / 16;
+    if (steps < 2)
+        return ucs2_hash_portable (str, hash, length);
+
+    __m256i k16 = _mm256_set1_epi32 ((int)hash_k_pow (16));
+    __m256i acc0 = _mm256_setzero_si256 ();
+    __m256i acc1 = _mm256_setzero_si256 ();
+    for (int s = 0; s < steps; s ++) {
+        const jschar* p = str + s * 16;
+        acc0 = _mm256_add_epi32 (_mm256_mullo_epi32 (acc0, k16), _mm256_cvtepu16_epi32 (_mm_loadu_si128 ((const __m128i*)p)));
+        acc1 = _mm256_add_epi32 (_mm256_mullo_epi32 (acc1, k16), _mm256_cvtepu16_epi32 (_mm_loadu_si128 ((const __m128i*)(p + 8))));
+    }
+
+    uint32_t h = hash_avx2_lanes ((uint32_t)hash, acc0, acc1, steps);
+    return ucs2_hash_portable (str + steps * 16, (int)h, length - steps * 16);
+}
+#endif
+
+/// transcoding
+
+// ascii runs are handled a block at a time, everything else a character at a time
+
+static int
+ascii_prefix_length_portable (const uint8_t* str, int len)
+{
+    int i = 0;
+    while (i < len && str[i] < 0x80)
+        i ++;
+    return i;
+}
+
+#if HAVE_SSE2
+static int
+ascii_prefix_length_sse2 (const uint8_t* str, int len)
+{
+    int i = 0;
+    for (; i + 16 <= len; i += 16) {
+        unsigned mask = _mm_movemask_epi8 (_mm_loadu_si128 ((const __m128i*)(str + i)));
+        if (mask)
+            return i + __builtin_ctz (mask);
+    }
+    return i + ascii_prefix_length_portable (str + i, len - i);
+}
+#endif
+
+#if HAVE_AVX2
+AVX2_FUNCTION static int
+ascii_prefix_length_avx2 (const uint8_t* str, int len)
+{
+    int i = 0;
+    for (; i + 32 <= len; i += 32) {
+        unsigned mask = (unsigned)_mm256_movemask_epi8 (_mm256_loadu_si256 ((const __m256i*)(str + i)));
+        if (mask)
+            return i + __builtin_ctz (mask);
+    }
+    return i + ascii_prefix_length_sse2 (str + i, len - i);
+}
+#endif
+
+// decodes the sequence at @s (which has @len bytes left) into *@cp, returning the number of bytes
+// it used.  an invalid sequence uses as many bytes as were a valid start of one (at least 1) and
+// decodes to U+FFFD.
+static int
+decode_utf8_sequence (const uint8_t* s, int len, uint32_t* cp)
+{
+    uint8_t b0 = s[0];
+    uint8_t lo = 0x80, hi = 0xbf;
+    uint32_t c;
+    int need;
+
+    if (b0 < 0x80) {
+        *cp = b0;
+        return 1;
+    }
+    else if (b0 >= 0xc2 && b0 <= 0xdf) {
+        need = 1;
+        c = b0 & 0x1f;
+    }
+    else if (b0 >= 0xe0 && b0 <= 0xef) {
+        need = 2;
+        c = b0 & 0x0f;
+        if (b0 == 0xe0) lo = 0xa0;      // overlong
+        else if (b0 == 0xed) hi = 0x9f; // surrogates
+    }
+    else if (b0 >= 0xf0 && b0 <= 0xf4) {
+        need = 3;
+        c = b0 & 0x07;
+        if (b0 == 0xf0) lo = 0x90;      // overlong
+        else if (b0 == 0xf4) hi = 0x8f; // past U+10FFFF
+    }
+    else {
+        *cp = 0xfffd;
+        return 1;
+    }
+
+    for (int n = 1; n <= need; n ++) {
+        if (n >= len || s[n] < lo || s[n] > hi) {
+            *cp = 0xfffd;
+            return n;
+        }
+        c = (c << 6) | (s[n] & 0x3f);
+        lo = 0x80;
+        hi = 0xbf;
+    }
+    *cp = c;
+    return need + 1;
+}
+
+int
+utf8_to_utf16 (const uint8_t* src, int len, jschar* dst)
+{
+    jschar* d = dst;
+    int i = 0;
+
+    while (i < len) {
+#if HAVE_SSE2
+        __m128i zero = _mm_setzero_si128 ();
+        while (i + 16 <= len) {
+            __m128i block = _mm_loadu_si128 ((const __m128i*)(src + i));
+            unsigned mask = _mm_movemask_epi8 (block);
+            if (mask) {
+                // copy the ascii before the first non-ascii byte one at a time
+                int n = __builtin_ctz (mask);
+                for (int j = 0; j < n; j ++)
+                    *d++ = src[i + j];
+                i += n;
+                break;
+            }
+            _mm_storeu_si128 ((__m128i*)d, _mm_unpacklo_epi8 (block, zero));
+            _mm_storeu_si128 ((__m128i*)(d + 8), _mm_unpackhi_epi8 (block, zero));
+            d += 16;
+            i += 16;
+        }
+        if (i >= len)
+            break;
+#endif
+        uint32_t cp;
+        i += decode_utf8_sequence (src + i, len - i, &cp);
+        if (cp >= 0x10000) {
+            cp -= 0x10000;
+            *d++ = 0xd800 + (cp >> 10);
+            *d++ = 0xdc00 + (cp & 0x3ff);
+        }
+        else {
+            *d++ = (jschar)cp;
+        }
+    }
+
+    return d - dst;
+}
+
+int
+latin1_to_utf8 (const uint8_t* src, int len, char* dst)
+{
+    char* d = dst;
+    int i = 0;
+
+    while (i < len) {
+        int n = ascii_prefix_length (src + i, len - i);
+        memcpy (d, src + i, n);
+        d += n;
+        i += n;
+
+        // characters from 0x80 to 0xff are two bytes, and likely come in runs
+        while (i < len && src[i] >= 0x80) {
+            *d++ = 0xc0 | (src[i] >> 6);
+            *d++ = 0x80 | (src[i] & 0x3f);
+            i ++;
+        }
+    }
+
+    return d - dst;
+}
+
+int
+utf16_to_utf8 (const jschar* src, int len, char* dst)
+{
+    char* d = dst;
+    int i = 0;
+
+    while (i < len) {
+#if HAVE_SSE2
+        // 16 characters that are all below 0x80 pack down to 16 bytes
+        __m128i high_bits = _mm_set1_epi16 ((short)0xff80);
+        __m128i zero = _mm_setzero_si128 ();
+        while (i + 16 <= len) {
+            __m128i a = _mm_loadu_si128 ((const __m128i*)(src + i));
+            __m128i b = _mm_loadu_si128 ((const __m128i*)(src + i + 8));
+            __m128i any_high = _mm_or_si128 (_mm_and_si128 (a, high_bits), _mm_and_si128 (b, high_bits));
+            if (_mm_movemask_epi8 (_mm_cmpeq_epi8 (any_high, zero)) != 0xffff)
+                break;
+            _mm_storeu_si128 ((__m128i*)d, _mm_packus_epi16 (a, b));
+            d += 16;
+            i += 16;
+        }
+        if (i >= len)
+            break;
+#endif
+        jschar c = src[i++];
+        if (c < 0x80) {
+            *d++ = (char)c;
+        }
+        else if (c < 0x800) {
+            *d++ = 0xc0 | (c >> 6);
+            *d++ = 0x80 | (c & 0x3f);
+        }
+        else if (c >= 0xd800 && c <= 0xdbff && i < len && src[i] >= 0xdc00 && src[i] <= 0xdfff) {
+            uint32_t cp = 0x10000 + (((uint32_t)(c - 0xd800) << 10) | (src[i++] - 0xdc00));
+            *d++ = 0xf0 | (cp >> 18);
+            *d++ = 0x80 | ((cp >> 12) & 0x3f);
+            *d++ = 0x80 | ((cp >> 6) & 0x3f);
+            *d++ = 0x80 | (cp & 0x3f);
+        }
+        else {
+            if (c >= 0xd800 && c <= 0xdfff)
+                c = 0xfffd;
+            *d++ = 0xe0 | (c >> 12);
+            *d++ = 0x80 | ((c >> 6) & 0x3f);
+            *d++ = 0x80 | (c & 0x3f);
+        }
+    }
+
+    return d - dst;
+}
+
+/// dispatch
+
+#if HAVE_SSE2
+#define BASELINE(name) name##_sse2
+#else
+#define BASELINE(name) name##_portable
+#endif
+
+static int (*latin1_index_of_impl) (const uint8_t*, int, const uint8_t*, int, int) = BASELINE(latin1_index_of);
+static int (*ucs2_index_of_impl) (const jschar*, int, const jschar*, int, int) = BASELINE(ucs2_index_of);
+static uint32_t (*latin1_hash_impl) (const uint8_t*, int, int) = latin1_hash_portable;
+static uint32_t (*ucs2_hash_impl) (const jschar*, int, int) = ucs2_hash_portable;
+static int (*ascii_prefix_length_impl) (const uint8_t*, int) = BASELINE(ascii_prefix_length);
+
+void
+_ejs_string_kernels_init ()
+{
+#if HAVE_AVX2
+    __builtin_cpu_init ();
+    if (__builtin_cpu_supports ("avx2")) {
+        latin1_index_of_impl = latin1_index_of_avx2;
+        ucs2_index_of_impl = ucs2_index_of_avx2;
+        latin1_hash_impl = latin1_hash_avx2;
+        ucs2_hash_impl = ucs2_hash_avx2;
+        ascii_prefix_length_impl = ascii_prefix_length_avx2;
+    }
+#endif
+}
+
+int
+latin1_index_of (const uint8_t* haystack, int haystack_len, const uint8_t* needle, int needle_len, int start)
+{
+    if (needle_len == 1) {
+        const uint8_t* p = (const uint8_t*)memchr (haystack + start, needle[0], haystack_len - start);
+        return p ? p - haystack : -1;
+    }
+    return latin1_index_of_impl (haystack, haystack_len, needle, needle_len, start);
+}
+
+int
+ucs2_index_of (const jschar* haystack, int haystack_len, const jschar* needle, int needle_len, int start)
+{
+    return ucs2_index_of_impl (haystack, haystack_len, needle, needle_len, start);
+}
+
+int
+latin1_last_index_of (const uint8_t* haystack, int haystack_len, const uint8_t* needle, int needle_len, int start)
+{
+    return BASELINE(latin1_last_index_of) (haystack, haystack_len, needle, needle_len, start);
+}
+
+int
+ucs2_last_index_of (const jschar* haystack, int haystack_len, const jschar* needle, int needle_len, int start)
+{
+    return BASELINE(ucs2_last_index_of) (haystack, haystack_len, needle, needle_len, start);
+}
+
+int
+ucs2_mismatch (const jschar* a, const jschar* b, int len)
+{
+    return BASELINE(ucs2_mismatch) (a, b, len);
+}
+
+int
+latin1_ucs2_mismatch (const uint8_t* a, const jschar* b, int len)
+{
+    return BASELINE(latin1_ucs2_mismatch) (a, b, len);
+}
+
+uint32_t
+latin1_hash (const uint8_t* str, int hash, int length)
+{
+    return latin1_hash_impl (str, hash, length);
+}
+
+uint32_t
+ucs2_hash (const jschar* str, int hash, int length)
+{
+    return ucs2_hash_impl (str, hash, length);
+}
+
+int
+ascii_prefix_length (const uint8_t* str, int len)
+{
+    return ascii_prefix_length_impl (str, len);
+}
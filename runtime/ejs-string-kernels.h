@@ -0,0 +1,54 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-
+ * vim: set ts=4 sw=4 et tw=99 ft=cpp:
+ */
+#ifndef _ejs_string_kernels_h_
+#define _ejs_string_kernels_h_
+
+#include "ejs.h"
+
+// the loops at the bottom of string searching, comparing and hashing, one per width a flat string
+// can be stored in.  x86 builds use SSE2, and AVX2 for some when the cpu has it (which
+// _ejs_string_kernels_init checks for once at startup).  other targets get portable versions.
+// every version of a kernel gives exactly the same answers.
+
+EJS_BEGIN_DECLS
+
+void _ejs_string_kernels_init ();
+
+// the index of the first occurrence of the @needle_len characters of @needle in @haystack at or
+// after @start, or -1.  @needle_len is at least 1 and @start + @needle_len <= @haystack_len.
+int latin1_index_of (const uint8_t* haystack, int haystack_len, const uint8_t* needle, int needle_len, int start);
+int ucs2_index_of (const jschar* haystack, int haystack_len, const jschar* needle, int needle_len, int start);
+
+// the same, but the last occurrence at or before @start
+int latin1_last_index_of (const uint8_t* haystack, int haystack_len, const uint8_t* needle, int needle_len, int start);
+int ucs2_last_index_of (const jschar* haystack, int haystack_len, const jschar* needle, int needle_len, int start);
+
+// the index of the first of the @len characters at @a and @b that differ, or @len if none do
+int ucs2_mismatch (const jschar* a, const jschar* b, int len);
+int latin1_ucs2_mismatch (const uint8_t* a, const jschar* b, int len);
+
+// hashes are polynomials in the characters: appending @length characters to a string whose hash
+// is @hash gives hash * K^length + the hash of the new characters.  so ropes can be hashed a piece
+// at a time, and each piece in independent lanes.  the bits aren't mixed well, callers have to do
+// that on the final value.
+uint32_t latin1_hash (const uint8_t* str, int hash, int length);
+// (ucs2_hash is declared in ejs-types.h)
+
+// the number of bytes at the start of @str that are ascii
+int ascii_prefix_length (const uint8_t* str, int len);
+
+// decodes the @len bytes of utf8 at @src into @dst, which needs room for @len characters, and
+// returns how many it wrote.  malformed sequences (overlong ones, encoded surrogates, truncated ones
+// and so on) each become a U+FFFD, the way the WHATWG encoding standard does it.
+int utf8_to_utf16 (const uint8_t* src, int len, jschar* dst);
+
+// encodes the @len characters at @src as utf8 in @dst, returning the number of bytes written.  @dst
+// needs room for 2 bytes per latin1 character, 3 per ucs2 one.  unpaired surrogates are written as
+// U+FFFD.
+int latin1_to_utf8 (const uint8_t* src, int len, char* dst);
+int utf16_to_utf8 (const jschar* src, int len, char* dst);
+
+EJS_END_DECLS
+
+#endif /* _ejs_string_kernels_h_ */
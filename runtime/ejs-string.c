@@ -13,7 +13,7 @@
 #include "ejs-function.h"
 #include "ejs-regexp.h"
 #include "ejs-ops.h"
-#include "ejs-string.h"
+#include "ejs-string-kernels.h"
 #include "ejs-error.h"
 #include "ejs-symbol.h"
 
@@ -23,6 +23,10 @@
 // length below which we eschew creating a dependent string and just create a flat string containing the slice
 #define FLAT_DEP_THRESHOLD 32
 
+// ropes deeper than this get rebalanced.  a balanced rope this deep would have more characters than
+// a string can hold, so only ones built lopsidedly (by appending in a loop) get here.
+#define ROPE_MAX_DEPTH 48
+
 int32_t
 ucs2_strcmp (const jschar *s1, const jschar *s2)
 {
@@ -54,20 +58,6 @@ ucs2_strlen (const jschar *str)
     return rv;
 }
 
-uint32_t
-ucs2_hash (const jschar* str, int32_t hash, int length)
-{
-    const char* p = (const char*)str;
-
-    while (length >= 0) {
-        hash = (hash << 5) - hash * (*p++);
-        hash = (hash << 5) - hash + (*p++);
-        length --;
-    }
-
-    return (uint32_t)hash;
-}
-
 jschar*
 ucs2_strstr (const jschar *haystack,
              const jschar *needle)
@@ -164,156 +154,154 @@ ucs2_strrstr (const jschar *haystack,
 }
 
 
-static jschar
-utf8_to_ucs2 (const unsigned char * input, const unsigned char ** end_ptr)
+// true if the @len characters at @a_off in @a are the same as those at @b_off in @b, whatever
+// width each is stored in
+static EJSBool
+flat_chars_equal (EJSPrimString* a, int a_off, EJSPrimString* b, int b_off, int len)
 {
-    *end_ptr = input;
-    if (input[0] == 0)
-        return -1;
-    if (input[0] < 0x80) {
-        * end_ptr = input + 1;
-        return input[0];
-    }
-    if ((input[0] & 0xE0) == 0xE0) {
-        if (input[1] == 0 || input[2] == 0)
-            return -1;
-        * end_ptr = input + 3;
-        return
-            (input[0] & 0x0F)<<12 |
-            (input[1] & 0x3F)<<6  |
-            (input[2] & 0x3F);
-    }
-    if ((input[0] & 0xC0) == 0xC0) {
-        if (input[1] == 0)
-            return -1;
-        * end_ptr = input + 2;
-        return
-            (input[0] & 0x1F)<<6  |
-            (input[1] & 0x3F);
-    }
-    return -1;
+    EJSBool a_latin1 = EJS_PRIMSTR_IS_LATIN1(a);
+    EJSBool b_latin1 = EJS_PRIMSTR_IS_LATIN1(b);
+
+    if (a_latin1 && b_latin1)
+        return !memcmp (a->data.latin1 + a_off, b->data.latin1 + b_off, len);
+    if (!a_latin1 && !b_latin1)
+        return !memcmp (a->data.flat + a_off, b->data.flat + b_off, len * sizeof(jschar));
+    if (a_latin1)
+        return latin1_ucs2_mismatch (a->data.latin1 + a_off, b->data.flat + b_off, len) == len;
+    return latin1_ucs2_mismatch (b->data.latin1 + b_off, a->data.flat + a_off, len) == len;
 }
 
-static int
-utf16_to_utf8_char (const jschar* utf16, char* utf8, int *utf16_adv)
+// the search kernels want the needle in the same width as the haystack.  NeedleBuffer holds a
+// converted copy when it isn't, on the stack unless it's long.
+#define NEEDLE_BUFFER_SIZE 128
+
+typedef struct {
+    const void* chars;   // the needle's characters in the haystack's width, or NULL if it can't match
+    void* allocated;
+    union {
+        uint8_t latin1[NEEDLE_BUFFER_SIZE];
+        jschar ucs2[NEEDLE_BUFFER_SIZE];
+    } storage;
+} NeedleBuffer;
+
+static void
+needle_buffer_init (NeedleBuffer* nb, EJSPrimString* haystack, EJSPrimString* needle)
 {
-    jschar ucs2;
+    EJSBool haystack_latin1 = EJS_PRIMSTR_IS_LATIN1(haystack);
+    nb->allocated = NULL;
 
-    ucs2 = *utf16;
-    *utf16_adv = 1;
+    if (haystack_latin1 == EJS_PRIMSTR_IS_LATIN1(needle)) {
+        nb->chars = needle->data.flat;
+        return;
+    }
 
-    if (ucs2 < 0x80) {
-        utf8[0] = (char)ucs2;
-        return 1;
+    size_t char_size = haystack_latin1 ? sizeof(uint8_t) : sizeof(jschar);
+    void* buffer = nb->storage.latin1;
+    if (needle->length > NEEDLE_BUFFER_SIZE)
+        buffer = nb->allocated = malloc (char_size * needle->length);
+
+    if (haystack_latin1) {
+        // a ucs2 needle (a string literal, say) in a latin1 haystack.  it can only match if all
+        // of its characters fit in a byte.
+        uint8_t* narrow = (uint8_t*)buffer;
+        for (int i = 0; i < needle->length; i ++) {
+            jschar c = needle->data.flat[i];
+            if (c > 0xff) {
+                nb->chars = NULL;
+                return;
+            }
+            narrow[i] = (uint8_t)c;
+        }
     }
-    if (ucs2 >= 0x80  && ucs2 < 0x800) {
-        utf8[0] = (ucs2 >> 6)   | 0xC0;
-        utf8[1] = (ucs2 & 0x3F) | 0x80;
-        return 2;
+    else {
+        jschar* wide = (jschar*)buffer;
+        for (int i = 0; i < needle->length; i ++)
+            wide[i] = needle->data.latin1[i];
     }
-    if (ucs2 >= 0x800 && ucs2 < 0xFFFF) {
-        if (ucs2 >= 0xD800 && ucs2 <= 0xDFFF) {
-            // surrogate pair
-            jschar ucs2_2 = *(utf16 + 1);
-            uint32_t combined = 0x10000 + (((ucs2 - 0xD800) << 10) | (ucs2_2 - 0xDC00));
+    nb->chars = buffer;
+}
 
-            utf8[0] = 0xF0 | (combined >> 18);
-            utf8[1] = 0x80 | ((combined >> 12) & 0x3F);
-            utf8[2] = 0x80 | ((combined >> 6) & 0x3F);
-            utf8[3] = 0x80 | ((combined & 0x3F));
+static void
+needle_buffer_free (NeedleBuffer* nb)
+{
+    free (nb->allocated);
+}
 
-            *utf16_adv = 2;
-            return 4;
-        }
+// the index of the first occurrence of @needle in @haystack at or after @start, or -1.  both must
+// be flat.
+static int
+flat_index_of (EJSPrimString* haystack, EJSPrimString* needle, int start)
+{
+    int haystack_len = haystack->length;
+    int needle_len = needle->length;
 
-        utf8[0] = ((ucs2 >> 12)       ) | 0xE0;
-        utf8[1] = ((ucs2 >> 6 ) & 0x3F) | 0x80;
-        utf8[2] = ((ucs2      ) & 0x3F) | 0x80;
-        return 3;
+    if (start < 0)
+        start = 0;
+    if (start > haystack_len || needle_len > haystack_len - start)
+        return -1;
+    if (needle_len == 0)
+        return start;
+
+    NeedleBuffer nb;
+    int rv = -1;
+    needle_buffer_init (&nb, haystack, needle);
+    if (nb.chars) {
+        if (EJS_PRIMSTR_IS_LATIN1(haystack))
+            rv = latin1_index_of (haystack->data.latin1, haystack_len, (const uint8_t*)nb.chars, needle_len, start);
+        else
+            rv = ucs2_index_of (haystack->data.flat, haystack_len, (const jschar*)nb.chars, needle_len, start);
     }
-    EJS_NOT_IMPLEMENTED();
+    needle_buffer_free (&nb);
+    return rv;
 }
 
+// the index of the last occurrence of @needle in @haystack starting at or before @start (which
+// isn't negative), or -1.  both must be flat.
 static int
-ucs2_to_utf8_char (jschar ucs2, char *utf8)
+flat_last_index_of (EJSPrimString* haystack, EJSPrimString* needle, int start)
 {
-    if (ucs2 < 0x80) {
-        utf8[0] = (char)ucs2;
-        return 1;
-    }
-    if (ucs2 >= 0x80  && ucs2 < 0x800) {
-        utf8[0] = (ucs2 >> 6)   | 0xC0;
-        utf8[1] = (ucs2 & 0x3F) | 0x80;
-        return 2;
-    }
-    if (ucs2 >= 0x800 && ucs2 < 0xFFFF) {
-        if (ucs2 >= 0xD800 && ucs2 <= 0xDFFF) {
-            EJS_NOT_IMPLEMENTED();
-        }
+    int haystack_len = haystack->length;
+    int needle_len = needle->length;
 
-        utf8[0] = ((ucs2 >> 12)       ) | 0xE0;
-        utf8[1] = ((ucs2 >> 6 ) & 0x3F) | 0x80;
-        utf8[2] = ((ucs2      ) & 0x3F) | 0x80;
-        return 3;
+    if (start > haystack_len - needle_len)
+        start = haystack_len - needle_len;
+    if (start < 0)
+        return -1;
+    if (needle_len == 0)
+        return start;
+
+    NeedleBuffer nb;
+    int rv = -1;
+    needle_buffer_init (&nb, haystack, needle);
+    if (nb.chars) {
+        if (EJS_PRIMSTR_IS_LATIN1(haystack))
+            rv = latin1_last_index_of (haystack->data.latin1, haystack_len, (const uint8_t*)nb.chars, needle_len, start);
+        else
+            rv = ucs2_last_index_of (haystack->data.flat, haystack_len, (const jschar*)nb.chars, needle_len, start);
     }
-    EJS_NOT_IMPLEMENTED();
+    needle_buffer_free (&nb);
+    return rv;
 }
 
+
 char*
 ucs2_to_utf8 (const jschar *str)
 {
     int len = ucs2_strlen(str);
-    char *conservative = (char*)calloc (sizeof(char), len * 4 + 1);
-
-    const jschar *p = str;
-    char *c = conservative;
-    int utf16_adv;
-
-    while (*p) {
-        int adv = utf16_to_utf8_char (p, c, &utf16_adv);
-        if (adv < 1) {
-            // more here XXX
-            break;
-        }
-        c += adv;
-
-        p += utf16_adv;
-        len --;
-        if (len == 0)
-            break;
-    }
-
-    *c = 0;
-    return conservative;
+    char *utf8 = (char*)malloc (len * 3 + 1);
+    utf8[utf16_to_utf8 (str, len, utf8)] = 0;
+    return utf8;
 }
 
 char*
 ucs2_to_utf8_buf (const jschar *str, char* buf, size_t buf_size)
 {
+    // no utf16 unit takes more than 3 bytes, so if the worst case fits so does the real one
     int len = ucs2_strlen(str);
-    if (len > buf_size) // easy check right off the bat
+    if (len * 3 + 1 > buf_size)
         return NULL;
 
-    const jschar *p = str;
-    char *c = buf;
-
-    while (*p) {
-        int adv = ucs2_to_utf8_char (*p, c);
-        if (adv < 1) {
-            // more here XXX
-            break;
-        }
-        c += adv;
-        if (c - buf > buf_size)
-            return NULL;
-
-        p++;
-        len --;
-        if (len == 0)
-            break;
-    }
-
-    *c = 0;
+    buf[utf16_to_utf8 (str, len, buf)] = 0;
     return buf;
 }
 
@@ -338,6 +326,7 @@ _ejs_String_impl (ejsval env, ejsval _this, uint32_t argc, ejsval *args)
 
         if (argc > 0) {
             str->primStr = ToString(args[0]);
+            _ejs_gc_write_barrier(str, str->primStr);
         }
         else {
             str->primStr = _ejs_atom_empty;
@@ -554,14 +543,11 @@ _ejs_String_prototype_replace (ejsval env, ejsval _this, uint32_t argc, ejsval *
     //     of the first code unit of the matched substring and let matched be searchString. If no occurrences of
     //     searchString were found, return string.
 
-    jschar* string_cstr = EJSVAL_TO_FLAT_STRING(string);
-
-    jschar* p = ucs2_strstr(string_cstr, EJSVAL_TO_FLAT_STRING(searchString));
-    if (!p)
+    int pos = flat_index_of (_ejs_string_flatten_any(string), _ejs_string_flatten_any(searchString), 0);
+    if (pos == -1)
         return string;
 
     ejsval matched = searchString;
-    int pos = p - string_cstr;
 
     ejsval replStr;
 
@@ -600,21 +586,28 @@ _ejs_String_prototype_replace (ejsval env, ejsval _this, uint32_t argc, ejsval *
 jschar
 _ejs_string_ucs2_at (EJSPrimString* primstr, uint32_t offset)
 {
-    switch (EJS_PRIMSTR_GET_TYPE(primstr)) {
-    case EJS_STRING_DEPENDENT:
-        return _ejs_string_ucs2_at (primstr->data.dependent.dep, offset + primstr->data.dependent.off);
-    case EJS_STRING_ROPE:
-        if (offset < primstr->data.rope.left->length) {
-            return _ejs_string_ucs2_at (primstr->data.rope.left, offset);
-        }
-        else {
-            return _ejs_string_ucs2_at (primstr->data.rope.right, offset - primstr->data.rope.left->length);
+    // a loop rather than recursion, since ropes can be very deep
+    for (;;) {
+        switch (EJS_PRIMSTR_GET_TYPE(primstr)) {
+        case EJS_STRING_DEPENDENT:
+            offset += primstr->data.dependent.off;
+            primstr = primstr->data.dependent.dep;
+            break;
+        case EJS_STRING_ROPE:
+            if (offset < primstr->data.rope.left->length) {
+                primstr = primstr->data.rope.left;
+            }
+            else {
+                offset -= primstr->data.rope.left->length;
+                primstr = primstr->data.rope.right;
+            }
+            break;
+        case EJS_STRING_FLAT:
+            // the character is in this flat string
+            return EJS_PRIMSTR_FLAT_CHAR_AT(primstr, offset);
+        default:
+            EJS_NOT_IMPLEMENTED();
         }
-    case EJS_STRING_FLAT:
-        // the character is in this flat string
-        return primstr->data.flat[offset];
-    default:
-        EJS_NOT_IMPLEMENTED();
     }
 }
 
@@ -681,29 +674,14 @@ _ejs_String_prototype_indexOf (ejsval env, ejsval _this, uint32_t argc, ejsval *
     if (argc == 0)
         return NUMBER_TO_EJSVAL(idx);
 
-    ejsval haystack = ToString(_this);
-    jschar* haystack_cstr;
-    if (EJSVAL_IS_STRING(haystack)) {
-        haystack_cstr = EJSVAL_TO_FLAT_STRING(haystack);
-    }
-    else {
-        haystack_cstr = EJSVAL_TO_FLAT_STRING(((EJSString*)EJSVAL_TO_OBJECT(haystack))->primStr);
-    }
+    EJSPrimString* haystack = _ejs_string_flatten_any(ToString(_this));
+    EJSPrimString* needle = _ejs_string_flatten_any(ToString(args[0]));
 
-    ejsval needle = ToString(args[0]);
-    jschar *needle_cstr;
-    if (EJSVAL_IS_STRING(needle)) {
-        needle_cstr = EJSVAL_TO_FLAT_STRING(needle);
-    }
-    else {
-        needle_cstr = EJSVAL_TO_FLAT_STRING(((EJSString*)EJSVAL_TO_OBJECT(needle))->primStr);
-    }
-  
-    jschar* p = ucs2_strstr(haystack_cstr, needle_cstr);
-    if (p == NULL)
-        return NUMBER_TO_EJSVAL(idx);
+    int64_t pos = argc > 1 ? ToInteger(args[1]) : 0;
+    int start = MIN(MAX(pos, 0), haystack->length);
 
-    return NUMBER_TO_EJSVAL (p - haystack_cstr);
+    idx = flat_index_of (haystack, needle, start);
+    return NUMBER_TO_EJSVAL (idx);
 }
 
 static ejsval
@@ -713,29 +691,19 @@ _ejs_String_prototype_lastIndexOf (ejsval env, ejsval _this, uint32_t argc, ejsv
     if (argc == 0)
         return NUMBER_TO_EJSVAL(idx);
 
-    ejsval haystack = ToString(_this);
-    jschar* haystack_cstr;
-    if (EJSVAL_IS_STRING(haystack)) {
-        haystack_cstr = EJSVAL_TO_FLAT_STRING(haystack);
-    }
-    else {
-        haystack_cstr = EJSVAL_TO_FLAT_STRING(((EJSString*)EJSVAL_TO_OBJECT(haystack))->primStr);
-    }
+    EJSPrimString* haystack = _ejs_string_flatten_any(ToString(_this));
+    EJSPrimString* needle = _ejs_string_flatten_any(ToString(args[0]));
 
-    ejsval needle = ToString(args[0]);
-    jschar *needle_cstr;
-    if (EJSVAL_IS_STRING(needle)) {
-        needle_cstr = EJSVAL_TO_FLAT_STRING(needle);
+    // a position of NaN (or undefined) searches the whole string
+    int start = haystack->length;
+    if (argc > 1) {
+        double pos = ToDouble(args[1]);
+        if (!isnan(pos))
+            start = MIN(MAX(pos, 0), haystack->length);
     }
-    else {
-        needle_cstr = EJSVAL_TO_FLAT_STRING(((EJSString*)EJSVAL_TO_OBJECT(needle))->primStr);
-    }
-  
-    jschar* p = ucs2_strrstr(haystack_cstr, needle_cstr);
-    if (p == NULL)
-        return NUMBER_TO_EJSVAL(idx);
 
-    return NUMBER_TO_EJSVAL (p - haystack_cstr);
+    idx = flat_last_index_of (haystack, needle, start);
+    return NUMBER_TO_EJSVAL (idx);
 }
 
 static ejsval
@@ -894,18 +862,16 @@ _ejs_String_prototype_toLowerCase (ejsval env, ejsval _this, uint32_t argc, ejsv
     /* 1. Call CheckObjectCoercible passing the this value as its argument. */
     /* 2. Let S be the result of calling ToString, giving it the this value as its argument. */
     ejsval S = ToString(_this);
-    char* sstr = ucs2_to_utf8(EJSVAL_TO_FLAT_STRING(S));
+    EJSUtf8Buffer sstr;
+    _ejs_string_utf8_buffer_init (&sstr, S);
 
     /* 3. Let L be a String where each character of L is either the Unicode lowercase equivalent of the corresponding  */
     /*    character of S or the actual corresponding character of S if no Unicode lowercase equivalent exists. */
-    char* p = sstr;
-    while (*p) {
-        *p = tolower(*p);
-        p++;
-    }
+    for (size_t i = 0; i < sstr.length; i ++)
+        sstr.str[i] = tolower(sstr.str[i]);
 
-    ejsval L = _ejs_string_new_utf8(sstr);
-    free(sstr);
+    ejsval L = _ejs_string_new_utf8_len(sstr.str, sstr.length);
+    _ejs_string_utf8_buffer_free (&sstr);
 
     /* 4. Return L. */
     return L;
@@ -923,18 +889,16 @@ _ejs_String_prototype_toUpperCase (ejsval env, ejsval _this, uint32_t argc, ejsv
     /* 1. Call CheckObjectCoercible passing the this value as its argument. */
     /* 2. Let S be the result of calling ToString, giving it the this value as its argument. */
     ejsval S = ToString(_this);
-    char* sstr = ucs2_to_utf8(EJSVAL_TO_FLAT_STRING(S));
+    EJSUtf8Buffer sstr;
+    _ejs_string_utf8_buffer_init (&sstr, S);
 
     /* 3. Let L be a String where each character of L is either the Unicode lowercase equivalent of the corresponding  */
     /*    character of S or the actual corresponding character of S if no Unicode lowercase equivalent exists. */
-    char* p = sstr;
-    while (*p) {
-        *p = toupper(*p);
-        p++;
-    }
+    for (size_t i = 0; i < sstr.length; i ++)
+        sstr.str[i] = toupper(sstr.str[i]);
 
-    ejsval L = _ejs_string_new_utf8(sstr);
-    free(sstr);
+    ejsval L = _ejs_string_new_utf8_len(sstr.str, sstr.length);
+    _ejs_string_utf8_buffer_free (&sstr);
 
     /* 4. Return L. */
     return L;
@@ -1086,6 +1050,25 @@ _ejs_String_prototype_split (ejsval env, ejsval _this, uint32_t argc, ejsval *ar
         //     e. Return A.
         return A;
     }
+    // a non-empty separator can only match where a search for it finds it, so skip straight to
+    // those places rather than trying SplitMatch at every position.  this is steps 18-19 for
+    // that case.
+    if (EJSVAL_TO_STRLEN(R) > 0) {
+        EJSPrimString* flat_S = _ejs_string_flatten_any(S);
+        EJSPrimString* flat_R = _ejs_string_flatten_any(R);
+        int q;
+        while ((q = flat_index_of (flat_S, flat_R, p)) != -1) {
+            ejsval T = _ejs_string_new_substring (S, p, q-p);
+            _ejs_array_push_dense(A, 1, &T);
+            lengthA ++;
+            if (lengthA == lim) return A;
+            p = q + flat_R->length;
+        }
+        ejsval T = _ejs_string_new_substring (S, p, s-p);
+        _ejs_array_push_dense(A, 1, &T);
+        return A;
+    }
+
     // 18. Let q = p.
     int q = p;
 
@@ -1391,12 +1374,10 @@ _ejs_String_prototype_startsWith(ejsval env, ejsval _this, uint32_t argc, ejsval
     // something, which could contain traversal state across a rope.
     // as it is now, let's just flatten both strings (ugh) and walk
 
-    EJSPrimString* prim_S = _ejs_string_flatten(S);
-    EJSPrimString* prim_searchStr = _ejs_string_flatten(searchStr);
-    for (int i = 0; i < searchLength; i ++) {
-        if (prim_S->data.flat[i + start] != prim_searchStr->data.flat[i])
-            return _ejs_false;
-    }
+    EJSPrimString* prim_S = _ejs_string_flatten_any(S);
+    EJSPrimString* prim_searchStr = _ejs_string_flatten_any(searchStr);
+    if (!flat_chars_equal (prim_S, start, prim_searchStr, 0, searchLength))
+        return _ejs_false;
     
     
     return _ejs_true;
@@ -1466,12 +1447,10 @@ _ejs_String_prototype_endsWith(ejsval env, ejsval _this, uint32_t argc, ejsval *
     // something, which could contain traversal state across a rope.
     // as it is now, let's just flatten both strings (ugh) and walk
 
-    EJSPrimString* prim_S = _ejs_string_flatten(S);
-    EJSPrimString* prim_searchStr = _ejs_string_flatten(searchStr);
-    for (int i = 0; i < searchLength; i ++) {
-        if (prim_S->data.flat[i + start] != prim_searchStr->data.flat[i])
-            return _ejs_false;
-    }
+    EJSPrimString* prim_S = _ejs_string_flatten_any(S);
+    EJSPrimString* prim_searchStr = _ejs_string_flatten_any(searchStr);
+    if (!flat_chars_equal (prim_S, start, prim_searchStr, 0, searchLength))
+        return _ejs_false;
     return _ejs_true;
 }
 
@@ -1621,10 +1600,10 @@ _ejs_String_prototype_includes(ejsval env, ejsval _this, uint32_t argc, ejsval *
     // 10. Let start be min(max(pos, 0), len). 
     int64_t start = MIN(MAX(pos, 0), len);
 
-    EJSPrimString* prim_S = _ejs_string_flatten(S);
-    EJSPrimString* prim_searchStr = _ejs_string_flatten(searchStr);
+    EJSPrimString* prim_S = _ejs_string_flatten_any(S);
+    EJSPrimString* prim_searchStr = _ejs_string_flatten_any(searchStr);
 
-    return ucs2_strstr(prim_S->data.flat + start, prim_searchStr->data.flat) ? _ejs_true : _ejs_false;
+    return flat_index_of (prim_S, prim_searchStr, start) != -1 ? _ejs_true : _ejs_false;
 
     // 11. Let searchLen be the number of elements in searchStr. 
     // 12. If there exists any integer k not smaller than start such that k + searchLen is not greater than len, 
@@ -1790,6 +1769,7 @@ _ejs_string_init_proto()
 void
 _ejs_string_init(ejsval global)
 {
+    _ejs_string_kernels_init();
     _ejs_string_init_proto();
   
     _ejs_String = _ejs_function_new_without_proto (_ejs_null, _ejs_atom_String, (EJSClosureFunc)_ejs_String_impl);
@@ -1877,7 +1857,7 @@ _ejs_string_specop_get (ejsval obj, ejsval propertyName, ejsval receiver)
     }
 
     // we also handle the length getter here
-    if (EJSVAL_IS_STRING(propertyName) && !ucs2_strcmp (_ejs_ucs2_length, EJSVAL_TO_FLAT_STRING(propertyName))) {
+    if (EJSVAL_IS_STRING(propertyName) && _ejs_primstring_equal (EJSVAL_TO_STRING(propertyName), EJSVAL_TO_STRING(_ejs_atom_length))) {
         return NUMBER_TO_EJSVAL (EJSVAL_TO_STRLEN(estr->primStr));
     }
 
@@ -1947,12 +1927,13 @@ EJS_DEFINE_CLASS(StringIterator,
 
 /// EJSPrimString's
 
-ejsval
-_ejs_string_new_utf8 (const char* str)
+// a flat string with room for @len characters (and a terminating 0) of the given width.  small
+// strings keep their characters just past the struct, big ones in a malloced buffer.
+static EJSPrimString*
+new_flat (int len, EJSBool latin1)
 {
-    // XXX assume str is ascii for now
-    int str_len = strlen(str);
-    size_t value_size = EJS_PRIMSTR_FLAT_ALLOC_SIZE + sizeof(jschar) * (str_len + 1);
+    size_t char_size = latin1 ? sizeof(uint8_t) : sizeof(jschar);
+    size_t value_size = EJS_PRIMSTR_FLAT_ALLOC_SIZE + char_size * (len + 1);
     EJSBool ool_buffer = EJS_FALSE;
 
     if (value_size > 2048) {
@@ -1962,145 +1943,243 @@ _ejs_string_new_utf8 (const char* str)
 
     EJSPrimString* rv = _ejs_gc_new_primstr(value_size);
     EJS_PRIMSTR_SET_TYPE(rv, EJS_STRING_FLAT);
+    if (latin1)
+        EJS_PRIMSTR_SET_LATIN1(rv);
+    rv->length = len;
     if (ool_buffer) {
         EJS_PRIMSTR_SET_HAS_OOL_BUFFER(rv);
-        rv->data.flat = (jschar*)malloc(sizeof(jschar) * (str_len + 1));
+        rv->data.flat = (jschar*)malloc(char_size * (len + 1));
     }
     else {
         rv->data.flat = (jschar*)((char*)rv + EJS_PRIMSTR_FLAT_ALLOC_SIZE);
     }
-    jschar *p = rv->data.flat;
-    const unsigned char *stru = (const unsigned char*)str;
-    while (*stru) {
-        jschar c = utf8_to_ucs2 (stru, &stru);
-        if (c == (jschar)-1) {
-            break;
-        }
-        *p++ = c;
+    return rv;
+}
+
+static EJSBool
+ucs2_is_latin1 (const jschar* str, int len)
+{
+    for (int i = 0; i < len; i ++) {
+        if (str[i] > 0xff)
+            return EJS_FALSE;
     }
-    *p = 0;
-    rv->length = p - rv->data.flat;
+    return EJS_TRUE;
+}
+
+ejsval
+_ejs_string_new_latin1_len (const uint8_t* str, int len)
+{
+    EJSPrimString* rv = new_flat (len, EJS_TRUE);
+    memmove (rv->data.latin1, str, len);
+    rv->data.latin1[len] = 0;
     return STRING_TO_EJSVAL(rv);
 }
 
+ejsval
+_ejs_string_new_utf8 (const char* str)
+{
+    return _ejs_string_new_utf8_len (str, strlen(str));
+}
+
+// @len is in bytes
 ejsval
 _ejs_string_new_utf8_len (const char* str, int len)
 {
-    size_t value_size = EJS_PRIMSTR_FLAT_ALLOC_SIZE + sizeof(jschar) * (len + 1);
-    EJSBool ool_buffer = EJS_FALSE;
+    const uint8_t *stru = (const uint8_t*)str;
 
-    if (value_size > 2048) {
-        value_size = EJS_PRIMSTR_FLAT_ALLOC_SIZE;
-        ool_buffer = EJS_TRUE;
-    }
+    // ascii is by far the common case, and is already latin1
+    if (ascii_prefix_length (stru, len) == len)
+        return _ejs_string_new_latin1_len (stru, len);
 
-    EJSPrimString* rv = _ejs_gc_new_primstr(value_size);
-    EJS_PRIMSTR_SET_TYPE(rv, EJS_STRING_FLAT);
-    if (ool_buffer) {
-        EJS_PRIMSTR_SET_HAS_OOL_BUFFER(rv);
-        rv->data.flat = (jschar*)malloc(sizeof(jschar) * (len + 1));
-    }
-    else {
-        rv->data.flat = (jschar*)((char*)rv + EJS_PRIMSTR_FLAT_ALLOC_SIZE);
-    }
-    jschar *p = rv->data.flat;
-    const unsigned char *stru = (const unsigned char*)str;
-    while (len > 0) {
-        jschar c = utf8_to_ucs2 (stru, &stru);
-        if (c == (jschar)-1) {
-            break;
-        }
-        *p++ = c;
-        len--;
-    }
-    *p = 0;
-    rv->length = p - rv->data.flat;
-    return STRING_TO_EJSVAL(rv);
+    // no utf8 sequence decodes to more characters than it has bytes
+    jschar stack_buffer[256];
+    jschar *buffer = len <= 256 ? stack_buffer : (jschar*)malloc(sizeof(jschar) * len);
+    int length = utf8_to_utf16 (stru, len, buffer);
+    ejsval rv = _ejs_string_new_ucs2_len (buffer, length);
+    if (buffer != stack_buffer)
+        free (buffer);
+    return rv;
 }
 
 ejsval
 _ejs_string_new_ucs2 (const jschar* str)
 {
-    int str_len = ucs2_strlen(str);
-    size_t value_size = EJS_PRIMSTR_FLAT_ALLOC_SIZE + sizeof(jschar) * (str_len + 1);
-    EJSBool ool_buffer = EJS_FALSE;
-
-    if (value_size > 2048) {
-        value_size = EJS_PRIMSTR_FLAT_ALLOC_SIZE;
-        ool_buffer = EJS_TRUE;
-    }
+    return _ejs_string_new_ucs2_len (str, ucs2_strlen(str));
+}
 
-    EJSPrimString* rv = _ejs_gc_new_primstr(value_size);
-    EJS_PRIMSTR_SET_TYPE(rv, EJS_STRING_FLAT);
-    rv->length = str_len;
-    if (ool_buffer) {
-        EJS_PRIMSTR_SET_HAS_OOL_BUFFER(rv);
-        rv->data.flat = (jschar*)malloc(sizeof(jschar) * (str_len + 1));
+// narrows to latin1 if it can
+ejsval
+_ejs_string_new_ucs2_len (const jschar* str, int len)
+{
+    EJSPrimString* rv;
+    if (ucs2_is_latin1 (str, len)) {
+        rv = new_flat (len, EJS_TRUE);
+        for (int i = 0; i < len; i ++)
+            rv->data.latin1[i] = (uint8_t)str[i];
+        rv->data.latin1[len] = 0;
     }
     else {
-        rv->data.flat = (jschar*)((char*)rv + EJS_PRIMSTR_FLAT_ALLOC_SIZE);
+        rv = new_flat (len, EJS_FALSE);
+        memmove (rv->data.flat, str, len * sizeof(jschar));
+        rv->data.flat[len] = 0;
     }
-    memmove (rv->data.flat, str, str_len * sizeof(jschar));
-    rv->data.flat[str_len] = 0;
     return STRING_TO_EJSVAL(rv);
 }
 
-ejsval
-_ejs_string_new_ucs2_len (const jschar* str, int len)
+// where flattening writes the next characters, and how wide they are
+typedef struct {
+    EJSBool latin1;
+    union {
+        jschar *ucs2;
+        uint8_t *latin1;
+    } p;
+} FlattenCursor;
+
+static void
+flatten_cursor_init (FlattenCursor *c, EJSPrimString* flat)
 {
-    size_t value_size = EJS_PRIMSTR_FLAT_ALLOC_SIZE + sizeof(jschar) * (len + 1);
-    EJSBool ool_buffer = EJS_FALSE;
+    c->latin1 = EJS_PRIMSTR_IS_LATIN1(flat);
+    c->p.ucs2 = flat->data.flat;
+}
 
-    if (value_size > 2048) {
-        value_size = EJS_PRIMSTR_FLAT_ALLOC_SIZE;
-        ool_buffer = EJS_TRUE;
+static void
+flatten_cursor_terminate (FlattenCursor *c)
+{
+    if (c->latin1)
+        *c->p.latin1 = 0;
+    else
+        *c->p.ucs2 = 0;
+}
+
+typedef void (*FlatRunFunc) (void* data, EJSPrimString* flat, int off, int len);
+
+// calls @func on each run of characters in a flat string that together make up the @len
+// characters at @off in @n, in order.  appending to a string in a loop builds ropes thousands of
+// levels deep, so this walks them with an explicit stack instead of recursing.
+static void
+walk_flat_runs (EJSPrimString* n, int off, int len, FlatRunFunc func, void* data)
+{
+    typedef struct {
+        EJSPrimString* n;
+        int off;
+        int len;
+    } Frame;
+
+    Frame inline_frames[64];
+    Frame* frames = inline_frames;
+    int frames_size = 64;
+    int top = 0;
+
+    Frame f = { n, off, len };
+    for (;;) {
+        // follow left children in a loop, saving the right halves for later
+        while (f.len > 0) {
+            switch (EJS_PRIMSTR_GET_TYPE(f.n)) {
+            case EJS_STRING_FLAT:
+                func (data, f.n, f.off, f.len);
+                f.len = 0;
+                break;
+            case EJS_STRING_DEPENDENT:
+                f.off += f.n->data.dependent.off;
+                f.n = f.n->data.dependent.dep;
+                break;
+            case EJS_STRING_ROPE: {
+                EJSPrimString* left = f.n->data.rope.left;
+                if (f.off >= left->length) {
+                    f.off -= left->length;
+                    f.n = f.n->data.rope.right;
+                    break;
+                }
+                int left_len = MIN(f.len, left->length - f.off);
+                if (f.len > left_len) {
+                    if (top == frames_size) {
+                        frames_size *= 2;
+                        if (frames == inline_frames) {
+                            frames = (Frame*)malloc(sizeof(Frame) * frames_size);
+                            memmove (frames, inline_frames, sizeof(inline_frames));
+                        }
+                        else {
+                            frames = (Frame*)realloc(frames, sizeof(Frame) * frames_size);
+                        }
+                    }
+                    Frame right = { f.n->data.rope.right, 0, f.len - left_len };
+                    frames[top++] = right;
+                }
+                f.n = left;
+                f.len = left_len;
+                break;
+            }
+            default:
+                EJS_NOT_IMPLEMENTED();
+            }
+        }
+        if (top == 0)
+            break;
+        f = frames[--top];
     }
 
-    EJSPrimString* rv = _ejs_gc_new_primstr(value_size);
-    EJS_PRIMSTR_SET_TYPE(rv, EJS_STRING_FLAT);
-    rv->length = len;
-    if (ool_buffer) {
-        EJS_PRIMSTR_SET_HAS_OOL_BUFFER(rv);
-        rv->data.flat = (jschar*)malloc(sizeof(jschar) * (len + 1));
+    if (frames != inline_frames)
+        free (frames);
+}
+
+// copies @len characters starting at @off of the flat string @flat to the FlattenCursor @data,
+// converting between widths as needed.  a latin1 cursor can still be fed ucs2 characters, from
+// latin1 strings that have since been widened.
+static void
+flatten_append (void* data, EJSPrimString *flat, int off, int len)
+{
+    FlattenCursor *c = (FlattenCursor*)data;
+
+    if (EJS_PRIMSTR_IS_LATIN1(flat)) {
+        const uint8_t *src = flat->data.latin1 + off;
+        if (c->latin1) {
+            memmove (c->p.latin1, src, len);
+            c->p.latin1 += len;
+        }
+        else {
+            for (int i = 0; i < len; i ++)
+                *c->p.ucs2++ = src[i];
+        }
     }
     else {
-        rv->data.flat = (jschar*)((char*)rv + EJS_PRIMSTR_FLAT_ALLOC_SIZE);
+        const jschar *src = flat->data.flat + off;
+        if (c->latin1) {
+            for (int i = 0; i < len; i ++)
+                *c->p.latin1++ = (uint8_t)src[i];
+        }
+        else {
+            memmove (c->p.ucs2, src, len * sizeof(jschar));
+            c->p.ucs2 += len;
+        }
     }
-    memmove (rv->data.flat, str, len * sizeof(jschar));
-    rv->data.flat[len] = 0;
-    return STRING_TO_EJSVAL(rv);
 }
 
-static void flatten_dep (jschar **p, EJSPrimString *n, int* off, int* len);
-
 ejsval
 _ejs_string_new_substring (ejsval str, int off, int len)
 {
     EJSPrimString *prim_str = EJSVAL_TO_STRING(str);
     EJSPrimString* rv;
 
+    // the stack scan only recognizes tagged values, so keep one for @str while we allocate and
+    // read prim_str back from it afterward
+    volatile ejsval str_root = str;
+
     // XXX we should probably validate off/len here..
     if (len < FLAT_DEP_THRESHOLD) {
-        rv = _ejs_gc_new_primstr(EJS_PRIMSTR_FLAT_ALLOC_SIZE + sizeof(jschar) * (len + 1));
-        EJS_PRIMSTR_SET_TYPE(rv, EJS_STRING_FLAT);
+        rv = new_flat (len, EJS_PRIMSTR_IS_LATIN1(prim_str));
+        prim_str = EJSVAL_TO_STRING(str_root);
 
-        rv->data.flat = (jschar*)((char*)rv + EJS_PRIMSTR_FLAT_ALLOC_SIZE);
-
-        // reuse the flatten machinery by using a stack allocated dep string that we flatten into the rv
-        EJSPrimString dep = { 0 };
-        EJS_PRIMSTR_SET_TYPE(&dep, EJS_STRING_DEPENDENT);
-        dep.length = len;
-        dep.data.dependent.dep = prim_str;
-        dep.data.dependent.off = off;
-        jschar* p = rv->data.flat;
-        int tmp_off = 0;
-        int tmp_len = len;
-        flatten_dep (&p, &dep, &tmp_off, &tmp_len);
-        *p = 0;
+        FlattenCursor c;
+        flatten_cursor_init (&c, rv);
+        walk_flat_runs (prim_str, off, len, flatten_append, &c);
+        flatten_cursor_terminate (&c);
     }
     else {
         rv = _ejs_gc_new_primstr(EJS_PRIMSTR_DEP_ALLOC_SIZE);
+        prim_str = EJSVAL_TO_STRING(str_root);
         EJS_PRIMSTR_SET_TYPE(rv, EJS_STRING_DEPENDENT);
+        if (EJS_PRIMSTR_IS_LATIN1(prim_str))
+            EJS_PRIMSTR_SET_LATIN1(rv);
         rv->data.dependent.dep = prim_str;
         rv->data.dependent.off = off;
     }
@@ -2108,29 +2187,196 @@ _ejs_string_new_substring (ejsval str, int off, int len)
     return STRING_TO_EJSVAL(rv);
 }
 
+static uint32_t
+rope_depth (EJSPrimString* n)
+{
+    return EJS_PRIMSTR_GET_TYPE(n) == EJS_STRING_ROPE ? n->data.rope.depth : 0;
+}
+
+static EJSPrimString*
+new_rope (EJSPrimString* lhs, EJSPrimString* rhs)
+{
+    // callers often have the pieces only as raw pointers, which the stack scan doesn't recognize
+    volatile ejsval lhs_root = STRING_TO_EJSVAL(lhs);
+    volatile ejsval rhs_root = STRING_TO_EJSVAL(rhs);
+
+    EJSPrimString* rv = _ejs_gc_new_primstr (EJS_PRIMSTR_ROPE_ALLOC_SIZE);
+    lhs = EJSVAL_TO_STRING(lhs_root);
+    rhs = EJSVAL_TO_STRING(rhs_root);
+
+    EJS_PRIMSTR_SET_TYPE(rv, EJS_STRING_ROPE);
+    if (EJS_PRIMSTR_IS_LATIN1(lhs) && EJS_PRIMSTR_IS_LATIN1(rhs))
+        EJS_PRIMSTR_SET_LATIN1(rv);
+    rv->length = lhs->length + rhs->length;
+    rv->data.rope.left = lhs;
+    rv->data.rope.right = rhs;
+    rv->data.rope.depth = MAX(rope_depth(lhs), rope_depth(rhs)) + 1;
+    return rv;
+}
+
+// concatenation for rebalancing: neighbouring pieces that add up to less than this are copied
+// into one flat string, so the pieces of a rope rebuilt from many small appends grow over time.
+#define REBALANCE_FLAT_THRESHOLD 1024
+
+static ejsval
+rebalance_concat (ejsval left, ejsval right)
+{
+    EJSPrimString* lhs = EJSVAL_TO_STRING(left);
+    EJSPrimString* rhs = EJSVAL_TO_STRING(right);
+
+    if (lhs->length + rhs->length >= REBALANCE_FLAT_THRESHOLD)
+        return STRING_TO_EJSVAL(new_rope (lhs, rhs));
+
+    volatile ejsval left_root = left;
+    volatile ejsval right_root = right;
+    EJSPrimString* rv = new_flat (lhs->length + rhs->length, EJS_PRIMSTR_IS_LATIN1(lhs) && EJS_PRIMSTR_IS_LATIN1(rhs));
+    lhs = EJSVAL_TO_STRING(left_root);
+    rhs = EJSVAL_TO_STRING(right_root);
+
+    FlattenCursor c;
+    flatten_cursor_init (&c, rv);
+    walk_flat_runs (lhs, 0, lhs->length, flatten_append, &c);
+    walk_flat_runs (rhs, 0, rhs->length, flatten_append, &c);
+    flatten_cursor_terminate (&c);
+    return STRING_TO_EJSVAL(rv);
+}
+
+// slots in the rebalancing forest.  a balanced rope in slot i has at least fib(i+2) characters, so
+// this covers any string length.
+#define REBALANCE_FOREST_SIZE 48
+
+// rebuilds @rope as a balanced rope over the same pieces, from Boehm, Atkinson and Plass, "Ropes:
+// an Alternative to Strings."  a rope is balanced if its length is at least fib(depth+2), and
+// balanced subtrees are kept whole, so rebalancing a rope built by appending to an already
+// rebalanced one only has to look at the new part.
+static ejsval
+rebalance (ejsval rope)
+{
+    // forest[i] is either undefined or a rope with length in [fib[i], fib[i+1]).  the slots that
+    // are filled, highest first, make up everything added so far.  they're ejsvals on the stack
+    // so the collector sees the ropes we build here.
+    ejsval forest[REBALANCE_FOREST_SIZE];
+    uint64_t fib[REBALANCE_FOREST_SIZE + 1];
+
+    // the pieces still to visit are raw pointers, kept alive only through @rope, so the walk
+    // starts from a copy the stack scan will see
+    volatile ejsval rope_root = rope;
+
+    fib[0] = 1;
+    fib[1] = 2;
+    for (int i = 2; i <= REBALANCE_FOREST_SIZE; i ++)
+        fib[i] = fib[i-1] + fib[i-2];
+    for (int i = 0; i < REBALANCE_FOREST_SIZE; i ++)
+        forest[i] = _ejs_undefined;
+
+    // walk the pieces (flat strings, dependent strings and balanced ropes) of @rope left to right,
+    // with an explicit stack of the right children still to visit
+    EJSPrimString* inline_pending[64];
+    EJSPrimString** pending = inline_pending;
+    int pending_size = 64;
+    int top = 0;
+
+    EJSPrimString* n = EJSVAL_TO_STRING(rope_root);
+    for (;;) {
+        while (EJS_PRIMSTR_GET_TYPE(n) == EJS_STRING_ROPE &&
+               (n->data.rope.depth >= REBALANCE_FOREST_SIZE || n->length < fib[n->data.rope.depth])) {
+            if (top == pending_size) {
+                pending_size *= 2;
+                if (pending == inline_pending) {
+                    pending = (EJSPrimString**)malloc(sizeof(EJSPrimString*) * pending_size);
+                    memmove (pending, inline_pending, sizeof(inline_pending));
+                }
+                else {
+                    pending = (EJSPrimString**)realloc(pending, sizeof(EJSPrimString*) * pending_size);
+                }
+            }
+            pending[top++] = n->data.rope.right;
+            n = n->data.rope.left;
+        }
+
+        if (n->length > 0) {
+            // merge the piece with every smaller slot, then upward until it fits
+            ejsval piece = STRING_TO_EJSVAL(n);
+            for (int i = 0; i < REBALANCE_FOREST_SIZE; i ++) {
+                if (!EJSVAL_IS_UNDEFINED(forest[i])) {
+                    piece = rebalance_concat (forest[i], piece);
+                    forest[i] = _ejs_undefined;
+                }
+                if (EJSVAL_TO_STRLEN(piece) < fib[i+1] || i == REBALANCE_FOREST_SIZE - 1) {
+                    forest[i] = piece;
+                    break;
+                }
+            }
+        }
+
+        if (top == 0)
+            break;
+        n = pending[--top];
+    }
 
-static void flatten_rope (jschar **p, EJSPrimString *n);
+    if (pending != inline_pending)
+        free (pending);
+
+    ejsval rv = _ejs_undefined;
+    for (int i = 0; i < REBALANCE_FOREST_SIZE; i ++) {
+        if (EJSVAL_IS_UNDEFINED(forest[i]))
+            continue;
+        rv = EJSVAL_IS_UNDEFINED(rv) ? forest[i] : rebalance_concat (forest[i], rv);
+    }
+    return rv;
+}
 
 ejsval
 _ejs_string_concat (ejsval left, ejsval right)
 {
     EJSPrimString* lhs = EJSVAL_TO_STRING(left);
     EJSPrimString* rhs = EJSVAL_TO_STRING(right);
+    EJSBool latin1 = EJS_PRIMSTR_IS_LATIN1(lhs) && EJS_PRIMSTR_IS_LATIN1(rhs);
+
+    // our caller may not need @left or @right after this, in which case an optimizing compiler
+    // leaves only lhs and rhs, which the stack scan doesn't see.  keep tagged copies where it does,
+    // and read lhs and rhs back from them after allocating.
+    volatile ejsval left_root = left;
+    volatile ejsval right_root = right;
     
     if (lhs->length + rhs->length < FLAT_ROPE_THRESHOLD) {
         uint32_t new_strlen = lhs->length + rhs->length;
+        if (latin1) {
+            EJSPrimString* rv = new_flat (new_strlen, EJS_TRUE);
+            lhs = EJSVAL_TO_STRING(left_root);
+            rhs = EJSVAL_TO_STRING(right_root);
+
+            FlattenCursor c;
+            flatten_cursor_init (&c, rv);
+            walk_flat_runs (lhs, 0, lhs->length, flatten_append, &c);
+            walk_flat_runs (rhs, 0, rhs->length, flatten_append, &c);
+            flatten_cursor_terminate (&c);
+            return STRING_TO_EJSVAL(rv);
+        }
+
+        // one side might still be latin1 in a ucs2 buffer (string literals are), so let
+        // _ejs_string_new_ucs2_len narrow the result.
         jschar buffer[FLAT_ROPE_THRESHOLD];
-        jschar *p = buffer;
-        flatten_rope(&p, lhs);
-        flatten_rope(&p, rhs);
+        FlattenCursor c = { EJS_FALSE, { buffer } };
+        walk_flat_runs (lhs, 0, lhs->length, flatten_append, &c);
+        walk_flat_runs (rhs, 0, rhs->length, flatten_append, &c);
         return _ejs_string_new_ucs2_len(buffer, new_strlen);
     }
     else {
-        EJSPrimString* rv = _ejs_gc_new_primstr (EJS_PRIMSTR_ROPE_ALLOC_SIZE);
-        EJS_PRIMSTR_SET_TYPE(rv, EJS_STRING_ROPE);
-        rv->length = lhs->length + rhs->length;
-        rv->data.rope.left = lhs;
-        rv->data.rope.right = rhs;
+        // appending a short string to a rope that ends in a short flat string merges the two,
+        // rather than making the rope a level deeper for every piece appended
+        if (EJS_PRIMSTR_GET_TYPE(lhs) == EJS_STRING_ROPE) {
+            EJSPrimString* last = lhs->data.rope.right;
+            if (EJS_PRIMSTR_GET_TYPE(last) == EJS_STRING_FLAT && last->length + rhs->length < FLAT_ROPE_THRESHOLD) {
+                ejsval merged = _ejs_string_concat (STRING_TO_EJSVAL(last), right);
+                lhs = EJSVAL_TO_STRING(left_root);
+                return STRING_TO_EJSVAL(new_rope (lhs->data.rope.left, EJSVAL_TO_STRING(merged)));
+            }
+        }
+
+        EJSPrimString* rv = new_rope (lhs, rhs);
+        if (rv->data.rope.depth > ROPE_MAX_DEPTH)
+            return rebalance (STRING_TO_EJSVAL(rv));
         return STRING_TO_EJSVAL(rv);
     }
 }
@@ -2156,128 +2402,193 @@ _ejs_string_concatv (ejsval first, ...)
     return result;
 }
 
-static void flatten_dep (jschar **p, EJSPrimString *n, int* off, int* len);
+/// string builders
 
-static void
-flatten_rope (jschar **p, EJSPrimString *n)
-{
-    switch (EJS_PRIMSTR_GET_TYPE(n)) {
-    case EJS_STRING_FLAT:
-        memmove (*p, n->data.flat, n->length * sizeof(jschar));
-        *p += n->length;
-        break;
-    case EJS_STRING_ROPE:
-        flatten_rope(p, n->data.rope.left);
-        flatten_rope(p, n->data.rope.right);
-        break;
-    case EJS_STRING_DEPENDENT: {
-        int off = n->data.dependent.off;
-        int len = n->length;
-        flatten_dep (p, n->data.dependent.dep, &off, &len);
-        break;
-    }
-    default:
-        EJS_NOT_IMPLEMENTED();
-    }
+void
+_ejs_string_builder_init (EJSStringBuilder* builder)
+{
+    builder->latin1 = EJS_TRUE;
+    builder->length = 0;
+    builder->capacity = sizeof(builder->inline_buffer);
+    builder->buffer = builder->inline_buffer;
 }
 
+// makes room for @len more characters and a terminating 0, widening the buffer to ucs2 first if
+// @widen.  the capacity doubles each time it runs out, so appending n characters a piece at a time
+// copies O(n) of them in all.
 static void
-flatten_dep (jschar **p, EJSPrimString *n, int* off, int* len)
+builder_reserve (EJSStringBuilder* builder, uint32_t len, EJSBool widen)
 {
-    // nothing else to append
-    if (*len == 0)
-        return;
+    size_t char_size = (builder->latin1 && !widen) ? sizeof(uint8_t) : sizeof(jschar);
+    size_t needed = (builder->length + len + 1) * char_size;
 
-    // first step is to locate the node that contains the start of our characters
-    if (*off >= 0) {
-        switch (EJS_PRIMSTR_GET_TYPE(n)) {
-        case EJS_STRING_FLAT: {
-            if (*off < n->length) {
-                // we handle the first append here
-                int length_to_append = MIN(*len, n->length - *off);
-                memmove (*p, n->data.flat + *off, length_to_append * sizeof(jschar));
-                *p += length_to_append;
-                *len -= length_to_append;
-                *off = 0;
-            }
-            else {
-                *off -= n->length;
-            }
-            break;
-        }
-        case EJS_STRING_ROPE:
-            flatten_dep(p, n->data.rope.left, off, len);
-            flatten_dep(p, n->data.rope.right, off, len);
-            break;
-        case EJS_STRING_DEPENDENT: {
-            *off += n->data.dependent.off;
-            flatten_dep(p, n->data.dependent.dep, off, len);
-            break;
+    if (needed > builder->capacity) {
+        size_t capacity = builder->capacity * 2;
+        while (capacity < needed)
+            capacity *= 2;
+
+        if (builder->buffer == builder->inline_buffer) {
+            void* buffer = malloc (capacity);
+            memmove (buffer, builder->inline_buffer, builder->length * (builder->latin1 ? sizeof(uint8_t) : sizeof(jschar)));
+            builder->buffer = buffer;
         }
-        default:
-            EJS_NOT_IMPLEMENTED();
+        else {
+            builder->buffer = realloc (builder->buffer, capacity);
         }
+        builder->capacity = capacity;
+    }
+
+    if (widen) {
+        // back to front, so no character is overwritten before it's been moved
+        uint8_t* narrow = (uint8_t*)builder->buffer;
+        jschar* wide = (jschar*)builder->buffer;
+        for (int i = (int)builder->length - 1; i >= 0; i --)
+            wide[i] = narrow[i];
+        builder->latin1 = EJS_FALSE;
+    }
+}
+
+static void
+builder_append_run (void* data, EJSPrimString* flat, int off, int len)
+{
+    EJSStringBuilder* builder = (EJSStringBuilder*)data;
+
+    // ucs2 strings whose characters all fit in latin1 (literals, say) don't widen the buffer
+    EJSBool widen = builder->latin1 && !EJS_PRIMSTR_IS_LATIN1(flat) && !ucs2_is_latin1 (flat->data.flat + off, len);
+    builder_reserve (builder, len, widen);
+
+    FlattenCursor c;
+    c.latin1 = builder->latin1;
+    if (c.latin1)
+        c.p.latin1 = (uint8_t*)builder->buffer + builder->length;
+    else
+        c.p.ucs2 = (jschar*)builder->buffer + builder->length;
+    flatten_append (&c, flat, off, len);
+    builder->length += len;
+}
+
+void
+_ejs_string_builder_append (EJSStringBuilder* builder, ejsval str)
+{
+    EJSPrimString* primstr = EJSVAL_TO_STRING(str);
+    walk_flat_runs (primstr, 0, primstr->length, builder_append_run, builder);
+}
+
+ejsval
+_ejs_string_builder_finish (EJSStringBuilder* builder)
+{
+    EJSBool latin1 = builder->latin1;
+    size_t char_size = latin1 ? sizeof(uint8_t) : sizeof(jschar);
+    size_t size = (builder->length + 1) * char_size;
+    EJSPrimString* rv;
+
+    if (builder->buffer == builder->inline_buffer || EJS_PRIMSTR_FLAT_ALLOC_SIZE + size <= 2048) {
+        // small enough that new_flat keeps the characters inline, so copy them there
+        rv = new_flat (builder->length, latin1);
+        memmove (rv->data.flat, builder->buffer, builder->length * char_size);
+        if (builder->buffer != builder->inline_buffer)
+            free (builder->buffer);
     }
     else {
-        // we need to append len characters from this string into the buffer
-        switch (EJS_PRIMSTR_GET_TYPE(n)) {
-        case EJS_STRING_FLAT: {
-            int length_to_append = MIN (*len, n->length);
-            memmove (*p, n->data.flat, length_to_append * sizeof(jschar));
-            *p += length_to_append;
-            *len -= length_to_append;
-            break;
-        }
-        case EJS_STRING_ROPE:
-            flatten_dep(p, n->data.rope.left, off, len);
-            flatten_dep(p, n->data.rope.right, off, len);
-            break;
-        case EJS_STRING_DEPENDENT: {
-            int length_to_append = MIN (*len, n->length);
-            flatten_dep (p, n->data.dependent.dep, off, &length_to_append);
-            *len -= length_to_append;
-            break;
-        }
-        default:
-            EJS_NOT_IMPLEMENTED();
-        }
+        // the string takes over the buffer, only giving back the slack if there's a lot of it
+        rv = _ejs_gc_new_primstr (EJS_PRIMSTR_FLAT_ALLOC_SIZE);
+        EJS_PRIMSTR_SET_TYPE(rv, EJS_STRING_FLAT);
+        if (latin1)
+            EJS_PRIMSTR_SET_LATIN1(rv);
+        EJS_PRIMSTR_SET_HAS_OOL_BUFFER(rv);
+        rv->length = builder->length;
+        if (builder->capacity / 2 > size)
+            builder->buffer = realloc (builder->buffer, size);
+        rv->data.flat = (jschar*)builder->buffer;
     }
+
+    FlattenCursor c;
+    flatten_cursor_init (&c, rv);
+    if (c.latin1)
+        c.p.latin1 += rv->length;
+    else
+        c.p.ucs2 += rv->length;
+    flatten_cursor_terminate (&c);
+
+    // the builder doesn't own a buffer anymore, but can be used again
+    _ejs_string_builder_init (builder);
+    return STRING_TO_EJSVAL(rv);
+}
+
+void
+_ejs_string_builder_discard (EJSStringBuilder* builder)
+{
+    if (builder->buffer != builder->inline_buffer)
+        free (builder->buffer);
+    _ejs_string_builder_init (builder);
+}
+
+ejsval
+_ejs_string_concatn (uint32_t argc, ejsval* args)
+{
+    if (argc == 0)
+        return _ejs_atom_empty;
+    if (argc == 1)
+        return args[0];
+
+    EJSStringBuilder builder;
+    _ejs_string_builder_init (&builder);
+    for (uint32_t i = 0; i < argc; i ++)
+        _ejs_string_builder_append (&builder, args[i]);
+    return _ejs_string_builder_finish (&builder);
 }
 
 EJSPrimString*
-_ejs_primstring_flatten (EJSPrimString* primstr)
+_ejs_primstring_flatten_any (EJSPrimString* primstr)
 {
     if (EJS_PRIMSTR_GET_TYPE(primstr) == EJS_STRING_FLAT)
         return primstr;
 
-    jschar *buffer = (jschar*)malloc(sizeof(jschar) * (primstr->length + 1));
-    jschar *p = buffer;
+    // modify the string in-place, switching from a rope or dep to a flat string
+    EJSBool latin1 = EJS_PRIMSTR_IS_LATIN1(primstr);
+    void *buffer = malloc((latin1 ? sizeof(uint8_t) : sizeof(jschar)) * (primstr->length + 1));
+    FlattenCursor c;
+    c.latin1 = latin1;
+    c.p.ucs2 = (jschar*)buffer;
+    walk_flat_runs (primstr, 0, primstr->length, flatten_append, &c);
+    flatten_cursor_terminate (&c);
 
-    switch (EJS_PRIMSTR_GET_TYPE(primstr)) {
-    case EJS_STRING_DEPENDENT: {
-        // modify the string in-place, switching from a dep to a flat string
-        int off = 0;
-        int length = primstr->length;
-        flatten_dep (&p, primstr, &off, &length);
-        //EJS_ASSERT (off == 0);
-        //EJS_ASSERT (length == 0);
-        break;
-    }
-    case EJS_STRING_ROPE: {
-        // modify the string in-place, switching from a rope to a flat string
-        flatten_rope (&p, primstr);
-        break;
-    }
-    default:
-        EJS_NOT_REACHED();
-    }
+    EJS_PRIMSTR_CLEAR_TYPE(primstr);
+    EJS_PRIMSTR_SET_TYPE(primstr, EJS_STRING_FLAT);
+    EJS_PRIMSTR_SET_HAS_OOL_BUFFER(primstr);
+    primstr->data.flat = (jschar*)buffer;
+    return primstr;
+}
 
+EJSPrimString*
+_ejs_string_flatten_any (ejsval str)
+{
+    return _ejs_primstring_flatten_any (EJSVAL_TO_STRING_IMPL(str));
+}
+
+// switches a latin1 flat string to ucs2 in place.  this only happens for callers that want a
+// jschar*, and only once per string.
+static void
+widen_flat (EJSPrimString* primstr)
+{
+    jschar *buffer = (jschar*)malloc(sizeof(jschar) * (primstr->length + 1));
+    for (int i = 0; i < primstr->length; i ++)
+        buffer[i] = primstr->data.latin1[i];
     buffer[primstr->length] = 0;
 
-    EJS_PRIMSTR_CLEAR_TYPE(primstr);
-    EJS_PRIMSTR_SET_TYPE(primstr, EJS_STRING_FLAT);
+    if (EJS_PRIMSTR_HAS_OOL_BUFFER(primstr))
+        free (primstr->data.latin1);
+    EJS_PRIMSTR_CLEAR_LATIN1(primstr);
     EJS_PRIMSTR_SET_HAS_OOL_BUFFER(primstr);
     primstr->data.flat = buffer;
+}
+
+EJSPrimString*
+_ejs_primstring_flatten (EJSPrimString* primstr)
+{
+    primstr = _ejs_primstring_flatten_any (primstr);
+    if (EJS_PRIMSTR_IS_LATIN1(primstr))
+        widen_flat (primstr);
     return primstr;
 }
 
@@ -2287,63 +2598,44 @@ _ejs_string_flatten (ejsval str)
     return _ejs_primstring_flatten (EJSVAL_TO_STRING_IMPL(str));
 }
 
+// the hash is over characters, not bytes, so it's the same whichever width the string is stored in
 static uint32_t
-hash_dep (int hash, EJSPrimString* n, int* off, int* len)
+flat_hash (EJSPrimString* flat, int32_t hash, int off, int length)
 {
-    // nothing left to hash
-    if (*len == 0)
-        return hash;
+    if (EJS_PRIMSTR_IS_LATIN1(flat))
+        return latin1_hash (flat->data.latin1 + off, hash, length);
+    return ucs2_hash (flat->data.flat + off, hash, length);
+}
 
-    // first step is to locate the node that contains the start of our characters
-    if (*off >= 0) {
-        switch (EJS_PRIMSTR_GET_TYPE(n)) {
-        case EJS_STRING_FLAT:
-            if (*off < n->length) {
-                int length_to_hash = MIN(*len, n->length - *off);
-                hash = ucs2_hash (n->data.flat + *off, hash, length_to_hash);
-                *len -= length_to_hash;
-                *off = 0;
-            }
-            else {
-                *off -= n->length;
-            }
-            break;
-        case EJS_STRING_ROPE:
-            hash = hash_dep (hash, n->data.rope.left, off, len);
-            hash = hash_dep (hash, n->data.rope.right, off, len);
-            break;
-        case EJS_STRING_DEPENDENT:
-            *off += n->data.dependent.off;
-            hash = hash_dep(hash, n->data.dependent.dep, off, len);
-            break;
-        }
-    }
-    return hash;
+static void
+hash_run (void* data, EJSPrimString* flat, int off, int len)
+{
+    uint32_t *hash = (uint32_t*)data;
+    *hash = flat_hash (flat, *hash, off, len);
 }
 
+// the polynomial the kernels compute has poorly mixed low bits (the lowest is just the parity of
+// the characters' sum), and hash tables index with them, so they're run through murmur3's
+// finalizer.  mixing in the length keeps leading NULs from hashing the same as nothing.
 static uint32_t
-_ejs_primstring_hash_inner (EJSPrimString* primstr, int cur_hash)
+hash_finish (uint32_t h, uint32_t length)
 {
-    switch (EJS_PRIMSTR_GET_TYPE(primstr)) {
-    case EJS_STRING_FLAT:
-        return ucs2_hash (primstr->data.flat, cur_hash, primstr->length);
-    case EJS_STRING_DEPENDENT: {
-        int length = primstr->length;
-        int off = 0;
-        return hash_dep (cur_hash, primstr, &off, &length);
-    }
-    case EJS_STRING_ROPE: {
-        int hash = _ejs_primstring_hash_inner (primstr->data.rope.left, cur_hash);
-        return _ejs_primstring_hash_inner (primstr->data.rope.right, hash);
-    }
-    }
+    h ^= length;
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
 }
 
 uint32_t
 _ejs_primstring_hash (EJSPrimString* primstr)
 {
     if (!EJS_PRIMSTR_HAS_HASH(primstr)) {
-        primstr->hash = _ejs_primstring_hash_inner (primstr, 0);
+        uint32_t hash = 0;
+        walk_flat_runs (primstr, 0, primstr->length, hash_run, &hash);
+        primstr->hash = hash_finish (hash, primstr->length);
         EJS_PRIMSTR_SET_HAS_HASH(primstr);
     }
     return primstr->hash;
@@ -2357,6 +2649,56 @@ _ejs_string_hash (ejsval str)
     return _ejs_primstring_hash (EJSVAL_TO_STRING_IMPL(str));
 }
 
+int32_t
+_ejs_primstring_compare (EJSPrimString* a, EJSPrimString* b)
+{
+    if (a == b)
+        return 0;
+
+    a = _ejs_primstring_flatten_any (a);
+    b = _ejs_primstring_flatten_any (b);
+
+    int len = MIN(a->length, b->length);
+    EJSBool a_latin1 = EJS_PRIMSTR_IS_LATIN1(a);
+    EJSBool b_latin1 = EJS_PRIMSTR_IS_LATIN1(b);
+    int i;
+
+    if (a_latin1 && b_latin1) {
+        int rv = memcmp (a->data.latin1, b->data.latin1, len);
+        if (rv)
+            return rv;
+        i = len;
+    }
+    else if (!a_latin1 && !b_latin1)
+        i = ucs2_mismatch (a->data.flat, b->data.flat, len);
+    else if (a_latin1)
+        i = latin1_ucs2_mismatch (a->data.latin1, b->data.flat, len);
+    else
+        i = latin1_ucs2_mismatch (b->data.latin1, a->data.flat, len);
+
+    if (i < len)
+        return ((int32_t)EJS_PRIMSTR_FLAT_CHAR_AT(a, i)) - ((int32_t)EJS_PRIMSTR_FLAT_CHAR_AT(b, i));
+    return ((int32_t)a->length) - ((int32_t)b->length);
+}
+
+EJSBool
+_ejs_primstring_equal (EJSPrimString* a, EJSPrimString* b)
+{
+    if (a == b)
+        return EJS_TRUE;
+    if (a->length != b->length)
+        return EJS_FALSE;
+    // there's only one atom for any given contents
+    if (EJS_PRIMSTR_IS_ATOM(a) && EJS_PRIMSTR_IS_ATOM(b))
+        return EJS_FALSE;
+    if (EJS_PRIMSTR_HAS_HASH(a) && EJS_PRIMSTR_HAS_HASH(b) && a->hash != b->hash)
+        return EJS_FALSE;
+
+    a = _ejs_primstring_flatten_any (a);
+    b = _ejs_primstring_flatten_any (b);
+    return flat_chars_equal (a, 0, b, 0, a->length);
+}
+
 jschar
 _ejs_string_char_code_at(EJSPrimString* primstr, int i)
 {
@@ -2365,54 +2707,52 @@ _ejs_string_char_code_at(EJSPrimString* primstr, int i)
         return (jschar)-1;
     }
 
-    switch (EJS_PRIMSTR_GET_TYPE(primstr)) {
-    case EJS_STRING_FLAT:
-        return primstr->data.flat[i];
-    case EJS_STRING_ROPE: {
-        if (i >= primstr->data.rope.left->length) {
-            return _ejs_string_char_code_at (primstr->data.rope.left, i);
-        }
-        else {
-            return _ejs_string_char_code_at (primstr->data.rope.right, i - primstr->data.rope.left->length);
-        }
-    }
-    case EJS_STRING_DEPENDENT: {
-        return _ejs_string_char_code_at (primstr->data.dependent.dep, i + primstr->data.dependent.off);
-    }
-    default:
-        EJS_NOT_IMPLEMENTED();
-    }
+    return _ejs_string_ucs2_at (primstr, i);
+}
+
+// writes @primstr's contents (flat) to @buf as utf8, followed by a 0, and returns the number of
+// bytes before the 0.  @buf needs room for UTF8_BUFFER_SIZE(primstr) bytes.
+#define UTF8_BUFFER_SIZE(primstr) ((size_t)(primstr)->length * (EJS_PRIMSTR_IS_LATIN1(primstr) ? 2 : 3) + 1)
+
+static size_t
+flat_to_utf8 (EJSPrimString* primstr, char* buf)
+{
+    int len;
+    if (EJS_PRIMSTR_IS_LATIN1(primstr))
+        len = latin1_to_utf8 (primstr->data.latin1, primstr->length, buf);
+    else
+        len = utf16_to_utf8 (primstr->data.flat, primstr->length, buf);
+    buf[len] = 0;
+    return len;
 }
 
 char*
 _ejs_string_to_utf8(EJSPrimString* primstr)
 {
-    int length = primstr->length * 4+1;
-    char* buf = (char*)malloc(length);
-    char *p = buf;
-
-    for (int i = 0; i < primstr->length; i ++) {
-        jschar ucs2 = _ejs_string_char_code_at(primstr, i);
-        if (ucs2 == (jschar)-1) {
-            free (buf);
-            char error_buf[256];
-            snprintf (error_buf, sizeof(error_buf), "error converting ucs2 to utf8, index %d\n", i);
-            return strdup(error_buf);
-        }
-        int adv = ucs2_to_utf8_char (ucs2, p);
-        if (adv < 1) {
-            printf ("error converting ucs2 to utf8, index %d\n", i);
-            free(buf);
-            return NULL;
-        }
-        p += adv;
-    }
-
-    *p = 0;
+    primstr = _ejs_primstring_flatten_any (primstr);
 
+    char* buf = (char*)malloc(UTF8_BUFFER_SIZE(primstr));
+    flat_to_utf8 (primstr, buf);
     return buf;
 }
 
+void
+_ejs_string_utf8_buffer_init (EJSUtf8Buffer* utf8, ejsval str)
+{
+    EJSPrimString* primstr = _ejs_primstring_flatten_any (EJSVAL_TO_STRING(str));
+    size_t size = UTF8_BUFFER_SIZE(primstr);
+
+    utf8->str = size <= sizeof(utf8->inline_buffer) ? utf8->inline_buffer : (char*)malloc(size);
+    utf8->length = flat_to_utf8 (primstr, utf8->str);
+}
+
+void
+_ejs_string_utf8_buffer_free (EJSUtf8Buffer* utf8)
+{
+    if (utf8->str != utf8->inline_buffer)
+        free (utf8->str);
+}
+
 void
 _ejs_string_init_literal (const char *name, ejsval *val, EJSPrimString* str, jschar* ucs2_data, int32_t length)
 {
@@ -2420,17 +2760,138 @@ _ejs_string_init_literal (const char *name, ejsval *val, EJSPrimString* str, jsc
     str->hash = 0;
     str->gc_header = (EJS_STRING_FLAT|EJS_PRIMSTR_HAS_OOL_BUFFER_MASK) << EJS_GC_USER_FLAGS_SHIFT;
     str->data.flat = ucs2_data;
-    *val = STRING_TO_EJSVAL(str);
+    *val = _ejs_string_intern (STRING_TO_EJSVAL(str));
+
+    // the literal's contents were already interned in a string the collector might free
+    if (EJSVAL_TO_STRING_IMPL(*val) != str)
+        _ejs_gc_add_root (val);
+}
+
+/* atoms */
+
+// an open addressed set of every atom, sized in powers of 2.  it's malloced, not in the gc heap,
+// and isn't a root.
+static EJSPrimString** atoms;
+static uint32_t atoms_size;
+static uint32_t atoms_count;
+
+static EJSPrimString*
+find_atom (EJSPrimString* flat, uint32_t hash, uint32_t *index)
+{
+    uint32_t mask = atoms_size - 1;
+    uint32_t i = hash & mask;
+    for (; atoms[i]; i = (i + 1) & mask) {
+        EJSPrimString* atom = atoms[i];
+        if (atom->length == flat->length && (uint32_t)atom->hash == hash &&
+            flat_chars_equal (atom, 0, flat, 0, flat->length))
+            return atom;
+    }
+    *index = i;
+    return NULL;
+}
+
+// rebuilds the table with room for @new_size atoms, dropping the ones the collector's about to
+// sweep if @purge is set
+static void
+resize_atoms (uint32_t new_size, EJSBool purge)
+{
+    EJSPrimString** old_atoms = atoms;
+    uint32_t old_size = atoms_size;
+
+    atoms = (EJSPrimString**)calloc (new_size, sizeof(EJSPrimString*));
+    atoms_size = new_size;
+    atoms_count = 0;
+
+    for (uint32_t i = 0; i < old_size; i ++) {
+        EJSPrimString* atom = old_atoms[i];
+        if (!atom || (purge && _ejs_gc_is_collectable (atom)))
+            continue;
+        uint32_t mask = atoms_size - 1;
+        uint32_t j = (uint32_t)atom->hash & mask;
+        while (atoms[j])
+            j = (j + 1) & mask;
+        atoms[j] = atom;
+        atoms_count ++;
+    }
+
+    free (old_atoms);
+}
+
+ejsval
+_ejs_string_intern (ejsval str)
+{
+    EJSPrimString* primstr = EJSVAL_TO_STRING_IMPL(str);
+    if (EJS_PRIMSTR_IS_ATOM(primstr))
+        return str;
+
+    if (!atoms)
+        resize_atoms (1024, EJS_FALSE);
+
+    primstr = _ejs_primstring_flatten_any (primstr);
+    uint32_t hash = _ejs_primstring_hash (primstr);
+    uint32_t index;
+    EJSPrimString* atom = find_atom (primstr, hash, &index);
+    if (atom) {
+        _ejs_gc_shade (atom);
+        return STRING_TO_EJSVAL(atom);
+    }
+
+    EJS_PRIMSTR_SET_ATOM(primstr);
+    atoms[index] = primstr;
+    atoms_count ++;
+    if (atoms_count * 2 > atoms_size)
+        resize_atoms (atoms_size * 2, EJS_FALSE);
+    return str;
+}
+
+ejsval
+_ejs_string_find_atom (ejsval str)
+{
+    EJSPrimString* primstr = EJSVAL_TO_STRING_IMPL(str);
+    if (EJS_PRIMSTR_IS_ATOM(primstr))
+        return str;
+
+    if (!atoms)
+        return _ejs_undefined;
+
+    primstr = _ejs_primstring_flatten_any (primstr);
+    uint32_t index;
+    EJSPrimString* atom = find_atom (primstr, _ejs_primstring_hash (primstr), &index);
+    if (!atom)
+        return _ejs_undefined;
+    _ejs_gc_shade (atom);
+    return STRING_TO_EJSVAL(atom);
+}
+
+void
+_ejs_string_purge_atoms ()
+{
+    if (!atoms)
+        return;
+
+    uint32_t live = 0;
+    for (uint32_t i = 0; i < atoms_size; i ++) {
+        if (atoms[i] && !_ejs_gc_is_collectable (atoms[i]))
+            live ++;
+    }
+    if (live == atoms_count)
+        return;
+
+    // rebuilding the table drops the dead atoms without leaving holes in probe sequences
+    uint32_t new_size = atoms_size;
+    while (new_size > 1024 && live * 8 < new_size)
+        new_size >>= 1;
+    resize_atoms (new_size, EJS_TRUE);
 }
 
 char*
 _ejs_string_describe (ejsval str)
 {
-    return ucs2_to_utf8(EJSVAL_TO_FLAT_STRING(str));
+    return _ejs_string_to_utf8(EJSVAL_TO_STRING(str));
 }
 
 char*
 _ejs_string_describe_prim (EJSPrimString *str)
 {
-    return ucs2_to_utf8(_ejs_primstring_flatten(str)->data.flat);
+    return _ejs_string_to_utf8(str);
 }
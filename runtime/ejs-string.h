@@ -74,6 +74,25 @@ typedef enum {
 #define EJS_PRIMSTR_HAS_OOL_BUFFER(s) ((((EJSPrimString*)(s))->gc_header & EJS_PRIMSTR_HAS_OOL_BUFFER_MASK_SHIFTED) >> EJS_GC_USER_FLAGS_SHIFT) != 0
 #define EJS_PRIMSTR_SET_HAS_OOL_BUFFER(s) ((((EJSPrimString*)(s))->gc_header |= EJS_PRIMSTR_HAS_OOL_BUFFER_MASK_SHIFTED))
 
+// if the string is the interned copy of its contents (an atom.)  only atoms are used as property
+// keys, so keys can be compared by pointer.
+#define EJS_PRIMSTR_ATOM_MASK 0x20
+#define EJS_PRIMSTR_ATOM_MASK_SHIFTED (EJS_PRIMSTR_ATOM_MASK << EJS_GC_USER_FLAGS_SHIFT)
+#define EJS_PRIMSTR_IS_ATOM(s) ((((EJSPrimString*)(s))->gc_header & EJS_PRIMSTR_ATOM_MASK_SHIFTED) != 0)
+#define EJS_PRIMSTR_SET_ATOM(s) ((((EJSPrimString*)(s))->gc_header |= EJS_PRIMSTR_ATOM_MASK_SHIFTED))
+
+// if every character in the string is <= 0xff.  flat strings with this set store one byte per
+// character in data.latin1.  ropes and dependent strings get it when everything they're built from
+// has it, so flattening them knows the width up front.
+#define EJS_PRIMSTR_LATIN1_MASK 0x40
+#define EJS_PRIMSTR_LATIN1_MASK_SHIFTED (EJS_PRIMSTR_LATIN1_MASK << EJS_GC_USER_FLAGS_SHIFT)
+#define EJS_PRIMSTR_IS_LATIN1(s) ((((EJSPrimString*)(s))->gc_header & EJS_PRIMSTR_LATIN1_MASK_SHIFTED) != 0)
+#define EJS_PRIMSTR_SET_LATIN1(s) ((((EJSPrimString*)(s))->gc_header |= EJS_PRIMSTR_LATIN1_MASK_SHIFTED))
+#define EJS_PRIMSTR_CLEAR_LATIN1(s) ((((EJSPrimString*)(s))->gc_header &= ~EJS_PRIMSTR_LATIN1_MASK_SHIFTED))
+
+// character @i of a flat string of either width
+#define EJS_PRIMSTR_FLAT_CHAR_AT(s,i) (EJS_PRIMSTR_IS_LATIN1(s) ? (jschar)(s)->data.latin1[i] : (s)->data.flat[i])
+
 struct _EJSPrimString {
     GCObjectHeader gc_header;
     uint32_t length;
@@ -83,9 +102,13 @@ struct _EJSPrimString {
         //    for flattened strings, this points to the memory location just beyond this struct - i.e. (char*)primStringPointer + sizeof(_EJSPrimString)
         //    for atoms/string literals, this points to the statically compiled C string constant.
         jschar *flat;
+        // the same buffer for latin1 flat strings
+        uint8_t *latin1;
         struct {
             struct _EJSPrimString *left;
             struct _EJSPrimString *right;
+            // the longest path from here to a flat or dependent string
+            uint32_t depth;
         } rope;
         struct {
             struct _EJSPrimString *dep;
@@ -95,28 +118,79 @@ struct _EJSPrimString {
 };
 
 #define EJS_PRIMSTR_FLAT_ALLOC_SIZE (offsetof(struct _EJSPrimString, data.flat) + sizeof(jschar*))
-#define EJS_PRIMSTR_ROPE_ALLOC_SIZE (offsetof(struct _EJSPrimString, data.rope.right) + sizeof(struct _EJSPrimString*))
+#define EJS_PRIMSTR_ROPE_ALLOC_SIZE (offsetof(struct _EJSPrimString, data.rope.depth) + sizeof(uint32_t))
 #define EJS_PRIMSTR_DEP_ALLOC_SIZE  (offsetof(struct _EJSPrimString, data.dependent.off) + sizeof(int))
 
 ejsval _ejs_string_new_utf8 (const char* str);
 ejsval _ejs_string_new_utf8_len (const char* str, int len);
 ejsval _ejs_string_new_ucs2 (const jschar* str);
 ejsval _ejs_string_new_ucs2_len (const jschar* str, int len);
+ejsval _ejs_string_new_latin1_len (const uint8_t* str, int len);
 ejsval _ejs_string_new_substring (ejsval str, int off, int len);
 
 ejsval _ejs_string_concat (ejsval left, ejsval right);
 ejsval _ejs_string_concatv (ejsval first, ...);
+// concatenates all @argc strings in @args into one flat string.  the compiler uses this for
+// template literals.
+ejsval _ejs_string_concatn (uint32_t argc, ejsval* args);
 EJSPrimString* _ejs_string_flatten (ejsval str);
 EJSPrimString* _ejs_primstring_flatten (EJSPrimString* primstr);
+// these flatten without widening, so the result's characters are in data.latin1 if it's
+// EJS_PRIMSTR_IS_LATIN1, and data.flat otherwise.  _ejs_string_flatten and EJSVAL_TO_FLAT_STRING
+// always hand back ucs2.
+EJSPrimString* _ejs_string_flatten_any (ejsval str);
+EJSPrimString* _ejs_primstring_flatten_any (EJSPrimString* primstr);
+
+// a growable buffer for putting a string together out of many pieces without a rope node (and
+// later a flatten) per piece.  it holds latin1 characters until a piece needs more than a byte,
+// and ucs2 from then on.  _ejs_string_builder_finish makes a flat string that takes over the
+// buffer rather than copying it, unless the result is small.
+typedef struct {
+    EJSBool latin1;
+    uint32_t length;
+    size_t capacity; // in bytes
+    void* buffer;
+    uint8_t inline_buffer[256];
+} EJSStringBuilder;
+
+void   _ejs_string_builder_init (EJSStringBuilder* builder);
+void   _ejs_string_builder_append (EJSStringBuilder* builder, ejsval str);
+ejsval _ejs_string_builder_finish (EJSStringBuilder* builder);
+// frees the buffer of a builder that's being given up on, say because making a piece threw
+void   _ejs_string_builder_discard (EJSStringBuilder* builder);
 
 jschar _ejs_string_ucs2_at (EJSPrimString* primstr, uint32_t offset);
 
 uint32_t _ejs_string_hash (ejsval str);
 
+// like ucs2_strcmp, but for strings of either width
+int32_t _ejs_primstring_compare (EJSPrimString* a, EJSPrimString* b);
+EJSBool _ejs_primstring_equal (EJSPrimString* a, EJSPrimString* b);
+
 char* _ejs_string_to_utf8(EJSPrimString* primstr);
 
+// a string's contents as utf8, kept in inline_buffer (so usually on the caller's stack) when they
+// fit, so handing a short string to a write or a libc call doesn't need a malloc.
+typedef struct {
+    char* str;      // 0 terminated, though the string can have 0s of its own
+    size_t length;  // in bytes, not counting the terminator
+    char inline_buffer[256];
+} EJSUtf8Buffer;
+
+void _ejs_string_utf8_buffer_init (EJSUtf8Buffer* utf8, ejsval str);
+void _ejs_string_utf8_buffer_free (EJSUtf8Buffer* utf8);
+
 void _ejs_string_init_literal (const char *name, ejsval *val, EJSPrimString* str, jschar* ucs2_data, int32_t length);
 
+// the atom with @str's contents.  if there isn't one yet, @str is flattened and becomes it.
+ejsval _ejs_string_intern (ejsval str);
+// the atom with @str's contents, or undefined if there isn't one (in which case no object has a
+// property with that name.)
+ejsval _ejs_string_find_atom (ejsval str);
+// atoms are weak.  the collector calls this between marking and sweeping to drop the ones nothing
+// else refers to.
+void _ejs_string_purge_atoms ();
+
 ejsval GetReplaceSubstitution(ejsval matched, ejsval string, int position, ejsval captures, ejsval replacement);
 
 #define EJSVAL_IS_STRINGITERATOR(v) (EJSVAL_IS_OBJECT(v) && (EJSVAL_TO_OBJECT(v)->ops == &_ejs_StringIterator_specops))
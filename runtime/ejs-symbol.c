@@ -181,6 +181,7 @@ _ejs_symbol_new (ejsval description)
     _ejs_init_object((EJSObject*)rv, _ejs_Symbol_prototype, &_ejs_Symbol_specops);
 
     rv->description = EJSVAL_IS_UNDEFINED(description) ? description : ToString(description);
+    _ejs_gc_write_barrier(rv, rv->description);
 
     return OBJECT_TO_EJSVAL(rv);
 }
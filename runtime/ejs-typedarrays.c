@@ -195,6 +195,7 @@ _ejs_DataView_impl (ejsval env, ejsval _this, uint32_t argc, ejsval *args)
     }
 
     view->buffer = args[0];
+    _ejs_gc_write_barrier(view, view->buffer);
     view->byteOffset = offset;
     view->byteLength = len;
 
@@ -428,6 +429,7 @@ EJS_DATA_VIEW_METHOD_IMPL(Float64, double, 8);
          _ejs_log ("arg0 not a number or object...\n");                      \
          EJS_NOT_IMPLEMENTED();                                         \
      }                                                                  \
+     _ejs_gc_write_barrier(arr, arr->buffer);                           \
                                                                         \
      _ejs_object_define_value_property (_this, _ejs_atom_length, DOUBLE_TO_EJSVAL_IMPL(arr->length), EJS_PROP_FLAGS_ENUMERABLE); \
      _ejs_object_define_value_property (_this, _ejs_atom_byteOffset, DOUBLE_TO_EJSVAL_IMPL(arr->byteOffset), EJS_PROP_FLAGS_ENUMERABLE); \
@@ -440,20 +442,9 @@ EJS_DATA_VIEW_METHOD_IMPL(Float64, double, 8);
  static ejsval                                                          \
  _ejs_##ArrayType##array_specop_get (ejsval obj, ejsval propertyName, ejsval receiver)  \
  {                                                                      \
-     /* check if propertyName is an integer, or a string that we can convert to an int */ \
-     EJSBool is_index = EJS_FALSE;                                      \
-     ejsval idx_val = ToNumber(propertyName);                           \
      int idx;                                                           \
-     if (EJSVAL_IS_NUMBER(idx_val)) {                                   \
-         double n = EJSVAL_TO_NUMBER(idx_val);                          \
-         if (floor(n) == n) {                                           \
-             idx = (int)n;                                              \
-             is_index = EJS_TRUE;                                       \
-         }                                                              \
-     }                                                                  \
-                                                                        \
-     if (is_index) {                                                    \
-         if (idx < 0 || idx > EJS_TYPEDARRAY_LEN(obj)) {                \
+     if (_ejs_array_index(propertyName, &idx)) {                        \
+         if (idx >= EJS_TYPEDARRAY_LEN(obj)) {                          \
              return _ejs_undefined;                                     \
          }                                                              \
          void* data = _ejs_typedarray_get_data (EJSVAL_TO_OBJECT(obj)); \
@@ -461,7 +452,7 @@ EJS_DATA_VIEW_METHOD_IMPL(Float64, double, 8);
      }                                                                  \
                                                                         \
      /* we also handle the length getter here */                        \
-     if (EJSVAL_IS_STRING(propertyName) && !ucs2_strcmp (_ejs_ucs2_length, EJSVAL_TO_FLAT_STRING(propertyName))) { \
+     if (EJSVAL_IS_STRING(propertyName) && _ejs_primstring_equal (EJSVAL_TO_STRING(propertyName), EJSVAL_TO_STRING(_ejs_atom_length))) { \
          return NUMBER_TO_EJSVAL (EJS_TYPEDARRAY_LEN(obj));             \
      }                                                                  \
                                                                         \
@@ -470,7 +461,7 @@ EJS_DATA_VIEW_METHOD_IMPL(Float64, double, 8);
  }                                                                      \
                                                                         \
  static EJSPropertyDesc*                                                \
- _ejs_##ArrayType##array_specop_get_own_property (ejsval obj, ejsval propertyName, ejsval* exc) \
+ _ejs_##ArrayType##array_specop_get_own_property (ejsval obj, ejsval propertyName, ejsval* exc, EJSPropertyDesc* desc) \
  {                                                                      \
      if (EJSVAL_IS_NUMBER(propertyName)) {                              \
          double needle = EJSVAL_TO_NUMBER(propertyName);                \
@@ -480,26 +471,15 @@ EJS_DATA_VIEW_METHOD_IMPL(Float64, double, 8);
                  return NULL; /* XXX */                                 \
          }                                                              \
      }                                                                  \
-     return _ejs_Object_specops.GetOwnProperty (obj, propertyName, exc); \
+     return _ejs_Object_specops.GetOwnProperty (obj, propertyName, exc, desc); \
  }                                                                      \
                                                                         \
  static EJSBool                                                         \
  _ejs_##ArrayType##array_specop_set (ejsval obj, ejsval propertyName, ejsval val, ejsval receiver) \
  {                                                                      \
-     /* check if propertyName is an integer, or a string that we can convert to an int */ \
-     EJSBool is_index = EJS_FALSE;                                      \
-     ejsval idx_val = ToNumber(propertyName);                           \
      int idx;                                                           \
-     if (EJSVAL_IS_NUMBER(idx_val)) {                                   \
-         double n = EJSVAL_TO_NUMBER(idx_val);                          \
-         if (floor(n) == n) {                                           \
-             idx = (int)n;                                              \
-             is_index = EJS_TRUE;                                       \
-         }                                                              \
-     }                                                                  \
-                                                                        \
-     if (is_index) {                                                    \
-         if (idx < 0 || idx >= EJS_TYPEDARRAY_LEN(obj)) {               \
+     if (_ejs_array_index(propertyName, &idx)) {                        \
+         if (idx >= EJS_TYPEDARRAY_LEN(obj)) {                          \
              return EJS_TRUE;                                           \
          }                                                              \
          void* data = _ejs_typedarray_get_data (EJSVAL_TO_OBJECT(obj)); \
@@ -807,7 +787,7 @@ _ejs_arraybuffer_specop_get (ejsval obj, ejsval propertyName, ejsval receiver)
     }
 
     // we also handle the length getter here
-    if (EJSVAL_IS_STRING(propertyName) && !ucs2_strcmp (_ejs_ucs2_byteLength, EJSVAL_TO_FLAT_STRING(propertyName))) {
+    if (EJSVAL_IS_STRING(propertyName) && _ejs_primstring_equal (EJSVAL_TO_STRING(propertyName), EJSVAL_TO_STRING(_ejs_atom_byteLength))) {
         return NUMBER_TO_EJSVAL (EJS_ARRAY_BUFFER_BYTE_LEN(obj));
     }
 
@@ -816,7 +796,7 @@ _ejs_arraybuffer_specop_get (ejsval obj, ejsval propertyName, ejsval receiver)
 }
 
 static EJSPropertyDesc*
-_ejs_arraybuffer_specop_get_own_property (ejsval obj, ejsval propertyName, ejsval *exc)
+_ejs_arraybuffer_specop_get_own_property (ejsval obj, ejsval propertyName, ejsval *exc, EJSPropertyDesc* desc)
 {
     if (EJSVAL_IS_NUMBER(propertyName)) {
         double needle = EJSVAL_TO_NUMBER(propertyName);
@@ -829,7 +809,7 @@ _ejs_arraybuffer_specop_get_own_property (ejsval obj, ejsval propertyName, ejsva
 
     // XXX we need to handle the length property here (see EJSArray's get_own_property)
 
-    return _ejs_Object_specops.GetOwnProperty (obj, propertyName, exc);
+    return _ejs_Object_specops.GetOwnProperty (obj, propertyName, exc, desc);
 }
 
 static EJSBool
@@ -998,7 +978,7 @@ _ejs_dataview_specop_get (ejsval obj, ejsval propertyName, ejsval receiver)
 }
 
 static EJSPropertyDesc*
-_ejs_dataview_specop_get_own_property (ejsval obj, ejsval propertyName, ejsval* exc)
+_ejs_dataview_specop_get_own_property (ejsval obj, ejsval propertyName, ejsval* exc, EJSPropertyDesc* desc)
 {
     if (EJSVAL_IS_NUMBER(propertyName)) {
         double needle = EJSVAL_TO_NUMBER(propertyName);
@@ -1009,7 +989,7 @@ _ejs_dataview_specop_get_own_property (ejsval obj, ejsval propertyName, ejsval*
         }
     }
 
-    return _ejs_Object_specops.GetOwnProperty (obj, propertyName, exc);
+    return _ejs_Object_specops.GetOwnProperty (obj, propertyName, exc, desc);
 }
 
 static EJSBool
@@ -96,6 +96,8 @@ _ejs_list_pop_head (EJSList *list)
     return;
 
   list->head = head->next;
+  if (list->head)
+    list->head->prev = NULL;
   if (head == list->tail)
     list->tail = NULL;
 
@@ -75,6 +75,7 @@ typedef int32_t EJSBool;
 typedef struct _EJSPrimString EJSPrimString;
 typedef struct _EJSClosureEnv EJSClosureEnv;
 typedef struct _EJSObject EJSObject;
+typedef struct _EJSShape EJSShape;
 
 #include "ejsval.h"
 #include "ejs-value.h"
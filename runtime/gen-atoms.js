@@ -64,6 +64,6 @@ console.log ("static void _ejs_init_static_strings() {");
 for (var an = 0, ae = atom_names.length; an < ae; an ++) {
   var atom = atom_names[an];
   console.log ("    _ejs_primstring_" + atom + ".data.flat = (jschar*)_ejs_ucs2_" + atom + ";");
-  console.log ("    _ejs_atom_" + atom + " = STRING_TO_EJSVAL((EJSPrimString*)&_ejs_primstring_" + atom + ");");
+  console.log ("    _ejs_atom_" + atom + " = _ejs_string_intern(STRING_TO_EJSVAL((EJSPrimString*)&_ejs_primstring_" + atom + "));");
 }
 console.log ("}");
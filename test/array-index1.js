@@ -0,0 +1,39 @@
+// element loads and stores with every kind of index, in and out of the open-coded path
+
+var a = [10, 11, 12, 13];
+var sum = 0;
+for (var i = 0; i < a.length; i ++) {
+  a[i] = a[i] * 2;
+  sum += a[i];
+}
+console.log(sum);
+
+console.log(a[1.5]);
+console.log(a[-1]);
+console.log(a[4]);
+console.log(a[-0]);
+console.log(a["2"]);
+
+a[1.5] = "frac";
+a[-1] = "neg";
+console.log(a[1.5], a[-1], a.length);
+
+var holes = [];
+holes[3] = 3;
+console.log(holes[0], holes[3], holes.length);
+
+var notarray = { 0: "zero", length: 1 };
+console.log(notarray[0]);
+
+var s = "str";
+console.log(s[1]);
+
+var t = new Int32Array(4);
+t[2] = 5;
+t[4] = 6;
+console.log(t[2], t[4], t.length);
+
+var grow = [];
+for (var j = 0; j < 100; j ++)
+  grow[j] = j;
+console.log(grow[99], grow.length);
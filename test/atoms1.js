@@ -0,0 +1,27 @@
+// property names built at runtime have to find the properties named by literals, and the other way around
+
+var obj = { alpha: 1, beta: 2 };
+var prefix = "al";
+
+console.log(obj[prefix + "pha"]);
+console.log(obj["be" + "ta".toString()]);
+
+for (var i = 0; i < 2000; i ++) {
+  obj["k" + i] = i;
+  var garbage = { };
+  garbage["g" + i] = "x" + i;
+}
+
+console.log(obj.k1999);
+console.log(obj["k" + (1000 + 500)]);
+console.log(obj["g" + 10]);
+
+var keys = Object.keys({ gamma: 1 });
+var o2 = {};
+o2[keys[0]] = "from keys";
+console.log(o2.gamma);
+
+delete obj["al" + "pha"];
+console.log(obj.alpha);
+console.log("alpha" in obj);
+console.log(["be", "ta"].join("") in obj);
@@ -0,0 +1,35 @@
+// objects used as dictionaries: lots of keys, deletes, and keys coming back in insertion order
+
+var dict = {};
+for (var i = 0; i < 10000; i ++)
+  dict["key" + i] = i;
+
+for (var j = 0; j < 10000; j ++) {
+  if (j % 3 != 0)
+    delete dict["key" + j];
+}
+
+dict.key1 = "back";
+
+var count = 0;
+var first = [];
+for (var k in dict) {
+  if (first.length < 4)
+    first.push(k);
+  count ++;
+}
+
+console.log(count);
+console.log(first.join(","));
+console.log(Object.keys(dict).pop());
+console.log(dict.key9999);
+console.log(dict.key9998);
+console.log("key2" in dict);
+
+for (var r = 0; r < 50; r ++) {
+  for (var n = 0; n < 200; n ++)
+    dict["tmp" + n] = n;
+  for (var n = 0; n < 200; n ++)
+    delete dict["tmp" + n];
+}
+console.log(Object.keys(dict).length);
@@ -0,0 +1,39 @@
+// long lived objects that are repeatedly handed short lived values
+
+var cache = {};
+var list = [];
+var counter = 0;
+
+function remember(key, value) {
+  cache[key] = value;
+  list.push(value);
+}
+
+function make_counter() {
+  var captured = null;
+  return {
+    set: function (v) { captured = v; },
+    get: function () { return captured; }
+  };
+}
+
+var c = make_counter();
+
+for (var i = 0; i < 200000; i ++) {
+  var tmp = { index: i, name: "item" + i };
+  if (i % 1000 == 0) {
+    remember("k" + (i / 1000), tmp);
+    c.set({ last: tmp.name });
+  }
+  counter += tmp.index % 7;
+}
+
+var sum = 0;
+for (var j = 0; j < list.length; j ++)
+  sum += list[j].index;
+
+console.log(list.length);
+console.log(sum);
+console.log(cache.k150.name);
+console.log(c.get().last);
+console.log(counter);
@@ -0,0 +1,31 @@
+// growing arrays and property maps while the collector runs, then deleting from them
+
+var obj = {};
+var arr = [];
+
+for (var i = 0; i < 20000; i ++) {
+  obj["p" + i] = { value: i };
+  arr.push("e" + i);
+  var garbage = { a: [i, i + 1, i + 2], b: "x" + i };
+}
+
+for (var j = 0; j < 20000; j += 2)
+  delete obj["p" + j];
+
+for (var k = 0; k < 100000; k ++) {
+  var tmp = [k, { k: k }];
+}
+
+var sum = 0;
+var count = 0;
+for (var key in obj) {
+  sum += obj[key].value;
+  count ++;
+}
+
+console.log(count);
+console.log(sum);
+console.log(obj.p19999.value);
+console.log(obj.p0);
+console.log(arr.length);
+console.log(arr[12345]);
@@ -0,0 +1,38 @@
+// property loads and stores whose cached shapes and prototypes change underneath them
+
+function A(v) { this.v = v; }
+A.prototype.kind = "a";
+function B(v) { this.w = 0; this.v = v; }
+B.prototype.kind = "b";
+
+function getV(o) { return o.v; }
+function getKind(o) { return o.kind; }
+function setZ(o, z) { o.z = z; return o; }
+
+var objs = [];
+for (var i = 0; i < 12; i ++) {
+  var o = (i % 3 == 0) ? new A(i) : (i % 3 == 1) ? new B(i) : { v: i, kind: "literal" };
+  objs.push(setZ(o, i * 2));
+}
+
+var out = [];
+for (var j = 0; j < objs.length; j ++)
+  out.push(getV(objs[j]) + getKind(objs[j]) + objs[j].z);
+console.log(out.join(","));
+
+A.prototype.kind = "A";
+console.log(getKind(objs[0]), getKind(objs[3]));
+
+var setterCalls = 0;
+Object.defineProperty(B.prototype, "z", { set: function(v) { setterCalls ++; }, get: function() { return "getter"; } });
+var b = setZ(new B(100), 5);
+console.log(setterCalls, b.z, Object.keys(b));
+
+Object.defineProperty(A.prototype, "z", { value: "readonly", writable: false });
+var a = setZ(new A(200), 6);
+console.log(a.z, Object.keys(a));
+
+var sealed = new A(300);
+Object.preventExtensions(sealed);
+setZ(sealed, 7);
+console.log(sealed.z, Object.keys(sealed));
@@ -0,0 +1,26 @@
+// number op number is open-coded, everything else still goes through the runtime
+
+var sum = 0;
+for (var i = 0; i < 1000; i ++)
+  sum = sum + i * 2 - i / 2;
+console.log(sum);
+
+console.log(7 % 3, -7 % 3, 1 / (-1 % 1), 5.5 % 2);
+console.log(1 / 0, -1 / 0, 0 / 0);
+console.log(0 / 0 === 0 / 0, 0 / 0 !== 0 / 0, 0 === -0, 1 == 1, 1 != 1);
+console.log(1 < 2, 2 <= 2, 3 > 4, 4 >= 5, 0 / 0 < 1, 0 / 0 >= 1);
+
+console.log(5 & 3, 5 | 3, 5 ^ 3, 1 << 31, 1 << 32, -16 >> 2, -16 >>> 2, -1 >>> 0);
+console.log(1.9 | 0, -1.9 | 0, 2147483647.5 | 0, -2147483648.5 | 0);
+console.log(4294967296 | 0, 4294967297 | 0, 1e20 | 0, (0 / 0) | 0, (1 / 0) | 0);
+console.log(1 << 33, 1 << -1, 8 >> 1.5);
+
+// mixed and non-number operands
+console.log(1 + "2", "3" - 1, "4" * "2", null + 1, true + 1, undefined + 1);
+console.log("5" | 2, "a" < "b", "10" < "9", 10 < "9", "1" == 1, "1" === 1);
+console.log([] + {}, [1] * [2]);
+
+var n = 0;
+while (n < 10 && (n & 7) !== 7)
+  n = n + 1;
+console.log(n);
@@ -0,0 +1,39 @@
+// objects sharing, leaving and outgrowing hidden classes
+
+function Point(x, y) { this.x = x; this.y = y; }
+
+var points = [];
+for (var i = 0; i < 1000; i ++)
+  points.push(new Point(i, -i));
+
+var p = points[10];
+p.z = 3;
+delete p.z;
+console.log(Object.keys(p));
+
+var q = points[20];
+delete q.x;
+q.w = 4;
+console.log(Object.keys(q), q.y, q.w, q.x);
+
+var acc = { a: 1 };
+Object.defineProperty(acc, "b", { get: function() { return this.a + 1; }, enumerable: true });
+acc.c = 3;
+console.log(acc.a, acc.b, acc.c, Object.keys(acc));
+
+Object.defineProperty(acc, "a", { writable: false });
+acc.a = 10;
+console.log(acc.a, acc.b, Object.keys(acc));
+
+var big = {};
+for (var j = 0; j < 100; j ++)
+  big["p" + j] = j;
+var sum = 0;
+for (var key in big)
+  sum += big[key];
+console.log(sum, Object.keys(big).length, big.p0, big.p99);
+
+var total = 0;
+for (var k = 0; k < points.length; k ++)
+  total += points[k].y;
+console.log(total);
@@ -0,0 +1,26 @@
+// template literals and join put their strings together in one buffer instead of a rope, and have
+// to produce the same strings (and call toString in the same order) as concatenating them would
+
+var order = [];
+function tracked(name) { return { toString: function() { order.push(name); return name; } }; }
+
+var a = 1, b = "two", c = "€";
+console.log(`${a}`);
+console.log(`a=${a} b=${b} c=${c}!`);
+console.log(`${a}${b}${c}`);
+console.log(`outer ${`inner ${b} ${`innermost ${a}`}`} done`);
+console.log(`${tracked("x")}-${tracked("y")}-${tracked("z")}`, order.join(" "));
+
+var long = "";
+for (var i = 0; i < 100; i ++)
+  long = `${long}${i % 10}`;
+console.log(long.length, long.substring(95));
+
+console.log([1, null, "é", undefined, 2.5].join());
+console.log([1, 2, 3].join(" - "), [1, 2, 3].join(undefined), ["only"].join("x"), [].join());
+
+var parts = [];
+for (var i = 0; i < 5000; i ++)
+  parts.push(i % 2 ? "ab" : "€");
+var joined = parts.join("");
+console.log(joined.length, joined.charCodeAt(0), joined.substring(7496));
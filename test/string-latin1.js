@@ -0,0 +1,24 @@
+// strings whose characters all fit in a byte are stored that way, and have to behave exactly like
+// the wider ones, including when they're mixed together
+
+var s = "";
+for (var i = 0; i < 40; i ++)
+  s = s + String.fromCharCode(97 + i % 26);
+
+var wide = s + "€";
+var accented = "caf" + "é";
+
+console.log(s);
+console.log(s.length, wide.length, accented.length);
+console.log(wide.charCodeAt(40), accented.charCodeAt(3));
+console.log(s.indexOf("xyz"), s.indexOf("a", 1), s.lastIndexOf("abc"), wide.indexOf("€"));
+console.log(s.substring(30, 35), wide.substring(38));
+console.log(s.startsWith("abc"), wide.endsWith("n€"), s.includes("zab"));
+console.log(s === "abcdefghijklmnopqrstuvwxyzabcdefghijklmn", accented === "café");
+console.log("abc" < "abd", "ÿ" < "€", "z" > accented);
+console.log(Number("1" + "2.5") + 1);
+
+var o = {};
+o[accented] = 1;
+o["café"] += 1;
+console.log(o[accented]);
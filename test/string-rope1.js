@@ -0,0 +1,19 @@
+// strings built a piece at a time make very deep ropes, which have to be flattened, hashed and
+// indexed without recursing once per piece
+
+var s = "";
+for (var i = 0; i < 100000; i ++)
+  s += i % 10;
+
+var t = "";
+for (var i = 0; i < 20000; i ++)
+  t = (i % 7) + "-" + t;
+
+console.log(s.length, t.length);
+console.log(s.charAt(99999), s.charCodeAt(12345), t.charAt(1));
+console.log(s.indexOf("90123", 50000), t.lastIndexOf("6-"));
+console.log(s.substring(99990), t.substring(0, 10));
+
+var o = {};
+o[s] = "found";
+console.log(o[s.substring(0, 50000) + s.substring(50000)]);
@@ -0,0 +1,22 @@
+// searching long strings, in both the widths they can be stored in, and with needles stored in
+// the other width
+
+var line = "2026-10-17 12:00:00 INFO request served in 12ms";
+var log = [];
+for (var i = 0; i < 500; i ++)
+  log.push(i == 377 ? "2026-10-17 12:00:01 ERROR request failed: timeout" : line);
+var text = log.join("\n");
+var wide = text + " — done";
+
+console.log(text.indexOf("ERROR"), wide.indexOf("ERROR"), text.indexOf("ERROR", 18000), text.indexOf("WARN"));
+console.log(text.lastIndexOf("INFO"), wide.lastIndexOf("INFO"), text.lastIndexOf("INFO", 100), wide.lastIndexOf("—"));
+console.log(text.includes("timeout"), wide.includes("— done"), text.includes("— done"));
+console.log(text.indexOf("\n"), text.indexOf("ms\n2026"), wide.indexOf("12ms —"));
+
+var lines = text.split("\n");
+console.log(lines.length, lines[377], lines[499] === line);
+console.log(wide.split(" — ").length, wide.split("ms").length, "a,b,,c,".split(",").length, "abc".split("").length);
+
+var sorted = ["request", "réquest", "requests", "request€", "Request"].sort();
+console.log(sorted.join(" "));
+console.log("abc" < "abd", "€a" > "€", line === log[0], text.substring(0, 47) === line);
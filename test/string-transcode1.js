@@ -0,0 +1,25 @@
+// strings leave and enter the runtime as utf8 (console output, JSON.parse, Number), and have to
+// come through intact whether they're ascii, latin1 or wider, short or long
+
+var ascii = "";
+for (var i = 0; i < 300; i ++)
+  ascii = ascii + String.fromCharCode(32 + i % 95);
+
+var mixed = "";
+for (var i = 0; i < 100; i ++)
+  mixed = mixed + "a" + "é" + "€" + "😀";
+
+console.log(ascii);
+console.log(mixed);
+console.log("café", "€", "😀", "ÿĀ");
+console.log(mixed.length, mixed.charCodeAt(3), mixed.charCodeAt(4), mixed.codePointAt(3));
+
+var parsed = JSON.parse('{"name": "café", "sym": "€", "face": "😀", "list": ["ü", "' + ascii.substring(16, 56) + '"]}');
+console.log(parsed.name, parsed.name.length, parsed.sym.charCodeAt(0), parsed.face.length, parsed.list[0], parsed.list[1]);
+
+var digits = "";
+for (var i = 0; i < 200; i ++)
+  digits = digits + (i % 10);
+console.log(Number("12.5"), Number("1" + "e3"), Number("3€"), Number("é"), Number(digits) > 1e198);
+
+console.log("ÉCOLE".toLowerCase().length, ("abc" + "€").toUpperCase(), ("xyz" + "é").toUpperCase().length);